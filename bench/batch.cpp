@@ -0,0 +1,265 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Renders a set of objects that use a few different meshes, submitted in
+// random order, first with one draw call per object and then through a
+// VkdfBatch, which sorts them by mesh and draws each mesh once with
+// instancing. Command buffers are recorded every frame and the cost of
+// batching is included in the recording time.
+// ----------------------------------------------------------------------------
+
+#define NUM_OBJECTS 4096
+#define NUM_MESHES  4
+
+typedef struct {
+   BenchTarget target;
+   BenchScene scene;
+   VkShaderModule vs_module;
+   VkPipeline pipeline;
+   VkCommandPool cmd_pool;
+   VkCommandBuffer cmd_buf;
+
+   VkdfModel *models[NUM_MESHES];
+   VkdfObject *objects[NUM_OBJECTS];
+
+   // Per-object instance data for the non-batched draws, in the same
+   // order as 'objects'
+   VkdfBuffer instance_buf;
+
+   VkdfBatch *batch;
+} BenchResources;
+
+static VkPipeline
+create_pipeline(VkdfContext *ctx, BenchResources *res)
+{
+   VkVertexInputBindingDescription vi_binding[2];
+   VkVertexInputAttributeDescription vi_attribs[7];
+
+   // Vertex attribute binding 0: position, normal
+   vi_binding[0].binding = 0;
+   vi_binding[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+   vi_binding[0].stride = 2 * sizeof(glm::vec3);
+
+   // Vertex attribute binding 1: VkdfBatchInstance
+   vi_binding[1].binding = 1;
+   vi_binding[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+   vi_binding[1].stride = sizeof(VkdfBatchInstance);
+
+   // binding 0, location 0: position
+   vi_attribs[0].binding = 0;
+   vi_attribs[0].location = 0;
+   vi_attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+   vi_attribs[0].offset = 0;
+
+   // binding 0, location 1: normal
+   vi_attribs[1].binding = 0;
+   vi_attribs[1].location = 1;
+   vi_attribs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+   vi_attribs[1].offset = 12;
+
+   // binding 1, locations 2-5: model matrix
+   for (uint32_t i = 0; i < 4; i++) {
+      vi_attribs[2 + i].binding = 1;
+      vi_attribs[2 + i].location = 2 + i;
+      vi_attribs[2 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      vi_attribs[2 + i].offset = i * sizeof(glm::vec4);
+   }
+
+   // binding 1, location 6: material index
+   vi_attribs[6].binding = 1;
+   vi_attribs[6].location = 6;
+   vi_attribs[6].format = VK_FORMAT_R32_SINT;
+   vi_attribs[6].offset = sizeof(glm::mat4);
+
+   return vkdf_create_gfx_pipeline(ctx,
+                                   NULL,
+                                   2,
+                                   vi_binding,
+                                   7,
+                                   vi_attribs,
+                                   true,
+                                   res->target.render_pass,
+                                   res->scene.pipeline_layout,
+                                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                   VK_CULL_MODE_BACK_BIT,
+                                   res->vs_module,
+                                   res->scene.fs_module);
+}
+
+static void
+init_objects(VkdfContext *ctx, BenchResources *res)
+{
+   for (uint32_t m = 0; m < NUM_MESHES; m++) {
+      VkdfMesh *mesh = vkdf_cube_mesh_new(ctx);
+      vkdf_mesh_fill_vertex_buffer(ctx, mesh);
+
+      res->models[m] = vkdf_model_new();
+      vkdf_model_add_mesh(res->models[m], mesh);
+   }
+
+   glm::vec4 *offsets = g_new(glm::vec4, NUM_OBJECTS);
+   bench_random_offsets(offsets, NUM_OBJECTS, 50.0f, 0.5f);
+
+   VkdfBatchInstance *instances = g_new0(VkdfBatchInstance, NUM_OBJECTS);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      VkdfModel *model = res->models[random() % NUM_MESHES];
+      VkdfObject *obj = vkdf_object_new(glm::vec3(offsets[i]), model);
+      vkdf_object_set_scale(obj, glm::vec3(offsets[i].w));
+      obj->material_idx_base = random() % 4;
+      res->objects[i] = obj;
+
+      instances[i].model = vkdf_object_get_model_matrix(obj);
+      instances[i].material_idx = obj->material_idx_base;
+   }
+
+   VkDeviceSize size = NUM_OBJECTS * sizeof(VkdfBatchInstance);
+   res->instance_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   vkdf_buffer_map_and_fill(ctx, res->instance_buf, 0, size, instances);
+
+   g_free(instances);
+   g_free(offsets);
+}
+
+static void
+record_frame(VkdfContext *ctx,
+             BenchResources *res,
+             BenchTimer *timer,
+             bool batched)
+{
+   // Batching happens on the CPU every frame, like in a renderer that
+   // collects the visible objects from a scene
+   if (batched) {
+      vkdf_batch_begin(res->batch, 0);
+      for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+         vkdf_batch_add_object(res->batch, res->pipeline, res->objects[i]);
+      vkdf_batch_end(ctx, res->batch);
+   }
+
+   vkdf_command_buffer_begin(res->cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   bench_timer_gpu_begin(timer, res->cmd_buf);
+   bench_target_begin(&res->target, res->cmd_buf);
+
+   vkdf_cmd_bind_descriptor_sets(res->cmd_buf,
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->scene.pipeline_layout,
+                                 0, 1, &res->scene.descriptor_set,
+                                 0, NULL);
+
+   if (batched) {
+      vkdf_batch_cmd_draw(res->batch, res->cmd_buf, 1, NULL, NULL);
+   } else {
+      vkdf_cmd_bind_pipeline(res->cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                             res->pipeline);
+
+      const VkDeviceSize offsets[1] = { 0 };
+      vkdf_cmd_bind_vertex_buffers(res->cmd_buf, 1, 1,
+                                   &res->instance_buf.buf, offsets);
+
+      // What an application that renders each object on its own does
+      for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+         VkdfMesh *mesh = res->objects[i]->model->meshes[0];
+         vkdf_cmd_bind_vertex_buffers(res->cmd_buf, 0, 1,
+                                      &mesh->vertex_buf.buf, offsets);
+         vkdf_cmd_draw(res->cmd_buf, mesh->vertices.size(), 1, 0, i);
+      }
+   }
+
+   bench_target_end(&res->target, res->cmd_buf);
+   bench_timer_gpu_end(timer, res->cmd_buf);
+
+   vkdf_command_buffer_end(res->cmd_buf);
+}
+
+static void
+run(VkdfContext *ctx, BenchResources *res, BenchOptions *opts,
+    const char *name, bool batched)
+{
+   BenchTimer timer;
+   bench_timer_init(ctx, &timer);
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, batched ? NUM_MESHES : NUM_OBJECTS);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 1);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 1);
+
+   // Warm up
+   record_frame(ctx, res, &timer, batched);
+   vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+   double record_ms = 0.0;
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      bench_timer_frame_start(&timer);
+
+      double start = bench_now_ms();
+      record_frame(ctx, res, &timer, batched);
+      record_ms += bench_now_ms() - start;
+
+      vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+      bench_timer_frame_end(ctx, &timer);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_uint("objects", NUM_OBJECTS);
+   bench_result_uint("meshes", NUM_MESHES);
+   bench_result_double("record_ms", record_ms / opts->frames);
+   bench_result_timer(&timer);
+   bench_result_end();
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, 0);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 0);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 0);
+
+   bench_timer_destroy(ctx, &timer);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchResources res;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   memset(&res, 0, sizeof(BenchResources));
+   bench_target_init(&ctx, &res.target, BENCH_WIDTH, BENCH_HEIGHT);
+   bench_scene_init(&ctx, &res.scene, &res.target, 1);
+   res.vs_module =
+      vkdf_create_shader_module(&ctx, BENCH_SHADER_DIR "/batch.vert.spv");
+   res.pipeline = create_pipeline(&ctx, &res);
+
+   init_objects(&ctx, &res);
+   res.batch = vkdf_batch_new(&ctx, NUM_OBJECTS, 1);
+
+   res.cmd_pool =
+      vkdf_create_gfx_command_pool(&ctx,
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+   vkdf_create_command_buffer(&ctx, res.cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &res.cmd_buf);
+
+   run(&ctx, &res, &opts, "draw_per_object", false);
+   run(&ctx, &res, &opts, "batched", true);
+
+   vkDestroyCommandPool(ctx.device, res.cmd_pool, NULL);
+   vkdf_batch_free(&ctx, res.batch);
+   vkdf_destroy_buffer(&ctx, &res.instance_buf);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+      vkdf_object_free(res.objects[i]);
+   for (uint32_t m = 0; m < NUM_MESHES; m++)
+      vkdf_model_free(&ctx, res.models[m]);
+   vkDestroyPipeline(ctx.device, res.pipeline, NULL);
+   vkDestroyShaderModule(ctx.device, res.vs_module, NULL);
+   bench_scene_destroy(&ctx, &res.scene);
+   bench_target_destroy(&ctx, &res.target);
+   return bench_cleanup(&ctx);
+}
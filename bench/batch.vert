@@ -0,0 +1,25 @@
+#version 400
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout(std140, set = 0, binding = 0) uniform vp_ubo {
+    mat4 ViewProjection;
+} VP;
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+
+// Per-instance data written by VkdfBatch
+layout(location = 2) in mat4 in_model;
+layout(location = 6) in int in_material_idx;
+
+layout(location = 0) out vec3 out_normal;
+
+void main()
+{
+   gl_Position = VP.ViewProjection * in_model * vec4(in_position, 1.0);
+
+   // Tint each material variant differently
+   out_normal = in_normal * (1.0 - 0.2 * float(in_material_idx & 3));
+}
@@ -0,0 +1,623 @@
+#include "bench-common.hpp"
+
+static bool _result_first_field = true;
+
+static uint32_t
+parse_uint_option(const char *arg, const char *name)
+{
+   char *end;
+   unsigned long value = strtoul(arg, &end, 10);
+   if (*arg == '\0' || *end != '\0')
+      vkdf_fatal("Invalid value for option '%s': '%s'", name, arg);
+   return (uint32_t) value;
+}
+
+static void
+parse_options(BenchOptions *opts, int argc, char **argv)
+{
+   opts->frames = BENCH_DEFAULT_FRAMES;
+   opts->seed = BENCH_DEFAULT_SEED;
+   opts->validation = false;
+
+   for (int i = 1; i < argc; i++) {
+      if (g_str_has_prefix(argv[i], "--frames=")) {
+         opts->frames = parse_uint_option(argv[i] + strlen("--frames="),
+                                          "--frames");
+      } else if (g_str_has_prefix(argv[i], "--seed=")) {
+         opts->seed = parse_uint_option(argv[i] + strlen("--seed="),
+                                        "--seed");
+      } else if (!strcmp(argv[i], "--validation")) {
+         opts->validation = true;
+      } else {
+         vkdf_fatal("Unknown option '%s'. "
+                    "Usage: %s [--frames=N] [--seed=N] [--validation]",
+                    argv[i], argv[0]);
+      }
+   }
+
+   if (opts->frames == 0)
+      vkdf_fatal("Number of frames must be greater than 0");
+}
+
+void
+bench_init(VkdfContext *ctx, BenchOptions *opts, int argc, char **argv)
+{
+   parse_options(opts, argc, argv);
+   srandom(opts->seed);
+   vkdf_init_headless(ctx, BENCH_WIDTH, BENCH_HEIGHT, opts->validation);
+}
+
+/**
+ * Returns the exit status for the benchmark program, which fails if any
+ * frame went over a budget set with vkdf_stats_set_budget().
+ */
+int
+bench_cleanup(VkdfContext *ctx)
+{
+   vkdf_cleanup(ctx);
+
+   uint32_t violations = vkdf_stats_get_budget_violations();
+   if (violations > 0) {
+      vkdf_error("%u frames over stats budget", violations);
+      return 1;
+   }
+
+   return 0;
+}
+
+static VkRenderPass
+create_render_pass(VkdfContext *ctx)
+{
+   VkAttachmentDescription attachments[2];
+
+   // Color attachment
+   attachments[0].format = BENCH_COLOR_FORMAT;
+   attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+   attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+   attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+   attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+   attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+   attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+   attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+   attachments[0].flags = 0;
+
+   // Depth attachment
+   attachments[1].format = BENCH_DEPTH_FORMAT;
+   attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+   attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+   attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+   attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+   attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+   attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+   attachments[1].finalLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+   attachments[1].flags = 0;
+
+   VkAttachmentReference color_reference;
+   color_reference.attachment = 0;
+   color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+   VkAttachmentReference depth_reference;
+   depth_reference.attachment = 1;
+   depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+   VkSubpassDescription subpass;
+   subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+   subpass.flags = 0;
+   subpass.inputAttachmentCount = 0;
+   subpass.pInputAttachments = NULL;
+   subpass.colorAttachmentCount = 1;
+   subpass.pColorAttachments = &color_reference;
+   subpass.pResolveAttachments = NULL;
+   subpass.pDepthStencilAttachment = &depth_reference;
+   subpass.preserveAttachmentCount = 0;
+   subpass.pPreserveAttachments = NULL;
+
+   VkRenderPassCreateInfo rp_info;
+   rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+   rp_info.pNext = NULL;
+   rp_info.attachmentCount = 2;
+   rp_info.pAttachments = attachments;
+   rp_info.subpassCount = 1;
+   rp_info.pSubpasses = &subpass;
+   rp_info.dependencyCount = 0;
+   rp_info.pDependencies = NULL;
+   rp_info.flags = 0;
+
+   VkRenderPass render_pass;
+   VkResult res =
+      vkCreateRenderPass(ctx->device, &rp_info, NULL, &render_pass);
+   if (res != VK_SUCCESS)
+      vkdf_fatal("Failed to create render pass");
+
+   return render_pass;
+}
+
+void
+bench_target_init(VkdfContext *ctx,
+                  BenchTarget *target,
+                  uint32_t width,
+                  uint32_t height)
+{
+   target->width = width;
+   target->height = height;
+
+   target->color_image =
+      vkdf_create_image(ctx,
+                        width,
+                        height,
+                        1,
+                        VK_IMAGE_TYPE_2D,
+                        BENCH_COLOR_FORMAT,
+                        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_VIEW_TYPE_2D);
+
+   target->depth_image =
+      vkdf_create_image(ctx,
+                        width,
+                        height,
+                        1,
+                        VK_IMAGE_TYPE_2D,
+                        BENCH_DEPTH_FORMAT,
+                        0,
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        VK_IMAGE_ASPECT_DEPTH_BIT,
+                        VK_IMAGE_VIEW_TYPE_2D);
+
+   target->render_pass = create_render_pass(ctx);
+
+   target->framebuffer =
+      vkdf_create_framebuffer(ctx,
+                              target->render_pass,
+                              target->color_image.view,
+                              width,
+                              height,
+                              &target->depth_image);
+}
+
+void
+bench_target_destroy(VkdfContext *ctx, BenchTarget *target)
+{
+   vkDestroyFramebuffer(ctx->device, target->framebuffer, NULL);
+   vkDestroyRenderPass(ctx->device, target->render_pass, NULL);
+   vkdf_destroy_image(ctx, &target->color_image);
+   vkdf_destroy_image(ctx, &target->depth_image);
+}
+
+void
+bench_target_begin(BenchTarget *target, VkCommandBuffer cmd_buf)
+{
+   VkClearValue clear_values[2];
+   clear_values[0].color.float32[0] = 0.0f;
+   clear_values[0].color.float32[1] = 0.0f;
+   clear_values[0].color.float32[2] = 0.0f;
+   clear_values[0].color.float32[3] = 1.0f;
+   clear_values[1].depthStencil.depth = 1.0f;
+   clear_values[1].depthStencil.stencil = 0;
+
+   VkRenderPassBeginInfo rp_begin;
+   rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+   rp_begin.pNext = NULL;
+   rp_begin.renderPass = target->render_pass;
+   rp_begin.framebuffer = target->framebuffer;
+   rp_begin.renderArea.offset.x = 0;
+   rp_begin.renderArea.offset.y = 0;
+   rp_begin.renderArea.extent.width = target->width;
+   rp_begin.renderArea.extent.height = target->height;
+   rp_begin.clearValueCount = 2;
+   rp_begin.pClearValues = clear_values;
+
+   vkCmdBeginRenderPass(cmd_buf, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+
+   VkViewport viewport;
+   viewport.height = target->height;
+   viewport.width = target->width;
+   viewport.minDepth = 0.0f;
+   viewport.maxDepth = 1.0f;
+   viewport.x = 0;
+   viewport.y = 0;
+   vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+
+   VkRect2D scissor;
+   scissor.extent.width = target->width;
+   scissor.extent.height = target->height;
+   scissor.offset.x = 0;
+   scissor.offset.y = 0;
+   vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+}
+
+void
+bench_target_end(BenchTarget *target, VkCommandBuffer cmd_buf)
+{
+   vkCmdEndRenderPass(cmd_buf);
+}
+
+glm::mat4
+bench_view_projection(BenchTarget *target, glm::vec3 eye, glm::vec3 center)
+{
+   glm::mat4 clip = glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
+                              0.0f,-1.0f, 0.0f, 0.0f,
+                              0.0f, 0.0f, 0.5f, 0.0f,
+                              0.0f, 0.0f, 0.5f, 1.0f);
+
+   glm::mat4 projection =
+      clip * glm::perspective(glm::radians(45.0f),
+                              (float) target->width / target->height,
+                              0.1f, 1000.0f);
+
+   glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+   return projection * view;
+}
+
+/**
+ * Generates per-object offsets (.xyz = translation, .w = scale) inside a
+ * cube of the given extent around the origin. Uses random() so results
+ * only depend on the seed.
+ */
+void
+bench_random_offsets(glm::vec4 *offsets,
+                     uint32_t count,
+                     float extent,
+                     float scale)
+{
+   for (uint32_t i = 0; i < count; i++) {
+      offsets[i].x = ((random() % 2001) / 1000.0f - 1.0f) * extent;
+      offsets[i].y = ((random() % 2001) / 1000.0f - 1.0f) * extent;
+      offsets[i].z = ((random() % 2001) / 1000.0f - 1.0f) * extent;
+      offsets[i].w = scale;
+   }
+}
+
+VkdfBuffer
+bench_create_ubo(VkdfContext *ctx, VkDeviceSize size, const void *data)
+{
+   VkdfBuffer buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   if (data)
+      vkdf_buffer_map_and_fill(ctx, buf, 0, size, data);
+
+   return buf;
+}
+
+VkDescriptorSet
+bench_create_descriptor_set(VkdfContext *ctx,
+                            VkDescriptorPool pool,
+                            VkDescriptorSetLayout layout)
+{
+   VkDescriptorSet set;
+   VkDescriptorSetAllocateInfo alloc_info[1];
+   alloc_info[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+   alloc_info[0].pNext = NULL;
+   alloc_info[0].descriptorPool = pool;
+   alloc_info[0].descriptorSetCount = 1;
+   alloc_info[0].pSetLayouts = &layout;
+   VkResult res = vkAllocateDescriptorSets(ctx->device, alloc_info, &set);
+
+   if (res != VK_SUCCESS)
+      vkdf_fatal("Failed to allocate descriptor set");
+
+   return set;
+}
+
+static VkPipelineLayout
+create_pipeline_layout(VkdfContext *ctx, VkDescriptorSetLayout set_layout)
+{
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 0;
+   pipeline_layout_info.pPushConstantRanges = NULL;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = &set_layout;
+   pipeline_layout_info.flags = 0;
+
+   VkPipelineLayout pipeline_layout;
+   VkResult res = vkCreatePipelineLayout(ctx->device,
+                                         &pipeline_layout_info,
+                                         NULL,
+                                         &pipeline_layout);
+   if (res != VK_SUCCESS)
+      vkdf_fatal("Failed to create pipeline layout");
+
+   return pipeline_layout;
+}
+
+void
+bench_scene_init(VkdfContext *ctx,
+                 BenchScene *scene,
+                 BenchTarget *target,
+                 uint32_t num_objects)
+{
+   scene->num_objects = num_objects;
+
+   scene->cube_mesh = vkdf_cube_mesh_new(ctx);
+   vkdf_mesh_fill_vertex_buffer(ctx, scene->cube_mesh);
+
+   // Per-object offsets
+   glm::vec4 *offsets = g_new(glm::vec4, num_objects);
+   bench_random_offsets(offsets, num_objects, 50.0f, 0.5f);
+
+   VkDeviceSize offsets_size = num_objects * sizeof(glm::vec4);
+   scene->offsets_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         offsets_size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   vkdf_buffer_map_and_fill(ctx, scene->offsets_buf, 0, offsets_size, offsets);
+   g_free(offsets);
+
+   // View / Projection
+   glm::mat4 VP = bench_view_projection(target,
+                                        glm::vec3(0.0f, 60.0f, 120.0f),
+                                        glm::vec3(0.0f, 0.0f, 0.0f));
+   scene->VP_ubo = bench_create_ubo(ctx, sizeof(glm::mat4), &VP[0][0]);
+
+   // Descriptors
+   scene->descriptor_pool =
+      vkdf_create_descriptor_pool(ctx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);
+
+   scene->set_layout =
+      vkdf_create_ubo_descriptor_set_layout(ctx, 0, 1,
+                                            VK_SHADER_STAGE_VERTEX_BIT, false);
+
+   scene->descriptor_set =
+      bench_create_descriptor_set(ctx, scene->descriptor_pool,
+                                  scene->set_layout);
+
+   VkDeviceSize VP_offset = 0;
+   VkDeviceSize VP_size = sizeof(glm::mat4);
+   vkdf_descriptor_set_buffer_update(ctx, scene->descriptor_set,
+                                     scene->VP_ubo.buf,
+                                     0, 1, &VP_offset, &VP_size, false);
+
+   scene->pipeline_layout = create_pipeline_layout(ctx, scene->set_layout);
+
+   // Shaders
+   scene->vs_module =
+      vkdf_create_shader_module(ctx, BENCH_SHADER_DIR "/shader.vert.spv");
+   scene->fs_module =
+      vkdf_create_shader_module(ctx, BENCH_SHADER_DIR "/shader.frag.spv");
+}
+
+VkPipeline
+bench_scene_create_pipeline(VkdfContext *ctx,
+                            BenchScene *scene,
+                            BenchTarget *target,
+                            VkPipelineCache *cache)
+{
+   VkVertexInputBindingDescription vi_binding[2];
+   VkVertexInputAttributeDescription vi_attribs[3];
+
+   // Vertex attribute binding 0: position, normal
+   vi_binding[0].binding = 0;
+   vi_binding[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+   vi_binding[0].stride = 2 * sizeof(glm::vec3);
+
+   // Vertex attribute binding 1: per-object offset
+   vi_binding[1].binding = 1;
+   vi_binding[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+   vi_binding[1].stride = sizeof(glm::vec4);
+
+   // binding 0, location 0: position
+   vi_attribs[0].binding = 0;
+   vi_attribs[0].location = 0;
+   vi_attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+   vi_attribs[0].offset = 0;
+
+   // binding 0, location 1: normal
+   vi_attribs[1].binding = 0;
+   vi_attribs[1].location = 1;
+   vi_attribs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+   vi_attribs[1].offset = 12;
+
+   // binding 1, location 2: offset
+   vi_attribs[2].binding = 1;
+   vi_attribs[2].location = 2;
+   vi_attribs[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+   vi_attribs[2].offset = 0;
+
+   return vkdf_create_gfx_pipeline(ctx,
+                                   cache,
+                                   2,
+                                   vi_binding,
+                                   3,
+                                   vi_attribs,
+                                   true,
+                                   target->render_pass,
+                                   scene->pipeline_layout,
+                                   VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                   VK_CULL_MODE_BACK_BIT,
+                                   scene->vs_module,
+                                   scene->fs_module);
+}
+
+/**
+ * Binds the pipeline, vertex buffers and descriptor set for the scene.
+ * Must be recorded inside the target's render pass.
+ */
+void
+bench_scene_bind(BenchScene *scene,
+                 VkCommandBuffer cmd_buf,
+                 VkPipeline pipeline)
+{
+   vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+   const VkDeviceSize offsets[1] = { 0 };
+   vkdf_cmd_bind_vertex_buffers(cmd_buf, 0, 1,
+                                &scene->cube_mesh->vertex_buf.buf, offsets);
+   vkdf_cmd_bind_vertex_buffers(cmd_buf, 1, 1,
+                                &scene->offsets_buf.buf, offsets);
+
+   vkdf_cmd_bind_descriptor_sets(cmd_buf,
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 scene->pipeline_layout,
+                                 0, 1, &scene->descriptor_set,
+                                 0, NULL);
+}
+
+void
+bench_scene_destroy(VkdfContext *ctx, BenchScene *scene)
+{
+   vkDestroyShaderModule(ctx->device, scene->vs_module, NULL);
+   vkDestroyShaderModule(ctx->device, scene->fs_module, NULL);
+   vkDestroyPipelineLayout(ctx->device, scene->pipeline_layout, NULL);
+   vkFreeDescriptorSets(ctx->device, scene->descriptor_pool,
+                        1, &scene->descriptor_set);
+   vkDestroyDescriptorSetLayout(ctx->device, scene->set_layout, NULL);
+   vkDestroyDescriptorPool(ctx->device, scene->descriptor_pool, NULL);
+   vkdf_destroy_buffer(ctx, &scene->VP_ubo);
+   vkdf_destroy_buffer(ctx, &scene->offsets_buf);
+   vkdf_mesh_free(ctx, scene->cube_mesh);
+}
+
+void
+bench_timer_init(VkdfContext *ctx, BenchTimer *timer)
+{
+   memset(timer, 0, sizeof(BenchTimer));
+   timer->gpu_time = vkdf_query_pool_new(ctx, VK_QUERY_TYPE_TIMESTAMP, 1, 1);
+   timer->gpu_scope = vkdf_query_pool_add_scope(timer->gpu_time, "frame");
+}
+
+void
+bench_timer_destroy(VkdfContext *ctx, BenchTimer *timer)
+{
+   vkdf_query_pool_free(ctx, timer->gpu_time);
+}
+
+/**
+ * Must be recorded outside a render pass.
+ */
+void
+bench_timer_gpu_begin(BenchTimer *timer, VkCommandBuffer cmd_buf)
+{
+   vkdf_query_pool_reset(timer->gpu_time, cmd_buf, 0);
+   vkdf_query_begin(timer->gpu_time, cmd_buf, 0, timer->gpu_scope);
+}
+
+/**
+ * Must be recorded outside a render pass.
+ */
+void
+bench_timer_gpu_end(BenchTimer *timer, VkCommandBuffer cmd_buf)
+{
+   vkdf_query_end(timer->gpu_time, cmd_buf, 0, timer->gpu_scope);
+}
+
+void
+bench_timer_frame_start(BenchTimer *timer)
+{
+   timer->start_ms = bench_now_ms();
+   vkdf_stats_reset();
+}
+
+/**
+ * Benchmarks wait for each frame to complete before ending it, so GPU
+ * results for the frame are always available at this point.
+ */
+void
+bench_timer_frame_end(VkdfContext *ctx, BenchTimer *timer)
+{
+   timer->cpu_ms += bench_now_ms() - timer->start_ms;
+   timer->frames++;
+   vkdf_query_pool_collect(ctx, timer->gpu_time, 0);
+
+   vkdf_stats_frame_end();
+   const VkdfStats *stats = vkdf_stats_get_last_frame();
+   for (uint32_t i = 0; i < VKDF_STAT_COUNT; i++)
+      timer->stats.counters[i] += stats->counters[i];
+}
+
+void
+bench_result_begin(const char *bench, BenchOptions *opts)
+{
+   _result_first_field = true;
+   printf("{");
+   bench_result_string("bench", bench);
+   bench_result_uint("frames", opts->frames);
+   bench_result_uint("seed", opts->seed);
+}
+
+static inline void
+result_key(const char *key)
+{
+   printf("%s\"%s\":", _result_first_field ? "" : ",", key);
+   _result_first_field = false;
+}
+
+void
+bench_result_uint(const char *key, uint64_t value)
+{
+   result_key(key);
+   printf("%" PRIu64, value);
+}
+
+void
+bench_result_double(const char *key, double value)
+{
+   result_key(key);
+   printf("%.6f", value);
+}
+
+void
+bench_result_string(const char *key, const char *value)
+{
+   result_key(key);
+   printf("\"%s\"", value);
+}
+
+static const char *stat_keys[VKDF_STAT_COUNT] = {
+   "draws",
+   "indexed_draws",
+   "indirect_draws",
+   "instances",
+   "pipeline_binds",
+   "descriptor_set_binds",
+   "vertex_buffer_binds",
+   "index_buffer_binds",
+   "submits",
+   "upload_bytes",
+};
+
+/**
+ * Reports average wall time per frame (including the wait for the GPU),
+ * average GPU time per frame if timestamps are supported, and the average
+ * per-frame value of the framework's stats counters.
+ */
+void
+bench_result_timer(BenchTimer *timer)
+{
+   if (timer->frames == 0)
+      return;
+
+   bench_result_double("frame_ms", timer->cpu_ms / timer->frames);
+
+   VkdfQueryScope *scope = &timer->gpu_time->scopes[timer->gpu_scope];
+   if (timer->gpu_time->supported && scope->samples > 0) {
+      bench_result_double("gpu_ms",
+                          scope->total[VKDF_QUERY_RESULT_TIME_NS] /
+                          (scope->samples * 1000000.0));
+   }
+
+   for (uint32_t i = 0; i < VKDF_STAT_COUNT; i++) {
+      bench_result_double(stat_keys[i],
+                          timer->stats.counters[i] / (double) timer->frames);
+   }
+}
+
+void
+bench_result_end()
+{
+   printf("}\n");
+   fflush(stdout);
+}
@@ -0,0 +1,170 @@
+#ifndef __BENCH_COMMON_H__
+#define __BENCH_COMMON_H__
+
+#include "vkdf.hpp"
+
+// ----------------------------------------------------------------------------
+// Shared infrastructure for the benchmark programs. Benchmarks run headless,
+// render to offscreen targets, use a fixed number of frames and a fixed
+// random seed (both can be overriden with --frames=N and --seed=N) and
+// print their results to stdout as one JSON object per line.
+// ----------------------------------------------------------------------------
+
+#define BENCH_WIDTH           1024
+#define BENCH_HEIGHT          768
+
+#define BENCH_DEFAULT_FRAMES  500
+#define BENCH_DEFAULT_SEED    1
+
+#define BENCH_COLOR_FORMAT    VK_FORMAT_R8G8B8A8_UNORM
+#define BENCH_DEPTH_FORMAT    VK_FORMAT_D32_SFLOAT
+
+typedef struct {
+   uint32_t frames;
+   uint32_t seed;
+   bool validation;
+} BenchOptions;
+
+typedef struct {
+   uint32_t width;
+   uint32_t height;
+   VkdfImage color_image;
+   VkdfImage depth_image;
+   VkRenderPass render_pass;
+   VkFramebuffer framebuffer;
+} BenchTarget;
+
+/**
+ * A simple scene of cubes rendered with bench shader.vert/frag. Each cube
+ * takes its translation and scale from a per-instance attribute, so cube
+ * 'i' can be drawn either as part of an instanced draw or on its own by
+ * using firstInstance = i.
+ */
+typedef struct {
+   uint32_t num_objects;
+   VkdfMesh *cube_mesh;
+   VkdfBuffer offsets_buf;
+   VkdfBuffer VP_ubo;
+   VkDescriptorPool descriptor_pool;
+   VkDescriptorSetLayout set_layout;
+   VkDescriptorSet descriptor_set;
+   VkPipelineLayout pipeline_layout;
+   VkShaderModule vs_module;
+   VkShaderModule fs_module;
+} BenchScene;
+
+/**
+ * Accumulates CPU and GPU time and framework stats counters for a number of
+ * frames. GPU time is only available when the device supports timestamp
+ * queries.
+ */
+typedef struct {
+   VkdfQueryPool *gpu_time;
+   uint32_t gpu_scope;
+   double start_ms;
+   double cpu_ms;
+   uint32_t frames;
+   VkdfStats stats;
+} BenchTimer;
+
+static inline double
+bench_now_ms()
+{
+   return vkdf_trace_now_ns() / 1000000.0;
+}
+
+void
+bench_init(VkdfContext *ctx, BenchOptions *opts, int argc, char **argv);
+
+int
+bench_cleanup(VkdfContext *ctx);
+
+void
+bench_target_init(VkdfContext *ctx,
+                  BenchTarget *target,
+                  uint32_t width,
+                  uint32_t height);
+
+void
+bench_target_destroy(VkdfContext *ctx, BenchTarget *target);
+
+void
+bench_target_begin(BenchTarget *target, VkCommandBuffer cmd_buf);
+
+void
+bench_target_end(BenchTarget *target, VkCommandBuffer cmd_buf);
+
+glm::mat4
+bench_view_projection(BenchTarget *target, glm::vec3 eye, glm::vec3 center);
+
+void
+bench_random_offsets(glm::vec4 *offsets,
+                     uint32_t count,
+                     float extent,
+                     float scale);
+
+VkdfBuffer
+bench_create_ubo(VkdfContext *ctx, VkDeviceSize size, const void *data);
+
+VkDescriptorSet
+bench_create_descriptor_set(VkdfContext *ctx,
+                            VkDescriptorPool pool,
+                            VkDescriptorSetLayout layout);
+
+void
+bench_scene_init(VkdfContext *ctx,
+                 BenchScene *scene,
+                 BenchTarget *target,
+                 uint32_t num_objects);
+
+VkPipeline
+bench_scene_create_pipeline(VkdfContext *ctx,
+                            BenchScene *scene,
+                            BenchTarget *target,
+                            VkPipelineCache *cache);
+
+void
+bench_scene_bind(BenchScene *scene,
+                 VkCommandBuffer cmd_buf,
+                 VkPipeline pipeline);
+
+void
+bench_scene_destroy(VkdfContext *ctx, BenchScene *scene);
+
+void
+bench_timer_init(VkdfContext *ctx, BenchTimer *timer);
+
+void
+bench_timer_destroy(VkdfContext *ctx, BenchTimer *timer);
+
+void
+bench_timer_gpu_begin(BenchTimer *timer, VkCommandBuffer cmd_buf);
+
+void
+bench_timer_gpu_end(BenchTimer *timer, VkCommandBuffer cmd_buf);
+
+void
+bench_timer_frame_start(BenchTimer *timer);
+
+void
+bench_timer_frame_end(VkdfContext *ctx, BenchTimer *timer);
+
+void
+bench_result_begin(const char *bench, BenchOptions *opts);
+
+void
+bench_result_uint(const char *key, uint64_t value);
+
+void
+bench_result_double(const char *key, double value);
+
+void
+bench_result_string(const char *key, const char *value);
+
+void
+bench_result_timer(BenchTimer *timer);
+
+void
+bench_result_end();
+
+#endif
@@ -0,0 +1,94 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Measures the CPU cost of frustum culling sets of objects of different
+// sizes scattered around the camera, testing all the objects with
+// vkdf_cull_frustum() versus querying a VkdfBvh built over them. Each
+// frame culls the whole set once.
+// ----------------------------------------------------------------------------
+
+static const uint32_t object_counts[] = {
+   10000,
+   100000,
+   1000000,
+};
+
+static void
+run(BenchOptions *opts, const VkdfFrustum *frustum, uint32_t num_objects)
+{
+   VkdfCullBounds *bounds = vkdf_cull_bounds_new(num_objects);
+   VkdfBvh *bvh = vkdf_bvh_new(0.0f);
+   for (uint32_t i = 0; i < num_objects; i++) {
+      VkdfSphere sphere;
+      sphere.center = glm::vec3((random() % 2001 - 1000) / 10.0f,
+                                (random() % 2001 - 1000) / 10.0f,
+                                (random() % 2001 - 1000) / 10.0f);
+      sphere.radius = 0.5f + (random() % 100) / 50.0f;
+
+      VkdfBox box;
+      box.min = sphere.center - glm::vec3(sphere.radius * 0.7f);
+      box.max = sphere.center + glm::vec3(sphere.radius * 0.7f);
+
+      vkdf_cull_bounds_add(bounds, &box, &sphere);
+      vkdf_bvh_insert(bvh, &box, i);
+   }
+
+   uint32_t *visible = g_new(uint32_t, num_objects);
+   uint32_t num_visible = 0;
+
+   double start = bench_now_ms();
+   for (uint32_t i = 0; i < opts->frames; i++)
+      num_visible = vkdf_cull_frustum(frustum, bounds, visible);
+   double ms = bench_now_ms() - start;
+
+   bench_result_begin("cull_frustum", opts);
+   bench_result_uint("objects", num_objects);
+   bench_result_uint("visible", num_visible);
+   bench_result_double("cull_ms", ms / opts->frames);
+   bench_result_end();
+
+   std::vector<uint32_t> bvh_visible;
+   bvh_visible.reserve(num_objects);
+
+   start = bench_now_ms();
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      bvh_visible.clear();
+      vkdf_bvh_query_frustum(bvh, frustum, &bvh_visible);
+   }
+   ms = bench_now_ms() - start;
+
+   bench_result_begin("cull_bvh", opts);
+   bench_result_uint("objects", num_objects);
+   bench_result_uint("visible", bvh_visible.size());
+   bench_result_double("cull_ms", ms / opts->frames);
+   bench_result_end();
+
+   g_free(visible);
+   vkdf_cull_bounds_free(bounds);
+   vkdf_bvh_free(bvh);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   BenchTarget target;
+   bench_target_init(&ctx, &target, BENCH_WIDTH, BENCH_HEIGHT);
+
+   glm::mat4 view_proj = bench_view_projection(&target,
+                                               glm::vec3(0.0f),
+                                               glm::vec3(0.0f, 0.0f, -1.0f));
+   VkdfFrustum frustum;
+   vkdf_frustum_from_matrix(&frustum, view_proj);
+
+   const uint32_t num_counts = sizeof(object_counts) / sizeof(object_counts[0]);
+   for (uint32_t i = 0; i < num_counts; i++)
+      run(&opts, &frustum, object_counts[i]);
+
+   bench_target_destroy(&ctx, &target);
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,61 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Measures the cost of updating a UBO descriptor to point to a different
+// region of a buffer, which is what the framework does through
+// vkdf_descriptor_set_buffer_update(). Each frame performs a fixed number
+// of updates cycling through a set of buffer regions.
+// ----------------------------------------------------------------------------
+
+#define UPDATES_PER_FRAME  1000
+#define NUM_REGIONS        64
+#define REGION_SIZE        256
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   VkDeviceSize align =
+      ctx.phy_device_props.limits.minUniformBufferOffsetAlignment;
+   VkDeviceSize stride = (REGION_SIZE + align - 1) / align * align;
+
+   VkdfBuffer ubo = bench_create_ubo(&ctx, stride * NUM_REGIONS, NULL);
+
+   VkDescriptorPool pool =
+      vkdf_create_descriptor_pool(&ctx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);
+
+   VkDescriptorSetLayout layout =
+      vkdf_create_ubo_descriptor_set_layout(&ctx, 0, 1,
+                                            VK_SHADER_STAGE_VERTEX_BIT, false);
+
+   VkDescriptorSet set = bench_create_descriptor_set(&ctx, pool, layout);
+
+   double ms = 0.0;
+   for (uint32_t i = 0; i < opts.frames; i++) {
+      double start = bench_now_ms();
+      for (uint32_t j = 0; j < UPDATES_PER_FRAME; j++) {
+         VkDeviceSize offset = (random() % NUM_REGIONS) * stride;
+         VkDeviceSize range = REGION_SIZE;
+         vkdf_descriptor_set_buffer_update(&ctx, set, ubo.buf,
+                                           0, 1, &offset, &range, false);
+      }
+      ms += bench_now_ms() - start;
+   }
+
+   bench_result_begin("descriptor_update", &opts);
+   bench_result_uint("updates_per_frame", UPDATES_PER_FRAME);
+   bench_result_double("frame_ms", ms / opts.frames);
+   bench_result_double("update_us",
+                       ms * 1000.0 / ((double) opts.frames * UPDATES_PER_FRAME));
+   bench_result_end();
+
+   vkFreeDescriptorSets(ctx.device, pool, 1, &set);
+   vkDestroyDescriptorSetLayout(ctx.device, layout, NULL);
+   vkDestroyDescriptorPool(ctx.device, pool, NULL);
+   vkdf_destroy_buffer(&ctx, &ubo);
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,219 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Renders a set of cubes that use random combinations of a few pipelines,
+// descriptor sets and meshes through a VkdfDrawList, first in the order
+// they were added and then sorted by key (pipeline, set, mesh and then
+// front to back). Both modes skip redundant binds, so the difference in
+// binds comes from the sorting. The draw list is built, sorted and
+// recorded every frame, and the cost of sorting is reported separately.
+// ----------------------------------------------------------------------------
+
+#define NUM_OBJECTS   16384
+#define NUM_PIPELINES 4
+#define NUM_SETS      16
+#define NUM_MESHES    4
+
+#define EYE glm::vec3(0.0f, 60.0f, 120.0f)
+
+typedef struct {
+   BenchTarget target;
+   BenchScene scene;
+   VkPipeline pipelines[NUM_PIPELINES];
+   VkDescriptorPool set_pool;
+   VkDescriptorSet sets[NUM_SETS];
+   VkdfMesh *meshes[NUM_MESHES];
+   VkCommandPool cmd_pool;
+   VkCommandBuffer cmd_buf;
+
+   VkdfDraw *draws;
+   VkdfDrawList *list;
+} BenchResources;
+
+static void
+init_draws(VkdfContext *ctx, BenchResources *res)
+{
+   for (uint32_t i = 0; i < NUM_PIPELINES; i++) {
+      res->pipelines[i] =
+         bench_scene_create_pipeline(ctx, &res->scene, &res->target, NULL);
+   }
+
+   // All the sets point to the same View/Projection UBO, they only have
+   // to be different objects
+   res->set_pool =
+      vkdf_create_descriptor_pool(ctx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                  NUM_SETS);
+   for (uint32_t i = 0; i < NUM_SETS; i++) {
+      res->sets[i] = bench_create_descriptor_set(ctx, res->set_pool,
+                                                 res->scene.set_layout);
+      VkDeviceSize offset = 0;
+      VkDeviceSize size = sizeof(glm::mat4);
+      vkdf_descriptor_set_buffer_update(ctx, res->sets[i],
+                                        res->scene.VP_ubo.buf,
+                                        0, 1, &offset, &size, false);
+   }
+
+   for (uint32_t i = 0; i < NUM_MESHES; i++) {
+      res->meshes[i] = vkdf_cube_mesh_new(ctx);
+      vkdf_mesh_fill_vertex_buffer(ctx, res->meshes[i]);
+   }
+
+   // The scene's per-object offsets give the distance to the camera
+   glm::vec4 *offsets;
+   VK_CHECK(vkMapMemory(ctx->device, res->scene.offsets_buf.mem,
+                        0, VK_WHOLE_SIZE, 0, (void **) &offsets));
+
+   res->draws = g_new0(VkdfDraw, NUM_OBJECTS);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      uint32_t p = random() % NUM_PIPELINES;
+      uint32_t s = random() % NUM_SETS;
+      uint32_t m = random() % NUM_MESHES;
+      float dist = glm::length(glm::vec3(offsets[i]) - EYE);
+
+      VkdfDraw *draw = &res->draws[i];
+      draw->key = vkdf_draw_key(0, p, s, m,
+                                vkdf_draw_key_depth(dist, 0.1f, 1000.0f,
+                                                    false));
+      draw->pipeline = res->pipelines[p];
+      draw->pipeline_layout = res->scene.pipeline_layout;
+      draw->set_index = 0;
+      draw->set = res->sets[s];
+      draw->vertex_buf = res->meshes[m]->vertex_buf.buf;
+      draw->vertex_buf_offset = 0;
+      draw->index_buf = VK_NULL_HANDLE;
+      draw->count = res->meshes[m]->vertices.size();
+      draw->first = 0;
+      draw->instance_count = 1;
+      draw->first_instance = i;
+   }
+
+   vkUnmapMemory(ctx->device, res->scene.offsets_buf.mem);
+
+   res->list = vkdf_draw_list_new();
+}
+
+static void
+record_frame(BenchResources *res, BenchTimer *timer)
+{
+   vkdf_command_buffer_begin(res->cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   bench_timer_gpu_begin(timer, res->cmd_buf);
+   bench_target_begin(&res->target, res->cmd_buf);
+
+   const VkDeviceSize offsets[1] = { 0 };
+   vkdf_cmd_bind_vertex_buffers(res->cmd_buf, 1, 1,
+                                &res->scene.offsets_buf.buf, offsets);
+
+   vkdf_draw_list_cmd_draw(res->list, res->cmd_buf);
+
+   bench_target_end(&res->target, res->cmd_buf);
+   bench_timer_gpu_end(timer, res->cmd_buf);
+
+   vkdf_command_buffer_end(res->cmd_buf);
+}
+
+static void
+build_list(BenchResources *res, bool sorted, double *sort_ms)
+{
+   vkdf_draw_list_reset(res->list);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+      vkdf_draw_list_add(res->list, &res->draws[i]);
+
+   if (sorted) {
+      double start = bench_now_ms();
+      vkdf_draw_list_sort(res->list);
+      *sort_ms += bench_now_ms() - start;
+   }
+}
+
+static void
+run(VkdfContext *ctx, BenchResources *res, BenchOptions *opts,
+    const char *name, bool sorted)
+{
+   BenchTimer timer;
+   bench_timer_init(ctx, &timer);
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, NUM_OBJECTS);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 1);
+   if (sorted) {
+      vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, NUM_PIPELINES);
+      vkdf_stats_set_budget(VKDF_STAT_BIND_DESCRIPTOR_SETS,
+                            NUM_PIPELINES * NUM_SETS);
+   }
+
+   // Warm up
+   double sort_ms = 0.0;
+   build_list(res, sorted, &sort_ms);
+   record_frame(res, &timer);
+   vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+   sort_ms = 0.0;
+   double record_ms = 0.0;
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      bench_timer_frame_start(&timer);
+
+      build_list(res, sorted, &sort_ms);
+
+      double start = bench_now_ms();
+      record_frame(res, &timer);
+      record_ms += bench_now_ms() - start;
+
+      vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+      bench_timer_frame_end(ctx, &timer);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_uint("objects", NUM_OBJECTS);
+   bench_result_double("sort_ms", sort_ms / opts->frames);
+   bench_result_double("record_ms", record_ms / opts->frames);
+   bench_result_timer(&timer);
+   bench_result_end();
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, 0);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 0);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 0);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_DESCRIPTOR_SETS, 0);
+
+   bench_timer_destroy(ctx, &timer);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchResources res;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   memset(&res, 0, sizeof(BenchResources));
+   bench_target_init(&ctx, &res.target, BENCH_WIDTH, BENCH_HEIGHT);
+   bench_scene_init(&ctx, &res.scene, &res.target, NUM_OBJECTS);
+   init_draws(&ctx, &res);
+
+   res.cmd_pool =
+      vkdf_create_gfx_command_pool(&ctx,
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+   vkdf_create_command_buffer(&ctx, res.cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &res.cmd_buf);
+
+   run(&ctx, &res, &opts, "draw_list_unsorted", false);
+   run(&ctx, &res, &opts, "draw_list_sorted", true);
+
+   vkDestroyCommandPool(ctx.device, res.cmd_pool, NULL);
+   vkdf_draw_list_free(res.list);
+   g_free(res.draws);
+   for (uint32_t i = 0; i < NUM_MESHES; i++)
+      vkdf_mesh_free(&ctx, res.meshes[i]);
+   vkDestroyDescriptorPool(ctx.device, res.set_pool, NULL);
+   for (uint32_t i = 0; i < NUM_PIPELINES; i++)
+      vkDestroyPipeline(ctx.device, res.pipelines[i], NULL);
+   bench_scene_destroy(&ctx, &res.scene);
+   bench_target_destroy(&ctx, &res.target);
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,119 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Renders the same set of cubes using one draw call per cube and then using
+// a single instanced draw call. Command buffers are recorded every frame so
+// the CPU cost of recording the draws is included in the results. Each mode
+// sets stats budgets for the draws and binds it is expected to record, so a
+// change that adds commands to the frame makes the benchmark fail.
+// ----------------------------------------------------------------------------
+
+#define NUM_OBJECTS 4096
+
+typedef struct {
+   BenchTarget target;
+   BenchScene scene;
+   VkPipeline pipeline;
+   VkCommandPool cmd_pool;
+   VkCommandBuffer cmd_buf;
+} BenchResources;
+
+static void
+record_frame(BenchResources *res, BenchTimer *timer, bool instanced)
+{
+   vkdf_command_buffer_begin(res->cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   bench_timer_gpu_begin(timer, res->cmd_buf);
+   bench_target_begin(&res->target, res->cmd_buf);
+   bench_scene_bind(&res->scene, res->cmd_buf, res->pipeline);
+
+   uint32_t num_vertices = res->scene.cube_mesh->vertices.size();
+   if (instanced) {
+      vkdf_cmd_draw(res->cmd_buf, num_vertices, res->scene.num_objects, 0, 0);
+   } else {
+      for (uint32_t i = 0; i < res->scene.num_objects; i++)
+         vkdf_cmd_draw(res->cmd_buf, num_vertices, 1, 0, i);
+   }
+
+   bench_target_end(&res->target, res->cmd_buf);
+   bench_timer_gpu_end(timer, res->cmd_buf);
+
+   vkdf_command_buffer_end(res->cmd_buf);
+}
+
+static void
+run(VkdfContext *ctx, BenchResources *res, BenchOptions *opts,
+    const char *name, bool instanced)
+{
+   BenchTimer timer;
+   bench_timer_init(ctx, &timer);
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW,
+                         instanced ? 1 : res->scene.num_objects);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 1);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 1);
+
+   // Warm up
+   record_frame(res, &timer, instanced);
+   vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+   double record_ms = 0.0;
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      bench_timer_frame_start(&timer);
+
+      double start = bench_now_ms();
+      record_frame(res, &timer, instanced);
+      record_ms += bench_now_ms() - start;
+
+      vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+      bench_timer_frame_end(ctx, &timer);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_uint("objects", res->scene.num_objects);
+   bench_result_double("record_ms", record_ms / opts->frames);
+   bench_result_timer(&timer);
+   bench_result_end();
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, 0);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 0);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 0);
+
+   bench_timer_destroy(ctx, &timer);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchResources res;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   memset(&res, 0, sizeof(BenchResources));
+   bench_target_init(&ctx, &res.target, BENCH_WIDTH, BENCH_HEIGHT);
+   bench_scene_init(&ctx, &res.scene, &res.target, NUM_OBJECTS);
+   res.pipeline =
+      bench_scene_create_pipeline(&ctx, &res.scene, &res.target, NULL);
+
+   res.cmd_pool =
+      vkdf_create_gfx_command_pool(&ctx,
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+   vkdf_create_command_buffer(&ctx, res.cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &res.cmd_buf);
+
+   run(&ctx, &res, &opts, "draw_calls", false);
+   run(&ctx, &res, &opts, "instanced", true);
+
+   vkDestroyCommandPool(ctx.device, res.cmd_pool, NULL);
+   vkDestroyPipeline(ctx.device, res.pipeline, NULL);
+   bench_scene_destroy(&ctx, &res.scene);
+   bench_target_destroy(&ctx, &res.target);
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,163 @@
+#include "bench-common.hpp"
+
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// Measures model loading and upload of the model's vertex and index data to
+// GPU buffers, both importing the model with Assimp (plus conversion to
+// VkdfModel) and loading it from the binary model cache, with float and
+// compact vertex formats. Uses the tree model from the model demo and
+// synthetic height-field grids of increasing size generated from the seed.
+// ----------------------------------------------------------------------------
+
+// Synthetic grids of N x N quads
+static const uint32_t grid_sizes[] = {
+   64,
+   256,
+   512,
+};
+
+// Loads of the smallest grid per frame. Larger grids are loaded fewer times
+// so that every grid imports roughly the same number of triangles.
+#define GRID_BASE_SIZE 64
+
+static char *
+write_grid_obj(uint32_t n)
+{
+   char *name = g_strdup_printf("vkdf-bench-grid-%u-%d.obj", n, getpid());
+   char *path = g_build_filename(g_get_tmp_dir(), name, NULL);
+   g_free(name);
+
+   FILE *f = fopen(path, "w");
+   if (!f)
+      vkdf_fatal("Failed to create '%s'", path);
+
+   for (uint32_t z = 0; z <= n; z++) {
+      for (uint32_t x = 0; x <= n; x++) {
+         float y = (random() % 1001) / 1000.0f;
+         fprintf(f, "v %f %f %f\n", (float) x, y, (float) z);
+      }
+   }
+
+   // OBJ indices are 1-based
+   for (uint32_t z = 0; z < n; z++) {
+      for (uint32_t x = 0; x < n; x++) {
+         uint32_t i0 = z * (n + 1) + x + 1;
+         uint32_t i1 = i0 + 1;
+         uint32_t i2 = i0 + (n + 1);
+         uint32_t i3 = i2 + 1;
+         fprintf(f, "f %u %u %u\n", i0, i2, i1);
+         fprintf(f, "f %u %u %u\n", i1, i2, i3);
+      }
+   }
+
+   fclose(f);
+
+   return path;
+}
+
+static void
+run(VkdfContext *ctx, BenchOptions *opts, const char *name,
+    const char *path, uint32_t iterations, bool cached,
+    VkdfVertexFormat format)
+{
+   double load_ms = 0.0;
+   double upload_ms = 0.0;
+   uint64_t num_vertices = 0;
+   uint64_t num_indices = 0;
+   uint64_t vertex_bytes = 0;
+   uint64_t index_bytes = 0;
+
+   for (uint32_t i = 0; i < iterations; i++) {
+      double start = bench_now_ms();
+      VkdfModel *model =
+         cached ? vkdf_model_load(path) : vkdf_model_import(path);
+      double loaded = bench_now_ms();
+      vkdf_model_set_vertex_format(model, format);
+      vkdf_model_fill_vertex_buffers(ctx, model, false);
+      double uploaded = bench_now_ms();
+
+      load_ms += loaded - start;
+      upload_ms += uploaded - loaded;
+
+      if (i == 0) {
+         for (uint32_t m = 0; m < model->meshes.size(); m++) {
+            num_vertices += vkdf_mesh_get_num_vertices(model->meshes[m]);
+            num_indices += vkdf_mesh_get_num_indices(model->meshes[m]);
+            vertex_bytes +=
+               vkdf_mesh_get_vertex_data_size(model->meshes[m]);
+            index_bytes +=
+               vkdf_mesh_get_index_data_size(model->meshes[m]);
+         }
+      }
+
+      vkdf_model_free(ctx, model);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_uint("iterations", iterations);
+   bench_result_uint("vertices", num_vertices);
+   bench_result_uint("indices", num_indices);
+   bench_result_uint("vertex_bytes", vertex_bytes);
+   bench_result_uint("index_bytes", index_bytes);
+   bench_result_double("load_ms", load_ms / iterations);
+   bench_result_double("upload_ms", upload_ms / iterations);
+   bench_result_end();
+}
+
+static void
+run_model(VkdfContext *ctx, BenchOptions *opts, const char *name,
+          const char *path, uint32_t iterations)
+{
+   char *cache_path = vkdf_model_cache_get_path(path);
+   unlink(cache_path);
+
+   char *bench_name = g_strdup_printf("model_load_%s", name);
+   run(ctx, opts, bench_name, path, iterations, false,
+       VKDF_VERTEX_FORMAT_FLOAT);
+   g_free(bench_name);
+
+   // Populate the cache before measuring loads from it
+   VkdfModel *model = vkdf_model_load(path);
+   vkdf_model_free(ctx, model);
+
+   bench_name = g_strdup_printf("model_load_cached_%s", name);
+   run(ctx, opts, bench_name, path, iterations, true,
+       VKDF_VERTEX_FORMAT_FLOAT);
+   g_free(bench_name);
+
+   bench_name = g_strdup_printf("model_load_cached_compact_%s", name);
+   run(ctx, opts, bench_name, path, iterations, true,
+       VKDF_VERTEX_FORMAT_COMPACT);
+   g_free(bench_name);
+
+   unlink(cache_path);
+   g_free(cache_path);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   run_model(&ctx, &opts, "tree", BENCH_DATA_DIR "/tree.obj", opts.frames);
+
+   const uint32_t num_grids = sizeof(grid_sizes) / sizeof(grid_sizes[0]);
+   for (uint32_t i = 0; i < num_grids; i++) {
+      uint32_t n = grid_sizes[i];
+      uint32_t scale = (n / GRID_BASE_SIZE) * (n / GRID_BASE_SIZE);
+      uint32_t iterations = MAX(opts.frames / scale, 1);
+
+      char *path = write_grid_obj(n);
+      char *name = g_strdup_printf("grid_%u", n);
+      run_model(&ctx, &opts, name, path, iterations);
+      unlink(path);
+      g_free(name);
+      g_free(path);
+   }
+
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,64 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Measures graphics pipeline creation time, without a pipeline cache and
+// with a pipeline cache that has already seen the pipeline. Each frame
+// creates (and destroys) one pipeline.
+// ----------------------------------------------------------------------------
+
+static void
+run(VkdfContext *ctx, BenchOptions *opts, BenchTarget *target,
+    BenchScene *scene, const char *name, VkPipelineCache *cache)
+{
+   double ms = 0.0;
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      double start = bench_now_ms();
+      VkPipeline pipeline =
+         bench_scene_create_pipeline(ctx, scene, target, cache);
+      ms += bench_now_ms() - start;
+
+      vkDestroyPipeline(ctx->device, pipeline, NULL);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_double("create_ms", ms / opts->frames);
+   bench_result_end();
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchTarget target;
+   BenchScene scene;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   bench_target_init(&ctx, &target, BENCH_WIDTH, BENCH_HEIGHT);
+   bench_scene_init(&ctx, &scene, &target, 1);
+
+   run(&ctx, &opts, &target, &scene, "pipeline_create", NULL);
+
+   VkPipelineCacheCreateInfo info;
+   info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+   info.pNext = NULL;
+   info.initialDataSize = 0;
+   info.pInitialData = NULL;
+   info.flags = 0;
+
+   VkPipelineCache cache;
+   VK_CHECK(vkCreatePipelineCache(ctx.device, &info, NULL, &cache));
+
+   // Prime the cache
+   VkPipeline pipeline =
+      bench_scene_create_pipeline(&ctx, &scene, &target, &cache);
+   vkDestroyPipeline(ctx.device, pipeline, NULL);
+
+   run(&ctx, &opts, &target, &scene, "pipeline_create_cached", &cache);
+
+   vkDestroyPipelineCache(ctx.device, cache, NULL);
+   bench_scene_destroy(&ctx, &scene);
+   bench_target_destroy(&ctx, &target);
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,21 @@
+#version 400
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout(std140, set = 0, binding = 0) uniform vp_ubo {
+    mat4 ViewProjection;
+} VP;
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec4 in_offset; // .xyz = translation, .w = scale
+
+layout(location = 0) out vec3 out_normal;
+
+void main()
+{
+   vec3 pos = in_position * in_offset.w + in_offset.xyz;
+   gl_Position = VP.ViewProjection * vec4(pos, 1.0);
+   out_normal = in_normal;
+}
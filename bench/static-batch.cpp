@@ -0,0 +1,192 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Renders a set of static cubes with a few different materials, first with
+// one draw call per cube and then from a VkdfStaticBatch built from the
+// same cubes, which needs one draw per material. The time it takes to
+// build the batch is reported too. Command buffers are recorded every
+// frame.
+// ----------------------------------------------------------------------------
+
+#define NUM_OBJECTS   4096
+#define NUM_MATERIALS 4
+
+typedef struct {
+   BenchTarget target;
+   BenchScene scene;
+   VkPipeline pipeline;
+   VkCommandPool cmd_pool;
+   VkCommandBuffer cmd_buf;
+
+   // A single per-instance offset that leaves the batch's world-space
+   // positions as they are
+   VkdfBuffer identity_buf;
+
+   VkdfStaticBatch *batch;
+   double build_ms;
+} BenchResources;
+
+static void
+init_batch(VkdfContext *ctx, BenchResources *res)
+{
+   glm::vec4 identity = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+   res->identity_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         sizeof(glm::vec4),
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   vkdf_buffer_map_and_fill(ctx, res->identity_buf, 0, sizeof(glm::vec4),
+                            &identity);
+
+   // Same cubes as the scene's per-object offsets
+   glm::vec4 *offsets;
+   VK_CHECK(vkMapMemory(ctx->device, res->scene.offsets_buf.mem,
+                        0, VK_WHOLE_SIZE, 0, (void **) &offsets));
+
+   VkdfModel *model = vkdf_model_new();
+   vkdf_model_add_mesh(model, res->scene.cube_mesh);
+
+   VkdfObject **objects = g_new(VkdfObject *, NUM_OBJECTS);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      objects[i] = vkdf_object_new(glm::vec3(offsets[i]), model);
+      vkdf_object_set_scale(objects[i], glm::vec3(offsets[i].w));
+      objects[i]->material_idx_base = random() % NUM_MATERIALS;
+   }
+
+   vkUnmapMemory(ctx->device, res->scene.offsets_buf.mem);
+
+   double start = bench_now_ms();
+   res->batch = vkdf_static_batch_new();
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+      vkdf_static_batch_add_object(res->batch, objects[i]);
+   vkdf_static_batch_build(ctx, res->batch);
+   res->build_ms = bench_now_ms() - start;
+
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+      vkdf_object_free(objects[i]);
+   g_free(objects);
+
+   // The mesh belongs to the scene
+   model->meshes.clear();
+   vkdf_model_free(ctx, model);
+}
+
+static void
+record_frame(BenchResources *res, BenchTimer *timer, bool batched)
+{
+   vkdf_command_buffer_begin(res->cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+   bench_timer_gpu_begin(timer, res->cmd_buf);
+   bench_target_begin(&res->target, res->cmd_buf);
+   bench_scene_bind(&res->scene, res->cmd_buf, res->pipeline);
+
+   if (batched) {
+      const VkDeviceSize offsets[1] = { 0 };
+      vkdf_cmd_bind_vertex_buffers(res->cmd_buf, 1, 1,
+                                   &res->identity_buf.buf, offsets);
+      vkdf_static_batch_cmd_bind(res->batch, res->cmd_buf, 0);
+
+      // A real renderer would bind each material's state here
+      uint32_t num_ranges = vkdf_static_batch_get_num_ranges(res->batch);
+      for (uint32_t r = 0; r < num_ranges; r++)
+         vkdf_static_batch_cmd_draw_range(res->batch, res->cmd_buf, r, 1, 0);
+   } else {
+      uint32_t num_vertices = res->scene.cube_mesh->vertices.size();
+      for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+         vkdf_cmd_draw(res->cmd_buf, num_vertices, 1, 0, i);
+   }
+
+   bench_target_end(&res->target, res->cmd_buf);
+   bench_timer_gpu_end(timer, res->cmd_buf);
+
+   vkdf_command_buffer_end(res->cmd_buf);
+}
+
+static void
+run(VkdfContext *ctx, BenchResources *res, BenchOptions *opts,
+    const char *name, bool batched)
+{
+   BenchTimer timer;
+   bench_timer_init(ctx, &timer);
+
+   if (batched)
+      vkdf_stats_set_budget(VKDF_STAT_DRAW_INDEXED, NUM_MATERIALS);
+   else
+      vkdf_stats_set_budget(VKDF_STAT_DRAW, NUM_OBJECTS);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 1);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 1);
+
+   // Warm up
+   record_frame(res, &timer, batched);
+   vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+   double record_ms = 0.0;
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      bench_timer_frame_start(&timer);
+
+      double start = bench_now_ms();
+      record_frame(res, &timer, batched);
+      record_ms += bench_now_ms() - start;
+
+      vkdf_command_buffer_execute_sync(ctx, res->cmd_buf,
+                                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+      bench_timer_frame_end(ctx, &timer);
+   }
+
+   bench_result_begin(name, opts);
+   bench_result_uint("objects", NUM_OBJECTS);
+   if (batched) {
+      bench_result_uint("ranges",
+                        vkdf_static_batch_get_num_ranges(res->batch));
+      bench_result_double("build_ms", res->build_ms);
+   }
+   bench_result_double("record_ms", record_ms / opts->frames);
+   bench_result_timer(&timer);
+   bench_result_end();
+
+   vkdf_stats_set_budget(VKDF_STAT_DRAW, 0);
+   vkdf_stats_set_budget(VKDF_STAT_DRAW_INDEXED, 0);
+   vkdf_stats_set_budget(VKDF_STAT_BIND_PIPELINE, 0);
+   vkdf_stats_set_budget(VKDF_STAT_SUBMITS, 0);
+
+   bench_timer_destroy(ctx, &timer);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+   BenchResources res;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   memset(&res, 0, sizeof(BenchResources));
+   bench_target_init(&ctx, &res.target, BENCH_WIDTH, BENCH_HEIGHT);
+   bench_scene_init(&ctx, &res.scene, &res.target, NUM_OBJECTS);
+   res.pipeline =
+      bench_scene_create_pipeline(&ctx, &res.scene, &res.target, NULL);
+   init_batch(&ctx, &res);
+
+   res.cmd_pool =
+      vkdf_create_gfx_command_pool(&ctx,
+                                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+   vkdf_create_command_buffer(&ctx, res.cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                              1, &res.cmd_buf);
+
+   run(&ctx, &res, &opts, "static_per_object", false);
+   run(&ctx, &res, &opts, "static_batched", true);
+
+   vkDestroyCommandPool(ctx.device, res.cmd_pool, NULL);
+   vkdf_static_batch_free(&ctx, res.batch);
+   vkdf_destroy_buffer(&ctx, &res.identity_buf);
+   vkDestroyPipeline(ctx.device, res.pipeline, NULL);
+   bench_scene_destroy(&ctx, &res.scene);
+   bench_target_destroy(&ctx, &res.target);
+   return bench_cleanup(&ctx);
+}
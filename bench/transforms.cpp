@@ -0,0 +1,98 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Measures the CPU cost of writing the model matrices of many objects to a
+// mapped host-visible buffer every frame, building each matrix from its
+// VkdfObject with glm versus the batched SoA path in VkdfTransformStore.
+// ----------------------------------------------------------------------------
+
+#define NUM_OBJECTS 100000
+
+static void
+report(BenchOptions *opts, const char *name, double ms)
+{
+   bench_result_begin(name, opts);
+   bench_result_uint("objects", NUM_OBJECTS);
+   bench_result_double("update_ms", ms / opts->frames);
+   bench_result_end();
+}
+
+static void
+run_objects(BenchOptions *opts, VkdfObject **objs, uint8_t *map)
+{
+   double start = bench_now_ms();
+   for (uint32_t f = 0; f < opts->frames; f++) {
+      uint8_t *dst = map;
+      for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+         glm::mat4 Model = vkdf_object_get_model_matrix(objs[i]);
+         memcpy(dst, &Model[0][0], sizeof(glm::mat4));
+         dst += sizeof(glm::mat4);
+      }
+   }
+   double ms = bench_now_ms() - start;
+
+   report(opts, "transforms_objects", ms);
+}
+
+static void
+run_store(BenchOptions *opts, VkdfTransformStore *store, uint8_t *map)
+{
+   double start = bench_now_ms();
+   for (uint32_t f = 0; f < opts->frames; f++) {
+      vkdf_transform_store_compute_matrices(store, 0, NUM_OBJECTS,
+                                            map, sizeof(glm::mat4));
+   }
+   double ms = bench_now_ms() - start;
+
+   report(opts, "transforms_store", ms);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   VkdfObject **objs = g_new(VkdfObject *, NUM_OBJECTS);
+   VkdfTransformStore *store = vkdf_transform_store_new(NUM_OBJECTS);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      glm::vec3 pos = glm::vec3((random() % 2001 - 1000) / 10.0f,
+                                (random() % 2001 - 1000) / 10.0f,
+                                (random() % 2001 - 1000) / 10.0f);
+      objs[i] = vkdf_object_new(pos, NULL);
+      vkdf_object_set_rotation(objs[i],
+                               glm::vec3(random() % 360,
+                                         random() % 360,
+                                         random() % 360));
+      vkdf_object_set_scale(objs[i],
+                            glm::vec3(1.0f + (random() % 100) / 50.0f));
+      vkdf_transform_store_add_object(store, objs[i]);
+   }
+
+   VkDeviceSize size = NUM_OBJECTS * sizeof(glm::mat4);
+   VkdfBuffer buf =
+      vkdf_create_buffer(&ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   uint8_t *map;
+   vkMapMemory(ctx.device, buf.mem, 0, size, 0, (void **) &map);
+
+   run_objects(&opts, objs, map);
+   run_store(&opts, store, map);
+
+   vkUnmapMemory(ctx.device, buf.mem);
+   vkdf_destroy_buffer(&ctx, &buf);
+
+   vkdf_transform_store_free(store);
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++)
+      vkdf_object_free(objs[i]);
+   g_free(objs);
+
+   return bench_cleanup(&ctx);
+}
@@ -0,0 +1,121 @@
+#include "bench-common.hpp"
+
+// ----------------------------------------------------------------------------
+// Measures upload bandwidth for buffers of different sizes, both writing
+// directly to host-visible memory and going through a staging buffer
+// copied to device-local memory. Each frame uploads the buffer once.
+// ----------------------------------------------------------------------------
+
+static const VkDeviceSize upload_sizes[] = {
+   64 * 1024,
+   1024 * 1024,
+   16 * 1024 * 1024,
+};
+
+static void
+report(BenchOptions *opts, const char *name, VkDeviceSize size, double ms)
+{
+   double mb = (size * (double) opts->frames) / (1024.0 * 1024.0);
+
+   bench_result_begin(name, opts);
+   bench_result_uint("bytes", size);
+   bench_result_double("upload_ms", ms / opts->frames);
+   bench_result_double("mb_per_s", mb / (ms / 1000.0));
+   bench_result_end();
+}
+
+static void
+run_mapped(VkdfContext *ctx, BenchOptions *opts,
+           VkDeviceSize size, const uint8_t *data)
+{
+   VkdfBuffer buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   double start = bench_now_ms();
+   for (uint32_t i = 0; i < opts->frames; i++)
+      vkdf_buffer_map_and_fill(ctx, buf, 0, size, data);
+   double ms = bench_now_ms() - start;
+
+   report(opts, "upload_mapped", size, ms);
+
+   vkdf_destroy_buffer(ctx, &buf);
+}
+
+static void
+run_staging(VkdfContext *ctx, BenchOptions *opts, VkCommandPool cmd_pool,
+            VkDeviceSize size, const uint8_t *data)
+{
+   VkdfBuffer staging =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   VkdfBuffer buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   // The copy is the same every frame so we only record it once
+   VkCommandBuffer cmd_buf;
+   vkdf_create_command_buffer(ctx, cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1, &cmd_buf);
+
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+   VkBufferCopy region;
+   region.srcOffset = 0;
+   region.dstOffset = 0;
+   region.size = size;
+   vkCmdCopyBuffer(cmd_buf, staging.buf, buf.buf, 1, &region);
+   vkdf_command_buffer_end(cmd_buf);
+
+   double start = bench_now_ms();
+   for (uint32_t i = 0; i < opts->frames; i++) {
+      vkdf_buffer_map_and_fill(ctx, staging, 0, size, data);
+      vkdf_command_buffer_execute_sync(ctx, cmd_buf,
+                                       VK_PIPELINE_STAGE_TRANSFER_BIT);
+   }
+   double ms = bench_now_ms() - start;
+
+   report(opts, "upload_staging", size, ms);
+
+   vkFreeCommandBuffers(ctx->device, cmd_pool, 1, &cmd_buf);
+   vkdf_destroy_buffer(ctx, &staging);
+   vkdf_destroy_buffer(ctx, &buf);
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfContext ctx;
+   BenchOptions opts;
+
+   bench_init(&ctx, &opts, argc, argv);
+
+   const uint32_t num_sizes = sizeof(upload_sizes) / sizeof(upload_sizes[0]);
+   const VkDeviceSize max_size = upload_sizes[num_sizes - 1];
+
+   uint8_t *data = g_new(uint8_t, max_size);
+   for (VkDeviceSize i = 0; i < max_size; i++)
+      data[i] = random() & 0xff;
+
+   VkCommandPool cmd_pool = vkdf_create_gfx_command_pool(&ctx, 0);
+
+   for (uint32_t i = 0; i < num_sizes; i++) {
+      run_mapped(&ctx, &opts, upload_sizes[i], data);
+      run_staging(&ctx, &opts, cmd_pool, upload_sizes[i], data);
+   }
+
+   vkDestroyCommandPool(ctx.device, cmd_pool, NULL);
+   g_free(data);
+   return bench_cleanup(&ctx);
+}
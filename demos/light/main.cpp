@@ -23,6 +23,13 @@
 // WARNING: this must match the size of the array in the vertex shader
 #define NUM_LIGHTS    4
 
+// Every this many cubes, one floats up and down
+#define FLOATING_CUBE_STEP 7
+
+// Log pipeline statistics and GPU time for the scene pass every this many
+// frames
+#define STATS_LOG_FRAMES 300
+
 typedef struct {
    VkdfObject *obj;
    glm::vec4 color;
@@ -46,6 +53,7 @@ typedef struct {
    // UBOs for View/Projection and Model matrices
    VkdfBuffer VP_ubo;
    VkdfBuffer M_ubo;
+   uint8_t *M_ubo_map;
 
    // UBO for lights
    VkdfBuffer Light_ubo;
@@ -64,6 +72,22 @@ typedef struct {
    VkdfMesh *cube_mesh;
    SceneCube cubes[ROOM_WIDTH * ROOM_DEPTH];
 
+   // Transforms of the cubes, same order as 'cubes'
+   VkdfTransformStore *transforms;
+   float float_time;
+
+   // World-space bounds of the cubes for frustum culling, and the indices
+   // of the cubes that passed in the last frame
+   VkdfCullBounds *cube_bounds;
+   uint32_t *visible_cubes;
+
+   // One indirect draw command per cube, visible cubes first and the rest
+   // with 0 instances. Kept mapped and rewritten after culling every frame.
+   // Only used if the device supports drawIndirectFirstInstance, otherwise
+   // all the cubes are drawn with a single instanced draw.
+   VkdfBuffer draw_buf;
+   VkDrawIndirectCommand *draw_cmds;
+
    // Vertex buffer with colors for each cube
    VkdfBuffer cube_color_buf;
 
@@ -72,6 +96,14 @@ typedef struct {
 
    // Camera
    VkdfCamera *camera;
+
+   // Pipeline statistics and GPU time for the scene pass, one query set per
+   // swap chain image
+   VkdfQueryPool *stats_pool;
+   uint32_t stats_scope;
+   VkdfQueryPool *time_pool;
+   uint32_t time_scope;
+   uint32_t stats_frames;
 } SceneResources;
 
 static VkdfBuffer
@@ -201,10 +233,18 @@ render_pass_commands(VkdfContext *ctx, SceneResources *res, uint32_t index)
    rp_begin.clearValueCount = 2;
    rp_begin.pClearValues = clear_values;
 
+   vkdf_query_pool_reset(res->stats_pool, res->cmd_bufs[index], index);
+   vkdf_query_pool_reset(res->time_pool, res->cmd_bufs[index], index);
+   vkdf_query_begin(res->time_pool, res->cmd_bufs[index],
+                    index, res->time_scope);
+
    vkCmdBeginRenderPass(res->cmd_bufs[index],
                         &rp_begin,
                         VK_SUBPASS_CONTENTS_INLINE);
 
+   vkdf_query_begin(res->stats_pool, res->cmd_bufs[index],
+                    index, res->stats_scope);
+
    // Viewport and Scissor
    VkViewport viewport;
    viewport.height = ctx->height;
@@ -223,55 +263,77 @@ render_pass_commands(VkdfContext *ctx, SceneResources *res, uint32_t index)
    vkCmdSetScissor(res->cmd_bufs[index], 0, 1, &scissor);
 
    // Pipeline
-   vkCmdBindPipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                     res->pipeline);
+   vkdf_cmd_bind_pipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          res->pipeline);
 
    // Vertex buffer: position, normal
    const VkdfMesh *mesh = res->cubes[0].  obj->model->meshes[0];
 
    const VkDeviceSize offsets[1] = { 0 };
-   vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                          0,                       // Start Binding
-                          1,                       // Binding Count
-                          &mesh->vertex_buf.buf,   // Buffers
-                          offsets);                // Offsets
+   vkdf_cmd_bind_vertex_buffers(res->cmd_bufs[index],
+                                0,                       // Start Binding
+                                1,                       // Binding Count
+                                &mesh->vertex_buf.buf,   // Buffers
+                                offsets);                // Offsets
 
 
    // Vertex buffer: color
-   vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                          1,                            // Start Binding
-                          1,                            // Binding Count
-                          &res->cube_color_buf.buf,     // Buffers
-                          offsets);                     // Offsets
+   vkdf_cmd_bind_vertex_buffers(res->cmd_bufs[index],
+                                1,                            // Start Binding
+                                1,                            // Binding Count
+                                &res->cube_color_buf.buf,     // Buffers
+                                offsets);                     // Offsets
 
    // Bind static MVP descriptor set once
-   vkCmdBindDescriptorSets(res->cmd_bufs[index],
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           0,                        // First decriptor set
-                           1,                        // Descriptor set count
-                           &res->MVP_descriptor_set, // Descriptor sets
-                           0,                        // Dynamic offset count
-                           NULL);                    // Dynamic offsets
+   vkdf_cmd_bind_descriptor_sets(res->cmd_bufs[index],
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 0,                        // First decriptor set
+                                 1,                        // Descriptor set count
+                                 &res->MVP_descriptor_set, // Descriptor sets
+                                 0,                        // Dynamic offset count
+                                 NULL);                    // Dynamic offsets
 
    // Bind static Light descriptor set once
-   vkCmdBindDescriptorSets(res->cmd_bufs[index],
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           1,                          // First decriptor set
-                           1,                          // Descriptor set count
-                           &res->Light_descriptor_set, // Descriptor sets
-                           0,                          // Dynamic offset count
-                           NULL);                      // Dynamic offsets
+   vkdf_cmd_bind_descriptor_sets(res->cmd_bufs[index],
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 1,                          // First decriptor set
+                                 1,                          // Descriptor set count
+                                 &res->Light_descriptor_set, // Descriptor sets
+                                 0,                          // Dynamic offset count
+                                 NULL);                      // Dynamic offsets
 
    // Draw
-   vkCmdDraw(res->cmd_bufs[index],
-             mesh->vertices.size(),                // vertex count
-             ROOM_WIDTH * ROOM_DEPTH,              // instance count
-             0,                                    // first vertex
-             0);                                   // first instance
+   if (res->draw_cmds == NULL) {
+      vkdf_cmd_draw(res->cmd_bufs[index],
+                    mesh->vertices.size(),             // vertex count
+                    ROOM_WIDTH * ROOM_DEPTH,           // instance count
+                    0,                                 // first vertex
+                    0);                                // first instance
+   } else if (ctx->device_features.multiDrawIndirect) {
+      vkdf_cmd_draw_indirect(res->cmd_bufs[index],
+                             res->draw_buf.buf,
+                             0,
+                             ROOM_WIDTH * ROOM_DEPTH,
+                             sizeof(VkDrawIndirectCommand));
+   } else {
+      for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++) {
+         vkdf_cmd_draw_indirect(res->cmd_bufs[index],
+                                res->draw_buf.buf,
+                                i * sizeof(VkDrawIndirectCommand),
+                                1,
+                                sizeof(VkDrawIndirectCommand));
+      }
+   }
+
+   vkdf_query_end(res->stats_pool, res->cmd_bufs[index],
+                  index, res->stats_scope);
 
    vkCmdEndRenderPass(res->cmd_bufs[index]);
+
+   vkdf_query_end(res->time_pool, res->cmd_bufs[index],
+                  index, res->time_scope);
 }
 
 static VkPipelineLayout
@@ -325,14 +387,28 @@ create_descriptor_set(VkdfContext *ctx,
 static void
 init_matrices(SceneResources *res)
 {
-   glm::mat4 clip = glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
-                              0.0f,-1.0f, 0.0f, 0.0f,
-                              0.0f, 0.0f, 0.5f, 0.0f,
-                              0.0f, 0.0f, 0.5f, 1.0f);
-
-   res->projection =  clip * glm::perspective(glm::radians(45.0f),
-                                              (float) WIN_WIDTH / WIN_HEIGHT,
-                                              SCENE_NEAR, SCENE_FAR);
+   vkdf_camera_set_projection(res->camera, 45.0f,
+                              (float) WIN_WIDTH / WIN_HEIGHT,
+                              SCENE_NEAR, SCENE_FAR);
+
+   res->projection = vkdf_camera_get_projection_matrix(res->camera);
+   res->view = vkdf_camera_get_view_matrix(res->camera);
+}
+
+static void
+create_stats_pool(VkdfContext *ctx, SceneResources *res)
+{
+   res->stats_pool =
+      vkdf_query_pool_new(ctx, VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                          1, ctx->swap_chain_length);
+   res->stats_scope = vkdf_query_pool_add_scope(res->stats_pool, "Scene");
+
+   res->time_pool =
+      vkdf_query_pool_new(ctx, VK_QUERY_TYPE_TIMESTAMP,
+                          1, ctx->swap_chain_length);
+   res->time_scope = vkdf_query_pool_add_scope(res->time_pool, "Scene");
+
+   res->stats_frames = 0;
 }
 
 static void inline
@@ -410,6 +486,15 @@ init_objects(VkdfContext *ctx, SceneResources *res)
          }
       }
    }
+
+   res->transforms = vkdf_transform_store_new(ROOM_WIDTH * ROOM_DEPTH);
+   for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++)
+      vkdf_transform_store_add_object(res->transforms, res->cubes[i].obj);
+
+   res->cube_bounds = vkdf_cull_bounds_new(ROOM_WIDTH * ROOM_DEPTH);
+   for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++)
+      vkdf_cull_bounds_add_object(res->cube_bounds, res->cubes[i].obj);
+   res->visible_cubes = g_new(uint32_t, ROOM_WIDTH * ROOM_DEPTH);
 }
 
 static inline VkPipeline
@@ -551,6 +636,23 @@ init_resources(VkdfContext *ctx, SceneResources *res)
    res->M_ubo = create_ubo(ctx, ROOM_WIDTH * ROOM_DEPTH * sizeof(glm::mat4),
                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
+   // Keep it mapped, Model matrices are written to it as the cubes change
+   vkMapMemory(ctx->device, res->M_ubo.mem, 0, VK_WHOLE_SIZE, 0,
+               (void **) &res->M_ubo_map);
+
+   // Create indirect draw buffer, filled after culling every frame
+   if (ctx->device_features.drawIndirectFirstInstance) {
+      res->draw_buf =
+         vkdf_create_buffer(ctx,
+                            0,
+                            ROOM_WIDTH * ROOM_DEPTH *
+                               sizeof(VkDrawIndirectCommand),
+                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      vkMapMemory(ctx->device, res->draw_buf.mem, 0, VK_WHOLE_SIZE, 0,
+                  (void **) &res->draw_cmds);
+   }
+
    // Create UBO for lights
    res->Light_ubo = create_ubo(ctx, NUM_LIGHTS * sizeof(VkdfLight),
                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
@@ -619,6 +721,9 @@ init_resources(VkdfContext *ctx, SceneResources *res)
 
    res->pipeline = create_pipeline(ctx, res, true);
 
+   // Pipeline statistics
+   create_stats_pool(ctx, res);
+
    // Command pool
    res->cmd_pool = vkdf_create_gfx_command_pool(ctx, 0);
 
@@ -658,36 +763,63 @@ update_camera(GLFWwindow *window, VkdfCamera *cam)
 }
 
 static void
-scene_update(VkdfContext *ctx, void *data)
+cull_cubes(VkdfContext *ctx, SceneResources *res)
 {
-   static bool initialized = false;
+   VkdfFrustum frustum;
+   vkdf_frustum_from_camera(&frustum, res->camera);
 
-   SceneResources *res = (SceneResources *) data;
+   uint32_t num_visible =
+      vkdf_cull_frustum(&frustum, res->cube_bounds, res->visible_cubes);
 
-   // Only need to copy Model matrices once
-   if (!initialized) {
-      uint8_t *map;
-      VkDeviceSize buf_size = VK_WHOLE_SIZE;
-      vkMapMemory(ctx->device, res->M_ubo.mem, 0, buf_size, 0, (void**) &map);
+   if (res->draw_cmds == NULL)
+      return;
 
-      for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++) {
-         VkdfObject *obj = res->cubes[i].obj;
-         glm::mat4 Model = vkdf_object_get_model_matrix(obj);
-         memcpy(map, &Model[0][0], sizeof(glm::mat4));
-         map += sizeof(glm::mat4);
+   const uint32_t vertex_count =
+      res->cubes[0].obj->model->meshes[0]->vertices.size();
+
+   for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++) {
+      VkDrawIndirectCommand *cmd = &res->draw_cmds[i];
+      cmd->vertexCount = vertex_count;
+      cmd->firstVertex = 0;
+      if (i < num_visible) {
+         cmd->instanceCount = 1;
+         cmd->firstInstance = res->visible_cubes[i];
+      } else {
+         cmd->instanceCount = 0;
+         cmd->firstInstance = 0;
       }
+   }
 
-      VkMappedMemoryRange range;
-      range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-      range.pNext = NULL;
-      range.memory = res->M_ubo.mem;
-      range.offset = 0;
-      range.size = buf_size;
-      vkFlushMappedMemoryRanges(ctx->device, 1, &range);
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = res->draw_buf.mem;
+   range.offset = 0;
+   range.size = VK_WHOLE_SIZE;
+   vkFlushMappedMemoryRanges(ctx->device, 1, &range);
+}
 
-      vkUnmapMemory(ctx->device, res->M_ubo.mem);
+static void
+scene_update(VkdfContext *ctx, void *data)
+{
+   SceneResources *res = (SceneResources *) data;
+
+   // Float some of the cubes up and down. The cubes are attached to the
+   // transform store, so moving them through the object setters marks
+   // their transforms dirty and the flush below only uploads theirs.
+   res->float_time += 0.02f;
+   for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i += FLOATING_CUBE_STEP) {
+      VkdfObject *obj = res->cubes[i].obj;
+      glm::vec3 pos = obj->pos;
+      pos.y = 1.5f * (1.0f + sinf(res->float_time + i));
+      vkdf_object_set_position(obj, pos);
+      vkdf_cull_bounds_set_object(res->cube_bounds, i, obj);
    }
 
+   // Upload the Model matrices of the cubes that moved
+   vkdf_transform_store_flush(ctx, res->transforms, &res->M_ubo,
+                              res->M_ubo_map, sizeof(glm::mat4));
+
    // Move ligths around every frame
    {
       static float light_x_dir[NUM_LIGHTS] = { 1.0f,  1.0f, -1.0f, -1.0 };
@@ -722,9 +854,9 @@ scene_update(VkdfContext *ctx, void *data)
       }
    }
 
-   // Update camera view
-   {
-      update_camera(ctx->window, res->camera);
+   // Update camera view, only if the camera moved
+   update_camera(ctx->window, res->camera);
+   if (vkdf_camera_is_dirty(res->camera)) {
       res->view = vkdf_camera_get_view_matrix(res->camera);
 
       uint8_t *map;
@@ -744,7 +876,8 @@ scene_update(VkdfContext *ctx, void *data)
       vkUnmapMemory(ctx->device, res->VP_ubo.mem);
    }
 
-   initialized = true;
+   // Skip the cubes that are out of view
+   cull_cubes(ctx, res);
 }
 
 static void
@@ -752,6 +885,18 @@ scene_render(VkdfContext *ctx, void *data)
 {
    SceneResources *res = (SceneResources *) data;
 
+   // Grab the results from the previous submission of this command buffer
+   // before it resets the queries again
+   vkdf_query_pool_collect(ctx, res->stats_pool, ctx->swap_chain_index);
+   vkdf_query_pool_collect(ctx, res->time_pool, ctx->swap_chain_index);
+   if (++res->stats_frames == STATS_LOG_FRAMES) {
+      vkdf_query_pool_log(res->stats_pool);
+      vkdf_query_pool_clear_stats(res->stats_pool);
+      vkdf_query_pool_log(res->time_pool);
+      vkdf_query_pool_clear_stats(res->time_pool);
+      res->stats_frames = 0;
+   }
+
    VkPipelineStageFlags pipeline_stages =
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -815,6 +960,7 @@ destroy_ubo_resources(VkdfContext *ctx, SceneResources *res)
    vkDestroyBuffer(ctx->device, res->VP_ubo.buf, NULL);
    vkFreeMemory(ctx->device, res->VP_ubo.mem, NULL);
 
+   vkUnmapMemory(ctx->device, res->M_ubo.mem);
    vkDestroyBuffer(ctx->device, res->M_ubo.buf, NULL);
    vkFreeMemory(ctx->device, res->M_ubo.mem, NULL);
 
@@ -828,6 +974,13 @@ cleanup_resources(VkdfContext *ctx, SceneResources *res)
    vkdf_camera_free(res->camera);
    for (uint32_t i = 0; i < ROOM_WIDTH * ROOM_DEPTH; i++)
       vkdf_object_free(res->cubes[i].obj);
+   vkdf_transform_store_free(res->transforms);
+   vkdf_cull_bounds_free(res->cube_bounds);
+   g_free(res->visible_cubes);
+   if (res->draw_cmds) {
+      vkUnmapMemory(ctx->device, res->draw_buf.mem);
+      vkdf_destroy_buffer(ctx, &res->draw_buf);
+   }
    vkdf_mesh_free(ctx, res->cube_mesh);
    vkdf_destroy_buffer(ctx, &res->cube_color_buf);
    destroy_pipeline_resources(ctx, res, true);
@@ -839,6 +992,8 @@ cleanup_resources(VkdfContext *ctx, SceneResources *res)
    destroy_shader_resources(ctx, res);
    destroy_command_buffer_resources(ctx, res);
    vkDestroyCommandPool(ctx->device, res->cmd_pool, NULL);
+   vkdf_query_pool_free(ctx, res->stats_pool);
+   vkdf_query_pool_free(ctx, res->time_pool);
 }
 
 static void
@@ -850,6 +1005,8 @@ before_rebuild_swap_chain_cb(VkdfContext *ctx, void *user_data)
    destroy_framebuffer_resources(ctx, res);
    vkdf_destroy_image(ctx, &res->depth_image);
    destroy_command_buffer_resources(ctx, res);
+   vkdf_query_pool_free(ctx, res->stats_pool);
+   vkdf_query_pool_free(ctx, res->time_pool);
 }
 
 static void
@@ -862,6 +1019,7 @@ after_rebuild_swap_chain_cb(VkdfContext *ctx, void *user_data)
       vkdf_create_framebuffers_for_swap_chain(ctx, res->render_pass,
                                               &res->depth_image);
    res->pipeline = create_pipeline(ctx, res, false);
+   create_stats_pool(ctx, res);
    create_command_buffers(ctx, res);
 }
 
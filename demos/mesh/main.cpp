@@ -172,35 +172,35 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
    vkCmdSetScissor(res->cmd_bufs[index], 0, 1, &scissor);
 
    // Pipeline
-   vkCmdBindPipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                     res->pipeline);
+   vkdf_cmd_bind_pipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          res->pipeline);
 
    // Vertex buffer
    const VkdfMesh *mesh = res->objs[0]->model->meshes[0];
    const VkDeviceSize offsets[1] = { 0 };
-   vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                          0,                       // Start Binding
-                          1,                       // Binding Count
-                          &mesh->vertex_buf.buf,   // Buffers
-                          offsets);                // Offsets
+   vkdf_cmd_bind_vertex_buffers(res->cmd_bufs[index],
+                                0,                       // Start Binding
+                                1,                       // Binding Count
+                                &mesh->vertex_buf.buf,   // Buffers
+                                offsets);                // Offsets
 
 
    // Bind static VP descriptor set once
-   vkCmdBindDescriptorSets(res->cmd_bufs[index],
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           0,                        // First decriptor set
-                           1,                        // Descriptor set count
-                           &res->MVP_descriptor_set, // Descriptor sets
-                           0,                        // Dynamic offset count
-                           NULL);                    // Dynamic offsets
+   vkdf_cmd_bind_descriptor_sets(res->cmd_bufs[index],
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 0,                        // First decriptor set
+                                 1,                        // Descriptor set count
+                                 &res->MVP_descriptor_set, // Descriptor sets
+                                 0,                        // Dynamic offset count
+                                 NULL);                    // Dynamic offsets
 
    // Draw
-   vkCmdDraw(res->cmd_bufs[index],
-             mesh->vertices.size(),                // vertex count
-             NUM_OBJECTS,                          // instance count
-             0,                                    // first vertex
-             0);                                   // first instance
+   vkdf_cmd_draw(res->cmd_bufs[index],
+                 mesh->vertices.size(),                // vertex count
+                 NUM_OBJECTS,                          // instance count
+                 0,                                    // first vertex
+                 0);                                   // first instance
 
    vkCmdEndRenderPass(res->cmd_bufs[index]);
 }
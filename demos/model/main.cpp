@@ -11,20 +11,47 @@
 // per-vertex and per-instance buffers with vertex data from all meshes in
 // the model, as well as single index buffer and renders it multiple times
 // using instancing.
+//
+// The instances are culled on the GPU every frame by a compute shader that
+// writes the indirect draw arguments for each mesh and the list of visible
+// instances, so the command buffers are recorded only once while the camera
+// pans across the scene. Culling is done against the frustum and against a
+// Hi-Z pyramid built from the depth of the instances that were visible in
+// the previous frame, which are rendered first.
+//
+// Each object also selects a level of detail every frame from its distance
+// to the camera, and is only an instance of the draws of that level.
+//
+// Meshes are drawn once per reference from the model's scene graph, with
+// the node transform of that reference, so what is drawn matches the
+// model's bounds that the objects are culled with.
+//
+// Objects drawn at full detail are also culled per meshlet: a second
+// compute shader tests the meshlets of each visible object against the
+// frustum and for facing away from the camera, and only draws the index
+// ranges of the meshlets that pass.
 // ----------------------------------------------------------------------------
 
 // WARNING: this must not be larger than the the size of the Model array in
 // the vertex shader
 #define NUM_OBJECTS 500
 
+// Objects draw the coarsest level of detail whose error is at most this
+// many pixels on screen
+#define LOD_MAX_PIXEL_ERROR 1.0f
+
 typedef struct {
    VkCommandPool cmd_pool;
    VkCommandBuffer *cmd_bufs;
    VkRenderPass render_pass;
+   VkRenderPass late_render_pass;
    VkPipelineLayout pipeline_layout;
    VkPipeline pipeline;
    VkShaderModule vs_module;
    VkShaderModule fs_module;
+   VkShaderModule cs_module;
+   VkShaderModule hiz_cs_module;
+   VkShaderModule meshlet_cs_module;
    VkFramebuffer *framebuffers;
    VkdfImage depth_image;
 
@@ -41,19 +68,34 @@ typedef struct {
    VkDescriptorSet descriptor_set;
 
    // View/Projection matrices
+   VkdfCamera *camera;
    glm::mat4 view;
    glm::mat4 projection;
+   float cam_angle;
 
    // Objects
    VkdfObject *objs[NUM_OBJECTS];
    VkdfModel *model;
-   VkdfBuffer instance_buf;
+
+   // GPU culling of the objects, with one indirect draw per mesh instance
+   // and level of detail: the draws of level 'l' are [l * num_instances,
+   // (l + 1) * num_instances)
+   VkdfHiz *hiz;
+   VkdfGpuCull *cull;
+   uint32_t num_lods;
+
+   // Meshlet culling of the full-detail draws, with one meshlet draw per
+   // mesh instance. NULL if the device or the model doesn't support it.
+   VkdfMeshletCull *meshlet_cull;
 } DemoResources;
 
+// Per-mesh instance push constants
 typedef struct {
-   glm::vec3 pos;
-   glm::vec3 normal;
-} VertexData;
+   glm::mat4 transform;
+   glm::vec4 pos_scale;
+   glm::vec4 pos_offset;
+   uint32_t material_idx;
+} MeshConstants;
 
 static VkdfBuffer
 create_ubo(VkdfContext *ctx, uint32_t size, uint32_t mem_props)
@@ -67,30 +109,40 @@ create_ubo(VkdfContext *ctx, uint32_t size, uint32_t mem_props)
    return buf;
 }
 
+// The early render pass clears the attachments and keeps depth for the
+// Hi-Z pyramid, the late render pass adds to them and presents
 static VkRenderPass
-create_render_pass(VkdfContext *ctx, DemoResources *res)
+create_render_pass(VkdfContext *ctx, DemoResources *res, bool late)
 {
    VkAttachmentDescription attachments[2];
 
    // Single color attachment
    attachments[0].format = ctx->surface_format;
    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-   attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+   attachments[0].loadOp = late ?
+      VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-   attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-   attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   attachments[0].initialLayout = late ?
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+   attachments[0].finalLayout = late ?
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR :
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
    attachments[0].flags = 0;
 
    // Depth attachment
    attachments[1].format = res->depth_image.format;
    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-   attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-   attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+   attachments[1].loadOp = late ?
+      VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+   attachments[1].storeOp = late ?
+      VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-   attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+   attachments[1].initialLayout = late ?
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL :
+      VK_IMAGE_LAYOUT_UNDEFINED;
    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
    attachments[1].flags = 0;
 
@@ -116,6 +168,18 @@ create_render_pass(VkdfContext *ctx, DemoResources *res)
    subpass.preserveAttachmentCount = 0;
    subpass.pPreserveAttachments = NULL;
 
+   // The late render pass draws on top of the early one's color output.
+   // Depth is synchronized by vkdf_hiz_cmd_build().
+   VkSubpassDependency dependency;
+   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+   dependency.dstSubpass = 0;
+   dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+   dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+   dependency.dependencyFlags = 0;
+
    // Create render pass
    VkRenderPassCreateInfo rp_info;
    rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -124,8 +188,8 @@ create_render_pass(VkdfContext *ctx, DemoResources *res)
    rp_info.pAttachments = attachments;
    rp_info.subpassCount = 1;
    rp_info.pSubpasses = &subpass;
-   rp_info.dependencyCount = 0;
-   rp_info.pDependencies = NULL;
+   rp_info.dependencyCount = late ? 1 : 0;
+   rp_info.pDependencies = late ? &dependency : NULL;
    rp_info.flags = 0;
 
    VkRenderPass render_pass;
@@ -138,7 +202,10 @@ create_render_pass(VkdfContext *ctx, DemoResources *res)
 }
 
 static void
-render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
+render_pass_commands(VkdfContext *ctx,
+                     DemoResources *res,
+                     uint32_t index,
+                     VkRenderPass render_pass)
 {
    VkClearValue clear_values[2];
    clear_values[0].color.float32[0] = 0.0f;
@@ -151,7 +218,7 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
    VkRenderPassBeginInfo rp_begin;
    rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
    rp_begin.pNext = NULL;
-   rp_begin.renderPass = res->render_pass;
+   rp_begin.renderPass = render_pass;
    rp_begin.framebuffer = res->framebuffers[index];
    rp_begin.renderArea.offset.x = 0;
    rp_begin.renderArea.offset.y = 0;
@@ -182,55 +249,74 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
    vkCmdSetScissor(res->cmd_bufs[index], 0, 1, &scissor);
 
    // Pipeline
-   vkCmdBindPipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                     res->pipeline);
+   vkdf_cmd_bind_pipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          res->pipeline);
 
    // Bind static UBO descriptor set: MVP matrices and model materials
-   vkCmdBindDescriptorSets(res->cmd_bufs[index],
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           0,                        // First decriptor set
-                           1,                        // Descriptor set count
-                           &res->descriptor_set,     // Descriptor sets
-                           0,                        // Dynamic offset count
-                           NULL);                    // Dynamic offsets
-
-   // Render NUM_OBJECTS instances of each mesh of the model
+   vkdf_cmd_bind_descriptor_sets(res->cmd_bufs[index],
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 0,                      // First decriptor set
+                                 1,                      // Descriptor set count
+                                 &res->descriptor_set,   // Descriptor sets
+                                 0,                      // Dynamic offset count
+                                 NULL);                  // Dynamic offsets
+
+   // Render the visible objects for each mesh instance of the model
    // We have a single vertex buffer for all per-vertex data with data for
-   // all the meshes, the same for per-instance attributes and for the index
-   // data, so we always bind the same buffers but update the offsets depending
-   // on the mesh we are rendering.
+   // all the meshes, the same for the index data, so we always bind the same
+   // buffers but update the offsets depending on the mesh we are rendering.
    VkdfModel *model = res->model;
    for (uint32_t i = 0; i < res->model->meshes.size(); i++) {
+      VkdfMesh *mesh = model->meshes[i];
+
       // Index buffer for this mesh
-      vkCmdBindIndexBuffer(res->cmd_bufs[index],
-                           model->index_buf.buf,               // Buffer
-                           model->index_buf_offsets[i],        // Offset
-                           VK_INDEX_TYPE_UINT32);              // Index type
+      vkdf_cmd_bind_index_buffer(res->cmd_bufs[index],
+                                 model->index_buf.buf,             // Buffer
+                                 model->index_buf_offsets[i],      // Offset
+                                 mesh->index_type);                // Index type
 
       // Per-vertex attributes for this mesh
-      vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                             0,                                // Start Binding
-                             1,                                // Binding Count
-                             &model->vertex_buf.buf,           // Buffers
-                             &model->vertex_buf_offsets[i]);   // Offsets
-
-      // Per-instance attributes for this mesh: we have a buffer with the
-      // material index for each instance of each mesh, ordered by mesh.
-      VkDeviceSize instance_buf_offset = i * NUM_OBJECTS * sizeof(uint32_t);
-      vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                             1,                                // Start Binding
-                             1,                                // Binding Count
-                             &res->instance_buf.buf,           // Buffers
-                             &instance_buf_offset);            // Offsets
-
-      // Draw NUM_OBJECTS instances of this mesh
-      vkCmdDrawIndexed(res->cmd_bufs[index],
-                       model->meshes[i]->indices.size(),       // Index count
-                       NUM_OBJECTS,                            // Instance count
-                       0,                                      // First index
-                       0,                                      // Vertex offset
-                       0);                                     // First instance
+      vkdf_cmd_bind_vertex_buffers(res->cmd_bufs[index],
+                                   0,                              // Start Binding
+                                   1,                              // Binding Count
+                                   &model->vertex_buf.buf,         // Buffers
+                                   &model->vertex_buf_offsets[i]); // Offsets
+
+      // Draw each reference to this mesh from the model's scene graph with
+      // its node transform, at each level of detail. The instance counts
+      // and the per-instance object indices (binding 1) come from the
+      // culling pass. Meshes use different index types and dequantization
+      // constants, and instances different transforms, so each one is a
+      // separate indirect draw.
+      uint32_t num_instances = model->instances.size();
+      uint32_t first = vkdf_model_get_mesh_first_instance(model, i);
+      uint32_t count = vkdf_model_get_mesh_num_instances(model, i);
+      for (uint32_t j = first; j < first + count; j++) {
+         // Node transform, position dequantization and material
+         MeshConstants mesh_constants;
+         mesh_constants.transform = model->instances[j].transform;
+         mesh_constants.pos_scale = glm::vec4(mesh->pos_scale, 0.0f);
+         mesh_constants.pos_offset = glm::vec4(mesh->pos_offset, 0.0f);
+         mesh_constants.material_idx = mesh->material_idx;
+         vkCmdPushConstants(res->cmd_bufs[index],
+                            res->pipeline_layout,
+                            VK_SHADER_STAGE_VERTEX_BIT,
+                            0, sizeof(mesh_constants), &mesh_constants);
+
+         // Full detail draws only the meshlets that survived culling
+         uint32_t first_lod = 0;
+         if (res->meshlet_cull && mesh->meshlets.size() > 0) {
+            vkdf_meshlet_cull_cmd_draw(ctx, res->meshlet_cull,
+                                       res->cmd_bufs[index], 1, j);
+            first_lod = 1;
+         }
+
+         for (uint32_t l = first_lod; l < res->num_lods; l++) {
+            vkdf_gpu_cull_cmd_draw(ctx, res->cull, res->cmd_bufs[index], 1,
+                                   l * num_instances + j, 1);
+         }
+      }
    }
 
    vkCmdEndRenderPass(res->cmd_bufs[index]);
@@ -240,11 +326,18 @@ static VkPipelineLayout
 create_pipeline_layout(VkdfContext *ctx,
                        VkDescriptorSetLayout set_layout)
 {
+   // Per-mesh instance node transform, position dequantization scale and
+   // offset and material index
+   VkPushConstantRange push_constant_range;
+   push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+   push_constant_range.offset = 0;
+   push_constant_range.size = sizeof(MeshConstants);
+
    VkPipelineLayoutCreateInfo pipeline_layout_info;
    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
    pipeline_layout_info.pNext = NULL;
-   pipeline_layout_info.pushConstantRangeCount = 0;
-   pipeline_layout_info.pPushConstantRanges = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = &push_constant_range;
    pipeline_layout_info.setLayoutCount = 1;
    pipeline_layout_info.pSetLayouts = &set_layout;
    pipeline_layout_info.flags = 0;
@@ -283,17 +376,13 @@ create_descriptor_set(VkdfContext *ctx,
 static void
 init_matrices(DemoResources *res)
 {
-   glm::mat4 clip = glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
-                              0.0f,-1.0f, 0.0f, 0.0f,
-                              0.0f, 0.0f, 0.5f, 0.0f,
-                              0.0f, 0.0f, 0.5f, 1.0f);
-
-   res->projection =
-      clip * glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+   // Looking down +Z, towards the origin
+   res->camera = vkdf_camera_new(0.0f, 0.0f, -15.0f,   // Position
+                                 0.0f, 180.0f, 0.0f);  // Rotation
+   vkdf_camera_set_projection(res->camera, 45.0f, 1.0f, 0.1f, 100.0f);
 
-   res->view = glm::lookAt(glm::vec3( 0,  0, -15),  // Camera position
-                           glm::vec3( 0,  0,  0),   // Looking at origin
-                           glm::vec3( 0,  1,  0));  // Up direction
+   res->projection = vkdf_camera_get_projection_matrix(res->camera);
+   res->view = vkdf_camera_get_view_matrix(res->camera);
 }
 
 static void
@@ -301,6 +390,10 @@ init_models(VkdfContext *ctx, DemoResources *res)
 {
    res->model = vkdf_model_load("./data/tree.obj");
 
+   // Use 16-bit quantized positions and octahedral normals, which halves
+   // the size of the vertex data
+   vkdf_model_set_vertex_format(res->model, VKDF_VERTEX_FORMAT_COMPACT);
+
    // Create per-vertex and index buffers for this model. Make it so we have
    // a single buffer for the entire model that packs data from all meshes
    // (instead of having a different vertex/index buffer per mesh). This way,
@@ -308,13 +401,22 @@ init_models(VkdfContext *ctx, DemoResources *res)
    // for each one, instead we simply update the byte offset into the buffer
    // where the mesh's data is stored.
    vkdf_model_fill_vertex_buffers(ctx, res->model, false);
+
+   // Meshes are drawn once per instance, so make sure a model without a
+   // scene graph still draws each mesh once, untransformed
+   if (res->model->instances.size() == 0) {
+      std::vector<VkdfModelInstance> instances(res->model->meshes.size());
+      for (uint32_t i = 0; i < instances.size(); i++) {
+         instances[i].transform = glm::mat4(1.0f);
+         instances[i].mesh_idx = i;
+      }
+      vkdf_model_set_instances(res->model, instances);
+   }
 }
 
 static void
 init_objects(VkdfContext *ctx, DemoResources *res)
 {
-   const VkdfModel *model = res->model;
-
    // Create objects
    glm::vec3 start_pos = glm::vec3(-10.0f, -1.0f, -8.0f);
    glm::vec3 pos = start_pos;
@@ -330,42 +432,89 @@ init_objects(VkdfContext *ctx, DemoResources *res)
          pos.z += 4.0f;
       }
    }
+}
 
-   // Prepare per-instance vertex buffer with material indices for each
-   // mesh instance. The first NUM_OBJECTS indices belong to the materials
-   // for each instance of the first mesh, then we have the next NUM_OBJECTS
-   // material indices for the second mesh, etc
-   VkDeviceSize instance_data_size =
-      sizeof(uint32_t) * model->meshes.size() * NUM_OBJECTS;
-   res->instance_buf =
-      vkdf_create_buffer(ctx,
-                         0,
-                         instance_data_size,
-                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-   uint32_t *map;
-   VK_CHECK(vkMapMemory(ctx->device, res->instance_buf.mem,
-                        0, instance_data_size, 0, (void **) &map));
-
-   for (uint32_t j = 0; j < model->meshes.size(); j++) {
-      assert(model->meshes[j]->material_idx >= 0 &&
-             model->meshes[j]->material_idx < (int32_t) model->materials.size());
-      for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
-         *map = model->meshes[j]->material_idx; 
-         map++;
+static void
+init_culling(VkdfContext *ctx, DemoResources *res)
+{
+   VkdfModel *model = res->model;
+
+   // One indirect draw per mesh instance and level of detail, each drawing
+   // the level's index range from the instance's mesh offsets bound in
+   // render_pass_commands(). Meshes with fewer levels than the model use
+   // their coarsest level for the rest.
+   uint32_t num_instances = model->instances.size();
+   res->num_lods = vkdf_model_get_num_lods(model);
+   uint32_t num_draws = res->num_lods * num_instances;
+   VkDrawIndexedIndirectCommand *draws =
+      g_new0(VkDrawIndexedIndirectCommand, num_draws);
+   for (uint32_t i = 0; i < num_instances; i++) {
+      VkdfMesh *mesh = model->meshes[model->instances[i].mesh_idx];
+      assert(mesh->material_idx >= 0 &&
+             mesh->material_idx < (int32_t) model->materials.size());
+      for (uint32_t l = 0; l < res->num_lods; l++) {
+         uint32_t mesh_lod = MIN(l, mesh->num_lods - 1);
+         VkDrawIndexedIndirectCommand *draw = &draws[l * num_instances + i];
+         draw->indexCount = vkdf_mesh_get_lod_num_indices(mesh, mesh_lod);
+         draw->firstIndex = vkdf_mesh_get_lod_first_index(mesh, mesh_lod);
       }
    }
 
-   VkMappedMemoryRange range;
-   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-   range.pNext = NULL;
-   range.memory = res->instance_buf.mem;
-   range.offset = 0;
-   range.size = instance_data_size;
-   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+   res->cull = vkdf_gpu_cull_new(ctx, res->cs_module,
+                                 NUM_OBJECTS, num_draws, draws, res->hiz);
+   g_free(draws);
 
-   vkUnmapMemory(ctx->device, res->instance_buf.mem);
+   // The objects do not move, so their bounds are only uploaded once. They
+   // start at full detail until scene_update() selects their level.
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      vkdf_gpu_cull_set_object(res->cull, i, res->objs[i]);
+      vkdf_gpu_cull_set_draws(res->cull, i, 0, num_instances);
+   }
+
+   // Meshlets of the full-detail draw of each mesh instance, tested with
+   // the objects' model matrices and the instance's node transform
+   bool has_meshlets = false;
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      has_meshlets = has_meshlets || model->meshes[i]->meshlets.size() > 0;
+
+   if (!has_meshlets || !vkdf_meshlet_cull_is_supported(ctx))
+      return;
+
+   uint32_t *cull_draws = g_new(uint32_t, num_instances);
+   uint32_t *mesh_idxs = g_new(uint32_t, num_instances);
+   glm::mat4 *transforms = g_new(glm::mat4, num_instances);
+   for (uint32_t i = 0; i < num_instances; i++) {
+      cull_draws[i] = i;
+      mesh_idxs[i] = model->instances[i].mesh_idx;
+      transforms[i] = model->instances[i].transform;
+   }
+
+   res->meshlet_cull =
+      vkdf_meshlet_cull_new(ctx, res->meshlet_cs_module, res->cull, model,
+                            &res->M_ubo, num_instances,
+                            cull_draws, mesh_idxs, transforms);
+
+   g_free(cull_draws);
+   g_free(mesh_idxs);
+   g_free(transforms);
+}
+
+/**
+ * Makes each object an instance of the draws of the level of detail it
+ * needs from the current camera position. Only objects whose level
+ * changed are uploaded.
+ */
+static void
+select_lods(VkdfContext *ctx, DemoResources *res)
+{
+   uint32_t num_instances = res->model->instances.size();
+   for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+      uint32_t lod = vkdf_object_select_lod(res->objs[i], res->camera,
+                                            ctx->height,
+                                            LOD_MAX_PIXEL_ERROR);
+      vkdf_gpu_cull_set_draws(res->cull, i, lod * num_instances,
+                              num_instances);
+   }
 }
 
 static void
@@ -420,9 +569,14 @@ init_resources(VkdfContext *ctx, DemoResources *res)
                             sizeof(glm::mat4), sizeof(glm::mat4),
                             &res->projection[0][0]);
 
-   // Create UBO for Model matrix
-   res->M_ubo = create_ubo(ctx, NUM_OBJECTS * sizeof(glm::mat4),
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   // Create UBO for Model matrix. Meshlet culling reads it as a storage
+   // buffer.
+   res->M_ubo = vkdf_create_buffer(ctx,
+                                   0,
+                                   NUM_OBJECTS * sizeof(glm::mat4),
+                                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
    fill_model_ubo(ctx, res);
 
@@ -448,8 +602,9 @@ init_resources(VkdfContext *ctx, DemoResources *res)
                         1,
                         VK_IMAGE_TYPE_2D,
                         VK_FORMAT_D16_UNORM,
-                        0,
-                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT,
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_SAMPLED_BIT,
                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                         VK_IMAGE_ASPECT_DEPTH_BIT,
                         VK_IMAGE_VIEW_TYPE_2D);
@@ -457,9 +612,19 @@ init_resources(VkdfContext *ctx, DemoResources *res)
    // Shaders
    res->vs_module = vkdf_create_shader_module(ctx, "shader.vert.spv");
    res->fs_module = vkdf_create_shader_module(ctx, "shader.frag.spv");
+   res->cs_module = vkdf_create_shader_module(ctx, "cull.comp.spv");
+   res->hiz_cs_module = vkdf_create_shader_module(ctx, "hiz.comp.spv");
+   res->meshlet_cs_module =
+      vkdf_create_shader_module(ctx, "meshlet-cull.comp.spv");
 
-   // Render pass
-   res->render_pass = create_render_pass(ctx, res);
+   // Hi-Z pyramid, GPU culling buffers and pipelines
+   res->hiz = vkdf_hiz_new(ctx, res->hiz_cs_module, &res->depth_image,
+                           ctx->width, ctx->height);
+   init_culling(ctx, res);
+
+   // Render passes
+   res->render_pass = create_render_pass(ctx, res, false);
+   res->late_render_pass = create_render_pass(ctx, res, true);
 
    // Framebuffers
    res->framebuffers =
@@ -505,32 +670,27 @@ init_resources(VkdfContext *ctx, DemoResources *res)
    // Pipeline
    res->pipeline_layout = create_pipeline_layout(ctx, res->set_layout);
 
-   // Vertex attribute binding 0: position and normal
+   // Vertex attribute binding 0: position and normal. All meshes in the
+   // model have the same layout.
    VkVertexInputBindingDescription vi_bindings[2];
    vi_bindings[0].binding = 0;
    vi_bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-   vi_bindings[0].stride = sizeof(VertexData);
+   vi_bindings[0].stride = vkdf_mesh_get_vertex_stride(res->model->meshes[0]);
 
-   // Vertex attribute binding 1: material index (per-instance)
+   // Vertex attribute binding 1: object index (per-instance), written by
+   // the culling pass
    vi_bindings[1].binding = 1;
    vi_bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
    vi_bindings[1].stride = sizeof(uint32_t);
 
    VkVertexInputAttributeDescription vi_attribs[3];
 
-   // binding 0, location 0: position
-   vi_attribs[0].binding = 0;
-   vi_attribs[0].location = 0;
-   vi_attribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-   vi_attribs[0].offset = 0;
-
-   // binding 0, location 1: normal
-   vi_attribs[1].binding = 0;
-   vi_attribs[1].location = 1;
-   vi_attribs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-   vi_attribs[1].offset = 12;
+   // binding 0, location 0: position, location 1: normal. We don't use
+   // texture coordinates.
+   vkdf_vertex_format_get_attributes(res->model->vertex_format,
+                                     false, 0, 0, vi_attribs);
 
-   // binding 1, location 2: per-instance material index
+   // binding 1, location 2: per-instance object index
    vi_attribs[2].binding = 1;
    vi_attribs[2].location = 2;
    vi_attribs[2].format = VK_FORMAT_R32_UINT;
@@ -564,7 +724,20 @@ init_resources(VkdfContext *ctx, DemoResources *res)
    for (uint32_t i = 0; i < ctx->swap_chain_length; i++) {
       vkdf_command_buffer_begin(res->cmd_bufs[i],
                                 VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
-      render_pass_commands(ctx, res, i);
+      // Draw what was visible in the previous frame, build the Hi-Z
+      // pyramid from it and then draw what it did not occlude. Each pass
+      // culls the meshlets of the objects it draws at full detail.
+      vkdf_gpu_cull_cmd_dispatch(res->cull, res->cmd_bufs[i],
+                                 VKDF_GPU_CULL_PASS_EARLY);
+      if (res->meshlet_cull)
+         vkdf_meshlet_cull_cmd_dispatch(res->meshlet_cull, res->cmd_bufs[i]);
+      render_pass_commands(ctx, res, i, res->render_pass);
+      vkdf_hiz_cmd_build(res->hiz, res->cmd_bufs[i]);
+      vkdf_gpu_cull_cmd_dispatch(res->cull, res->cmd_bufs[i],
+                                 VKDF_GPU_CULL_PASS_LATE);
+      if (res->meshlet_cull)
+         vkdf_meshlet_cull_cmd_dispatch(res->meshlet_cull, res->cmd_bufs[i]);
+      render_pass_commands(ctx, res, i, res->late_render_pass);
       vkdf_command_buffer_end(res->cmd_bufs[i]);
    }
 }
@@ -572,6 +745,29 @@ init_resources(VkdfContext *ctx, DemoResources *res)
 static void
 scene_update(VkdfContext *ctx, void *data)
 {
+   DemoResources *res = (DemoResources *) data;
+
+   // Pan the camera left and right so the set of visible objects changes,
+   // and move it back and forth so their levels of detail change
+   res->cam_angle += 0.01f;
+   float yaw = 30.0f * sinf(res->cam_angle);
+   float z = -15.0f + 10.0f * sinf(res->cam_angle * 0.5f);
+   vkdf_camera_set_position(res->camera, 0.0f, 0.0f, z);
+   vkdf_camera_set_rotation(res->camera, 0.0f, 180.0f + yaw, 0.0f);
+   res->view = vkdf_camera_get_view_matrix(res->camera);
+
+   vkdf_buffer_map_and_fill(ctx, res->VP_ubo,
+                            0, sizeof(glm::mat4),
+                            &res->view[0][0]);
+
+   select_lods(ctx, res);
+
+   vkdf_gpu_cull_update(ctx, res->cull,
+                        vkdf_camera_get_view_projection_matrix(res->camera));
+   if (res->meshlet_cull) {
+      vkdf_meshlet_cull_update(ctx, res->meshlet_cull,
+                               vkdf_camera_get_position(res->camera));
+   }
 }
 
 static void
@@ -609,6 +805,9 @@ destroy_shader_resources(VkdfContext *ctx, DemoResources *res)
 {
   vkDestroyShaderModule(ctx->device, res->vs_module, NULL);
   vkDestroyShaderModule(ctx->device, res->fs_module, NULL);
+  vkDestroyShaderModule(ctx->device, res->cs_module, NULL);
+  vkDestroyShaderModule(ctx->device, res->hiz_cs_module, NULL);
+  vkDestroyShaderModule(ctx->device, res->meshlet_cs_module, NULL);
 }
 
 static void
@@ -646,13 +845,17 @@ destroy_ubo_resources(VkdfContext *ctx, DemoResources *res)
 void
 cleanup_resources(VkdfContext *ctx, DemoResources *res)
 {
-   vkDestroyBuffer(ctx->device, res->instance_buf.buf, NULL);
-   vkFreeMemory(ctx->device, res->instance_buf.mem, NULL);
+   if (res->meshlet_cull)
+      vkdf_meshlet_cull_free(ctx, res->meshlet_cull);
+   vkdf_gpu_cull_free(ctx, res->cull);
+   vkdf_hiz_free(ctx, res->hiz);
+   vkdf_camera_free(res->camera);
    for (uint32_t i = 0; i < NUM_OBJECTS; i++)
       vkdf_object_free(res->objs[i]);
    vkdf_model_free(ctx, res->model);
    destroy_pipeline_resources(ctx, res);
    vkDestroyRenderPass(ctx->device, res->render_pass, NULL);
+   vkDestroyRenderPass(ctx->device, res->late_render_pass, NULL);
    destroy_descriptor_resources(ctx, res);
    destroy_ubo_resources(ctx, res);
    vkdf_destroy_image(ctx, &res->depth_image);
@@ -13,18 +13,41 @@ layout(std140, set = 0, binding = 1) uniform m_ubo {
     mat4 Model[500];
 } M;
 
-layout(location = 0) in vec3 in_position;
-layout(location = 1) in vec3 in_normal;
-layout(location = 2) in uint in_material_idx;
+// Node transform of the mesh instance, dequantization of the mesh's 16-bit
+// positions and the mesh's material
+layout(push_constant) uniform pcb {
+    mat4 transform;
+    vec4 pos_scale;
+    vec4 pos_offset;
+    uint material_idx;
+} Mesh;
+
+layout(location = 0) in vec4 in_position;
+layout(location = 1) in vec2 in_normal;
+// Object index written by the culling pass
+layout(location = 2) in uint in_object_idx;
 
 layout(location = 0) out vec3 out_normal;
 layout(location = 1) flat out uint out_material_idx;
 
+// Octahedral normal decoding
+vec3 decode_normal(vec2 e)
+{
+   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+   if (n.z < 0.0) {
+      n.xy = (1.0 - abs(n.yx)) *
+             vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return normalize(n);
+}
+
 void main()
 {
-   mat4 mvp = VP.Projection * VP.View * M.Model[gl_InstanceIndex];
-   vec4 pos = vec4(in_position.x, in_position.y, in_position.z, 1.0);
+   mat4 mvp = VP.Projection * VP.View * M.Model[in_object_idx] *
+              Mesh.transform;
+   vec3 position = in_position.xyz * Mesh.pos_scale.xyz + Mesh.pos_offset.xyz;
+   vec4 pos = vec4(position.x, position.y, position.z, 1.0);
    gl_Position = mvp * pos;
-   out_normal = in_normal;
-   out_material_idx = in_material_idx;
+   out_normal = normalize(mat3(Mesh.transform) * decode_normal(in_normal));
+   out_material_idx = Mesh.material_idx;
 }
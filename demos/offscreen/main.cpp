@@ -23,6 +23,7 @@ typedef struct {
    VkDescriptorPool descriptor_pool;
    VkDescriptorSet descriptor_set;
    VkSemaphore offscreen_draw_sem;
+   VkdfSubmitBatch *submit_batch;
 
    glm::mat4 clip;
    glm::mat4 view;
@@ -147,27 +148,27 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res)
                         VK_SUBPASS_CONTENTS_INLINE);
 
    // Pipeline
-   vkCmdBindPipeline(res->render_cmd_buf,
-                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                     res->pipeline);
+   vkdf_cmd_bind_pipeline(res->render_cmd_buf,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          res->pipeline);
 
    // Descriptor set
-   vkCmdBindDescriptorSets(res->render_cmd_buf,
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           0,                      // First decriptor set
-                           1,                      // Descriptor set count
-                           &res->descriptor_set,   // Descriptor sets
-                           0,                      // Dynamic offset count
-                           NULL);                  // Dynamic offsets
+   vkdf_cmd_bind_descriptor_sets(res->render_cmd_buf,
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 0,                      // First decriptor set
+                                 1,                      // Descriptor set count
+                                 &res->descriptor_set,   // Descriptor sets
+                                 0,                      // Dynamic offset count
+                                 NULL);                  // Dynamic offsets
 
    // Vertex buffer
    const VkDeviceSize offsets[1] = { 0 };
-   vkCmdBindVertexBuffers(res->render_cmd_buf,
-                          0,                       // Start Binding
-                          1,                       // Binding Count
-                          &res->vertex_buf.buf,    // Buffers
-                          offsets);                // Offsets
+   vkdf_cmd_bind_vertex_buffers(res->render_cmd_buf,
+                                0,                       // Start Binding
+                                1,                       // Binding Count
+                                &res->vertex_buf.buf,    // Buffers
+                                offsets);                // Offsets
 
    // Viewport and Scissor
    VkViewport viewport;
@@ -187,11 +188,11 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res)
    vkCmdSetScissor(res->render_cmd_buf, 0, 1, &scissor);
 
    // Draw
-   vkCmdDraw(res->render_cmd_buf,
-             3,                    // vertex count
-             1,                    // instance count
-             0,                    // first vertex
-             0);                   // first instance
+   vkdf_cmd_draw(res->render_cmd_buf,
+                 3,                    // vertex count
+                 1,                    // instance count
+                 0,                    // first vertex
+                 0);                   // first instance
 
    vkCmdEndRenderPass(res->render_cmd_buf);
 }
@@ -441,6 +442,10 @@ init_resources(VkdfContext *ctx, DemoResources *res)
    // buffer that renders to the offscreen image and the command buffer that
    // copies from the offscreen image to the presentation image.
    res->offscreen_draw_sem = vkdf_create_semaphore(ctx);
+
+   // Both command buffers are submitted to the graphics queue in each
+   // frame, so we batch them into a single queue submission
+   res->submit_batch = vkdf_submit_batch_new(ctx, ctx->gfx_queue);
 }
 
 static void
@@ -477,15 +482,11 @@ scene_render(VkdfContext *ctx, void *data)
 {
    DemoResources *res = (DemoResources *) data;
 
-   VkPipelineStageFlags pipeline_stages_offscreen =
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
    // We can render to the offscreen image right away
-   vkdf_command_buffer_execute(ctx,
-                               res->render_cmd_buf,
-                               &pipeline_stages_offscreen,
-                               0, NULL,
-                               1, &res->offscreen_draw_sem);
+   vkdf_submit_batch_add(res->submit_batch,
+                         res->render_cmd_buf,
+                         0, NULL, NULL,
+                         1, &res->offscreen_draw_sem);
 
    // Copying from the offscreen image to the presentation image requires
    // that we have acquired the presentation image and that we have completed
@@ -498,11 +499,12 @@ scene_render(VkdfContext *ctx, void *data)
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
    };
-   vkdf_command_buffer_execute(ctx,
-                               res->present_cmd_bufs[ctx->swap_chain_index],
-                               pipeline_stages_present,
-                               2, copy_wait_sems,
-                               1, &ctx->draw_sem[ctx->swap_chain_index]);
+   vkdf_submit_batch_add(res->submit_batch,
+                         res->present_cmd_bufs[ctx->swap_chain_index],
+                         2, copy_wait_sems, pipeline_stages_present,
+                         1, &ctx->draw_sem[ctx->swap_chain_index]);
+
+   vkdf_submit_batch_flush(res->submit_batch, NULL);
 }
 
 static void
@@ -554,6 +556,7 @@ destroy_ubo_resources(VkdfContext *ctx, DemoResources *res)
 void
 cleanup_resources(VkdfContext *ctx, DemoResources *res)
 {
+   vkdf_submit_batch_free(ctx, res->submit_batch);
    vkDestroySemaphore(ctx->device, res->offscreen_draw_sem, NULL);
    destroy_pipeline_resources(ctx, res);
    vkDestroyRenderPass(ctx->device, res->render_pass, NULL);
@@ -142,26 +142,26 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
                         VK_SUBPASS_CONTENTS_INLINE);
 
    // Pipeline
-   vkCmdBindPipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                     res->pipeline);
+   vkdf_cmd_bind_pipeline(res->cmd_bufs[index], VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          res->pipeline);
 
    // Descriptor set
-   vkCmdBindDescriptorSets(res->cmd_bufs[index],
-                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                           res->pipeline_layout,
-                           0,                      // First decriptor set
-                           1,                      // Descriptor set count
-                           &res->descriptor_set,   // Descriptor sets
-                           0,                      // Dynamic offset count
-                           NULL);                  // Dynamic offsets
+   vkdf_cmd_bind_descriptor_sets(res->cmd_bufs[index],
+                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 res->pipeline_layout,
+                                 0,                      // First decriptor set
+                                 1,                      // Descriptor set count
+                                 &res->descriptor_set,   // Descriptor sets
+                                 0,                      // Dynamic offset count
+                                 NULL);                  // Dynamic offsets
 
    // Vertex buffer
    const VkDeviceSize offsets[1] = { 0 };
-   vkCmdBindVertexBuffers(res->cmd_bufs[index],
-                          0,                       // Start Binding
-                          1,                       // Binding Count
-                          &res->vertex_buf.buf,    // Buffers
-                          offsets);                // Offsets
+   vkdf_cmd_bind_vertex_buffers(res->cmd_bufs[index],
+                                0,                       // Start Binding
+                                1,                       // Binding Count
+                                &res->vertex_buf.buf,    // Buffers
+                                offsets);                // Offsets
 
    // Viewport and Scissor
    VkViewport viewport;
@@ -181,11 +181,11 @@ render_pass_commands(VkdfContext *ctx, DemoResources *res, uint32_t index)
    vkCmdSetScissor(res->cmd_bufs[index], 0, 1, &scissor);
 
    // Draw
-   vkCmdDraw(res->cmd_bufs[index],
-             3,                    // vertex count
-             1,                    // instance count
-             0,                    // first vertex
-             0);                   // first instance
+   vkdf_cmd_draw(res->cmd_bufs[index],
+                 3,                    // vertex count
+                 1,                    // instance count
+                 0,                    // first vertex
+                 0);                   // first instance
 
    vkCmdEndRenderPass(res->cmd_bufs[index]);
 }
@@ -0,0 +1,282 @@
+#include "vkdf.hpp"
+
+#include <algorithm>
+
+/**
+ * Creates a batcher with room for 'max_instances' instances per frame and
+ * 'num_frames' frames in flight (usually the swap chain length).
+ */
+VkdfBatch *
+vkdf_batch_new(VkdfContext *ctx, uint32_t max_instances, uint32_t num_frames)
+{
+   assert(max_instances > 0 && num_frames > 0);
+
+   VkdfBatch *batch = g_new0(VkdfBatch, 1);
+   batch->max_instances = max_instances;
+   batch->num_frames = num_frames;
+   batch->items = std::vector<VkdfBatchItem>();
+   batch->draws = std::vector<VkdfBatchDraw>();
+
+   VkDeviceSize size =
+      (VkDeviceSize) max_instances * num_frames * sizeof(VkdfBatchInstance);
+   batch->instance_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VK_CHECK(vkMapMemory(ctx->device, batch->instance_buf.mem,
+                        0, VK_WHOLE_SIZE, 0,
+                        (void **) &batch->instance_map));
+
+   return batch;
+}
+
+void
+vkdf_batch_free(VkdfContext *ctx, VkdfBatch *batch)
+{
+   vkUnmapMemory(ctx->device, batch->instance_buf.mem);
+   vkdf_destroy_buffer(ctx, &batch->instance_buf);
+
+   batch->items.clear();
+   std::vector<VkdfBatchItem>(batch->items).swap(batch->items);
+   batch->draws.clear();
+   std::vector<VkdfBatchDraw>(batch->draws).swap(batch->draws);
+
+   g_free(batch);
+}
+
+/**
+ * Starts collecting the objects to render in a frame. 'frame' selects the
+ * region of the instance buffer the frame's instances are written to.
+ */
+void
+vkdf_batch_begin(VkdfBatch *batch, uint32_t frame)
+{
+   assert(frame < batch->num_frames);
+
+   batch->frame = frame;
+   batch->items.clear();
+   batch->draws.clear();
+}
+
+static inline void
+add_item(VkdfBatch *batch,
+         VkPipeline pipeline,
+         VkdfObject *obj,
+         uint32_t mesh_idx,
+         int32_t instance_idx)
+{
+   VkdfModel *model = obj->model;
+
+   VkdfBatchItem item;
+   item.pipeline = pipeline;
+   item.mesh = model->meshes[mesh_idx];
+   item.obj = obj;
+   item.mesh_idx = mesh_idx;
+   item.instance_idx = instance_idx;
+
+   if (model->vertex_buf.buf != 0) {
+      item.vertex_buf = model->vertex_buf.buf;
+      item.vertex_offset = model->vertex_buf_offsets[mesh_idx];
+   } else {
+      item.vertex_buf = item.mesh->vertex_buf.buf;
+      item.vertex_offset = 0;
+   }
+
+   batch->items.push_back(item);
+}
+
+/**
+ * Submits all the meshes of an object (or all their placements, if the
+ * object's model has mesh instances) to be rendered with 'pipeline' in
+ * the current frame.
+ */
+void
+vkdf_batch_add_object(VkdfBatch *batch, VkPipeline pipeline, VkdfObject *obj)
+{
+   VkdfModel *model = obj->model;
+
+   if (model->instances.size() > 0) {
+      for (uint32_t i = 0; i < model->instances.size(); i++)
+         add_item(batch, pipeline, obj, model->instances[i].mesh_idx, i);
+   } else {
+      for (uint32_t m = 0; m < model->meshes.size(); m++)
+         add_item(batch, pipeline, obj, m, -1);
+   }
+}
+
+// Items that compare equal can be drawn in the same instanced draw. The
+// vertex buffer comes before the mesh so meshes that share a packed vertex
+// buffer are drawn one after the other.
+static bool
+item_less(const VkdfBatchItem &a, const VkdfBatchItem &b)
+{
+   if (a.pipeline != b.pipeline)
+      return a.pipeline < b.pipeline;
+   if (a.vertex_buf != b.vertex_buf)
+      return a.vertex_buf < b.vertex_buf;
+   if (a.vertex_offset != b.vertex_offset)
+      return a.vertex_offset < b.vertex_offset;
+   return a.mesh < b.mesh;
+}
+
+/**
+ * Sorts and merges the objects submitted since vkdf_batch_begin() into
+ * instanced draws and uploads their per-instance data. Must be called
+ * before submitting the command buffer recorded with
+ * vkdf_batch_cmd_draw().
+ */
+void
+vkdf_batch_end(VkdfContext *ctx, VkdfBatch *batch)
+{
+   VKDF_TRACE_SCOPE("batch_end");
+
+   uint32_t num_items = batch->items.size();
+   if (num_items == 0)
+      return;
+
+   if (num_items > batch->max_instances)
+      vkdf_fatal("Batch: too many instances in a frame");
+
+   std::stable_sort(batch->items.begin(), batch->items.end(), item_less);
+
+   const VkDeviceSize region_offset =
+      (VkDeviceSize) batch->frame * batch->max_instances *
+      sizeof(VkdfBatchInstance);
+   VkdfBatchInstance *instances =
+      (VkdfBatchInstance *) (batch->instance_map + region_offset);
+
+   for (uint32_t i = 0; i < num_items; i++) {
+      VkdfBatchItem *item = &batch->items[i];
+
+      VkdfBatchInstance *inst = &instances[i];
+      inst->model = vkdf_object_get_model_matrix(item->obj);
+      if (item->instance_idx >= 0) {
+         inst->model = inst->model *
+            item->obj->model->instances[item->instance_idx].transform;
+      }
+      inst->material_idx = vkdf_object_get_material_idx(item->obj, item->mesh);
+
+      if (i > 0 && !item_less(batch->items[i - 1], *item)) {
+         batch->draws.back().num_instances++;
+         continue;
+      }
+
+      VkdfBatchDraw draw;
+      draw.pipeline = item->pipeline;
+      draw.model = item->obj->model;
+      draw.mesh_idx = item->mesh_idx;
+      draw.first_instance = i;
+      draw.num_instances = 1;
+      batch->draws.push_back(draw);
+   }
+
+   VkMappedMemoryRange range =
+      vkdf_buffer_get_flush_range(ctx, &batch->instance_buf, region_offset,
+                                  num_items * sizeof(VkdfBatchInstance));
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES,
+                     num_items * sizeof(VkdfBatchInstance));
+}
+
+/**
+ * Records the draws of the current frame. Pipelines, vertex and index
+ * buffers are only bound when they change from one draw to the next, and
+ * the instance buffer is bound once to 'instance_binding'. 'draw_func',
+ * if not NULL, is called before each draw. Must be recorded inside a
+ * render pass compatible with the submitted pipelines.
+ */
+void
+vkdf_batch_cmd_draw(VkdfBatch *batch,
+                    VkCommandBuffer cmd_buf,
+                    uint32_t instance_binding,
+                    VkdfBatchDrawFunc draw_func,
+                    void *data)
+{
+   if (batch->draws.size() == 0)
+      return;
+
+   VkDeviceSize instance_offset =
+      (VkDeviceSize) batch->frame * batch->max_instances *
+      sizeof(VkdfBatchInstance);
+   vkdf_cmd_bind_vertex_buffers(cmd_buf, instance_binding, 1,
+                                &batch->instance_buf.buf, &instance_offset);
+
+   VkPipeline bound_pipeline = VK_NULL_HANDLE;
+   VkBuffer bound_vertex_buf = VK_NULL_HANDLE;
+   VkDeviceSize bound_vertex_offset = 0;
+   VkBuffer bound_index_buf = VK_NULL_HANDLE;
+   VkDeviceSize bound_index_offset = 0;
+
+   for (uint32_t i = 0; i < batch->draws.size(); i++) {
+      const VkdfBatchDraw *draw = &batch->draws[i];
+      VkdfModel *model = draw->model;
+      VkdfMesh *mesh = model->meshes[draw->mesh_idx];
+
+      if (draw->pipeline != bound_pipeline) {
+         vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                draw->pipeline);
+         bound_pipeline = draw->pipeline;
+      }
+
+      VkBuffer vertex_buf;
+      VkDeviceSize vertex_offset;
+      if (model->vertex_buf.buf != 0) {
+         vertex_buf = model->vertex_buf.buf;
+         vertex_offset = model->vertex_buf_offsets[draw->mesh_idx];
+      } else {
+         vertex_buf = mesh->vertex_buf.buf;
+         vertex_offset = 0;
+      }
+
+      if (vertex_buf != bound_vertex_buf ||
+          vertex_offset != bound_vertex_offset) {
+         vkdf_cmd_bind_vertex_buffers(cmd_buf, 0, 1,
+                                      &vertex_buf, &vertex_offset);
+         bound_vertex_buf = vertex_buf;
+         bound_vertex_offset = vertex_offset;
+      }
+
+      uint32_t num_indices = vkdf_mesh_get_num_indices(mesh);
+      if (num_indices > 0) {
+         VkBuffer index_buf;
+         VkDeviceSize index_offset;
+         if (model->index_buf.buf != 0) {
+            index_buf = model->index_buf.buf;
+            index_offset = model->index_buf_offsets[draw->mesh_idx];
+         } else {
+            index_buf = mesh->index_buf.buf;
+            index_offset = 0;
+         }
+
+         // Meshes in the same index buffer may use different index types,
+         // but then they also start at different offsets
+         if (index_buf != bound_index_buf ||
+             index_offset != bound_index_offset) {
+            vkdf_cmd_bind_index_buffer(cmd_buf, index_buf, index_offset,
+                                       mesh->index_type);
+            bound_index_buf = index_buf;
+            bound_index_offset = index_offset;
+         }
+      }
+
+      if (draw_func)
+         draw_func(cmd_buf, draw, data);
+
+      if (num_indices > 0) {
+         vkdf_cmd_draw_indexed(cmd_buf,
+                               num_indices,
+                               draw->num_instances,
+                               0,
+                               0,
+                               draw->first_instance);
+      } else {
+         vkdf_cmd_draw(cmd_buf,
+                       vkdf_mesh_get_num_vertices(mesh),
+                       draw->num_instances,
+                       0,
+                       draw->first_instance);
+      }
+   }
+}
@@ -0,0 +1,106 @@
+#ifndef __VKDF_BATCH_H__
+#define __VKDF_BATCH_H__
+
+/**
+ * Automatic instancing of objects that share meshes.
+ *
+ * Every frame, the application submits the objects to render with the
+ * pipeline to render each of them with. The batcher sorts the meshes of
+ * the submitted objects by pipeline, vertex buffer and mesh, merges
+ * consecutive runs of the same mesh into a single instanced draw and
+ * writes the per-instance data of each draw (VkdfBatchInstance) to a
+ * streaming instance buffer, so the number of draws depends on the number
+ * of different meshes and pipelines and not on the number of objects.
+ *
+ * The instance buffer is split in one region per frame in flight. Each
+ * frame writes its instances to the region of the frame index passed to
+ * vkdf_batch_begin(), so the application must not reuse a frame index
+ * until the GPU has finished with the commands that used it.
+ *
+ * Vertex shaders read the per-instance data from 5 attributes on the
+ * instance binding passed to vkdf_batch_cmd_draw(): the model matrix as 4
+ * vec4 columns followed by the material index as an int, with a stride of
+ * sizeof(VkdfBatchInstance).
+ */
+
+// Same layout as the per-instance vertex attributes
+typedef struct {
+   glm::mat4 model;
+   int32_t material_idx;
+   uint32_t padding[3];
+} VkdfBatchInstance;
+
+// An instanced draw of a mesh. Instances are relative to the current
+// frame's region of the instance buffer.
+typedef struct {
+   VkPipeline pipeline;
+   VkdfModel *model;
+   uint32_t mesh_idx;
+   uint32_t first_instance;
+   uint32_t num_instances;
+} VkdfBatchDraw;
+
+// A mesh of a submitted object, or one of its placements for models with
+// mesh instances (instance_idx is -1 otherwise)
+typedef struct {
+   VkPipeline pipeline;
+   VkBuffer vertex_buf;
+   VkDeviceSize vertex_offset;
+   VkdfMesh *mesh;
+   VkdfObject *obj;
+   uint32_t mesh_idx;
+   int32_t instance_idx;
+} VkdfBatchItem;
+
+/**
+ * Called by vkdf_batch_cmd_draw() before each draw, after binding its
+ * pipeline and buffers, to record any other state it needs (descriptor
+ * sets, push constants...).
+ */
+typedef void (*VkdfBatchDrawFunc)(VkCommandBuffer cmd_buf,
+                                  const VkdfBatchDraw *draw,
+                                  void *data);
+
+typedef struct {
+   uint32_t max_instances;
+   uint32_t num_frames;
+   uint32_t frame;
+
+   // Per-instance data, kept mapped. Frame 'f' writes its instances
+   // starting at instance f * max_instances.
+   VkdfBuffer instance_buf;
+   uint8_t *instance_map;
+
+   std::vector<VkdfBatchItem> items;
+   std::vector<VkdfBatchDraw> draws;
+} VkdfBatch;
+
+VkdfBatch *
+vkdf_batch_new(VkdfContext *ctx, uint32_t max_instances, uint32_t num_frames);
+
+void
+vkdf_batch_free(VkdfContext *ctx, VkdfBatch *batch);
+
+void
+vkdf_batch_begin(VkdfBatch *batch, uint32_t frame);
+
+void
+vkdf_batch_add_object(VkdfBatch *batch, VkPipeline pipeline, VkdfObject *obj);
+
+void
+vkdf_batch_end(VkdfContext *ctx, VkdfBatch *batch);
+
+void
+vkdf_batch_cmd_draw(VkdfBatch *batch,
+                    VkCommandBuffer cmd_buf,
+                    uint32_t instance_binding,
+                    VkdfBatchDrawFunc draw_func,
+                    void *data);
+
+inline uint32_t
+vkdf_batch_get_num_draws(VkdfBatch *batch)
+{
+   return batch->draws.size();
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include "vkdf.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE2__
+// Loads a position into the low 3 lanes. The last position is loaded
+// element by element so we never read past the end of the data.
+static inline __m128
+load_position(const uint8_t *positions,
+              uint32_t stride,
+              uint32_t i,
+              uint32_t count)
+{
+   const float *p = (const float *) (positions + (size_t) i * stride);
+   if (i + 1 < count)
+      return _mm_loadu_ps(p);
+   return _mm_set_ps(0.0f, p[2], p[1], p[0]);
+}
+#endif
+
+/**
+ * Computes the bounding box of 'count' positions (3 floats each) read from
+ * 'positions' every 'stride' bytes. The box is empty if 'count' is 0.
+ */
+void
+vkdf_box_compute(VkdfBox *box,
+                 const uint8_t *positions,
+                 uint32_t stride,
+                 uint32_t count)
+{
+   vkdf_box_init_empty(box);
+   if (count == 0)
+      return;
+
+#ifdef __SSE2__
+   __m128 v_min = _mm_set1_ps(FLT_MAX);
+   __m128 v_max = _mm_set1_ps(-FLT_MAX);
+   for (uint32_t i = 0; i < count; i++) {
+      __m128 p = load_position(positions, stride, i, count);
+      v_min = _mm_min_ps(v_min, p);
+      v_max = _mm_max_ps(v_max, p);
+   }
+
+   float min[4], max[4];
+   _mm_storeu_ps(min, v_min);
+   _mm_storeu_ps(max, v_max);
+   box->min = glm::vec3(min[0], min[1], min[2]);
+   box->max = glm::vec3(max[0], max[1], max[2]);
+#else
+   for (uint32_t i = 0; i < count; i++) {
+      glm::vec3 p;
+      memcpy(&p, positions + (size_t) i * stride, sizeof(glm::vec3));
+      vkdf_box_add_point(box, p);
+   }
+#endif
+}
+
+/**
+ * Computes the axis-aligned box enclosing 'box' transformed by 'm'
+ * (J. Arvo, "Transforming Axis-Aligned Bounding Boxes"). 'out' can be
+ * 'box'.
+ */
+void
+vkdf_box_transform(const VkdfBox *box, const glm::mat4 &m, VkdfBox *out)
+{
+   if (vkdf_box_is_empty(box)) {
+      vkdf_box_init_empty(out);
+      return;
+   }
+
+   glm::vec3 center = vkdf_box_get_center(box);
+   glm::vec3 extent = (box->max - box->min) * 0.5f;
+
+   glm::vec3 c = glm::vec3(m * glm::vec4(center, 1.0f));
+   glm::vec3 e;
+   for (uint32_t r = 0; r < 3; r++) {
+      e[r] = fabsf(m[0][r]) * extent.x +
+             fabsf(m[1][r]) * extent.y +
+             fabsf(m[2][r]) * extent.z;
+   }
+
+   out->min = c - e;
+   out->max = c + e;
+}
+
+/**
+ * Computes a bounding sphere for the positions centered at the center of
+ * their bounding box 'box'. This is not the minimal sphere, but it is
+ * never larger than the box's own bounding sphere.
+ */
+void
+vkdf_sphere_compute(VkdfSphere *sphere,
+                    const VkdfBox *box,
+                    const uint8_t *positions,
+                    uint32_t stride,
+                    uint32_t count)
+{
+   if (count == 0 || vkdf_box_is_empty(box)) {
+      vkdf_sphere_init_empty(sphere);
+      return;
+   }
+
+   sphere->center = vkdf_box_get_center(box);
+
+#ifdef __SSE2__
+   const __m128 v_center =
+      _mm_set_ps(0.0f, sphere->center.z, sphere->center.y, sphere->center.x);
+   const __m128 v_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+   __m128 v_max_dist2 = _mm_setzero_ps();
+   for (uint32_t i = 0; i < count; i++) {
+      __m128 d = _mm_sub_ps(load_position(positions, stride, i, count),
+                            v_center);
+      d = _mm_and_ps(d, v_mask);
+      d = _mm_mul_ps(d, d);
+
+      // Horizontal add of x, y and z
+      __m128 s = _mm_add_ps(d, _mm_movehl_ps(d, d));
+      s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+      v_max_dist2 = _mm_max_ss(v_max_dist2, s);
+   }
+
+   sphere->radius = sqrtf(_mm_cvtss_f32(v_max_dist2));
+#else
+   float max_dist2 = 0.0f;
+   for (uint32_t i = 0; i < count; i++) {
+      glm::vec3 p;
+      memcpy(&p, positions + (size_t) i * stride, sizeof(glm::vec3));
+      glm::vec3 d = p - sphere->center;
+      max_dist2 = MAX(max_dist2, glm::dot(d, d));
+   }
+
+   sphere->radius = sqrtf(max_dist2);
+#endif
+}
+
+/**
+ * Grows the sphere just enough to enclose 'p', moving its center towards
+ * it (J. Ritter, "An Efficient Bounding Sphere").
+ */
+void
+vkdf_sphere_add_point(VkdfSphere *sphere, const glm::vec3 &p)
+{
+   if (vkdf_sphere_is_empty(sphere)) {
+      sphere->center = p;
+      sphere->radius = 0.0f;
+      return;
+   }
+
+   glm::vec3 d = p - sphere->center;
+   float dist2 = glm::dot(d, d);
+   if (dist2 <= sphere->radius * sphere->radius)
+      return;
+
+   float dist = sqrtf(dist2);
+   float radius = (sphere->radius + dist) * 0.5f;
+   sphere->center += d * ((radius - sphere->radius) / dist);
+   sphere->radius = radius;
+}
+
+/**
+ * Grows the sphere to the smallest sphere enclosing itself and 'other'
+ */
+void
+vkdf_sphere_merge(VkdfSphere *sphere, const VkdfSphere *other)
+{
+   if (vkdf_sphere_is_empty(other))
+      return;
+
+   if (vkdf_sphere_is_empty(sphere)) {
+      *sphere = *other;
+      return;
+   }
+
+   glm::vec3 d = other->center - sphere->center;
+   float dist = glm::length(d);
+
+   // One of them contains the other
+   if (dist + other->radius <= sphere->radius)
+      return;
+   if (dist + sphere->radius <= other->radius) {
+      *sphere = *other;
+      return;
+   }
+
+   float radius = (dist + sphere->radius + other->radius) * 0.5f;
+   sphere->center += d * ((radius - sphere->radius) / dist);
+   sphere->radius = radius;
+}
@@ -0,0 +1,91 @@
+#ifndef __VKDF_BOX_H__
+#define __VKDF_BOX_H__
+
+#include <float.h>
+
+/**
+ * Bounding volumes: axis-aligned boxes and spheres.
+ *
+ * Empty volumes (with no points) have min > max and a negative radius, so
+ * adding points or merging other volumes into them just works.
+ */
+
+typedef struct {
+   glm::vec3 min;
+   glm::vec3 max;
+} VkdfBox;
+
+typedef struct {
+   glm::vec3 center;
+   float radius;
+} VkdfSphere;
+
+inline void
+vkdf_box_init_empty(VkdfBox *box)
+{
+   box->min = glm::vec3(FLT_MAX);
+   box->max = glm::vec3(-FLT_MAX);
+}
+
+inline bool
+vkdf_box_is_empty(const VkdfBox *box)
+{
+   return box->min.x > box->max.x;
+}
+
+inline glm::vec3
+vkdf_box_get_center(const VkdfBox *box)
+{
+   return (box->min + box->max) * 0.5f;
+}
+
+inline void
+vkdf_box_add_point(VkdfBox *box, const glm::vec3 &p)
+{
+   box->min = glm::min(box->min, p);
+   box->max = glm::max(box->max, p);
+}
+
+inline void
+vkdf_box_merge(VkdfBox *box, const VkdfBox *other)
+{
+   box->min = glm::min(box->min, other->min);
+   box->max = glm::max(box->max, other->max);
+}
+
+void
+vkdf_box_compute(VkdfBox *box,
+                 const uint8_t *positions,
+                 uint32_t stride,
+                 uint32_t count);
+
+void
+vkdf_box_transform(const VkdfBox *box, const glm::mat4 &m, VkdfBox *out);
+
+inline void
+vkdf_sphere_init_empty(VkdfSphere *sphere)
+{
+   sphere->center = glm::vec3(0.0f);
+   sphere->radius = -1.0f;
+}
+
+inline bool
+vkdf_sphere_is_empty(const VkdfSphere *sphere)
+{
+   return sphere->radius < 0.0f;
+}
+
+void
+vkdf_sphere_compute(VkdfSphere *sphere,
+                    const VkdfBox *box,
+                    const uint8_t *positions,
+                    uint32_t stride,
+                    uint32_t count);
+
+void
+vkdf_sphere_add_point(VkdfSphere *sphere, const glm::vec3 &p);
+
+void
+vkdf_sphere_merge(VkdfSphere *sphere, const VkdfSphere *other);
+
+#endif
@@ -58,16 +58,43 @@ vkdf_buffer_map_and_fill(VkdfContext *ctx,
    memcpy(mapped_memory, data, size);
 
    if (!(buf.mem_props & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-      VkMappedMemoryRange range;
-      range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-      range.pNext = NULL;
-      range.memory = buf.mem;
-      range.offset = offset;
-      range.size = size;
+      VkMappedMemoryRange range =
+         vkdf_buffer_get_flush_range(ctx, &buf, offset, size);
       VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
    }
 
    vkUnmapMemory(ctx->device, buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, size);
+}
+
+/**
+ * Returns the range to flush after writing 'size' bytes at 'offset' in the
+ * mapped memory of 'buf'. Flush ranges must be aligned to
+ * nonCoherentAtomSize, or end at the end of the allocation, so the range
+ * is grown to the enclosing atoms.
+ */
+VkMappedMemoryRange
+vkdf_buffer_get_flush_range(VkdfContext *ctx,
+                            VkdfBuffer *buf,
+                            VkDeviceSize offset,
+                            VkDeviceSize size)
+{
+   assert(offset + size <= buf->mem_reqs.size);
+
+   const VkDeviceSize atom =
+      MAX(ctx->phy_device_props.limits.nonCoherentAtomSize, 1);
+   VkDeviceSize start = offset / atom * atom;
+   VkDeviceSize end = MIN((offset + size + atom - 1) / atom * atom,
+                          buf->mem_reqs.size);
+
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = buf->mem;
+   range.offset = start;
+   range.size = end - start;
+   return range;
 }
 
 void
@@ -22,6 +22,12 @@ vkdf_buffer_map_and_fill(VkdfContext *ctx,
                          VkDeviceSize size,
                          const void *data);
 
+VkMappedMemoryRange
+vkdf_buffer_get_flush_range(VkdfContext *ctx,
+                            VkdfBuffer *buf,
+                            VkDeviceSize offset,
+                            VkDeviceSize size);
+
 void
 vkdf_destroy_buffer(VkdfContext *ctx, VkdfBuffer *buf);
 
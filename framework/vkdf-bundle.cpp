@@ -0,0 +1,710 @@
+#include "vkdf.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#define BUNDLE_MAGIC    0x42464456 // "VDFB"
+#define BUNDLE_VERSION  5
+
+// Each chunk in a compressed section is preceded by a 32-bit header with
+// the number of bytes stored for it. Chunks that don't compress are stored
+// as-is and flagged with this bit.
+#define BUNDLE_CHUNK_RAW_BIT 0x80000000
+
+#define BUNDLE_MESH_HAS_UV (1 << 0)
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_entries;
+   uint32_t pad;
+   uint64_t entries_offset;
+} BundleHeader;
+
+// Model metadata section: this header, followed by 'num_materials'
+// VkdfMaterial, 'num_meshes' BundleMesh, 'num_instances' BundleInstance
+// and 'num_meshlets' VkdfMeshlet
+typedef struct {
+   uint32_t num_materials;
+   uint32_t num_meshes;
+   uint32_t num_instances;
+   uint32_t num_meshlets;
+} BundleModelMeta;
+
+typedef struct {
+   uint32_t num_vertices;
+   uint32_t num_indices;      // Level 0 only
+   int32_t material_idx;
+   uint32_t flags;
+   uint64_t vertex_offset;    // In the vertex data section
+   uint64_t index_offset;     // In the index data section
+   float box_min[3];
+   float box_max[3];
+   float sphere[4];           // Center and radius
+   uint32_t num_lods;
+   uint32_t lod_first_index[VKDF_MESH_MAX_LODS];
+   uint32_t lod_num_indices[VKDF_MESH_MAX_LODS];
+   float lod_error[VKDF_MESH_MAX_LODS];
+   uint32_t first_meshlet;    // In the meshlet table
+   uint32_t num_meshlets;
+} BundleMesh;
+
+typedef struct {
+   float transform[16];       // Column-major
+   uint32_t mesh_idx;
+   uint32_t pad;
+} BundleInstance;
+
+static bool
+read_at(int fd, void *dst, uint64_t size, uint64_t offset)
+{
+   uint8_t *ptr = (uint8_t *) dst;
+   while (size > 0) {
+      ssize_t n = pread(fd, ptr, size, offset);
+      if (n <= 0)
+         return false;
+      ptr += n;
+      size -= n;
+      offset += n;
+   }
+   return true;
+}
+
+VkdfBundle *
+vkdf_bundle_open(const char *path)
+{
+   int fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      vkdf_error("Failed to open bundle '%s'", path);
+      return NULL;
+   }
+
+   BundleHeader header;
+   if (!read_at(fd, &header, sizeof(header), 0) ||
+       header.magic != BUNDLE_MAGIC ||
+       header.version != BUNDLE_VERSION) {
+      vkdf_error("'%s' is not a valid bundle", path);
+      close(fd);
+      return NULL;
+   }
+
+   VkdfBundle *bundle = g_new0(VkdfBundle, 1);
+   bundle->entries = std::vector<VkdfBundleEntry>(header.num_entries);
+   bundle->fd = fd;
+
+   if (header.num_entries > 0 &&
+       !read_at(fd, &bundle->entries[0],
+                header.num_entries * sizeof(VkdfBundleEntry),
+                header.entries_offset)) {
+      vkdf_error("Failed to read entry table of bundle '%s'", path);
+      vkdf_bundle_close(bundle);
+      return NULL;
+   }
+
+   // Names are fixed-size, make sure they are terminated
+   for (uint32_t i = 0; i < bundle->entries.size(); i++)
+      bundle->entries[i].name[VKDF_BUNDLE_MAX_NAME - 1] = '\0';
+
+   return bundle;
+}
+
+void
+vkdf_bundle_close(VkdfBundle *bundle)
+{
+   bundle->entries.clear();
+   std::vector<VkdfBundleEntry>(bundle->entries).swap(bundle->entries);
+
+   g_free(bundle->chunk_buf);
+   close(bundle->fd);
+   g_free(bundle);
+}
+
+/**
+ * Returns the index of the section with the given name and type, or -1 if
+ * the bundle doesn't have it.
+ */
+int32_t
+vkdf_bundle_find(VkdfBundle *bundle, const char *name, uint32_t type)
+{
+   for (uint32_t i = 0; i < bundle->entries.size(); i++) {
+      if (bundle->entries[i].type == type &&
+          !strcmp(bundle->entries[i].name, name))
+         return i;
+   }
+   return -1;
+}
+
+static bool
+read_compressed(VkdfBundle *bundle, const VkdfBundleEntry *entry, uint8_t *dst)
+{
+#if HAVE_LZ4
+   uint32_t max_chunk_size = LZ4_compressBound(entry->chunk_size);
+   if (bundle->chunk_buf_size < max_chunk_size) {
+      g_free(bundle->chunk_buf);
+      bundle->chunk_buf = (uint8_t *) g_malloc(max_chunk_size);
+      bundle->chunk_buf_size = max_chunk_size;
+   }
+
+   uint64_t offset = entry->offset;
+   uint64_t end = entry->offset + entry->size;
+   uint64_t written = 0;
+   while (written < entry->raw_size) {
+      uint32_t chunk_header;
+      if (offset + sizeof(chunk_header) > end ||
+          !read_at(bundle->fd, &chunk_header, sizeof(chunk_header), offset))
+         return false;
+      offset += sizeof(chunk_header);
+
+      uint32_t stored_size = chunk_header & ~BUNDLE_CHUNK_RAW_BIT;
+      uint32_t raw_size = MIN(entry->chunk_size, entry->raw_size - written);
+      if (offset + stored_size > end || stored_size > max_chunk_size)
+         return false;
+
+      // Decompress each chunk straight into the destination
+      if (chunk_header & BUNDLE_CHUNK_RAW_BIT) {
+         if (stored_size != raw_size ||
+             !read_at(bundle->fd, dst + written, stored_size, offset))
+            return false;
+      } else {
+         if (!read_at(bundle->fd, bundle->chunk_buf, stored_size, offset))
+            return false;
+
+         int res = LZ4_decompress_safe((const char *) bundle->chunk_buf,
+                                       (char *) dst + written,
+                                       stored_size, raw_size);
+         if (res < 0 || (uint32_t) res != raw_size)
+            return false;
+      }
+
+      offset += stored_size;
+      written += raw_size;
+   }
+
+   return true;
+#else
+   vkdf_error("Bundle section '%s' is LZ4-compressed but the framework "
+              "has been built without LZ4 support", entry->name);
+   return false;
+#endif
+}
+
+/**
+ * Reads (and decompresses if needed) section 'idx' into 'dst', which must
+ * have room for the section's raw_size bytes.
+ */
+bool
+vkdf_bundle_read(VkdfBundle *bundle, uint32_t idx, void *dst)
+{
+   VKDF_TRACE_SCOPE("vkdf_bundle_read");
+
+   assert(idx < bundle->entries.size());
+   const VkdfBundleEntry *entry = &bundle->entries[idx];
+
+   bool ok;
+   switch (entry->compression) {
+   case VKDF_BUNDLE_COMPRESSION_NONE:
+      ok = entry->size == entry->raw_size &&
+           read_at(bundle->fd, dst, entry->size, entry->offset);
+      break;
+   case VKDF_BUNDLE_COMPRESSION_LZ4:
+      ok = read_compressed(bundle, entry, (uint8_t *) dst);
+      break;
+   default:
+      ok = false;
+      break;
+   }
+
+   if (!ok)
+      vkdf_error("Failed to read bundle section '%s'", entry->name);
+
+   return ok;
+}
+
+static VkdfBuffer
+create_buffer_from_section(VkdfContext *ctx,
+                           VkdfBundle *bundle,
+                           uint32_t idx,
+                           VkBufferUsageFlags usage,
+                           bool *ok)
+{
+   VkDeviceSize size = bundle->entries[idx].raw_size;
+
+   VkdfBuffer buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         usage,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   uint8_t *map;
+   VK_CHECK(vkMapMemory(ctx->device, buf.mem, 0, size, 0, (void **) &map));
+
+   *ok = vkdf_bundle_read(bundle, idx, map);
+
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = buf.mem;
+   range.offset = 0;
+   range.size = size;
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+
+   vkUnmapMemory(ctx->device, buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, size);
+
+   return buf;
+}
+
+static bool
+validate_model_meta(const uint8_t *meta, uint64_t meta_size,
+                    uint64_t vertex_data_size, uint64_t index_data_size)
+{
+   if (meta_size < sizeof(BundleModelMeta))
+      return false;
+
+   const BundleModelMeta *header = (const BundleModelMeta *) meta;
+   if (meta_size != sizeof(BundleModelMeta) +
+                    header->num_materials * sizeof(VkdfMaterial) +
+                    header->num_meshes * sizeof(BundleMesh) +
+                    header->num_instances * sizeof(BundleInstance) +
+                    header->num_meshlets * sizeof(VkdfMeshlet)) {
+      return false;
+   }
+
+   const BundleMesh *meshes = (const BundleMesh *)
+      (meta + sizeof(BundleModelMeta) +
+       header->num_materials * sizeof(VkdfMaterial));
+   for (uint32_t i = 0; i < header->num_meshes; i++) {
+      if (meshes[i].num_lods < 1 || meshes[i].num_lods > VKDF_MESH_MAX_LODS)
+         return false;
+
+      if ((uint64_t) meshes[i].first_meshlet + meshes[i].num_meshlets >
+          header->num_meshlets) {
+         return false;
+      }
+
+      // Coarser levels follow level 0's indices
+      uint64_t num_indices = meshes[i].num_indices;
+      for (uint32_t l = 1; l < meshes[i].num_lods; l++) {
+         if (meshes[i].lod_first_index[l] != num_indices)
+            return false;
+         num_indices += meshes[i].lod_num_indices[l];
+      }
+
+      uint32_t vertex_size = 2 * sizeof(glm::vec3) +
+         ((meshes[i].flags & BUNDLE_MESH_HAS_UV) ? sizeof(glm::vec2) : 0);
+      if (meshes[i].vertex_offset +
+             (uint64_t) meshes[i].num_vertices * vertex_size >
+             vertex_data_size ||
+          meshes[i].index_offset + num_indices * sizeof(uint32_t) >
+             index_data_size) {
+         return false;
+      }
+   }
+
+   const BundleInstance *instances =
+      (const BundleInstance *) (meshes + header->num_meshes);
+   for (uint32_t i = 0; i < header->num_instances; i++) {
+      if (instances[i].mesh_idx >= header->num_meshes)
+         return false;
+   }
+
+   return true;
+}
+
+/**
+ * Loads model 'name' from the bundle. The model's packed vertex and index
+ * buffers are created and filled directly from the bundle, so there is no
+ * need to call vkdf_model_fill_vertex_buffers() on it (and per-mesh
+ * buffers are not available). Returns NULL if the model can't be loaded.
+ */
+VkdfModel *
+vkdf_bundle_load_model(VkdfContext *ctx,
+                       VkdfBundle *bundle,
+                       const char *name)
+{
+   VKDF_TRACE_SCOPE("vkdf_bundle_load_model");
+
+   int32_t meta_idx =
+      vkdf_bundle_find(bundle, name, VKDF_BUNDLE_SECTION_MODEL_META);
+   int32_t vertices_idx =
+      vkdf_bundle_find(bundle, name, VKDF_BUNDLE_SECTION_MODEL_VERTICES);
+   int32_t indices_idx =
+      vkdf_bundle_find(bundle, name, VKDF_BUNDLE_SECTION_MODEL_INDICES);
+   if (meta_idx < 0 || vertices_idx < 0 || indices_idx < 0) {
+      vkdf_error("Model '%s' not found in bundle", name);
+      return NULL;
+   }
+
+   uint64_t meta_size = bundle->entries[meta_idx].raw_size;
+   uint8_t *meta = (uint8_t *) g_malloc(meta_size);
+   if (!vkdf_bundle_read(bundle, meta_idx, meta) ||
+       !validate_model_meta(meta, meta_size,
+                            bundle->entries[vertices_idx].raw_size,
+                            bundle->entries[indices_idx].raw_size)) {
+      vkdf_error("Invalid metadata for model '%s' in bundle", name);
+      g_free(meta);
+      return NULL;
+   }
+
+   const BundleModelMeta *header = (const BundleModelMeta *) meta;
+   const VkdfMaterial *materials =
+      (const VkdfMaterial *) (meta + sizeof(BundleModelMeta));
+   const BundleMesh *meshes =
+      (const BundleMesh *) (materials + header->num_materials);
+   const BundleInstance *instances =
+      (const BundleInstance *) (meshes + header->num_meshes);
+   const VkdfMeshlet *meshlets =
+      (const VkdfMeshlet *) (instances + header->num_instances);
+
+   VkdfModel *model = vkdf_model_new();
+   model->materials.assign(materials, materials + header->num_materials);
+
+   for (uint32_t i = 0; i < header->num_meshes; i++) {
+      VkdfMesh *mesh = vkdf_mesh_new();
+      mesh->material_idx = meshes[i].material_idx;
+      mesh->cached = true;
+      mesh->cached_num_vertices = meshes[i].num_vertices;
+      mesh->cached_num_indices = meshes[i].num_indices;
+      mesh->cached_has_uv = (meshes[i].flags & BUNDLE_MESH_HAS_UV) != 0;
+      memcpy(&mesh->box.min, meshes[i].box_min, sizeof(glm::vec3));
+      memcpy(&mesh->box.max, meshes[i].box_max, sizeof(glm::vec3));
+      memcpy(&mesh->sphere.center, meshes[i].sphere, sizeof(glm::vec3));
+      mesh->sphere.radius = meshes[i].sphere[3];
+      mesh->num_lods = meshes[i].num_lods;
+      memcpy(mesh->lod_first_index, meshes[i].lod_first_index,
+             sizeof(mesh->lod_first_index));
+      memcpy(mesh->lod_num_indices, meshes[i].lod_num_indices,
+             sizeof(mesh->lod_num_indices));
+      memcpy(mesh->lod_error, meshes[i].lod_error, sizeof(mesh->lod_error));
+      mesh->meshlets.assign(meshlets + meshes[i].first_meshlet,
+                            meshlets + meshes[i].first_meshlet +
+                               meshes[i].num_meshlets);
+      vkdf_model_add_mesh(model, mesh);
+
+      model->vertex_buf_offsets.push_back(meshes[i].vertex_offset);
+      model->index_buf_offsets.push_back(meshes[i].index_offset);
+   }
+
+   if (header->num_instances > 0) {
+      std::vector<VkdfModelInstance> model_instances(header->num_instances);
+      for (uint32_t i = 0; i < header->num_instances; i++) {
+         memcpy(&model_instances[i].transform, instances[i].transform,
+                sizeof(glm::mat4));
+         model_instances[i].mesh_idx = instances[i].mesh_idx;
+      }
+      vkdf_model_set_instances(model, model_instances);
+   }
+
+   g_free(meta);
+
+   bool vertices_ok, indices_ok;
+   model->vertex_buf =
+      create_buffer_from_section(ctx, bundle, vertices_idx,
+                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                 &vertices_ok);
+   model->index_buf =
+      create_buffer_from_section(ctx, bundle, indices_idx,
+                                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                 &indices_ok);
+
+   if (!vertices_ok || !indices_ok) {
+      vkdf_model_free(ctx, model);
+      return NULL;
+   }
+
+   return model;
+}
+
+/**
+ * Creates a bundle writer for 'path'. If 'compression' is not
+ * VKDF_BUNDLE_COMPRESSION_NONE, sections are compressed in chunks of
+ * 'chunk_size' bytes (0 selects VKDF_BUNDLE_DEFAULT_CHUNK_SIZE).
+ */
+VkdfBundleWriter *
+vkdf_bundle_writer_new(const char *path,
+                       VkdfBundleCompression compression,
+                       uint32_t chunk_size)
+{
+#if !HAVE_LZ4
+   if (compression == VKDF_BUNDLE_COMPRESSION_LZ4) {
+      vkdf_error("The framework has been built without LZ4 support, "
+                 "writing uncompressed bundle");
+      compression = VKDF_BUNDLE_COMPRESSION_NONE;
+   }
+#endif
+
+   FILE *f = fopen(path, "wb");
+   if (!f) {
+      vkdf_error("Failed to create bundle '%s'", path);
+      return NULL;
+   }
+
+   VkdfBundleWriter *writer = g_new0(VkdfBundleWriter, 1);
+   writer->entries = std::vector<VkdfBundleEntry>();
+   writer->file = f;
+   writer->path = g_strdup(path);
+   writer->compression = compression;
+   writer->chunk_size =
+      chunk_size > 0 ? chunk_size : VKDF_BUNDLE_DEFAULT_CHUNK_SIZE;
+
+   // Space for the header, which we write when we are done
+   BundleHeader header;
+   memset(&header, 0, sizeof(header));
+   writer->failed = fwrite(&header, sizeof(header), 1, f) != 1;
+   writer->offset = sizeof(header);
+
+   return writer;
+}
+
+static void
+writer_write(VkdfBundleWriter *writer, const void *data, uint64_t size)
+{
+   if (writer->failed || size == 0)
+      return;
+
+   writer->failed = fwrite(data, size, 1, writer->file) != 1;
+   writer->offset += size;
+}
+
+static void
+writer_align(VkdfBundleWriter *writer)
+{
+   static const uint8_t zeros[VKDF_BUNDLE_ALIGNMENT] = { 0 };
+
+   uint64_t aligned = (writer->offset + VKDF_BUNDLE_ALIGNMENT - 1) &
+                      ~((uint64_t) VKDF_BUNDLE_ALIGNMENT - 1);
+   writer_write(writer, zeros, aligned - writer->offset);
+}
+
+#if HAVE_LZ4
+static void
+writer_write_compressed(VkdfBundleWriter *writer,
+                        const uint8_t *data,
+                        uint64_t size)
+{
+   int max_chunk_size = LZ4_compressBound(writer->chunk_size);
+   char *chunk = (char *) g_malloc(max_chunk_size);
+
+   for (uint64_t pos = 0; pos < size; pos += writer->chunk_size) {
+      uint32_t raw_size = MIN(writer->chunk_size, size - pos);
+      int stored_size = LZ4_compress_default((const char *) data + pos,
+                                             chunk, raw_size,
+                                             max_chunk_size);
+
+      // Store chunks that don't compress as-is
+      if (stored_size <= 0 || (uint32_t) stored_size >= raw_size) {
+         uint32_t chunk_header = raw_size | BUNDLE_CHUNK_RAW_BIT;
+         writer_write(writer, &chunk_header, sizeof(chunk_header));
+         writer_write(writer, data + pos, raw_size);
+      } else {
+         uint32_t chunk_header = stored_size;
+         writer_write(writer, &chunk_header, sizeof(chunk_header));
+         writer_write(writer, chunk, stored_size);
+      }
+   }
+
+   g_free(chunk);
+}
+#endif
+
+/**
+ * Adds a section with 'size' bytes from 'data' to the bundle
+ */
+bool
+vkdf_bundle_writer_add_data(VkdfBundleWriter *writer,
+                            const char *name,
+                            uint32_t type,
+                            const void *data,
+                            uint64_t size)
+{
+   if (strlen(name) >= VKDF_BUNDLE_MAX_NAME) {
+      vkdf_error("Bundle section name '%s' is too long", name);
+      writer->failed = true;
+      return false;
+   }
+
+   writer_align(writer);
+
+   VkdfBundleEntry entry;
+   memset(&entry, 0, sizeof(entry));
+   strcpy(entry.name, name);
+   entry.type = type;
+   entry.compression = writer->compression;
+   entry.offset = writer->offset;
+   entry.raw_size = size;
+
+#if HAVE_LZ4
+   if (writer->compression == VKDF_BUNDLE_COMPRESSION_LZ4) {
+      entry.chunk_size = writer->chunk_size;
+      writer_write_compressed(writer, (const uint8_t *) data, size);
+   } else {
+      writer_write(writer, data, size);
+   }
+#else
+   writer_write(writer, data, size);
+#endif
+
+   entry.size = writer->offset - entry.offset;
+   writer->entries.push_back(entry);
+
+   return !writer->failed;
+}
+
+/**
+ * Adds a model to the bundle under 'name'. The model's vertex and index
+ * data are stored packed in the same layout that
+ * vkdf_model_fill_vertex_buffers() uses for model-wide buffers.
+ */
+bool
+vkdf_bundle_writer_add_model(VkdfBundleWriter *writer,
+                             const char *name,
+                             VkdfModel *model)
+{
+   uint32_t num_meshes = model->meshes.size();
+   uint32_t num_materials = model->materials.size();
+   uint32_t num_instances = model->instances.size();
+   uint32_t num_meshlets = 0;
+   for (uint32_t i = 0; i < num_meshes; i++)
+      num_meshlets += model->meshes[i]->meshlets.size();
+
+   uint64_t meta_size = sizeof(BundleModelMeta) +
+                        num_materials * sizeof(VkdfMaterial) +
+                        num_meshes * sizeof(BundleMesh) +
+                        num_instances * sizeof(BundleInstance) +
+                        num_meshlets * sizeof(VkdfMeshlet);
+   uint8_t *meta = (uint8_t *) g_malloc0(meta_size);
+
+   BundleModelMeta *header = (BundleModelMeta *) meta;
+   header->num_materials = num_materials;
+   header->num_meshes = num_meshes;
+   header->num_instances = num_instances;
+   header->num_meshlets = num_meshlets;
+
+   VkdfMaterial *materials = (VkdfMaterial *) (meta + sizeof(BundleModelMeta));
+   if (num_materials > 0) {
+      memcpy(materials, model->materials.data(),
+             num_materials * sizeof(VkdfMaterial));
+   }
+
+   // Make sure material padding doesn't leak uninitialized memory into the
+   // bundle, which would make it non-deterministic
+   for (uint32_t i = 0; i < num_materials; i++)
+      memset(materials[i].padding, 0, sizeof(materials[i].padding));
+
+   BundleMesh *meshes = (BundleMesh *) (materials + num_materials);
+   BundleInstance *instances = (BundleInstance *) (meshes + num_meshes);
+   VkdfMeshlet *meshlets = (VkdfMeshlet *) (instances + num_instances);
+   uint32_t meshlet_count = 0;
+   uint64_t vertex_data_size = 0;
+   uint64_t index_data_size = 0;
+   for (uint32_t i = 0; i < num_meshes; i++) {
+      VkdfMesh *mesh = model->meshes[i];
+      assert(mesh->vertex_format == VKDF_VERTEX_FORMAT_FLOAT);
+      assert(mesh->index_type == VK_INDEX_TYPE_UINT32);
+      meshes[i].num_vertices = vkdf_mesh_get_num_vertices(mesh);
+      meshes[i].num_indices = vkdf_mesh_get_num_indices(mesh);
+      meshes[i].material_idx = mesh->material_idx;
+      meshes[i].flags = vkdf_mesh_has_uv(mesh) ? BUNDLE_MESH_HAS_UV : 0;
+      meshes[i].vertex_offset = vertex_data_size;
+      meshes[i].index_offset = index_data_size;
+      meshes[i].num_lods = mesh->num_lods;
+      memcpy(meshes[i].lod_first_index, mesh->lod_first_index,
+             sizeof(mesh->lod_first_index));
+      memcpy(meshes[i].lod_num_indices, mesh->lod_num_indices,
+             sizeof(mesh->lod_num_indices));
+      memcpy(meshes[i].lod_error, mesh->lod_error, sizeof(mesh->lod_error));
+      meshes[i].first_meshlet = meshlet_count;
+      meshes[i].num_meshlets = mesh->meshlets.size();
+      if (mesh->meshlets.size() > 0) {
+         memcpy(meshlets + meshlet_count, mesh->meshlets.data(),
+                mesh->meshlets.size() * sizeof(VkdfMeshlet));
+      }
+      meshlet_count += mesh->meshlets.size();
+
+      memcpy(meshes[i].box_min, &mesh->box.min, sizeof(meshes[i].box_min));
+      memcpy(meshes[i].box_max, &mesh->box.max, sizeof(meshes[i].box_max));
+      memcpy(meshes[i].sphere, &mesh->sphere.center, 3 * sizeof(float));
+      meshes[i].sphere[3] = mesh->sphere.radius;
+
+      vertex_data_size += vkdf_mesh_get_vertex_data_size(mesh);
+      index_data_size += vkdf_mesh_get_index_data_size(mesh);
+   }
+
+   for (uint32_t i = 0; i < num_instances; i++) {
+      memcpy(instances[i].transform, &model->instances[i].transform,
+             sizeof(instances[i].transform));
+      instances[i].mesh_idx = model->instances[i].mesh_idx;
+   }
+
+   uint8_t *vertex_data = (uint8_t *) g_malloc(vertex_data_size);
+   uint8_t *index_data = (uint8_t *) g_malloc(index_data_size);
+   for (uint32_t i = 0; i < num_meshes; i++) {
+      vkdf_mesh_copy_vertex_data(model->meshes[i],
+                                 vertex_data + meshes[i].vertex_offset);
+      vkdf_mesh_copy_index_data(model->meshes[i],
+                                index_data + meshes[i].index_offset);
+   }
+
+   bool ok =
+      vkdf_bundle_writer_add_data(writer, name,
+                                  VKDF_BUNDLE_SECTION_MODEL_META,
+                                  meta, meta_size) &&
+      vkdf_bundle_writer_add_data(writer, name,
+                                  VKDF_BUNDLE_SECTION_MODEL_VERTICES,
+                                  vertex_data, vertex_data_size) &&
+      vkdf_bundle_writer_add_data(writer, name,
+                                  VKDF_BUNDLE_SECTION_MODEL_INDICES,
+                                  index_data, index_data_size);
+
+   g_free(meta);
+   g_free(vertex_data);
+   g_free(index_data);
+
+   return ok;
+}
+
+/**
+ * Writes the entry table and the header and frees the writer. If anything
+ * failed while writing, the partial bundle is removed. Returns whether the
+ * bundle was written successfully.
+ */
+bool
+vkdf_bundle_writer_finish(VkdfBundleWriter *writer)
+{
+   writer_align(writer);
+
+   BundleHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = BUNDLE_MAGIC;
+   header.version = BUNDLE_VERSION;
+   header.num_entries = writer->entries.size();
+   header.entries_offset = writer->offset;
+
+   if (header.num_entries > 0) {
+      writer_write(writer, &writer->entries[0],
+                   header.num_entries * sizeof(VkdfBundleEntry));
+   }
+
+   bool ok = !writer->failed &&
+             fseek(writer->file, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, writer->file) == 1;
+   ok = (fclose(writer->file) == 0) && ok;
+
+   if (!ok) {
+      vkdf_error("Failed to write bundle '%s'", writer->path);
+      unlink(writer->path);
+   }
+
+   writer->entries.clear();
+   std::vector<VkdfBundleEntry>(writer->entries).swap(writer->entries);
+   g_free(writer->path);
+   g_free(writer);
+
+   return ok;
+}
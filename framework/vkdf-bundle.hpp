@@ -0,0 +1,118 @@
+#ifndef __VKDF_BUNDLE_H__
+#define __VKDF_BUNDLE_H__
+
+/**
+ * Asset bundles.
+ *
+ * A bundle packs a number of assets (imported models and raw data blobs)
+ * into a single file, usually produced offline with the vkdf-pack tool,
+ * so that loading them at startup is a sequential read of one file rather
+ * than an import of each source asset.
+ *
+ * Layout:
+ *
+ *    header | section | section | ... | entry table
+ *
+ * Every section starts at a VKDF_BUNDLE_ALIGNMENT aligned offset and the
+ * entry table records the name, type, offset and size of each of them.
+ * Models are stored as three sections: a metadata section with the
+ * materials, the mesh table, the mesh instances and the meshlets, a vertex
+ * data section with the interleaved vertex data of all meshes and an index
+ * data section, laid out exactly as the model's packed vertex and index
+ * buffers.
+ *
+ * Sections can be compressed with LZ4 (when the framework is built with
+ * LZ4 support). Compressed sections are split in chunks that are
+ * compressed independently so they can be decompressed one at a time
+ * straight into the destination memory.
+ *
+ * Writers never include timestamps or uninitialized padding, so packing
+ * the same inputs always produces the same bundle.
+ */
+
+#define VKDF_BUNDLE_ALIGNMENT          256
+#define VKDF_BUNDLE_MAX_NAME           64
+#define VKDF_BUNDLE_DEFAULT_CHUNK_SIZE (256 * 1024)
+
+typedef enum {
+   VKDF_BUNDLE_SECTION_RAW = 0,
+   VKDF_BUNDLE_SECTION_MODEL_META,
+   VKDF_BUNDLE_SECTION_MODEL_VERTICES,
+   VKDF_BUNDLE_SECTION_MODEL_INDICES,
+} VkdfBundleSectionType;
+
+typedef enum {
+   VKDF_BUNDLE_COMPRESSION_NONE = 0,
+   VKDF_BUNDLE_COMPRESSION_LZ4,
+} VkdfBundleCompression;
+
+typedef struct {
+   char name[VKDF_BUNDLE_MAX_NAME];
+   uint32_t type;
+   uint32_t compression;
+   uint64_t offset;
+   uint64_t size;          // Bytes stored in the file
+   uint64_t raw_size;      // Bytes after decompression
+   uint32_t chunk_size;    // Decompressed bytes per chunk
+   uint32_t pad;
+} VkdfBundleEntry;
+
+typedef struct {
+   int fd;
+   std::vector<VkdfBundleEntry> entries;
+   uint8_t *chunk_buf;
+   uint32_t chunk_buf_size;
+} VkdfBundle;
+
+typedef struct {
+   FILE *file;
+   char *path;
+   uint64_t offset;
+   VkdfBundleCompression compression;
+   uint32_t chunk_size;
+   std::vector<VkdfBundleEntry> entries;
+   bool failed;
+} VkdfBundleWriter;
+
+// Reading
+
+VkdfBundle *
+vkdf_bundle_open(const char *path);
+
+void
+vkdf_bundle_close(VkdfBundle *bundle);
+
+int32_t
+vkdf_bundle_find(VkdfBundle *bundle, const char *name, uint32_t type);
+
+bool
+vkdf_bundle_read(VkdfBundle *bundle, uint32_t idx, void *dst);
+
+VkdfModel *
+vkdf_bundle_load_model(VkdfContext *ctx,
+                       VkdfBundle *bundle,
+                       const char *name);
+
+// Writing
+
+VkdfBundleWriter *
+vkdf_bundle_writer_new(const char *path,
+                       VkdfBundleCompression compression,
+                       uint32_t chunk_size);
+
+bool
+vkdf_bundle_writer_add_data(VkdfBundleWriter *writer,
+                            const char *name,
+                            uint32_t type,
+                            const void *data,
+                            uint64_t size);
+
+bool
+vkdf_bundle_writer_add_model(VkdfBundleWriter *writer,
+                             const char *name,
+                             VkdfModel *model);
+
+bool
+vkdf_bundle_writer_finish(VkdfBundleWriter *writer);
+
+#endif
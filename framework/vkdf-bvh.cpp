@@ -0,0 +1,552 @@
+#include "vkdf.hpp"
+
+static inline bool
+is_leaf(const VkdfBvhNode *node)
+{
+   return node->child[0] == -1;
+}
+
+static inline float
+box_area(const VkdfBox *box)
+{
+   glm::vec3 d = box->max - box->min;
+   return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static inline VkdfBox
+box_union(const VkdfBox *a, const VkdfBox *b)
+{
+   VkdfBox box = *a;
+   vkdf_box_merge(&box, b);
+   return box;
+}
+
+static inline bool
+box_contains(const VkdfBox *outer, const VkdfBox *inner)
+{
+   return outer->min.x <= inner->min.x && outer->min.y <= inner->min.y &&
+          outer->min.z <= inner->min.z && outer->max.x >= inner->max.x &&
+          outer->max.y >= inner->max.y && outer->max.z >= inner->max.z;
+}
+
+static inline bool
+box_overlaps_sphere(const VkdfBox *box, const VkdfSphere *sphere)
+{
+   float dist2 = 0.0f;
+   for (uint32_t i = 0; i < 3; i++) {
+      float c = sphere->center[i];
+      float d = c < box->min[i] ? box->min[i] - c :
+                c > box->max[i] ? c - box->max[i] : 0.0f;
+      dist2 += d * d;
+   }
+   return dist2 <= sphere->radius * sphere->radius;
+}
+
+// Slab test. On a hit, 't' is the distance to the entry point, or 0 if
+// the ray starts inside the box.
+static inline bool
+ray_hits_box(const VkdfBox *box,
+             const glm::vec3 &origin,
+             const glm::vec3 &inv_dir,
+             float max_t,
+             float *t)
+{
+   float t_min = 0.0f;
+   float t_max = max_t;
+   for (uint32_t i = 0; i < 3; i++) {
+      float t1 = (box->min[i] - origin[i]) * inv_dir[i];
+      float t2 = (box->max[i] - origin[i]) * inv_dir[i];
+      t_min = MAX(t_min, MIN(t1, t2));
+      t_max = MIN(t_max, MAX(t1, t2));
+   }
+
+   *t = t_min;
+   return t_min <= t_max;
+}
+
+VkdfBvh *
+vkdf_bvh_new(float margin)
+{
+   VkdfBvh *bvh = g_new0(VkdfBvh, 1);
+   bvh->nodes = std::vector<VkdfBvhNode>();
+   bvh->root = -1;
+   bvh->free_list = -1;
+   bvh->num_leaves = 0;
+   bvh->margin = margin;
+   return bvh;
+}
+
+void
+vkdf_bvh_free(VkdfBvh *bvh)
+{
+   bvh->nodes.clear();
+   std::vector<VkdfBvhNode>(bvh->nodes).swap(bvh->nodes);
+   g_free(bvh);
+}
+
+static int32_t
+alloc_node(VkdfBvh *bvh)
+{
+   int32_t idx;
+   if (bvh->free_list != -1) {
+      idx = bvh->free_list;
+      bvh->free_list = bvh->nodes[idx].parent;
+   } else {
+      idx = bvh->nodes.size();
+      bvh->nodes.push_back(VkdfBvhNode());
+   }
+
+   VkdfBvhNode *node = &bvh->nodes[idx];
+   node->parent = -1;
+   node->child[0] = -1;
+   node->child[1] = -1;
+   node->height = 0;
+   node->data = 0;
+   return idx;
+}
+
+static void
+free_node(VkdfBvh *bvh, int32_t idx)
+{
+   bvh->nodes[idx].parent = bvh->free_list;
+   bvh->nodes[idx].height = -1;
+   bvh->free_list = idx;
+}
+
+static inline void
+replace_child(VkdfBvh *bvh, int32_t parent, int32_t old_idx, int32_t new_idx)
+{
+   if (parent == -1) {
+      bvh->root = new_idx;
+      return;
+   }
+
+   VkdfBvhNode *node = &bvh->nodes[parent];
+   if (node->child[0] == old_idx)
+      node->child[0] = new_idx;
+   else
+      node->child[1] = new_idx;
+}
+
+/**
+ * If the heights of the children of 'ia' differ by more than 1, rotates
+ * the taller child up to replace 'ia' and returns its index. Otherwise
+ * returns 'ia'.
+ */
+static int32_t
+balance(VkdfBvh *bvh, int32_t ia)
+{
+   VkdfBvhNode *a = &bvh->nodes[ia];
+   if (is_leaf(a) || a->height < 2)
+      return ia;
+
+   // Rotating either child up is symmetric, 'up' is the taller child and
+   // 'side' which of A's children it is
+   int32_t ib = a->child[0];
+   int32_t ic = a->child[1];
+   int32_t diff = bvh->nodes[ic].height - bvh->nodes[ib].height;
+   if (diff >= -1 && diff <= 1)
+      return ia;
+
+   uint32_t side = diff > 1 ? 1 : 0;
+   int32_t iup = a->child[side];
+   VkdfBvhNode *up = &bvh->nodes[iup];
+   VkdfBvhNode *other = &bvh->nodes[a->child[1 - side]];
+
+   int32_t i0 = up->child[0];
+   int32_t i1 = up->child[1];
+   VkdfBvhNode *n0 = &bvh->nodes[i0];
+   VkdfBvhNode *n1 = &bvh->nodes[i1];
+
+   // 'up' takes A's place and A becomes its child
+   up->child[0] = ia;
+   up->parent = a->parent;
+   a->parent = iup;
+   replace_child(bvh, up->parent, ia, iup);
+
+   // The taller grandchild stays with 'up', the other one goes to A
+   int32_t ikeep = n0->height > n1->height ? i0 : i1;
+   int32_t imove = ikeep == i0 ? i1 : i0;
+   VkdfBvhNode *keep = &bvh->nodes[ikeep];
+   VkdfBvhNode *move = &bvh->nodes[imove];
+
+   up->child[1] = ikeep;
+   a->child[side] = imove;
+   move->parent = ia;
+
+   a->box = box_union(&other->box, &move->box);
+   a->height = 1 + MAX(other->height, move->height);
+   up->box = box_union(&a->box, &keep->box);
+   up->height = 1 + MAX(a->height, keep->height);
+
+   return iup;
+}
+
+// Refits boxes and heights from 'idx' up to the root, rebalancing on
+// the way
+static void
+fix_upwards(VkdfBvh *bvh, int32_t idx)
+{
+   while (idx != -1) {
+      idx = balance(bvh, idx);
+
+      VkdfBvhNode *node = &bvh->nodes[idx];
+      const VkdfBvhNode *c0 = &bvh->nodes[node->child[0]];
+      const VkdfBvhNode *c1 = &bvh->nodes[node->child[1]];
+      node->height = 1 + MAX(c0->height, c1->height);
+      node->box = box_union(&c0->box, &c1->box);
+
+      idx = node->parent;
+   }
+}
+
+static void
+insert_leaf(VkdfBvh *bvh, int32_t leaf)
+{
+   if (bvh->root == -1) {
+      bvh->root = leaf;
+      bvh->nodes[leaf].parent = -1;
+      return;
+   }
+
+   // Descend to the sibling that minimizes the surface area added to the
+   // tree, counting the growth of all the ancestors of the new node
+   const VkdfBox leaf_box = bvh->nodes[leaf].box;
+   int32_t idx = bvh->root;
+   while (!is_leaf(&bvh->nodes[idx])) {
+      const VkdfBvhNode *node = &bvh->nodes[idx];
+
+      VkdfBox combined = box_union(&node->box, &leaf_box);
+      float area = box_area(&node->box);
+      float combined_area = box_area(&combined);
+
+      // Cost of making the leaf a sibling of this node, and the minimum
+      // cost pushed down to the children if we descend
+      float cost = 2.0f * combined_area;
+      float inherited = 2.0f * (combined_area - area);
+
+      float child_cost[2];
+      for (uint32_t i = 0; i < 2; i++) {
+         const VkdfBvhNode *child = &bvh->nodes[node->child[i]];
+         VkdfBox box = box_union(&child->box, &leaf_box);
+         child_cost[i] = box_area(&box) + inherited;
+         if (!is_leaf(child))
+            child_cost[i] -= box_area(&child->box);
+      }
+
+      if (cost < child_cost[0] && cost < child_cost[1])
+         break;
+
+      idx = node->child[child_cost[0] < child_cost[1] ? 0 : 1];
+   }
+
+   int32_t sibling = idx;
+   int32_t old_parent = bvh->nodes[sibling].parent;
+   int32_t new_parent = alloc_node(bvh);
+
+   VkdfBvhNode *parent = &bvh->nodes[new_parent];
+   parent->parent = old_parent;
+   parent->box = box_union(&bvh->nodes[sibling].box, &leaf_box);
+   parent->height = bvh->nodes[sibling].height + 1;
+   parent->child[0] = sibling;
+   parent->child[1] = leaf;
+   replace_child(bvh, old_parent, sibling, new_parent);
+
+   bvh->nodes[sibling].parent = new_parent;
+   bvh->nodes[leaf].parent = new_parent;
+
+   fix_upwards(bvh, new_parent);
+}
+
+static void
+remove_leaf(VkdfBvh *bvh, int32_t leaf)
+{
+   if (leaf == bvh->root) {
+      bvh->root = -1;
+      return;
+   }
+
+   // The leaf's sibling takes the place of their parent
+   int32_t parent = bvh->nodes[leaf].parent;
+   int32_t grandparent = bvh->nodes[parent].parent;
+   const VkdfBvhNode *p = &bvh->nodes[parent];
+   int32_t sibling = p->child[0] == leaf ? p->child[1] : p->child[0];
+
+   replace_child(bvh, grandparent, parent, sibling);
+   bvh->nodes[sibling].parent = grandparent;
+   free_node(bvh, parent);
+
+   fix_upwards(bvh, grandparent);
+}
+
+static inline void
+set_leaf_box(VkdfBvh *bvh, int32_t leaf, const VkdfBox *box)
+{
+   VkdfBvhNode *node = &bvh->nodes[leaf];
+   node->tight = *box;
+   node->box.min = box->min - glm::vec3(bvh->margin);
+   node->box.max = box->max + glm::vec3(bvh->margin);
+}
+
+/**
+ * Adds a leaf for an object with world-space bounds 'box'. Returns the
+ * leaf's proxy id, which stays valid until it is removed. 'data' is what
+ * queries return for it, usually the object's index.
+ */
+int32_t
+vkdf_bvh_insert(VkdfBvh *bvh, const VkdfBox *box, uint32_t data)
+{
+   assert(!vkdf_box_is_empty(box));
+
+   int32_t leaf = alloc_node(bvh);
+   set_leaf_box(bvh, leaf, box);
+   bvh->nodes[leaf].data = data;
+
+   insert_leaf(bvh, leaf);
+   bvh->num_leaves++;
+   return leaf;
+}
+
+void
+vkdf_bvh_remove(VkdfBvh *bvh, int32_t proxy)
+{
+   assert(bvh->nodes[proxy].height == 0);
+
+   remove_leaf(bvh, proxy);
+   free_node(bvh, proxy);
+   bvh->num_leaves--;
+}
+
+/**
+ * Updates the bounds of a leaf. Returns true if the object moved out of
+ * its leaf's enlarged box and the leaf had to be inserted again.
+ */
+bool
+vkdf_bvh_move(VkdfBvh *bvh, int32_t proxy, const VkdfBox *box)
+{
+   assert(bvh->nodes[proxy].height == 0);
+
+   if (box_contains(&bvh->nodes[proxy].box, box)) {
+      bvh->nodes[proxy].tight = *box;
+      return false;
+   }
+
+   remove_leaf(bvh, proxy);
+   set_leaf_box(bvh, proxy, box);
+   insert_leaf(bvh, proxy);
+   return true;
+}
+
+/**
+ * Moves the leaves of the transforms in the store's dirty list.
+ * 'proxies' and 'local_boxes' are indexed by transform: the proxy of the
+ * object that uses each transform (-1 for none) and its object-space box.
+ */
+void
+vkdf_bvh_update_from_transforms(VkdfBvh *bvh,
+                                VkdfTransformStore *store,
+                                const int32_t *proxies,
+                                const VkdfBox *local_boxes)
+{
+   VKDF_TRACE_SCOPE("vkdf_bvh_update_from_transforms");
+
+   for (uint32_t i = 0; i < store->num_dirty; i++) {
+      uint32_t idx = store->dirty_list[i];
+      if (proxies[idx] < 0)
+         continue;
+
+      glm::mat4 model;
+      vkdf_transform_store_compute_matrices(store, idx, 1,
+                                            (uint8_t *) &model[0][0],
+                                            sizeof(glm::mat4));
+
+      VkdfBox box;
+      vkdf_box_transform(&local_boxes[idx], model, &box);
+      vkdf_bvh_move(bvh, proxies[idx], &box);
+   }
+}
+
+// Appends the data of all the leaves under 'idx'
+static void
+collect_leaves(VkdfBvh *bvh,
+               int32_t idx,
+               std::vector<int32_t> &stack,
+               std::vector<uint32_t> *out)
+{
+   size_t base = stack.size();
+   stack.push_back(idx);
+   while (stack.size() > base) {
+      const VkdfBvhNode *node = &bvh->nodes[stack.back()];
+      stack.pop_back();
+      if (is_leaf(node)) {
+         out->push_back(node->data);
+      } else {
+         stack.push_back(node->child[0]);
+         stack.push_back(node->child[1]);
+      }
+   }
+}
+
+// Tests the box against the planes in 'mask'. Returns false if it is
+// fully outside any of them and clears the bits of the planes it is fully
+// inside of.
+static inline bool
+test_frustum_planes(const VkdfFrustum *frustum,
+                    const VkdfBox *box,
+                    uint32_t *mask)
+{
+   for (uint32_t p = 0; p < 6; p++) {
+      if (!(*mask & (1 << p)))
+         continue;
+
+      const glm::vec4 &pl = frustum->planes[p];
+      glm::vec3 n = glm::vec3(pl);
+
+      // Box corners furthest along and against the plane's normal
+      glm::vec3 pv, nv;
+      for (uint32_t i = 0; i < 3; i++) {
+         pv[i] = n[i] >= 0.0f ? box->max[i] : box->min[i];
+         nv[i] = n[i] >= 0.0f ? box->min[i] : box->max[i];
+      }
+
+      if (glm::dot(n, pv) + pl.w < 0.0f)
+         return false;
+      if (glm::dot(n, nv) + pl.w >= 0.0f)
+         *mask &= ~(1 << p);
+   }
+   return true;
+}
+
+/**
+ * Appends the data of the leaves whose box is at least partially inside
+ * the frustum to 'out'. Returns how many were added.
+ */
+uint32_t
+vkdf_bvh_query_frustum(VkdfBvh *bvh,
+                       const VkdfFrustum *frustum,
+                       std::vector<uint32_t> *out)
+{
+   VKDF_TRACE_SCOPE("vkdf_bvh_query_frustum");
+
+   size_t start = out->size();
+   if (bvh->root == -1)
+      return 0;
+
+   // Node and the mask of planes it still has to be tested against
+   std::vector<std::pair<int32_t, uint32_t> > stack;
+   std::vector<int32_t> collect_stack;
+   stack.push_back(std::make_pair(bvh->root, 0x3fu));
+
+   while (!stack.empty()) {
+      int32_t idx = stack.back().first;
+      uint32_t mask = stack.back().second;
+      stack.pop_back();
+
+      const VkdfBvhNode *node = &bvh->nodes[idx];
+      if (!test_frustum_planes(frustum, &node->box, &mask))
+         continue;
+
+      // Fully inside: everything below is visible
+      if (mask == 0) {
+         collect_leaves(bvh, idx, collect_stack, out);
+         continue;
+      }
+
+      if (is_leaf(node)) {
+         if (test_frustum_planes(frustum, &node->tight, &mask))
+            out->push_back(node->data);
+         continue;
+      }
+
+      stack.push_back(std::make_pair(node->child[0], mask));
+      stack.push_back(std::make_pair(node->child[1], mask));
+   }
+
+   return out->size() - start;
+}
+
+/**
+ * Appends the data of the leaves whose box overlaps the sphere to 'out',
+ * for example, the objects within a light's radius. Returns how many were
+ * added.
+ */
+uint32_t
+vkdf_bvh_query_sphere(VkdfBvh *bvh,
+                      const VkdfSphere *sphere,
+                      std::vector<uint32_t> *out)
+{
+   VKDF_TRACE_SCOPE("vkdf_bvh_query_sphere");
+
+   size_t start = out->size();
+   if (bvh->root == -1)
+      return 0;
+
+   std::vector<int32_t> stack;
+   stack.push_back(bvh->root);
+   while (!stack.empty()) {
+      const VkdfBvhNode *node = &bvh->nodes[stack.back()];
+      stack.pop_back();
+
+      if (!box_overlaps_sphere(&node->box, sphere))
+         continue;
+
+      if (is_leaf(node)) {
+         if (box_overlaps_sphere(&node->tight, sphere))
+            out->push_back(node->data);
+      } else {
+         stack.push_back(node->child[0]);
+         stack.push_back(node->child[1]);
+      }
+   }
+
+   return out->size() - start;
+}
+
+/**
+ * Finds the closest leaf box hit by the ray within 'max_t' (in units of
+ * 'dir'). On a hit, returns the leaf's data in 'data' and the distance
+ * along the ray in 't'.
+ */
+bool
+vkdf_bvh_raycast(VkdfBvh *bvh,
+                 const glm::vec3 &origin,
+                 const glm::vec3 &dir,
+                 float max_t,
+                 uint32_t *data,
+                 float *t)
+{
+   VKDF_TRACE_SCOPE("vkdf_bvh_raycast");
+
+   if (bvh->root == -1)
+      return false;
+
+   glm::vec3 inv_dir = glm::vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+   float best_t = max_t;
+   bool hit = false;
+
+   std::vector<int32_t> stack;
+   stack.push_back(bvh->root);
+   while (!stack.empty()) {
+      const VkdfBvhNode *node = &bvh->nodes[stack.back()];
+      stack.pop_back();
+
+      float node_t;
+      if (!ray_hits_box(&node->box, origin, inv_dir, best_t, &node_t))
+         continue;
+
+      if (is_leaf(node)) {
+         if (ray_hits_box(&node->tight, origin, inv_dir, best_t, &node_t)) {
+            best_t = node_t;
+            *data = node->data;
+            hit = true;
+         }
+      } else {
+         stack.push_back(node->child[0]);
+         stack.push_back(node->child[1]);
+      }
+   }
+
+   if (hit)
+      *t = best_t;
+   return hit;
+}
@@ -0,0 +1,98 @@
+#ifndef __VKDF_BVH_H__
+#define __VKDF_BVH_H__
+
+/**
+ * Dynamic bounding volume hierarchy over world-space boxes.
+ *
+ * A binary tree of axis-aligned boxes where each leaf is a proxy for one
+ * object, identified by the value passed to vkdf_bvh_insert(). Leaves
+ * store their box enlarged by a margin, so objects that move a little stay
+ * within their leaf's box and vkdf_bvh_move() only has to update the
+ * leaf. Objects that move further are removed and inserted again. Inserts
+ * pick the sibling that grows the tree's total surface area the least and
+ * the tree is kept balanced with rotations, like Box2D's dynamic tree.
+ *
+ * Frustum queries skip the plane tests for subtrees fully inside the
+ * frustum, so their cost grows with the number of visible objects rather
+ * than with the total. Leaves are tested with their exact boxes, so
+ * queries return the same objects as testing every box one by one.
+ *
+ * When object transforms are kept in a VkdfTransformStore, the tree can
+ * be updated from the store's dirty list with
+ * vkdf_bvh_update_from_transforms(). This must be done before the dirty
+ * list is cleared by vkdf_transform_store_flush().
+ */
+
+typedef struct {
+   // For leaves, 'box' is the enlarged box and 'tight' the exact one
+   VkdfBox box;
+   VkdfBox tight;
+
+   // Next free node for nodes in the free list
+   int32_t parent;
+
+   // -1 for leaves
+   int32_t child[2];
+
+   // 0 for leaves, -1 for free nodes
+   int32_t height;
+
+   // Leaves only: the value passed to vkdf_bvh_insert()
+   uint32_t data;
+} VkdfBvhNode;
+
+typedef struct {
+   std::vector<VkdfBvhNode> nodes;
+   int32_t root;
+   int32_t free_list;
+   uint32_t num_leaves;
+   float margin;
+} VkdfBvh;
+
+VkdfBvh *
+vkdf_bvh_new(float margin);
+
+void
+vkdf_bvh_free(VkdfBvh *bvh);
+
+int32_t
+vkdf_bvh_insert(VkdfBvh *bvh, const VkdfBox *box, uint32_t data);
+
+void
+vkdf_bvh_remove(VkdfBvh *bvh, int32_t proxy);
+
+bool
+vkdf_bvh_move(VkdfBvh *bvh, int32_t proxy, const VkdfBox *box);
+
+inline uint32_t
+vkdf_bvh_get_data(VkdfBvh *bvh, int32_t proxy)
+{
+   assert(bvh->nodes[proxy].height == 0);
+   return bvh->nodes[proxy].data;
+}
+
+void
+vkdf_bvh_update_from_transforms(VkdfBvh *bvh,
+                                VkdfTransformStore *store,
+                                const int32_t *proxies,
+                                const VkdfBox *local_boxes);
+
+uint32_t
+vkdf_bvh_query_frustum(VkdfBvh *bvh,
+                       const VkdfFrustum *frustum,
+                       std::vector<uint32_t> *out);
+
+uint32_t
+vkdf_bvh_query_sphere(VkdfBvh *bvh,
+                      const VkdfSphere *sphere,
+                      std::vector<uint32_t> *out);
+
+bool
+vkdf_bvh_raycast(VkdfBvh *bvh,
+                 const glm::vec3 &origin,
+                 const glm::vec3 &dir,
+                 float max_t,
+                 uint32_t *data,
+                 float *t);
+
+#endif
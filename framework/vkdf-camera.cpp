@@ -44,6 +44,7 @@ vkdf_camera_set_rotation(VkdfCamera *cam, float rx, float ry, float rz)
    cam->rot.y = ry;
    cam->rot.z = rz;
    cam->dirty = true;
+   cam->rot_dirty = true;
 }
 
 void
@@ -78,31 +79,67 @@ vkdf_camera_rotate(VkdfCamera *cam, float rx, float ry, float rz)
       cam->rot.z += 360.0f;
 
    cam->dirty = true;
+   cam->rot_dirty = true;
 }
 
 /**
- * Obtains a normalized vector describing the camera viewing direction
+ * Rebuilds the orientation quaternion and the viewing direction after the
+ * camera rotates. The camera is rotated around X, then Y, then Z, so its
+ * view matrix rotates around Z, Y and X by the opposite angles.
  */
-glm::vec3
-vkdf_camera_get_viewdir(VkdfCamera *cam)
+static void
+update_rotation(VkdfCamera *cam)
 {
-   glm::vec3 v1, v2;
+   if (!cam->rot_dirty)
+      return;
 
-   /* Rotate around Y-axis */
-   float angle = DEG_TO_RAD(cam->rot.y + 90.0);
-   v1.x =  cos(angle);
-   v1.z = -sin(angle);
+   glm::quat qx = glm::angleAxis(DEG_TO_RAD(cam->rot.x), glm::vec3(1, 0, 0));
+   glm::quat qy = glm::angleAxis(DEG_TO_RAD(cam->rot.y), glm::vec3(0, 1, 0));
+   glm::quat qz = glm::angleAxis(DEG_TO_RAD(cam->rot.z), glm::vec3(0, 0, 1));
+   cam->orientation = glm::normalize(qz * qy * qx);
 
-   /* Rotate around X-axis */
-   angle = DEG_TO_RAD(cam->rot.x);
-	float cosX = cos(angle);
-	v2.x = v1.x * cosX;
-	v2.z = v1.z * cosX;
-	v2.y = sin(angle);
+   // The camera looks down -Z when it is not rotated
+   cam->viewdir = cam->orientation * glm::vec3(0.0f, 0.0f, -1.0f);
 
-   /* Rotate around Z-axis (not supportted!) */
+   cam->rot_dirty = false;
+}
 
-   return v2;
+/**
+ * Recomputes the cached view state if the camera changed since it was
+ * last requested.
+ */
+static void
+update_view(VkdfCamera *cam)
+{
+   update_rotation(cam);
+
+   if (!cam->dirty)
+      return;
+
+   cam->view = glm::translate(glm::mat4_cast(glm::conjugate(cam->orientation)),
+                              -cam->pos);
+
+   if (cam->has_projection) {
+      cam->view_proj = cam->projection * cam->view;
+
+      VkdfFrustum frustum;
+      vkdf_frustum_from_matrix(&frustum, cam->view_proj);
+      memcpy(cam->frustum_planes, frustum.planes, sizeof(frustum.planes));
+   } else {
+      cam->view_proj = cam->view;
+   }
+
+   cam->dirty = false;
+}
+
+/**
+ * Obtains a normalized vector describing the camera viewing direction
+ */
+glm::vec3
+vkdf_camera_get_viewdir(VkdfCamera *cam)
+{
+   update_rotation(cam);
+   return cam->viewdir;
 }
 
 /**
@@ -181,31 +218,88 @@ vkdf_camera_look_at(VkdfCamera *cam, float x, float y, float z)
 
    cam->rot.z = 0.0f;
    cam->dirty = true;
+   cam->rot_dirty = true;
+}
+
+glm::quat
+vkdf_camera_get_orientation(VkdfCamera *cam)
+{
+   update_rotation(cam);
+   return cam->orientation;
+}
+
+/**
+ * Sets a perspective projection with a vertical field of view of 'fovy'
+ * degrees. The projection is corrected for Vulkan's clip space (Y pointing
+ * down and depth in [0, 1]).
+ */
+void
+vkdf_camera_set_projection(VkdfCamera *cam,
+                           float fovy,
+                           float aspect,
+                           float z_near,
+                           float z_far)
+{
+   glm::mat4 clip = glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
+                              0.0f,-1.0f, 0.0f, 0.0f,
+                              0.0f, 0.0f, 0.5f, 0.0f,
+                              0.0f, 0.0f, 0.5f, 1.0f);
+
+   vkdf_camera_set_projection_matrix(cam,
+                                     clip * glm::perspective(DEG_TO_RAD(fovy),
+                                                             aspect,
+                                                             z_near, z_far));
+}
+
+/**
+ * Sets any projection matrix. It must produce Vulkan clip coordinates for
+ * the frustum planes to be correct.
+ */
+void
+vkdf_camera_set_projection_matrix(VkdfCamera *cam,
+                                  const glm::mat4 &projection)
+{
+   cam->projection = projection;
+   cam->has_projection = true;
+   cam->dirty = true;
+}
+
+glm::mat4
+vkdf_camera_get_projection_matrix(VkdfCamera *cam)
+{
+   assert(cam->has_projection);
+   return cam->projection;
 }
 
 glm::mat4
 vkdf_camera_get_rotation_matrix(VkdfCamera *cam)
 {
-   glm::mat4 mat(1.0);
-   float rx = DEG_TO_RAD(cam->rot.x);
-   float ry = DEG_TO_RAD(cam->rot.y);
-   float rz = DEG_TO_RAD(cam->rot.z);
-   mat = glm::rotate(mat, rz, glm::vec3(0, 0, 1));
-   mat = glm::rotate(mat, ry, glm::vec3(0, 1, 0));
-   mat = glm::rotate(mat, rx, glm::vec3(1, 0, 0));
-   return mat;
+   update_rotation(cam);
+   return glm::mat4_cast(cam->orientation);
 }
 
 glm::mat4
 vkdf_camera_get_view_matrix(VkdfCamera *cam)
 {
-   glm::mat4 mat(1.0);
-   float rx = DEG_TO_RAD(cam->rot.x);
-   float ry = DEG_TO_RAD(cam->rot.y);
-   float rz = DEG_TO_RAD(cam->rot.z);
-   mat = glm::rotate(mat, -rx, glm::vec3(1, 0, 0));
-   mat = glm::rotate(mat, -ry, glm::vec3(0, 1, 0));
-   mat = glm::rotate(mat, -rz, glm::vec3(0, 0, 1));
-   mat = glm::translate(mat, -cam->pos);
-   return mat;
+   update_view(cam);
+   return cam->view;
+}
+
+glm::mat4
+vkdf_camera_get_view_projection_matrix(VkdfCamera *cam)
+{
+   update_view(cam);
+   return cam->view_proj;
+}
+
+/**
+ * Returns the 6 planes of the camera's view frustum, in the layout of
+ * VkdfFrustum. Requires a projection.
+ */
+const glm::vec4 *
+vkdf_camera_get_frustum_planes(VkdfCamera *cam)
+{
+   assert(cam->has_projection);
+   update_view(cam);
+   return cam->frustum_planes;
 }
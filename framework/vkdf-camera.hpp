@@ -1,11 +1,39 @@
 #ifndef __VKDF_CAMERA_H__
 #define __VKDF_CAMERA_H__
 
+/**
+ * Cameras.
+ *
+ * Rotations are given as Euler angles in degrees, but the camera keeps its
+ * orientation as a quaternion and caches everything derived from it: the
+ * view direction, the view and view-projection matrices and the planes of
+ * the view frustum. These are only recomputed, without trigonometry, the
+ * first time they are requested after the camera moves or rotates, so
+ * cameras that don't change cost nothing per frame.
+ *
+ * The projection is set with vkdf_camera_set_projection(). Until then, the
+ * view-projection matrix is the view matrix and the frustum planes are
+ * not available.
+ */
+
 typedef struct {
    glm::vec3 pos;
    glm::vec3 rot;
    float dist;
+
+   // Whether the view state below is out of date with pos and rot
    bool dirty;
+   bool rot_dirty;
+
+   glm::quat orientation;
+   glm::vec3 viewdir;
+
+   bool has_projection;
+   glm::mat4 projection;
+
+   glm::mat4 view;
+   glm::mat4 view_proj;
+   glm::vec4 frustum_planes[6];
 } VkdfCamera;
 
 VkdfCamera *
@@ -44,10 +72,44 @@ vkdf_camera_strafe(VkdfCamera *cam, float d);
 void
 vkdf_camera_look_at(VkdfCamera *cam, float x, float y, float z);
 
+glm::quat
+vkdf_camera_get_orientation(VkdfCamera *cam);
+
+void
+vkdf_camera_set_projection(VkdfCamera *cam,
+                           float fovy,
+                           float aspect,
+                           float z_near,
+                           float z_far);
+
+void
+vkdf_camera_set_projection_matrix(VkdfCamera *cam,
+                                  const glm::mat4 &projection);
+
+glm::mat4
+vkdf_camera_get_projection_matrix(VkdfCamera *cam);
+
 glm::mat4
 vkdf_camera_get_view_matrix(VkdfCamera *cam);
 
+glm::mat4
+vkdf_camera_get_view_projection_matrix(VkdfCamera *cam);
+
+const glm::vec4 *
+vkdf_camera_get_frustum_planes(VkdfCamera *cam);
+
 glm::mat4
 vkdf_camera_get_rotation_matrix(VkdfCamera *cam);
 
+/**
+ * Whether the camera moved, rotated or changed its projection since its
+ * view matrices were last requested. Useful to skip uploading them when
+ * nothing changed.
+ */
+inline bool
+vkdf_camera_is_dirty(VkdfCamera *cam)
+{
+   return cam->dirty;
+}
+
 #endif
@@ -45,6 +45,8 @@ vkdf_command_buffer_begin(VkCommandBuffer cmd_buf,
    cmd_buf_info.pInheritanceInfo = NULL;
 
    VK_CHECK(vkBeginCommandBuffer(cmd_buf, &cmd_buf_info));
+
+   _vkdf_stats_cmd_buf_reset(cmd_buf);
 }
 
 void
@@ -74,6 +76,9 @@ vkdf_command_buffer_execute(VkdfContext *ctx,
    submit_info.pCommandBuffers = &cmd_buf;
 
    VK_CHECK(vkQueueSubmit(ctx->gfx_queue, 1, &submit_info, NULL));
+
+   _vkdf_stats_cmd_buf_submitted(cmd_buf);
+   _vkdf_stats_count(VKDF_STAT_SUBMITS, 1);
 }
 
 void
@@ -100,6 +105,9 @@ vkdf_command_buffer_execute_sync(VkdfContext *ctx,
    VK_CHECK(vkCreateFence(ctx->device, &fence_info, NULL, &fence));
 
    VK_CHECK(vkQueueSubmit(ctx->gfx_queue, 1, &submit_info, fence));
+   _vkdf_stats_cmd_buf_submitted(cmd_buf);
+   _vkdf_stats_count(VKDF_STAT_SUBMITS, 1);
+
    VK_CHECK(vkWaitForFences(ctx->device, 1, &fence, true, 100000000000ull));
 
    vkDestroyFence(ctx->device, fence, NULL);
@@ -0,0 +1,335 @@
+#include "vkdf.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Objects are culled in chunks of this many objects when using threads
+#define CULL_CHUNK_SIZE 4096
+
+static inline glm::vec4
+normalize_plane(const glm::vec4 &plane)
+{
+   return plane / glm::length(glm::vec3(plane));
+}
+
+/**
+ * Extracts the frustum planes from a view-projection matrix (G. Gribb and
+ * K. Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+ * World-View-Projection Matrix"), for Vulkan's 0..w depth range.
+ */
+void
+vkdf_frustum_from_matrix(VkdfFrustum *frustum, const glm::mat4 &view_proj)
+{
+   glm::vec4 row[4];
+   for (uint32_t i = 0; i < 4; i++) {
+      row[i] = glm::vec4(view_proj[0][i], view_proj[1][i],
+                         view_proj[2][i], view_proj[3][i]);
+   }
+
+   frustum->planes[0] = normalize_plane(row[3] + row[0]);   // Left
+   frustum->planes[1] = normalize_plane(row[3] - row[0]);   // Right
+   frustum->planes[2] = normalize_plane(row[3] + row[1]);   // Bottom
+   frustum->planes[3] = normalize_plane(row[3] - row[1]);   // Top
+   frustum->planes[4] = normalize_plane(row[2]);            // Near
+   frustum->planes[5] = normalize_plane(row[3] - row[2]);   // Far
+}
+
+/**
+ * Copies the camera's cached frustum planes, which are only recomputed
+ * when the camera changes. The camera must have a projection.
+ */
+void
+vkdf_frustum_from_camera(VkdfFrustum *frustum, VkdfCamera *cam)
+{
+   memcpy(frustum->planes, vkdf_camera_get_frustum_planes(cam),
+          sizeof(frustum->planes));
+}
+
+static void
+bounds_resize(VkdfCullBounds *bounds, uint32_t capacity)
+{
+   bounds->center_x = g_renew(float, bounds->center_x, capacity);
+   bounds->center_y = g_renew(float, bounds->center_y, capacity);
+   bounds->center_z = g_renew(float, bounds->center_z, capacity);
+   bounds->radius = g_renew(float, bounds->radius, capacity);
+   bounds->min_x = g_renew(float, bounds->min_x, capacity);
+   bounds->min_y = g_renew(float, bounds->min_y, capacity);
+   bounds->min_z = g_renew(float, bounds->min_z, capacity);
+   bounds->max_x = g_renew(float, bounds->max_x, capacity);
+   bounds->max_y = g_renew(float, bounds->max_y, capacity);
+   bounds->max_z = g_renew(float, bounds->max_z, capacity);
+   bounds->capacity = capacity;
+}
+
+VkdfCullBounds *
+vkdf_cull_bounds_new(uint32_t capacity)
+{
+   VkdfCullBounds *bounds = g_new0(VkdfCullBounds, 1);
+   bounds_resize(bounds, MAX(capacity, 1));
+   return bounds;
+}
+
+void
+vkdf_cull_bounds_free(VkdfCullBounds *bounds)
+{
+   g_free(bounds->center_x);
+   g_free(bounds->center_y);
+   g_free(bounds->center_z);
+   g_free(bounds->radius);
+   g_free(bounds->min_x);
+   g_free(bounds->min_y);
+   g_free(bounds->min_z);
+   g_free(bounds->max_x);
+   g_free(bounds->max_y);
+   g_free(bounds->max_z);
+   g_free(bounds);
+}
+
+/**
+ * Sets the world-space bounds of object 'idx'. Objects with empty bounds
+ * are always culled.
+ */
+void
+vkdf_cull_bounds_set(VkdfCullBounds *bounds,
+                     uint32_t idx,
+                     const VkdfBox *box,
+                     const VkdfSphere *sphere)
+{
+   assert(idx < bounds->count);
+
+   bounds->center_x[idx] = sphere->center.x;
+   bounds->center_y[idx] = sphere->center.y;
+   bounds->center_z[idx] = sphere->center.z;
+   bounds->radius[idx] = sphere->radius;
+
+   bounds->min_x[idx] = box->min.x;
+   bounds->min_y[idx] = box->min.y;
+   bounds->min_z[idx] = box->min.z;
+   bounds->max_x[idx] = box->max.x;
+   bounds->max_y[idx] = box->max.y;
+   bounds->max_z[idx] = box->max.z;
+
+   // No sphere is ever inside all the planes with this radius
+   if (vkdf_box_is_empty(box) || vkdf_sphere_is_empty(sphere))
+      bounds->radius[idx] = -FLT_MAX;
+}
+
+uint32_t
+vkdf_cull_bounds_add(VkdfCullBounds *bounds,
+                     const VkdfBox *box,
+                     const VkdfSphere *sphere)
+{
+   if (bounds->count == bounds->capacity)
+      bounds_resize(bounds, bounds->capacity * 2);
+
+   uint32_t idx = bounds->count++;
+   vkdf_cull_bounds_set(bounds, idx, box, sphere);
+   return idx;
+}
+
+/**
+ * Adds the current world-space bounds of 'obj'. They need to be updated
+ * with vkdf_cull_bounds_set_object() if the object moves.
+ */
+uint32_t
+vkdf_cull_bounds_add_object(VkdfCullBounds *bounds, VkdfObject *obj)
+{
+   VkdfBox box;
+   VkdfSphere sphere;
+   vkdf_object_get_box(obj, &box);
+   vkdf_object_get_sphere(obj, &sphere);
+   return vkdf_cull_bounds_add(bounds, &box, &sphere);
+}
+
+void
+vkdf_cull_bounds_set_object(VkdfCullBounds *bounds,
+                            uint32_t idx,
+                            VkdfObject *obj)
+{
+   VkdfBox box;
+   VkdfSphere sphere;
+   vkdf_object_get_box(obj, &box);
+   vkdf_object_get_sphere(obj, &sphere);
+   vkdf_cull_bounds_set(bounds, idx, &box, &sphere);
+}
+
+static inline bool
+is_visible(const VkdfFrustum *frustum,
+           const VkdfCullBounds *b,
+           uint32_t i)
+{
+   // Comparisons are written so that NaNs, which we can get from empty
+   // boxes, count as outside, like in the SSE path
+   for (uint32_t p = 0; p < 6; p++) {
+      const glm::vec4 &pl = frustum->planes[p];
+      float d = pl.x * b->center_x[i] + pl.y * b->center_y[i] +
+                pl.z * b->center_z[i] + pl.w;
+      if (!(d + b->radius[i] >= 0.0f))
+         return false;
+   }
+
+   for (uint32_t p = 0; p < 6; p++) {
+      const glm::vec4 &pl = frustum->planes[p];
+      float d = pl.x * (pl.x >= 0.0f ? b->max_x[i] : b->min_x[i]) +
+                pl.y * (pl.y >= 0.0f ? b->max_y[i] : b->min_y[i]) +
+                pl.z * (pl.z >= 0.0f ? b->max_z[i] : b->min_z[i]) + pl.w;
+      if (!(d >= 0.0f))
+         return false;
+   }
+
+   return true;
+}
+
+static uint32_t
+cull_range(const VkdfFrustum *frustum,
+           const VkdfCullBounds *b,
+           uint32_t first,
+           uint32_t count,
+           uint32_t *visible)
+{
+   uint32_t num_visible = 0;
+   uint32_t i = first;
+   uint32_t end = first + count;
+
+#ifdef __SSE2__
+   const __m128 zero = _mm_setzero_ps();
+
+   __m128 px[6], py[6], pz[6], pw[6];
+   for (uint32_t p = 0; p < 6; p++) {
+      px[p] = _mm_set1_ps(frustum->planes[p].x);
+      py[p] = _mm_set1_ps(frustum->planes[p].y);
+      pz[p] = _mm_set1_ps(frustum->planes[p].z);
+      pw[p] = _mm_set1_ps(frustum->planes[p].w);
+   }
+
+   // For each plane, the box corner furthest along its normal
+   const float *vx[6], *vy[6], *vz[6];
+   for (uint32_t p = 0; p < 6; p++) {
+      vx[p] = frustum->planes[p].x >= 0.0f ? b->max_x : b->min_x;
+      vy[p] = frustum->planes[p].y >= 0.0f ? b->max_y : b->min_y;
+      vz[p] = frustum->planes[p].z >= 0.0f ? b->max_z : b->min_z;
+   }
+
+   for (; i + 4 <= end; i += 4) {
+      // Spheres
+      __m128 cx = _mm_loadu_ps(b->center_x + i);
+      __m128 cy = _mm_loadu_ps(b->center_y + i);
+      __m128 cz = _mm_loadu_ps(b->center_z + i);
+      __m128 r = _mm_loadu_ps(b->radius + i);
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (uint32_t p = 0; p < 6; p++) {
+         __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx),
+                                          _mm_mul_ps(py[p], cy)),
+                               _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+         inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+      }
+
+      if (_mm_movemask_ps(inside) == 0)
+         continue;
+
+      // Boxes, only if any of the spheres passed
+      for (uint32_t p = 0; p < 6; p++) {
+         __m128 x = _mm_loadu_ps(vx[p] + i);
+         __m128 y = _mm_loadu_ps(vy[p] + i);
+         __m128 z = _mm_loadu_ps(vz[p] + i);
+         __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x),
+                                          _mm_mul_ps(py[p], y)),
+                               _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+         inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+      }
+
+      uint32_t mask = _mm_movemask_ps(inside);
+      while (mask) {
+         visible[num_visible++] = i + __builtin_ctz(mask);
+         mask &= mask - 1;
+      }
+   }
+#endif
+
+   for (; i < end; i++) {
+      if (is_visible(frustum, b, i))
+         visible[num_visible++] = i;
+   }
+
+   return num_visible;
+}
+
+typedef struct {
+   const VkdfFrustum *frustum;
+   const VkdfCullBounds *bounds;
+   uint32_t *visible;
+   uint32_t *chunk_visible;
+   uint32_t num_chunks;
+   gint next;
+} CullJob;
+
+static gpointer
+cull_thread(gpointer data)
+{
+   VKDF_TRACE_SCOPE("cull_thread");
+
+   CullJob *job = (CullJob *) data;
+
+   // Each chunk writes its visible list at the start of its own range of
+   // the output, vkdf_cull_frustum() compacts them when all are done
+   uint32_t c;
+   while ((c = (uint32_t) g_atomic_int_add(&job->next, 1)) < job->num_chunks) {
+      uint32_t first = c * CULL_CHUNK_SIZE;
+      uint32_t count = MIN(CULL_CHUNK_SIZE, job->bounds->count - first);
+      job->chunk_visible[c] = cull_range(job->frustum, job->bounds,
+                                         first, count,
+                                         job->visible + first);
+   }
+
+   return NULL;
+}
+
+/**
+ * Writes the indices of the objects in 'bounds' that are at least
+ * partially inside the frustum to 'visible', in increasing order, and
+ * returns how many there are. 'visible' must have room for all the
+ * objects in 'bounds'.
+ */
+uint32_t
+vkdf_cull_frustum(const VkdfFrustum *frustum,
+                  const VkdfCullBounds *bounds,
+                  uint32_t *visible)
+{
+   VKDF_TRACE_SCOPE("vkdf_cull_frustum");
+
+   uint32_t num_threads = MIN(g_get_num_processors(), VKDF_CULL_MAX_THREADS);
+   if (bounds->count < VKDF_CULL_PARALLEL_MIN_OBJECTS || num_threads <= 1)
+      return cull_range(frustum, bounds, 0, bounds->count, visible);
+
+   CullJob job;
+   job.frustum = frustum;
+   job.bounds = bounds;
+   job.visible = visible;
+   job.num_chunks = (bounds->count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+   job.chunk_visible = g_new(uint32_t, job.num_chunks);
+   job.next = 0;
+
+   num_threads = MIN(num_threads, job.num_chunks);
+
+   // The calling thread takes part too
+   std::vector<GThread *> threads;
+   for (uint32_t i = 1; i < num_threads; i++)
+      threads.push_back(g_thread_new("vkdf-cull", cull_thread, &job));
+
+   cull_thread(&job);
+
+   for (uint32_t i = 0; i < threads.size(); i++)
+      g_thread_join(threads[i]);
+
+   uint32_t num_visible = job.chunk_visible[0];
+   for (uint32_t c = 1; c < job.num_chunks; c++) {
+      memmove(visible + num_visible, visible + c * CULL_CHUNK_SIZE,
+              job.chunk_visible[c] * sizeof(uint32_t));
+      num_visible += job.chunk_visible[c];
+   }
+
+   g_free(job.chunk_visible);
+   return num_visible;
+}
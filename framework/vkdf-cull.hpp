@@ -0,0 +1,122 @@
+#ifndef __VKDF_CULL_H__
+#define __VKDF_CULL_H__
+
+/**
+ * Frustum culling.
+ *
+ * A VkdfFrustum holds the 6 planes of a view frustum, extracted from a
+ * view-projection matrix. Planes are normalized and point inwards, so a
+ * point 'p' is inside plane 'pl' if dot(pl.xyz, p) + pl.w >= 0. The
+ * matrix must produce Vulkan clip coordinates (0 <= z <= w), like the
+ * projection matrices used by the demos, which correct glm's GL-style
+ * depth range.
+ *
+ * VkdfCullBounds keeps the world-space bounding spheres and boxes of a set
+ * of objects in structure-of-arrays form. vkdf_cull_frustum() tests them
+ * against a frustum 4 at a time with SSE, first the spheres and then the
+ * boxes of the objects whose sphere is not fully outside, and writes the
+ * indices of the visible ones, in increasing order, to a compact list. The
+ * list can be written straight to a mapped instance index or indirect
+ * draw buffer. Large sets are split across up to VKDF_CULL_MAX_THREADS
+ * threads.
+ */
+
+/**
+ * Sets with fewer objects than this are culled on the calling thread only
+ */
+#define VKDF_CULL_PARALLEL_MIN_OBJECTS 16384
+
+typedef struct {
+   glm::vec4 planes[6];
+} VkdfFrustum;
+
+void
+vkdf_frustum_from_matrix(VkdfFrustum *frustum, const glm::mat4 &view_proj);
+
+void
+vkdf_frustum_from_camera(VkdfFrustum *frustum, VkdfCamera *cam);
+
+/**
+ * Whether the sphere is at least partially inside the frustum
+ */
+inline bool
+vkdf_frustum_test_sphere(const VkdfFrustum *frustum, const VkdfSphere *sphere)
+{
+   for (uint32_t i = 0; i < 6; i++) {
+      const glm::vec4 &pl = frustum->planes[i];
+      if (glm::dot(glm::vec3(pl), sphere->center) + pl.w < -sphere->radius)
+         return false;
+   }
+   return true;
+}
+
+/**
+ * Whether the box is at least partially inside the frustum. Conservative:
+ * boxes near the frustum's edges can pass even if they are outside.
+ */
+inline bool
+vkdf_frustum_test_box(const VkdfFrustum *frustum, const VkdfBox *box)
+{
+   for (uint32_t i = 0; i < 6; i++) {
+      const glm::vec4 &pl = frustum->planes[i];
+
+      // The corner of the box furthest along the plane's normal
+      glm::vec3 p = glm::vec3(pl.x >= 0.0f ? box->max.x : box->min.x,
+                              pl.y >= 0.0f ? box->max.y : box->min.y,
+                              pl.z >= 0.0f ? box->max.z : box->min.z);
+      if (glm::dot(glm::vec3(pl), p) + pl.w < 0.0f)
+         return false;
+   }
+   return true;
+}
+
+typedef struct {
+   uint32_t count;
+   uint32_t capacity;
+
+   // Bounding spheres
+   float *center_x;
+   float *center_y;
+   float *center_z;
+   float *radius;
+
+   // Bounding boxes
+   float *min_x;
+   float *min_y;
+   float *min_z;
+   float *max_x;
+   float *max_y;
+   float *max_z;
+} VkdfCullBounds;
+
+VkdfCullBounds *
+vkdf_cull_bounds_new(uint32_t capacity);
+
+void
+vkdf_cull_bounds_free(VkdfCullBounds *bounds);
+
+void
+vkdf_cull_bounds_set(VkdfCullBounds *bounds,
+                     uint32_t idx,
+                     const VkdfBox *box,
+                     const VkdfSphere *sphere);
+
+uint32_t
+vkdf_cull_bounds_add(VkdfCullBounds *bounds,
+                     const VkdfBox *box,
+                     const VkdfSphere *sphere);
+
+uint32_t
+vkdf_cull_bounds_add_object(VkdfCullBounds *bounds, VkdfObject *obj);
+
+void
+vkdf_cull_bounds_set_object(VkdfCullBounds *bounds,
+                            uint32_t idx,
+                            VkdfObject *obj);
+
+uint32_t
+vkdf_cull_frustum(const VkdfFrustum *frustum,
+                  const VkdfCullBounds *bounds,
+                  uint32_t *visible);
+
+#endif
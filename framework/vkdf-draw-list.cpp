@@ -0,0 +1,306 @@
+#include "vkdf.hpp"
+
+// Keys are sorted 8 bits at a time, least significant digit first
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MAX_PASSES (64 / RADIX_BITS)
+
+VkdfDrawList *
+vkdf_draw_list_new()
+{
+   VkdfDrawList *list = g_new0(VkdfDrawList, 1);
+   list->draws = std::vector<VkdfDraw>();
+   list->entries = std::vector<VkdfDrawListEntry>();
+   list->tmp = std::vector<VkdfDrawListEntry>();
+   return list;
+}
+
+void
+vkdf_draw_list_free(VkdfDrawList *list)
+{
+   list->draws.clear();
+   std::vector<VkdfDraw>(list->draws).swap(list->draws);
+   list->entries.clear();
+   std::vector<VkdfDrawListEntry>(list->entries).swap(list->entries);
+   list->tmp.clear();
+   std::vector<VkdfDrawListEntry>(list->tmp).swap(list->tmp);
+
+   g_free(list);
+}
+
+/**
+ * Removes all the draws from the list, keeping its storage for the next
+ * frame.
+ */
+void
+vkdf_draw_list_reset(VkdfDrawList *list)
+{
+   list->draws.clear();
+   list->entries.clear();
+}
+
+void
+vkdf_draw_list_add(VkdfDrawList *list, const VkdfDraw *draw)
+{
+   VkdfDrawListEntry entry;
+   entry.key = draw->key;
+   entry.draw_idx = list->draws.size();
+
+   list->draws.push_back(*draw);
+   list->entries.push_back(entry);
+}
+
+typedef struct {
+   GMutex mutex;
+   GCond cond;
+   uint32_t count;
+   uint32_t waiting;
+   uint32_t generation;
+} SortBarrier;
+
+static void
+barrier_wait(SortBarrier *barrier)
+{
+   if (barrier->count <= 1)
+      return;
+
+   g_mutex_lock(&barrier->mutex);
+   uint32_t generation = barrier->generation;
+   if (++barrier->waiting == barrier->count) {
+      barrier->waiting = 0;
+      barrier->generation++;
+      g_cond_broadcast(&barrier->cond);
+   } else {
+      while (generation == barrier->generation)
+         g_cond_wait(&barrier->cond, &barrier->mutex);
+   }
+   g_mutex_unlock(&barrier->mutex);
+}
+
+typedef struct {
+   VkdfDrawListEntry *bufs[2];
+   uint32_t count;
+   uint32_t num_threads;
+   uint32_t num_passes;
+   uint32_t shifts[RADIX_MAX_PASSES];
+
+   // One histogram of the current digit per thread
+   uint32_t (*hist)[RADIX_SIZE];
+
+   SortBarrier barrier;
+   gint next_thread;
+} SortJob;
+
+/**
+ * Each thread owns a contiguous chunk of the entries. For every digit, the
+ * threads count the digit values in their chunk, wait for the others, and
+ * then scatter their chunk to the other buffer. Thread 't' writes the
+ * entries with digit value 'd' after those of all the lower values and
+ * after those of value 'd' in the chunks of threads before it, so every
+ * pass is stable.
+ */
+static gpointer
+sort_thread(gpointer data)
+{
+   VKDF_TRACE_SCOPE("draw_list_sort_thread");
+
+   SortJob *job = (SortJob *) data;
+   uint32_t t = (uint32_t) g_atomic_int_add(&job->next_thread, 1);
+
+   uint32_t chunk_size = (job->count + job->num_threads - 1) / job->num_threads;
+   uint32_t start = MIN(t * chunk_size, job->count);
+   uint32_t end = MIN(start + chunk_size, job->count);
+
+   for (uint32_t p = 0; p < job->num_passes; p++) {
+      const VkdfDrawListEntry *src = job->bufs[p % 2];
+      VkdfDrawListEntry *dst = job->bufs[(p + 1) % 2];
+      const uint32_t shift = job->shifts[p];
+
+      uint32_t *hist = job->hist[t];
+      memset(hist, 0, RADIX_SIZE * sizeof(uint32_t));
+      for (uint32_t i = start; i < end; i++)
+         hist[(src[i].key >> shift) & (RADIX_SIZE - 1)]++;
+
+      barrier_wait(&job->barrier);
+
+      uint32_t offsets[RADIX_SIZE];
+      uint32_t offset = 0;
+      for (uint32_t d = 0; d < RADIX_SIZE; d++) {
+         for (uint32_t i = 0; i < job->num_threads; i++) {
+            if (i == t)
+               offsets[d] = offset;
+            offset += job->hist[i][d];
+         }
+      }
+
+      for (uint32_t i = start; i < end; i++)
+         dst[offsets[(src[i].key >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+
+      // Everyone must be done with this pass' histograms and buffers
+      // before the next one starts
+      barrier_wait(&job->barrier);
+   }
+
+   return NULL;
+}
+
+/**
+ * Sorts the draws by key. Draws with the same key keep the order they
+ * were added in.
+ */
+void
+vkdf_draw_list_sort(VkdfDrawList *list)
+{
+   VKDF_TRACE_SCOPE("vkdf_draw_list_sort");
+
+   uint32_t count = list->entries.size();
+   if (count < 2)
+      return;
+
+   // Digits that are the same in all keys don't change the order, so
+   // skip them. Keys built with vkdf_draw_key() often leave the pass and
+   // the high bits of the IDs at 0.
+   uint64_t diff = 0;
+   const uint64_t first_key = list->entries[0].key;
+   for (uint32_t i = 1; i < count; i++)
+      diff |= list->entries[i].key ^ first_key;
+
+   SortJob job;
+   job.num_passes = 0;
+   for (uint32_t p = 0; p < RADIX_MAX_PASSES; p++) {
+      uint32_t shift = p * RADIX_BITS;
+      if ((diff >> shift) & (RADIX_SIZE - 1))
+         job.shifts[job.num_passes++] = shift;
+   }
+
+   if (job.num_passes == 0)
+      return;
+
+   list->tmp.resize(count);
+   job.bufs[0] = &list->entries[0];
+   job.bufs[1] = &list->tmp[0];
+   job.count = count;
+   job.next_thread = 0;
+
+   job.num_threads = 1;
+   if (count >= VKDF_DRAW_LIST_PARALLEL_MIN_DRAWS) {
+      job.num_threads = MIN(g_get_num_processors(),
+                            VKDF_DRAW_LIST_MAX_THREADS);
+      job.num_threads = MAX(job.num_threads, 1);
+   }
+
+   job.hist = (uint32_t (*)[RADIX_SIZE])
+      g_new(uint32_t, job.num_threads * RADIX_SIZE);
+
+   g_mutex_init(&job.barrier.mutex);
+   g_cond_init(&job.barrier.cond);
+   job.barrier.count = job.num_threads;
+   job.barrier.waiting = 0;
+   job.barrier.generation = 0;
+
+   // The calling thread takes part too
+   std::vector<GThread *> threads;
+   for (uint32_t i = 1; i < job.num_threads; i++)
+      threads.push_back(g_thread_new("vkdf-draw-sort", sort_thread, &job));
+
+   sort_thread(&job);
+
+   for (uint32_t i = 0; i < threads.size(); i++)
+      g_thread_join(threads[i]);
+
+   g_mutex_clear(&job.barrier.mutex);
+   g_cond_clear(&job.barrier.cond);
+   g_free(job.hist);
+
+   // After an odd number of passes the sorted entries are in 'tmp'
+   if (job.num_passes % 2)
+      list->entries.swap(list->tmp);
+}
+
+/**
+ * Records the draws in the list's current order: the order they were
+ * added in, or the order of their keys after vkdf_draw_list_sort(). State
+ * is only bound when it differs from the previous draw's. Must be recorded
+ * inside a render pass compatible with the draws' pipelines.
+ */
+void
+vkdf_draw_list_cmd_draw(VkdfDrawList *list, VkCommandBuffer cmd_buf)
+{
+   VKDF_TRACE_SCOPE("vkdf_draw_list_cmd_draw");
+
+   VkPipeline bound_pipeline = VK_NULL_HANDLE;
+   VkPipelineLayout bound_layout = VK_NULL_HANDLE;
+   uint32_t bound_set_index = 0;
+   VkDescriptorSet bound_set = VK_NULL_HANDLE;
+   VkBuffer bound_vertex_buf = VK_NULL_HANDLE;
+   VkDeviceSize bound_vertex_buf_offset = 0;
+   VkBuffer bound_index_buf = VK_NULL_HANDLE;
+   VkDeviceSize bound_index_buf_offset = 0;
+   VkIndexType bound_index_type = VK_INDEX_TYPE_UINT32;
+
+   for (uint32_t i = 0; i < list->entries.size(); i++) {
+      const VkdfDraw *draw = &list->draws[list->entries[i].draw_idx];
+
+      if (draw->pipeline != bound_pipeline) {
+         vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                draw->pipeline);
+         bound_pipeline = draw->pipeline;
+      }
+
+      // Sets bound with a different layout may not be compatible, so
+      // bind again when the layout changes
+      if (draw->set != VK_NULL_HANDLE &&
+          (draw->set != bound_set ||
+           draw->set_index != bound_set_index ||
+           draw->pipeline_layout != bound_layout)) {
+         vkdf_cmd_bind_descriptor_sets(cmd_buf,
+                                       VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                       draw->pipeline_layout,
+                                       draw->set_index,
+                                       1,
+                                       &draw->set,
+                                       0,
+                                       NULL);
+         bound_set = draw->set;
+         bound_set_index = draw->set_index;
+         bound_layout = draw->pipeline_layout;
+      }
+
+      if (draw->vertex_buf != bound_vertex_buf ||
+          draw->vertex_buf_offset != bound_vertex_buf_offset) {
+         vkdf_cmd_bind_vertex_buffers(cmd_buf, 0, 1,
+                                      &draw->vertex_buf,
+                                      &draw->vertex_buf_offset);
+         bound_vertex_buf = draw->vertex_buf;
+         bound_vertex_buf_offset = draw->vertex_buf_offset;
+      }
+
+      if (draw->index_buf == VK_NULL_HANDLE) {
+         vkdf_cmd_draw(cmd_buf,
+                       draw->count,
+                       draw->instance_count,
+                       draw->first,
+                       draw->first_instance);
+         continue;
+      }
+
+      if (draw->index_buf != bound_index_buf ||
+          draw->index_buf_offset != bound_index_buf_offset ||
+          draw->index_type != bound_index_type) {
+         vkdf_cmd_bind_index_buffer(cmd_buf,
+                                    draw->index_buf,
+                                    draw->index_buf_offset,
+                                    draw->index_type);
+         bound_index_buf = draw->index_buf;
+         bound_index_buf_offset = draw->index_buf_offset;
+         bound_index_type = draw->index_type;
+      }
+
+      vkdf_cmd_draw_indexed(cmd_buf,
+                            draw->count,
+                            draw->instance_count,
+                            draw->first,
+                            draw->vertex_offset,
+                            draw->first_instance);
+   }
+}
@@ -0,0 +1,140 @@
+#ifndef __VKDF_DRAW_LIST_H__
+#define __VKDF_DRAW_LIST_H__
+
+/**
+ * Sorted draw lists.
+ *
+ * A VkdfDrawList collects the draws of a frame, each with the state it
+ * needs (pipeline, a descriptor set, vertex and index buffers) and a
+ * 64-bit sort key. vkdf_draw_list_sort() orders the draws by key with a
+ * radix sort, and vkdf_draw_list_cmd_draw() records them, skipping the
+ * pipeline, descriptor set, vertex and index buffer binds that would bind
+ * what is already bound.
+ *
+ * Keys built with vkdf_draw_key() sort draws by pass, then pipeline, then
+ * descriptor set, then material, and finally by depth, so state changes
+ * happen as rarely as possible and, within the same state, opaque draws
+ * go front to back to reduce overdraw. The pipeline, set and material
+ * fields of the key are IDs chosen by the application; they only need to
+ * be the same for draws that share the same state.
+ *
+ * Lists with at least VKDF_DRAW_LIST_PARALLEL_MIN_DRAWS draws are sorted
+ * by up to VKDF_DRAW_LIST_MAX_THREADS threads.
+ */
+
+#define VKDF_DRAW_LIST_PARALLEL_MIN_DRAWS 65536
+
+// Sort key fields, from the most significant bits to the least
+#define VKDF_DRAW_KEY_PASS_BITS      4
+#define VKDF_DRAW_KEY_PIPELINE_BITS 12
+#define VKDF_DRAW_KEY_SET_BITS      12
+#define VKDF_DRAW_KEY_MATERIAL_BITS 16
+#define VKDF_DRAW_KEY_DEPTH_BITS    20
+
+typedef struct {
+   uint64_t key;
+
+   VkPipeline pipeline;
+
+   // Descriptor set bound to 'set_index' of 'pipeline_layout', if not
+   // VK_NULL_HANDLE. Sets that are the same for all the draws should be
+   // bound by the application before vkdf_draw_list_cmd_draw().
+   VkPipelineLayout pipeline_layout;
+   uint32_t set_index;
+   VkDescriptorSet set;
+
+   // Bound to binding 0
+   VkBuffer vertex_buf;
+   VkDeviceSize vertex_buf_offset;
+
+   // Non-indexed draw if VK_NULL_HANDLE
+   VkBuffer index_buf;
+   VkDeviceSize index_buf_offset;
+   VkIndexType index_type;
+
+   // Index count and first index for indexed draws, vertex count and
+   // first vertex otherwise
+   uint32_t count;
+   uint32_t first;
+   int32_t vertex_offset;
+   uint32_t instance_count;
+   uint32_t first_instance;
+} VkdfDraw;
+
+typedef struct {
+   uint64_t key;
+   uint32_t draw_idx;
+} VkdfDrawListEntry;
+
+typedef struct {
+   std::vector<VkdfDraw> draws;
+
+   // Draws in the order they are recorded, sorted by
+   // vkdf_draw_list_sort(), and scratch space for the sort
+   std::vector<VkdfDrawListEntry> entries;
+   std::vector<VkdfDrawListEntry> tmp;
+} VkdfDrawList;
+
+inline uint64_t
+vkdf_draw_key(uint32_t pass,
+              uint32_t pipeline,
+              uint32_t set,
+              uint32_t material,
+              uint32_t depth)
+{
+   assert(pass < (1u << VKDF_DRAW_KEY_PASS_BITS));
+   assert(pipeline < (1u << VKDF_DRAW_KEY_PIPELINE_BITS));
+   assert(set < (1u << VKDF_DRAW_KEY_SET_BITS));
+   assert(material < (1u << VKDF_DRAW_KEY_MATERIAL_BITS));
+   assert(depth < (1u << VKDF_DRAW_KEY_DEPTH_BITS));
+
+   uint64_t key = pass;
+   key = (key << VKDF_DRAW_KEY_PIPELINE_BITS) | pipeline;
+   key = (key << VKDF_DRAW_KEY_SET_BITS) | set;
+   key = (key << VKDF_DRAW_KEY_MATERIAL_BITS) | material;
+   key = (key << VKDF_DRAW_KEY_DEPTH_BITS) | depth;
+   return key;
+}
+
+/**
+ * Quantizes a view-space distance in [z_near, z_far] to the depth field
+ * of a sort key. Draws with lower values go first, so opaque draws should use
+ * back_to_front = false and blended draws back_to_front = true.
+ */
+inline uint32_t
+vkdf_draw_key_depth(float dist, float z_near, float z_far, bool back_to_front)
+{
+   const uint32_t max_depth = (1u << VKDF_DRAW_KEY_DEPTH_BITS) - 1;
+
+   float t = (dist - z_near) / (z_far - z_near);
+   t = MAX(MIN(t, 1.0f), 0.0f);
+
+   uint32_t depth = (uint32_t) (t * max_depth);
+   return back_to_front ? max_depth - depth : depth;
+}
+
+VkdfDrawList *
+vkdf_draw_list_new();
+
+void
+vkdf_draw_list_free(VkdfDrawList *list);
+
+void
+vkdf_draw_list_reset(VkdfDrawList *list);
+
+void
+vkdf_draw_list_add(VkdfDrawList *list, const VkdfDraw *draw);
+
+void
+vkdf_draw_list_sort(VkdfDrawList *list);
+
+void
+vkdf_draw_list_cmd_draw(VkdfDrawList *list, VkCommandBuffer cmd_buf);
+
+inline uint32_t
+vkdf_draw_list_get_num_draws(VkdfDrawList *list)
+{
+   return list->draws.size();
+}
+
+#endif
@@ -110,24 +110,47 @@ vkdf_event_loop_run(VkdfContext *ctx,
                     vkdf_event_loop_render_func render_func,
                     void *data)
 {
+   vkdf_stats_reset();
+
    do {
 #if VKDF_LOG_FPS_ENABLE
       frame_start();
 #endif
+      VKDF_TRACE_SCOPE("frame");
 
-      update_func(ctx, data);
+      {
+         VKDF_TRACE_SCOPE("update");
+         update_func(ctx, data);
+      }
 
-      acquire_next_image(ctx);
-      render_func(ctx, data);
-      present_image(ctx);
+      {
+         VKDF_TRACE_SCOPE("acquire");
+         acquire_next_image(ctx);
+      }
 
-      glfwPollEvents();
+      {
+         VKDF_TRACE_SCOPE("render");
+         render_func(ctx, data);
+      }
+
+      {
+         VKDF_TRACE_SCOPE("present");
+         present_image(ctx);
+      }
+
+      {
+         VKDF_TRACE_SCOPE("poll events");
+         glfwPollEvents();
+      }
 
 #if VKDF_LOG_FPS_ENABLE
       frame_end();
 #endif
+      vkdf_stats_frame_end();
    } while (glfwGetKey(ctx->window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
             glfwWindowShouldClose(ctx->window) == 0);
 
    vkDeviceWaitIdle(ctx->device);
+
+   vkdf_trace_flush();
 }
@@ -0,0 +1,587 @@
+#include "vkdf.hpp"
+
+// Binding 0: frustum UBO, bindings 1-3: objects, draws and instance IDs,
+// with occlusion culling binding 4: Hi-Z pyramid, binding 5: visibility
+static const VkDescriptorType binding_types[6] = {
+   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+static inline uint32_t
+get_num_bindings(VkdfGpuCull *cull)
+{
+   return cull->hiz ? 6 : 4;
+}
+
+static VkDescriptorSetLayout
+create_set_layout(VkdfContext *ctx, uint32_t num_bindings)
+{
+   VkDescriptorSetLayoutBinding bindings[6];
+   for (uint32_t i = 0; i < num_bindings; i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = binding_types[i];
+      bindings[i].descriptorCount = 1;
+      bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo set_layout_info;
+   set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   set_layout_info.pNext = NULL;
+   set_layout_info.bindingCount = num_bindings;
+   set_layout_info.pBindings = bindings;
+   set_layout_info.flags = 0;
+
+   VkDescriptorSetLayout set_layout;
+   VK_CHECK(vkCreateDescriptorSetLayout(ctx->device,
+                                        &set_layout_info,
+                                        NULL,
+                                        &set_layout));
+   return set_layout;
+}
+
+static VkDescriptorPool
+create_pool(VkdfContext *ctx, bool has_hiz)
+{
+   VkDescriptorPoolSize type_count[3];
+   type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   type_count[0].descriptorCount = 1;
+   type_count[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   type_count[1].descriptorCount = has_hiz ? 4 : 3;
+   type_count[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+   type_count[2].descriptorCount = 1;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = 1;
+   pool_ci.poolSizeCount = has_hiz ? 3 : 2;
+   pool_ci.pPoolSizes = type_count;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VkDescriptorPool pool;
+   VK_CHECK(vkCreateDescriptorPool(ctx->device, &pool_ci, NULL, &pool));
+
+   return pool;
+}
+
+static void
+create_descriptor_set(VkdfContext *ctx, VkdfGpuCull *cull)
+{
+   const uint32_t num_bindings = get_num_bindings(cull);
+   cull->set_layout = create_set_layout(ctx, num_bindings);
+   cull->pool = create_pool(ctx, cull->hiz != NULL);
+
+   VkDescriptorSetAllocateInfo alloc_info;
+   alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+   alloc_info.pNext = NULL;
+   alloc_info.descriptorPool = cull->pool;
+   alloc_info.descriptorSetCount = 1;
+   alloc_info.pSetLayouts = &cull->set_layout;
+   VK_CHECK(vkAllocateDescriptorSets(ctx->device, &alloc_info, &cull->set));
+
+   const VkBuffer bufs[6] = {
+      cull->frustum_buf.buf,
+      cull->object_buf.buf,
+      cull->draw_buf.buf,
+      cull->instance_buf.buf,
+      VK_NULL_HANDLE,
+      cull->visibility_buf.buf,
+   };
+
+   VkDescriptorBufferInfo buf_info[6];
+   VkDescriptorImageInfo image_info;
+   VkWriteDescriptorSet writes[6];
+   for (uint32_t i = 0; i < num_bindings; i++) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].pNext = NULL;
+      writes[i].dstSet = cull->set;
+      writes[i].dstBinding = i;
+      writes[i].dstArrayElement = 0;
+      writes[i].descriptorCount = 1;
+      writes[i].descriptorType = binding_types[i];
+      writes[i].pTexelBufferView = NULL;
+
+      if (binding_types[i] == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+         image_info.sampler = cull->hiz->sampler;
+         image_info.imageView = cull->hiz->image.view;
+         image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+         writes[i].pImageInfo = &image_info;
+         writes[i].pBufferInfo = NULL;
+      } else {
+         buf_info[i].buffer = bufs[i];
+         buf_info[i].offset = 0;
+         buf_info[i].range = VK_WHOLE_SIZE;
+         writes[i].pImageInfo = NULL;
+         writes[i].pBufferInfo = &buf_info[i];
+      }
+   }
+
+   vkUpdateDescriptorSets(ctx->device, num_bindings, writes, 0, NULL);
+}
+
+static void
+create_pipeline(VkdfContext *ctx,
+                VkdfGpuCull *cull,
+                VkShaderModule cs_module)
+{
+   // The pass to run
+   VkPushConstantRange push_constant_range;
+   push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+   push_constant_range.offset = 0;
+   push_constant_range.size = sizeof(uint32_t);
+
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 1;
+   pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = &cull->set_layout;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &cull->pipeline_layout));
+
+   VkComputePipelineCreateInfo pipeline_info;
+   pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+   pipeline_info.pNext = NULL;
+   pipeline_info.flags = 0;
+   pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+   pipeline_info.stage.pNext = NULL;
+   pipeline_info.stage.flags = 0;
+   pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+   pipeline_info.stage.module = cs_module;
+   pipeline_info.stage.pName = "main";
+   pipeline_info.stage.pSpecializationInfo = NULL;
+   pipeline_info.layout = cull->pipeline_layout;
+   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+   pipeline_info.basePipelineIndex = -1;
+
+   VK_CHECK(vkCreateComputePipelines(ctx->device, NULL, 1, &pipeline_info,
+                                     NULL, &cull->pipeline));
+}
+
+/**
+ * Creates the buffers and the compute pipeline to cull 'num_objects'
+ * objects for 'num_draws' indexed draws. Only the index count, first index
+ * and vertex offset of 'draws' are used, the instance count and first
+ * instance are set for each frame by the culling pass.
+ *
+ * Objects start with empty bounds, so they are never visible until their
+ * bounds are set with vkdf_gpu_cull_set_bounds() or
+ * vkdf_gpu_cull_set_object().
+ *
+ * If 'hiz' is not NULL, objects are also culled against it. It must be
+ * rebuilt between the early and the late pass every frame.
+ */
+VkdfGpuCull *
+vkdf_gpu_cull_new(VkdfContext *ctx,
+                  VkShaderModule cs_module,
+                  uint32_t num_objects,
+                  uint32_t num_draws,
+                  const VkDrawIndexedIndirectCommand *draws,
+                  VkdfHiz *hiz)
+{
+   assert(num_objects > 0 && num_draws > 0);
+
+   VkdfGpuCull *cull = g_new0(VkdfGpuCull, 1);
+   cull->num_objects = num_objects;
+   cull->num_draws = num_draws;
+   cull->hiz = hiz;
+
+   // Object bounds
+   VkDeviceSize objects_size = num_objects * sizeof(VkdfGpuCullObject);
+   cull->object_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         objects_size,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VK_CHECK(vkMapMemory(ctx->device, cull->object_buf.mem,
+                        0, VK_WHOLE_SIZE, 0, (void **) &cull->objects));
+
+   VkdfBox box;
+   VkdfSphere sphere;
+   vkdf_box_init_empty(&box);
+   sphere.center = glm::vec3(0.0f);
+   sphere.radius = -FLT_MAX;
+   for (uint32_t i = 0; i < num_objects; i++) {
+      vkdf_gpu_cull_set_bounds(cull, i, &box, &sphere);
+      vkdf_gpu_cull_set_draws(cull, i, 0, num_draws);
+   }
+
+   // Frustum planes followed by the object and draw counts and the
+   // view-projection matrix
+   VkDeviceSize frustum_size =
+      6 * sizeof(glm::vec4) + 4 * sizeof(uint32_t) + sizeof(glm::mat4);
+   cull->frustum_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         frustum_size,
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VK_CHECK(vkMapMemory(ctx->device, cull->frustum_buf.mem,
+                        0, VK_WHOLE_SIZE, 0, (void **) &cull->frustum_map));
+
+   uint32_t counts[4] = { num_objects, num_draws, 0, 0 };
+   memset(cull->frustum_map, 0, frustum_size);
+   memcpy(cull->frustum_map + 6 * sizeof(glm::vec4), counts, sizeof(counts));
+
+   // No object was visible in the previous frame, so the first early pass
+   // draws nothing and the first late pass draws everything visible
+   if (hiz) {
+      VkDeviceSize visibility_size = num_objects * sizeof(uint32_t);
+      cull->visibility_buf =
+         vkdf_create_buffer(ctx,
+                            0,
+                            visibility_size,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+      uint32_t *visibility = g_new0(uint32_t, num_objects);
+      vkdf_buffer_map_and_fill(ctx, cull->visibility_buf,
+                               0, visibility_size, visibility);
+      g_free(visibility);
+   }
+
+   // Draw arguments. Draw 'd' takes its instance IDs from offset
+   // d * num_objects in the instance ID list: through firstInstance if the
+   // device supports it, otherwise vkdf_gpu_cull_cmd_draw() binds the list
+   // at that offset for each draw.
+   VkDeviceSize draws_size = num_draws * sizeof(VkDrawIndexedIndirectCommand);
+   VkDrawIndexedIndirectCommand *templates =
+      g_new(VkDrawIndexedIndirectCommand, num_draws);
+   for (uint32_t d = 0; d < num_draws; d++) {
+      templates[d] = draws[d];
+      templates[d].instanceCount = 0;
+      templates[d].firstInstance =
+         ctx->device_features.drawIndirectFirstInstance ? d * num_objects : 0;
+   }
+
+   cull->template_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         draws_size,
+                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   vkdf_buffer_map_and_fill(ctx, cull->template_buf, 0, draws_size, templates);
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, draws_size);
+   g_free(templates);
+
+   cull->draw_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         draws_size,
+                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   cull->instance_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         (VkDeviceSize) num_draws * num_objects *
+                            sizeof(uint32_t),
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   create_descriptor_set(ctx, cull);
+   create_pipeline(ctx, cull, cs_module);
+
+   return cull;
+}
+
+void
+vkdf_gpu_cull_free(VkdfContext *ctx, VkdfGpuCull *cull)
+{
+   vkDestroyPipeline(ctx->device, cull->pipeline, NULL);
+   vkDestroyPipelineLayout(ctx->device, cull->pipeline_layout, NULL);
+   vkFreeDescriptorSets(ctx->device, cull->pool, 1, &cull->set);
+   vkDestroyDescriptorSetLayout(ctx->device, cull->set_layout, NULL);
+   vkDestroyDescriptorPool(ctx->device, cull->pool, NULL);
+
+   vkUnmapMemory(ctx->device, cull->object_buf.mem);
+   vkUnmapMemory(ctx->device, cull->frustum_buf.mem);
+
+   vkdf_destroy_buffer(ctx, &cull->object_buf);
+   vkdf_destroy_buffer(ctx, &cull->frustum_buf);
+   vkdf_destroy_buffer(ctx, &cull->template_buf);
+   vkdf_destroy_buffer(ctx, &cull->draw_buf);
+   vkdf_destroy_buffer(ctx, &cull->instance_buf);
+   if (cull->hiz)
+      vkdf_destroy_buffer(ctx, &cull->visibility_buf);
+
+   g_free(cull);
+}
+
+static inline void
+mark_dirty(VkdfGpuCull *cull, uint32_t idx)
+{
+   if (cull->dirty_min > cull->dirty_max) {
+      cull->dirty_min = idx;
+      cull->dirty_max = idx;
+   } else {
+      cull->dirty_min = MIN(cull->dirty_min, idx);
+      cull->dirty_max = MAX(cull->dirty_max, idx);
+   }
+}
+
+void
+vkdf_gpu_cull_set_bounds(VkdfGpuCull *cull,
+                         uint32_t idx,
+                         const VkdfBox *box,
+                         const VkdfSphere *sphere)
+{
+   assert(idx < cull->num_objects);
+
+   VkdfGpuCullObject *obj = &cull->objects[idx];
+   obj->sphere = glm::vec4(sphere->center, sphere->radius);
+   obj->box_min = glm::vec4(box->min, 0.0f);
+   obj->box_max = glm::vec4(box->max, 0.0f);
+   mark_dirty(cull, idx);
+}
+
+void
+vkdf_gpu_cull_set_object(VkdfGpuCull *cull, uint32_t idx, VkdfObject *obj)
+{
+   VkdfBox box;
+   VkdfSphere sphere;
+   vkdf_object_get_box(obj, &box);
+   vkdf_object_get_sphere(obj, &sphere);
+   vkdf_gpu_cull_set_bounds(cull, idx, &box, &sphere);
+}
+
+/**
+ * Makes object 'idx' an instance of draws [first_draw, first_draw +
+ * num_draws) only. Objects start as instances of all the draws. Cheap
+ * enough to call every frame for the objects whose draws changed.
+ */
+void
+vkdf_gpu_cull_set_draws(VkdfGpuCull *cull,
+                        uint32_t idx,
+                        uint32_t first_draw,
+                        uint32_t num_draws)
+{
+   assert(idx < cull->num_objects);
+   assert(first_draw + num_draws <= cull->num_draws);
+
+   VkdfGpuCullObject *obj = &cull->objects[idx];
+   if (obj->first_draw == first_draw && obj->num_draws == num_draws)
+      return;
+
+   obj->first_draw = first_draw;
+   obj->num_draws = num_draws;
+   mark_dirty(cull, idx);
+}
+
+/**
+ * Uploads the view-projection matrix to cull with and the object bounds
+ * that changed since the last update. Must be called before submitting
+ * command buffers with the commands recorded by
+ * vkdf_gpu_cull_cmd_dispatch().
+ */
+void
+vkdf_gpu_cull_update(VkdfContext *ctx,
+                     VkdfGpuCull *cull,
+                     const glm::mat4 &view_proj)
+{
+   VKDF_TRACE_SCOPE("gpu_cull_update");
+
+   VkMappedMemoryRange ranges[2];
+   uint32_t num_ranges = 0;
+
+   VkdfFrustum frustum;
+   vkdf_frustum_from_matrix(&frustum, view_proj);
+   memcpy(cull->frustum_map, frustum.planes, 6 * sizeof(glm::vec4));
+   memcpy(cull->frustum_map + 6 * sizeof(glm::vec4) + 4 * sizeof(uint32_t),
+          &view_proj[0][0], sizeof(glm::mat4));
+   ranges[num_ranges].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   ranges[num_ranges].pNext = NULL;
+   ranges[num_ranges].memory = cull->frustum_buf.mem;
+   ranges[num_ranges].offset = 0;
+   ranges[num_ranges].size = VK_WHOLE_SIZE;
+   num_ranges++;
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES,
+                     6 * sizeof(glm::vec4) + sizeof(glm::mat4));
+
+   if (cull->dirty_min <= cull->dirty_max) {
+      const VkDeviceSize stride = sizeof(VkdfGpuCullObject);
+      ranges[num_ranges++] =
+         vkdf_buffer_get_flush_range(ctx, &cull->object_buf,
+                                     cull->dirty_min * stride,
+                                     (cull->dirty_max - cull->dirty_min + 1) *
+                                        stride);
+      _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES,
+                        (cull->dirty_max - cull->dirty_min + 1) * stride);
+
+      cull->dirty_min = 1;
+      cull->dirty_max = 0;
+   }
+
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, num_ranges, ranges));
+}
+
+/**
+ * Records a culling pass: resets the draw arguments, runs the compute
+ * shader and makes its results visible to indirect draws and vertex input.
+ * Must be recorded outside of a render pass and before the draws that use
+ * the results. Without a Hi-Z pyramid, a single pass of either kind culls
+ * all the objects.
+ */
+void
+vkdf_gpu_cull_cmd_dispatch(VkdfGpuCull *cull,
+                           VkCommandBuffer cmd_buf,
+                           VkdfGpuCullPass pass)
+{
+   VkDeviceSize draws_size =
+      cull->num_draws * sizeof(VkDrawIndexedIndirectCommand);
+
+   // Command buffers are submitted every frame, so wait for the previous
+   // pass's draws to read the results before overwriting them
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        0, NULL);
+
+   VkBufferCopy region;
+   region.srcOffset = 0;
+   region.dstOffset = 0;
+   region.size = draws_size;
+   vkCmdCopyBuffer(cmd_buf, cull->template_buf.buf, cull->draw_buf.buf,
+                   1, &region);
+
+   VkBufferMemoryBarrier reset_barrier =
+      vkdf_create_buffer_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT |
+                                 VK_ACCESS_SHADER_WRITE_BIT,
+                                 cull->draw_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        1, &reset_barrier,
+                        0, NULL);
+
+   vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          cull->pipeline);
+   vkdf_cmd_bind_descriptor_sets(cmd_buf,
+                                 VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 cull->pipeline_layout,
+                                 0, 1, &cull->set,
+                                 0, NULL);
+   uint32_t pass_value = pass;
+   vkCmdPushConstants(cmd_buf, cull->pipeline_layout,
+                      VK_SHADER_STAGE_COMPUTE_BIT,
+                      0, sizeof(uint32_t), &pass_value);
+   vkCmdDispatch(cmd_buf,
+                 (cull->num_objects + VKDF_GPU_CULL_GROUP_SIZE - 1) /
+                    VKDF_GPU_CULL_GROUP_SIZE,
+                 1, 1);
+
+   VkBufferMemoryBarrier result_barriers[3];
+   result_barriers[0] =
+      vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                                 cull->draw_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+   result_barriers[1] =
+      vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                                 cull->instance_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   // Visibility written by the late pass is read by the next passes
+   uint32_t num_barriers = 2;
+   if (cull->hiz) {
+      result_barriers[num_barriers++] =
+         vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                    VK_ACCESS_SHADER_READ_BIT |
+                                    VK_ACCESS_SHADER_WRITE_BIT,
+                                    cull->visibility_buf.buf,
+                                    0, VK_WHOLE_SIZE);
+   }
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        num_barriers, result_barriers,
+                        0, NULL);
+}
+
+/**
+ * Records the culled draws [first_draw, first_draw + draw_count) and binds
+ * the instance ID list to vertex binding 'instance_binding'. The pipeline,
+ * index buffer and the rest of the vertex buffers must be bound by the
+ * caller.
+ *
+ * Draws are issued with a single multi-draw if the device supports
+ * multiDrawIndirect and drawIndirectFirstInstance, otherwise with one
+ * indirect draw each.
+ */
+void
+vkdf_gpu_cull_cmd_draw(VkdfContext *ctx,
+                       VkdfGpuCull *cull,
+                       VkCommandBuffer cmd_buf,
+                       uint32_t instance_binding,
+                       uint32_t first_draw,
+                       uint32_t draw_count)
+{
+   assert(first_draw + draw_count <= cull->num_draws);
+
+   const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+   if (ctx->device_features.drawIndirectFirstInstance) {
+      VkDeviceSize offset = 0;
+      vkdf_cmd_bind_vertex_buffers(cmd_buf, instance_binding, 1,
+                                   &cull->instance_buf.buf, &offset);
+
+      if (ctx->device_features.multiDrawIndirect) {
+         vkdf_cmd_draw_indexed_indirect(cmd_buf,
+                                        cull->draw_buf.buf,
+                                        first_draw * stride,
+                                        draw_count,
+                                        stride);
+      } else {
+         for (uint32_t d = first_draw; d < first_draw + draw_count; d++) {
+            vkdf_cmd_draw_indexed_indirect(cmd_buf,
+                                           cull->draw_buf.buf,
+                                           d * stride,
+                                           1,
+                                           stride);
+         }
+      }
+   } else {
+      for (uint32_t d = first_draw; d < first_draw + draw_count; d++) {
+         VkDeviceSize offset =
+            (VkDeviceSize) d * cull->num_objects * sizeof(uint32_t);
+         vkdf_cmd_bind_vertex_buffers(cmd_buf, instance_binding, 1,
+                                      &cull->instance_buf.buf, &offset);
+         vkdf_cmd_draw_indexed_indirect(cmd_buf,
+                                        cull->draw_buf.buf,
+                                        d * stride,
+                                        1,
+                                        stride);
+      }
+   }
+}
@@ -0,0 +1,176 @@
+#ifndef __VKDF_GPU_CULL_H__
+#define __VKDF_GPU_CULL_H__
+
+/**
+ * GPU-driven frustum culling.
+ *
+ * Keeps the world-space bounds of a set of objects and a list of indexed
+ * draws in storage buffers. By default every object is an instance of
+ * every draw, like the meshes of a model rendered with instancing.
+ * vkdf_gpu_cull_set_draws() restricts an object to a range of draws
+ * instead, for example the draws of the level of detail selected for it
+ * with vkdf_object_select_lod(). Each frame, a compute shader tests the
+ * objects against the frustum and, for each of their draws, writes the
+ * number of visible instances to its VkDrawIndexedIndirectCommand and the
+ * indices of the visible objects to a compact instance ID list.
+ *
+ * The commands recorded by vkdf_gpu_cull_cmd_dispatch() and
+ * vkdf_gpu_cull_cmd_draw() do not depend on the visibility results, so
+ * command buffers can be recorded once and submitted every frame, only
+ * calling vkdf_gpu_cull_update() with the new view-projection matrix
+ * before submitting.
+ *
+ * If created with a Hi-Z pyramid (see vkdf-hiz.hpp), objects are also
+ * culled against the depth of the scene in two passes, recorded with
+ * vkdf_gpu_cull_cmd_dispatch() and the pass to run:
+ *
+ *  - VKDF_GPU_CULL_PASS_EARLY draws the objects in the frustum that were
+ *    visible in the previous frame, which are likely to be the occluders.
+ *  - The application renders them and builds the pyramid from their depth.
+ *  - VKDF_GPU_CULL_PASS_LATE tests all the objects in the frustum against
+ *    the pyramid, records which ones are visible for the next frame's early
+ *    pass and draws those that were not drawn in the early pass.
+ *
+ * Objects that become visible are drawn in the same frame they appear,
+ * so there is no popping, at the cost of rendering the scene in two
+ * passes. Without a pyramid, both passes only do frustum culling.
+ *
+ * The compute shader is provided by the application and must match this
+ * interface (see demos/model/cull.comp):
+ *
+ *    layout(local_size_x = VKDF_GPU_CULL_GROUP_SIZE) in;
+ *
+ *    layout(std140, set = 0, binding = 0) uniform frustum_ubo {
+ *       vec4 planes[6];
+ *       uvec4 counts;      // x: number of objects, y: number of draws
+ *       mat4 view_proj;
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 1) readonly buffer objects_ssbo {
+ *       VkdfGpuCullObject objects[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 2) buffer draws_ssbo {
+ *       VkDrawIndexedIndirectCommand draws[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 3) writeonly buffer ids_ssbo {
+ *       uint ids[];        // draw 'd' owns ids[d * num_objects] onwards
+ *    };
+ *
+ *    layout(push_constant) uniform pcb {
+ *       uint pass;         // VkdfGpuCullPass
+ *    };
+ *
+ * and, only when created with a Hi-Z pyramid:
+ *
+ *    layout(set = 0, binding = 4) uniform sampler2D hiz;
+ *
+ *    layout(std430, set = 0, binding = 5) buffer visibility_ssbo {
+ *       uint visible[];    // 1 if the object was visible in the late pass
+ *    };
+ *
+ * Draws read the ID of each instance from a per-instance uint vertex
+ * attribute that vkdf_gpu_cull_cmd_draw() binds to the instance ID list,
+ * so shaders must use it instead of gl_InstanceIndex to index per-object
+ * data.
+ */
+
+#define VKDF_GPU_CULL_GROUP_SIZE 64
+
+typedef enum {
+   VKDF_GPU_CULL_PASS_EARLY = 0,
+   VKDF_GPU_CULL_PASS_LATE,
+} VkdfGpuCullPass;
+
+// Same layout as the objects in the compute shader's storage buffer
+typedef struct {
+   glm::vec4 sphere;      // xyz: center, w: radius
+   glm::vec4 box_min;
+   glm::vec4 box_max;
+
+   // The object is an instance of draws [first_draw, first_draw + num_draws)
+   uint32_t first_draw;
+   uint32_t num_draws;
+   uint32_t pad[2];
+} VkdfGpuCullObject;
+
+typedef struct {
+   uint32_t num_objects;
+   uint32_t num_draws;
+
+   // Object bounds, kept mapped. Objects in [dirty_min, dirty_max] are
+   // flushed by the next call to vkdf_gpu_cull_update().
+   VkdfBuffer object_buf;
+   VkdfGpuCullObject *objects;
+   uint32_t dirty_min;
+   uint32_t dirty_max;
+
+   // Frustum planes, counts and view-projection matrix, kept mapped
+   VkdfBuffer frustum_buf;
+   uint8_t *frustum_map;
+
+   // Occlusion culling only: the pyramid and per-object visibility in the
+   // last late pass
+   VkdfHiz *hiz;
+   VkdfBuffer visibility_buf;
+
+   // Draw arguments with 0 instances, copied to draw_buf before culling
+   VkdfBuffer template_buf;
+
+   // Draw arguments and instance IDs written by the compute shader
+   VkdfBuffer draw_buf;
+   VkdfBuffer instance_buf;
+
+   VkDescriptorPool pool;
+   VkDescriptorSetLayout set_layout;
+   VkDescriptorSet set;
+   VkPipelineLayout pipeline_layout;
+   VkPipeline pipeline;
+} VkdfGpuCull;
+
+VkdfGpuCull *
+vkdf_gpu_cull_new(VkdfContext *ctx,
+                  VkShaderModule cs_module,
+                  uint32_t num_objects,
+                  uint32_t num_draws,
+                  const VkDrawIndexedIndirectCommand *draws,
+                  VkdfHiz *hiz);
+
+void
+vkdf_gpu_cull_free(VkdfContext *ctx, VkdfGpuCull *cull);
+
+void
+vkdf_gpu_cull_set_bounds(VkdfGpuCull *cull,
+                         uint32_t idx,
+                         const VkdfBox *box,
+                         const VkdfSphere *sphere);
+
+void
+vkdf_gpu_cull_set_object(VkdfGpuCull *cull, uint32_t idx, VkdfObject *obj);
+
+void
+vkdf_gpu_cull_set_draws(VkdfGpuCull *cull,
+                        uint32_t idx,
+                        uint32_t first_draw,
+                        uint32_t num_draws);
+
+void
+vkdf_gpu_cull_update(VkdfContext *ctx,
+                     VkdfGpuCull *cull,
+                     const glm::mat4 &view_proj);
+
+void
+vkdf_gpu_cull_cmd_dispatch(VkdfGpuCull *cull,
+                           VkCommandBuffer cmd_buf,
+                           VkdfGpuCullPass pass);
+
+void
+vkdf_gpu_cull_cmd_draw(VkdfContext *ctx,
+                       VkdfGpuCull *cull,
+                       VkCommandBuffer cmd_buf,
+                       uint32_t instance_binding,
+                       uint32_t first_draw,
+                       uint32_t draw_count);
+
+#endif
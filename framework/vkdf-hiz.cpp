@@ -0,0 +1,354 @@
+#include "vkdf.hpp"
+
+static VkSampler
+create_sampler(VkdfContext *ctx, uint32_t num_levels)
+{
+   VkSamplerCreateInfo sampler_info = {};
+   sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+   sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+   sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+   sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+   sampler_info.anisotropyEnable = false;
+   sampler_info.maxAnisotropy = 1.0f;
+   sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+   sampler_info.unnormalizedCoordinates = false;
+   sampler_info.compareEnable = false;
+   sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+   sampler_info.magFilter = VK_FILTER_NEAREST;
+   sampler_info.minFilter = VK_FILTER_NEAREST;
+   sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+   sampler_info.mipLodBias = 0.0f;
+   sampler_info.minLod = 0.0f;
+   sampler_info.maxLod = (float) num_levels;
+
+   VkSampler sampler;
+   VK_CHECK(vkCreateSampler(ctx->device, &sampler_info, NULL, &sampler));
+
+   return sampler;
+}
+
+static VkImageView
+create_level_view(VkdfContext *ctx, VkdfHiz *hiz, uint32_t level)
+{
+   VkImageViewCreateInfo view_info = {};
+   view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+   view_info.pNext = NULL;
+   view_info.image = hiz->image.image;
+   view_info.format = hiz->image.format;
+   view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+   view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+   view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+   view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+   view_info.subresourceRange =
+      vkdf_create_image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT,
+                                          level, 1, 0, 1);
+   view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+   view_info.flags = 0;
+
+   VkImageView view;
+   VK_CHECK(vkCreateImageView(ctx->device, &view_info, NULL, &view));
+
+   return view;
+}
+
+static void
+create_descriptor_sets(VkdfContext *ctx, VkdfHiz *hiz, VkImageView depth_view)
+{
+   // Binding 0: source level (or the depth image), binding 1: target level
+   VkDescriptorSetLayoutBinding bindings[2];
+   for (uint32_t i = 0; i < 2; i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = i == 0 ?
+         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER :
+         VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      bindings[i].descriptorCount = 1;
+      bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo set_layout_info;
+   set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   set_layout_info.pNext = NULL;
+   set_layout_info.bindingCount = 2;
+   set_layout_info.pBindings = bindings;
+   set_layout_info.flags = 0;
+
+   VK_CHECK(vkCreateDescriptorSetLayout(ctx->device,
+                                        &set_layout_info,
+                                        NULL,
+                                        &hiz->set_layout));
+
+   VkDescriptorPoolSize type_count[2];
+   type_count[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+   type_count[0].descriptorCount = hiz->num_levels;
+   type_count[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+   type_count[1].descriptorCount = hiz->num_levels;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = hiz->num_levels;
+   pool_ci.poolSizeCount = 2;
+   pool_ci.pPoolSizes = type_count;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VK_CHECK(vkCreateDescriptorPool(ctx->device, &pool_ci, NULL, &hiz->pool));
+
+   hiz->sets = g_new(VkDescriptorSet, hiz->num_levels);
+   for (uint32_t l = 0; l < hiz->num_levels; l++) {
+      VkDescriptorSetAllocateInfo alloc_info;
+      alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      alloc_info.pNext = NULL;
+      alloc_info.descriptorPool = hiz->pool;
+      alloc_info.descriptorSetCount = 1;
+      alloc_info.pSetLayouts = &hiz->set_layout;
+      VK_CHECK(vkAllocateDescriptorSets(ctx->device, &alloc_info,
+                                        &hiz->sets[l]));
+
+      VkDescriptorImageInfo image_info[2];
+      image_info[0].sampler = hiz->sampler;
+      if (l == 0) {
+         image_info[0].imageView = depth_view;
+         image_info[0].imageLayout =
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+      } else {
+         image_info[0].imageView = hiz->level_views[l - 1];
+         image_info[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+      }
+      image_info[1].sampler = VK_NULL_HANDLE;
+      image_info[1].imageView = hiz->level_views[l];
+      image_info[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkWriteDescriptorSet writes[2];
+      for (uint32_t i = 0; i < 2; i++) {
+         writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+         writes[i].pNext = NULL;
+         writes[i].dstSet = hiz->sets[l];
+         writes[i].dstBinding = i;
+         writes[i].dstArrayElement = 0;
+         writes[i].descriptorCount = 1;
+         writes[i].descriptorType = bindings[i].descriptorType;
+         writes[i].pImageInfo = &image_info[i];
+         writes[i].pBufferInfo = NULL;
+         writes[i].pTexelBufferView = NULL;
+      }
+
+      vkUpdateDescriptorSets(ctx->device, 2, writes, 0, NULL);
+   }
+}
+
+static void
+create_pipeline(VkdfContext *ctx, VkdfHiz *hiz, VkShaderModule cs_module)
+{
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 0;
+   pipeline_layout_info.pPushConstantRanges = NULL;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = &hiz->set_layout;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &hiz->pipeline_layout));
+
+   VkComputePipelineCreateInfo pipeline_info;
+   pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+   pipeline_info.pNext = NULL;
+   pipeline_info.flags = 0;
+   pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+   pipeline_info.stage.pNext = NULL;
+   pipeline_info.stage.flags = 0;
+   pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+   pipeline_info.stage.module = cs_module;
+   pipeline_info.stage.pName = "main";
+   pipeline_info.stage.pSpecializationInfo = NULL;
+   pipeline_info.layout = hiz->pipeline_layout;
+   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+   pipeline_info.basePipelineIndex = -1;
+
+   VK_CHECK(vkCreateComputePipelines(ctx->device, NULL, 1, &pipeline_info,
+                                     NULL, &hiz->pipeline));
+}
+
+static inline uint32_t
+level_size(uint32_t size, uint32_t level)
+{
+   for (uint32_t l = 0; l < level; l++)
+      size = MAX((size + 1) / 2, 1);
+   return size;
+}
+
+/**
+ * Creates a Hi-Z pyramid for 'depth_image', which must have been created
+ * with VK_IMAGE_USAGE_SAMPLED_BIT and a depth-only view.
+ */
+VkdfHiz *
+vkdf_hiz_new(VkdfContext *ctx,
+             VkShaderModule cs_module,
+             VkdfImage *depth_image,
+             uint32_t depth_width,
+             uint32_t depth_height)
+{
+   VkdfHiz *hiz = g_new0(VkdfHiz, 1);
+
+   hiz->width = level_size(depth_width, 1);
+   hiz->height = level_size(depth_height, 1);
+   hiz->num_levels = 1;
+   while (level_size(hiz->width, hiz->num_levels - 1) > 1 ||
+          level_size(hiz->height, hiz->num_levels - 1) > 1) {
+      hiz->num_levels++;
+   }
+
+   hiz->image =
+      vkdf_create_image(ctx,
+                        hiz->width,
+                        hiz->height,
+                        hiz->num_levels,
+                        VK_IMAGE_TYPE_2D,
+                        VK_FORMAT_R32_SFLOAT,
+                        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT |
+                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT,
+                        VK_IMAGE_USAGE_STORAGE_BIT |
+                        VK_IMAGE_USAGE_SAMPLED_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        VK_IMAGE_ASPECT_COLOR_BIT,
+                        VK_IMAGE_VIEW_TYPE_2D);
+
+   hiz->level_views = g_new(VkImageView, hiz->num_levels);
+   for (uint32_t l = 0; l < hiz->num_levels; l++)
+      hiz->level_views[l] = create_level_view(ctx, hiz, l);
+
+   hiz->sampler = create_sampler(ctx, hiz->num_levels);
+   hiz->depth_image = depth_image->image;
+
+   create_descriptor_sets(ctx, hiz, depth_image->view);
+   create_pipeline(ctx, hiz, cs_module);
+
+   return hiz;
+}
+
+void
+vkdf_hiz_free(VkdfContext *ctx, VkdfHiz *hiz)
+{
+   vkDestroyPipeline(ctx->device, hiz->pipeline, NULL);
+   vkDestroyPipelineLayout(ctx->device, hiz->pipeline_layout, NULL);
+   vkFreeDescriptorSets(ctx->device, hiz->pool, hiz->num_levels, hiz->sets);
+   vkDestroyDescriptorSetLayout(ctx->device, hiz->set_layout, NULL);
+   vkDestroyDescriptorPool(ctx->device, hiz->pool, NULL);
+   g_free(hiz->sets);
+
+   vkDestroySampler(ctx->device, hiz->sampler, NULL);
+   for (uint32_t l = 0; l < hiz->num_levels; l++)
+      vkDestroyImageView(ctx->device, hiz->level_views[l], NULL);
+   g_free(hiz->level_views);
+   vkdf_destroy_image(ctx, &hiz->image);
+
+   g_free(hiz);
+}
+
+/**
+ * Records the commands to build the pyramid from the depth image, which
+ * must be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, that is,
+ * after a render pass that stores depth and keeps it in that layout. The
+ * depth image is left in the same layout and the pyramid is left in
+ * VK_IMAGE_LAYOUT_GENERAL, ready to be read by compute shaders.
+ */
+void
+vkdf_hiz_cmd_build(VkdfHiz *hiz, VkCommandBuffer cmd_buf)
+{
+   const VkImageLayout attachment_layout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+   const VkImageLayout read_only_layout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+   VkImageMemoryBarrier barriers[2];
+
+   // Wait for depth writes. The previous contents of the pyramid are not
+   // needed, but the culling pass of previous frames may still read them.
+   barriers[0] =
+      vkdf_create_image_barrier(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                VK_ACCESS_SHADER_READ_BIT,
+                                attachment_layout,
+                                read_only_layout,
+                                hiz->depth_image,
+                                vkdf_create_image_subresource_range(
+                                   VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1));
+   barriers[1] =
+      vkdf_create_image_barrier(0,
+                                VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_GENERAL,
+                                hiz->image.image,
+                                vkdf_create_image_subresource_range(
+                                   VK_IMAGE_ASPECT_COLOR_BIT,
+                                   0, hiz->num_levels, 0, 1));
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        2, barriers);
+
+   vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          hiz->pipeline);
+
+   for (uint32_t l = 0; l < hiz->num_levels; l++) {
+      vkdf_cmd_bind_descriptor_sets(cmd_buf,
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    hiz->pipeline_layout,
+                                    0, 1, &hiz->sets[l],
+                                    0, NULL);
+
+      uint32_t w = level_size(hiz->width, l);
+      uint32_t h = level_size(hiz->height, l);
+      vkCmdDispatch(cmd_buf,
+                    (w + VKDF_HIZ_GROUP_SIZE - 1) / VKDF_HIZ_GROUP_SIZE,
+                    (h + VKDF_HIZ_GROUP_SIZE - 1) / VKDF_HIZ_GROUP_SIZE,
+                    1);
+
+      // Make the level visible to the next level and to culling shaders
+      VkImageMemoryBarrier level_barrier =
+         vkdf_create_image_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                   VK_ACCESS_SHADER_READ_BIT,
+                                   VK_IMAGE_LAYOUT_GENERAL,
+                                   VK_IMAGE_LAYOUT_GENERAL,
+                                   hiz->image.image,
+                                   vkdf_create_image_subresource_range(
+                                      VK_IMAGE_ASPECT_COLOR_BIT, l, 1, 0, 1));
+
+      vkCmdPipelineBarrier(cmd_buf,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           0,
+                           0, NULL,
+                           0, NULL,
+                           1, &level_barrier);
+   }
+
+   // Return the depth image to the render passes that follow
+   VkImageMemoryBarrier depth_barrier =
+      vkdf_create_image_barrier(0,
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                read_only_layout,
+                                attachment_layout,
+                                hiz->depth_image,
+                                vkdf_create_image_subresource_range(
+                                   VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1));
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                        0,
+                        0, NULL,
+                        0, NULL,
+                        1, &depth_barrier);
+}
@@ -0,0 +1,64 @@
+#ifndef __VKDF_HIZ_H__
+#define __VKDF_HIZ_H__
+
+/**
+ * Hierarchical depth (Hi-Z) pyramid.
+ *
+ * A mipmapped R32_SFLOAT image where each texel holds the farthest depth
+ * of the texels it covers in the level below, with level 0 built from a
+ * depth attachment at half its resolution. Levels are half the size of the
+ * previous one rounded up, and texels at the edges of odd-sized levels
+ * cover the extra texels too, so any region of the depth image is covered
+ * by at most 2x2 texels of the level where a texel is at least as large as
+ * the region. Culling shaders can then reject boxes whose nearest depth is
+ * farther than those texels with 4 fetches (see vkdf-gpu-cull.hpp).
+ *
+ * The pyramid is built with a compute shader provided by the application
+ * (see demos/model/hiz.comp), run once per level:
+ *
+ *    layout(local_size_x = VKDF_HIZ_GROUP_SIZE,
+ *           local_size_y = VKDF_HIZ_GROUP_SIZE) in;
+ *
+ *    layout(set = 0, binding = 0) uniform sampler2D src;
+ *    layout(set = 0, binding = 1, r32f) uniform writeonly image2D dst;
+ *
+ * Depth is expected to increase with distance (0 near, 1 far).
+ */
+
+#define VKDF_HIZ_GROUP_SIZE 8
+
+typedef struct {
+   uint32_t width;
+   uint32_t height;
+   uint32_t num_levels;
+
+   // The pyramid, its view of all levels and a view per level
+   VkdfImage image;
+   VkImageView *level_views;
+   VkSampler sampler;
+
+   // The depth image the pyramid is built from
+   VkImage depth_image;
+
+   // Compute pipeline and a descriptor set per level
+   VkDescriptorPool pool;
+   VkDescriptorSetLayout set_layout;
+   VkDescriptorSet *sets;
+   VkPipelineLayout pipeline_layout;
+   VkPipeline pipeline;
+} VkdfHiz;
+
+VkdfHiz *
+vkdf_hiz_new(VkdfContext *ctx,
+             VkShaderModule cs_module,
+             VkdfImage *depth_image,
+             uint32_t depth_width,
+             uint32_t depth_height);
+
+void
+vkdf_hiz_free(VkdfContext *ctx, VkdfHiz *hiz);
+
+void
+vkdf_hiz_cmd_build(VkdfHiz *hiz, VkCommandBuffer cmd_buf);
+
+#endif
@@ -50,11 +50,13 @@ create_debug_callback(VkdfContext *ctx,
 static void
 get_required_extensions(VkdfContext *ctx, bool enable_validation)
 {
-   uint32_t glfw_ext_count;
-   const char **glfw_extensions =
-      glfwGetRequiredInstanceExtensions(&glfw_ext_count);
-   if (!glfw_extensions)
-      vkdf_fatal("Required GLFW instance extensions not available");
+   uint32_t glfw_ext_count = 0;
+   const char **glfw_extensions = NULL;
+   if (!ctx->headless) {
+      glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
+      if (!glfw_extensions)
+         vkdf_fatal("Required GLFW instance extensions not available");
+   }
 
    ctx->inst_extension_count = glfw_ext_count;
    if (enable_validation)
@@ -155,6 +157,7 @@ init_physical_device(VkdfContext *ctx)
    vkGetPhysicalDeviceProperties(ctx->phy_device, &ctx->phy_device_props);
    vkGetPhysicalDeviceMemoryProperties(ctx->phy_device,
                                        &ctx->phy_device_mem_props);
+   vkGetPhysicalDeviceFeatures(ctx->phy_device, &ctx->phy_device_features);
 }
 
 static void
@@ -172,6 +175,18 @@ init_queues(VkdfContext *ctx)
    if (ctx->queue_count == 0)
       vkdf_fatal("Selected Vulkan device does not expose any queues");
 
+   // Without a surface we only need a graphics queue
+   if (ctx->headless) {
+      for (uint32_t i = 0; i < ctx->queue_count; i++) {
+         if (ctx->queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            ctx->gfx_queue_index = i;
+            ctx->pst_queue_index = i;
+            return;
+         }
+      }
+      vkdf_fatal("Selected device does not provide a graphics queue");
+   }
+
    bool *can_present = g_new(bool, ctx->queue_count);
    for (uint32_t i = 0; i < ctx->queue_count; i++) {
       // GLFW does not call vkGetPhysicalDeviceSurfaceSupportKHR and it should.
@@ -230,9 +245,24 @@ init_logical_device(VkdfContext *ctx)
    queue_info.queueCount = 1;
    queue_info.pQueuePriorities = queue_priorities;
 
-   ctx->device_extension_count = 1;
-   ctx->device_extensions = g_new0(const char *, ctx->device_extension_count);
-   ctx->device_extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+   if (!ctx->headless) {
+      ctx->device_extension_count = 1;
+      ctx->device_extensions =
+         g_new0(const char *, ctx->device_extension_count);
+      ctx->device_extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+   }
+
+   // Only enable the optional features we know how to use. Users should
+   // check ctx->device_features before relying on any of them.
+   memset(&ctx->device_features, 0, sizeof(VkPhysicalDeviceFeatures));
+   ctx->device_features.pipelineStatisticsQuery =
+      ctx->phy_device_features.pipelineStatisticsQuery;
+   ctx->device_features.occlusionQueryPrecise =
+      ctx->phy_device_features.occlusionQueryPrecise;
+   ctx->device_features.multiDrawIndirect =
+      ctx->phy_device_features.multiDrawIndirect;
+   ctx->device_features.drawIndirectFirstInstance =
+      ctx->phy_device_features.drawIndirectFirstInstance;
 
    VkDeviceCreateInfo device_info;
    device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -244,7 +274,7 @@ init_logical_device(VkdfContext *ctx)
    device_info.ppEnabledExtensionNames = ctx->device_extensions;
    device_info.enabledLayerCount = 0;
    device_info.ppEnabledLayerNames = NULL;
-   device_info.pEnabledFeatures = NULL;
+   device_info.pEnabledFeatures = &ctx->device_features;
 
    VkResult res =
       vkCreateDevice(ctx->phy_device, &device_info, NULL, &ctx->device);
@@ -523,6 +553,29 @@ vkdf_init(VkdfContext *ctx,
    _init_swap_chain(ctx);
 }
 
+/**
+ * Initializes Vulkan without a window, surface or swap chain. This is meant
+ * for programs that render to offscreen targets only (like benchmarks), so
+ * the width and height are only recorded in the context for reference.
+ */
+void
+vkdf_init_headless(VkdfContext *ctx,
+                   uint32_t width,
+                   uint32_t height,
+                   bool enable_validation)
+{
+   memset(ctx, 0, sizeof(VkdfContext));
+
+   ctx->headless = true;
+   ctx->width = width;
+   ctx->height = height;
+
+   init_instance(ctx, enable_validation);
+   init_physical_device(ctx);
+   init_queues(ctx);
+   init_logical_device(ctx);
+}
+
 static void
 destroy_instance(VkdfContext *ctx)
 {
@@ -534,6 +587,12 @@ destroy_instance(VkdfContext *ctx)
 void
 vkdf_cleanup(VkdfContext *ctx)
 {
+   if (ctx->headless) {
+      vkDestroyDevice(ctx->device, NULL);
+      destroy_instance(ctx);
+      return;
+   }
+
    destroy_swap_chain(ctx);
    vkDestroyDevice(ctx->device, NULL);
    vkDestroySurfaceKHR(ctx->inst, ctx->surface, NULL);
@@ -9,6 +9,12 @@ vkdf_init(VkdfContext *ctx,
           bool resizable,
           bool enable_validation);
 
+void
+vkdf_init_headless(VkdfContext *ctx,
+                   uint32_t width,
+                   uint32_t height,
+                   bool enable_validation);
+
 void
 vkdf_cleanup(VkdfContext *ctx);
 
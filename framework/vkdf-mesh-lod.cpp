@@ -0,0 +1,379 @@
+#include "vkdf.hpp"
+
+#include <algorithm>
+
+// Stop adding levels when simplification can't remove at least this
+// fraction of the triangles of the previous level
+#define LOD_MIN_REDUCTION 0.15f
+
+typedef struct {
+   double a00, a01, a02, a11, a12, a22;
+   double b0, b1, b2;
+   double c;
+   double w;
+} Quadric;
+
+typedef struct {
+   uint32_t u;    // Vertex to remove
+   uint32_t v;    // Vertex it collapses into
+   double cost;
+} Collapse;
+
+static inline void
+quadric_add(Quadric *q, const Quadric *o)
+{
+   q->a00 += o->a00; q->a01 += o->a01; q->a02 += o->a02;
+   q->a11 += o->a11; q->a12 += o->a12; q->a22 += o->a22;
+   q->b0 += o->b0; q->b1 += o->b1; q->b2 += o->b2;
+   q->c += o->c;
+   q->w += o->w;
+}
+
+// Adds the plane n·p + d = 0 ('n' normalized) with weight 'w'
+static inline void
+quadric_add_plane(Quadric *q, const glm::vec3 &n, double d, double w)
+{
+   q->a00 += w * n.x * n.x; q->a01 += w * n.x * n.y; q->a02 += w * n.x * n.z;
+   q->a11 += w * n.y * n.y; q->a12 += w * n.y * n.z; q->a22 += w * n.z * n.z;
+   q->b0 += w * d * n.x; q->b1 += w * d * n.y; q->b2 += w * d * n.z;
+   q->c += w * d * d;
+   q->w += w;
+}
+
+// Weighted average of squared distances from 'p' to the quadric's planes
+static inline double
+quadric_error(const Quadric *q, const glm::vec3 &p)
+{
+   double x = p.x, y = p.y, z = p.z;
+   double r = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+              2.0 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z) +
+              2.0 * (q->b0 * x + q->b1 * y + q->b2 * z) +
+              q->c;
+   return q->w > 0.0 ? fabs(r) / q->w : 0.0;
+}
+
+/**
+ * Maps each vertex to the lowest-numbered vertex with the same position
+ */
+static void
+build_position_remap(const glm::vec3 *positions,
+                     uint32_t num_vertices,
+                     std::vector<uint32_t> &remap)
+{
+   std::vector<uint32_t> order(num_vertices);
+   for (uint32_t i = 0; i < num_vertices; i++)
+      order[i] = i;
+
+   std::stable_sort(order.begin(), order.end(),
+                    [positions](uint32_t a, uint32_t b) {
+                       const glm::vec3 &pa = positions[a];
+                       const glm::vec3 &pb = positions[b];
+                       if (pa.x != pb.x)
+                          return pa.x < pb.x;
+                       if (pa.y != pb.y)
+                          return pa.y < pb.y;
+                       return pa.z < pb.z;
+                    });
+
+   remap.resize(num_vertices);
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      if (i > 0 && positions[order[i]] == positions[order[i - 1]])
+         remap[order[i]] = remap[order[i - 1]];
+      else
+         remap[order[i]] = order[i];
+   }
+}
+
+/**
+ * Locks vertices that can't be collapsed without opening cracks: attribute
+ * seams and vertices on open or non-manifold edges.
+ */
+static void
+find_locked_vertices(const uint32_t *indices,
+                     uint32_t num_indices,
+                     uint32_t num_vertices,
+                     const std::vector<uint32_t> &remap,
+                     std::vector<bool> &locked)
+{
+   std::vector<bool> locked_position(num_vertices, false);
+
+   for (uint32_t v = 0; v < num_vertices; v++) {
+      if (remap[v] != v)
+         locked_position[remap[v]] = true;
+   }
+
+   // Count triangles per undirected edge (between welded positions)
+   std::vector<uint64_t> edges;
+   edges.reserve(num_indices);
+   for (uint32_t i = 0; i < num_indices; i += 3) {
+      for (uint32_t k = 0; k < 3; k++) {
+         uint32_t a = remap[indices[i + k]];
+         uint32_t b = remap[indices[i + (k + 1) % 3]];
+         if (a == b)
+            continue;
+         edges.push_back(((uint64_t) MIN(a, b) << 32) | MAX(a, b));
+      }
+   }
+   std::sort(edges.begin(), edges.end());
+
+   for (uint32_t i = 0; i < edges.size(); ) {
+      uint32_t j = i + 1;
+      while (j < edges.size() && edges[j] == edges[i])
+         j++;
+      if (j - i != 2) {
+         locked_position[edges[i] >> 32] = true;
+         locked_position[edges[i] & 0xffffffff] = true;
+      }
+      i = j;
+   }
+
+   locked.resize(num_vertices);
+   for (uint32_t v = 0; v < num_vertices; v++)
+      locked[v] = locked_position[remap[v]];
+}
+
+static void
+build_vertex_triangles(const std::vector<uint32_t> &indices,
+                       uint32_t num_vertices,
+                       std::vector<uint32_t> &offsets,
+                       std::vector<uint32_t> &triangles)
+{
+   offsets.assign(num_vertices + 1, 0);
+   for (uint32_t i = 0; i < indices.size(); i++)
+      offsets[indices[i] + 1]++;
+
+   for (uint32_t v = 0; v < num_vertices; v++)
+      offsets[v + 1] += offsets[v];
+
+   std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+   triangles.resize(indices.size());
+   for (uint32_t i = 0; i < indices.size(); i++)
+      triangles[fill[indices[i]]++] = i / 3;
+}
+
+static bool
+collapse_flips_triangles(const glm::vec3 *positions,
+                         const std::vector<uint32_t> &indices,
+                         const std::vector<uint32_t> &offsets,
+                         const std::vector<uint32_t> &triangles,
+                         uint32_t u,
+                         uint32_t v)
+{
+   for (uint32_t a = offsets[u]; a < offsets[u + 1]; a++) {
+      const uint32_t *tri = &indices[3 * triangles[a]];
+      if (tri[0] == v || tri[1] == v || tri[2] == v)
+         continue;  // Removed by the collapse
+
+      glm::vec3 p[3], q[3];
+      for (uint32_t k = 0; k < 3; k++) {
+         p[k] = positions[tri[k]];
+         q[k] = tri[k] == u ? positions[v] : p[k];
+      }
+
+      glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+      glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+      if (glm::dot(n0, n1) <= 0.0f)
+         return true;
+   }
+
+   return false;
+}
+
+/**
+ * Simplifies the triangle list in 'indices' towards 'target_num_indices'
+ * indices by collapsing edges into existing vertices. Writes the result to
+ * 'out_indices' (which must have room for 'num_indices' indices) and
+ * returns its size. 'out_error' receives the largest error introduced, as
+ * a distance in object space.
+ */
+uint32_t
+vkdf_mesh_simplify(const glm::vec3 *positions,
+                   uint32_t num_vertices,
+                   const uint32_t *indices,
+                   uint32_t num_indices,
+                   uint32_t target_num_indices,
+                   uint32_t *out_indices,
+                   float *out_error)
+{
+   VKDF_TRACE_SCOPE("vkdf_mesh_simplify");
+
+   std::vector<uint32_t> remap;
+   build_position_remap(positions, num_vertices, remap);
+
+   std::vector<bool> locked;
+   find_locked_vertices(indices, num_indices, num_vertices, remap, locked);
+
+   // Area-weighted plane quadrics, accumulated per welded position
+   std::vector<Quadric> quadrics(num_vertices);
+   memset(quadrics.data(), 0, num_vertices * sizeof(Quadric));
+   for (uint32_t i = 0; i < num_indices; i += 3) {
+      const glm::vec3 &p0 = positions[indices[i + 0]];
+      const glm::vec3 &p1 = positions[indices[i + 1]];
+      const glm::vec3 &p2 = positions[indices[i + 2]];
+      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      float len = glm::length(n);
+      if (len == 0.0f)
+         continue;
+
+      n /= len;
+      double d = -glm::dot(n, p0);
+      for (uint32_t k = 0; k < 3; k++)
+         quadric_add_plane(&quadrics[remap[indices[i + k]]], n, d, 0.5 * len);
+   }
+
+   std::vector<uint32_t> cur(indices, indices + num_indices);
+   std::vector<uint32_t> collapse(num_vertices);
+   for (uint32_t v = 0; v < num_vertices; v++)
+      collapse[v] = v;
+
+   std::vector<uint32_t> adj_offsets, adj_triangles;
+   std::vector<Collapse> candidates;
+   std::vector<bool> touched(num_vertices);
+   double max_error = 0.0;
+
+   // Each pass collapses the cheapest edges whose neighborhoods don't
+   // overlap, so their costs stay valid for the whole pass
+   while (cur.size() > target_num_indices) {
+      build_vertex_triangles(cur, num_vertices, adj_offsets, adj_triangles);
+
+      candidates.clear();
+      for (uint32_t i = 0; i < cur.size(); i++) {
+         uint32_t a = cur[i];
+         uint32_t b = cur[i - i % 3 + (i + 1) % 3];
+         for (uint32_t dir = 0; dir < 2; dir++) {
+            uint32_t u = dir == 0 ? a : b;
+            uint32_t v = dir == 0 ? b : a;
+            if (locked[u] || remap[u] == remap[v])
+               continue;
+
+            Quadric q = quadrics[u];
+            quadric_add(&q, &quadrics[remap[v]]);
+
+            Collapse c;
+            c.u = u;
+            c.v = v;
+            c.cost = quadric_error(&q, positions[v]);
+            candidates.push_back(c);
+         }
+      }
+
+      std::sort(candidates.begin(), candidates.end(),
+                [](const Collapse &a, const Collapse &b) {
+                   if (a.cost != b.cost)
+                      return a.cost < b.cost;
+                   if (a.u != b.u)
+                      return a.u < b.u;
+                   return a.v < b.v;
+                });
+
+      std::fill(touched.begin(), touched.end(), false);
+      uint32_t triangles_to_remove = (cur.size() - target_num_indices) / 3;
+      uint32_t triangles_removed = 0;
+      uint32_t num_collapses = 0;
+      for (uint32_t i = 0; i < candidates.size(); i++) {
+         if (triangles_removed >= MAX(triangles_to_remove, 1))
+            break;
+
+         uint32_t u = candidates[i].u;
+         uint32_t v = candidates[i].v;
+         if (touched[u] || touched[v])
+            continue;
+
+         if (collapse_flips_triangles(positions, cur,
+                                      adj_offsets, adj_triangles, u, v)) {
+            continue;
+         }
+
+         collapse[u] = v;
+         quadric_add(&quadrics[remap[v]], &quadrics[u]);
+         max_error = MAX(max_error, candidates[i].cost);
+         num_collapses++;
+
+         for (uint32_t a = adj_offsets[u]; a < adj_offsets[u + 1]; a++) {
+            const uint32_t *tri = &cur[3 * adj_triangles[a]];
+            if (tri[0] == v || tri[1] == v || tri[2] == v)
+               triangles_removed++;
+            for (uint32_t k = 0; k < 3; k++)
+               touched[tri[k]] = true;
+         }
+      }
+
+      if (num_collapses == 0)
+         break;
+
+      // Apply the collapses and drop degenerate triangles
+      uint32_t count = 0;
+      for (uint32_t i = 0; i < cur.size(); i += 3) {
+         uint32_t a = collapse[cur[i + 0]];
+         uint32_t b = collapse[cur[i + 1]];
+         uint32_t c = collapse[cur[i + 2]];
+         if (remap[a] == remap[b] || remap[b] == remap[c] ||
+             remap[a] == remap[c]) {
+            continue;
+         }
+         cur[count++] = a;
+         cur[count++] = b;
+         cur[count++] = c;
+      }
+      cur.resize(count);
+   }
+
+   if (cur.size() > 0)
+      memcpy(out_indices, cur.data(), cur.size() * sizeof(uint32_t));
+   *out_error = sqrt(max_error);
+
+   return cur.size();
+}
+
+/**
+ * Generates up to 'num_lods' levels of detail (including the mesh itself)
+ * for a triangle-list mesh, replacing any levels it had. Each level targets
+ * VKDF_MESH_LOD_RATIO times the triangles of the previous one. Fewer
+ * levels are generated if simplification stops making progress.
+ */
+void
+vkdf_mesh_generate_lods(VkdfMesh *mesh, uint32_t num_lods)
+{
+   VKDF_TRACE_SCOPE("vkdf_mesh_generate_lods");
+
+   assert(!mesh->cached);
+
+   mesh->num_lods = 1;
+   mesh->lod_indices.clear();
+
+   uint32_t num_indices = mesh->indices.size();
+   if (num_indices == 0 || num_indices % 3 != 0)
+      return;
+
+   num_lods = MIN(num_lods, VKDF_MESH_MAX_LODS);
+
+   std::vector<uint32_t> lod(num_indices);
+   uint32_t prev_num_indices = num_indices;
+   float prev_error = 0.0f;
+   for (uint32_t l = 1; l < num_lods; l++) {
+      uint32_t target = (uint32_t) (prev_num_indices * VKDF_MESH_LOD_RATIO);
+      target -= target % 3;
+      if (target == 0)
+         break;
+
+      float error;
+      uint32_t count =
+         vkdf_mesh_simplify(mesh->vertices.data(), mesh->vertices.size(),
+                            mesh->indices.data(), num_indices, target,
+                            lod.data(), &error);
+      if (count == 0 ||
+          count > prev_num_indices * (1.0f - LOD_MIN_REDUCTION)) {
+         break;
+      }
+
+      mesh->lod_first_index[l] = num_indices + mesh->lod_indices.size();
+      mesh->lod_num_indices[l] = count;
+      mesh->lod_error[l] = MAX(error, prev_error);
+      mesh->lod_indices.insert(mesh->lod_indices.end(),
+                               lod.begin(), lod.begin() + count);
+      mesh->num_lods++;
+
+      prev_num_indices = count;
+      prev_error = mesh->lod_error[l];
+   }
+}
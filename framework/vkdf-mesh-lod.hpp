@@ -0,0 +1,41 @@
+#ifndef __VKDF_MESH_LOD_H__
+#define __VKDF_MESH_LOD_H__
+
+/**
+ * Mesh levels of detail.
+ *
+ * vkdf_mesh_generate_lods() simplifies triangle-list meshes with quadric
+ * error metrics (Garland and Heckbert, "Surface Simplification Using
+ * Quadric Error Metrics"), collapsing edges into one of their existing
+ * vertices so that every level shares the mesh's vertex data and only
+ * needs its own indices. Each level targets half the triangles of the
+ * previous one. Vertices on open borders and on attribute seams (vertices
+ * that share a position but not their other attributes) are never
+ * collapsed, so simplification doesn't open cracks.
+ *
+ * All levels live in the mesh's index data (and therefore in the model's
+ * packed index buffer), one after another, so drawing a level is a matter
+ * of picking its index range with vkdf_mesh_get_lod_first_index() and
+ * vkdf_mesh_get_lod_num_indices().
+ *
+ * Levels are selected per object with vkdf_object_select_lod(), which
+ * picks the coarsest level whose error projects to less than a given
+ * number of pixels on screen. Meshes with fewer levels than the selected
+ * one draw their coarsest level.
+ */
+
+#define VKDF_MESH_LOD_RATIO 0.5f
+
+void
+vkdf_mesh_generate_lods(VkdfMesh *mesh, uint32_t num_lods);
+
+uint32_t
+vkdf_mesh_simplify(const glm::vec3 *positions,
+                   uint32_t num_vertices,
+                   const uint32_t *indices,
+                   uint32_t num_indices,
+                   uint32_t target_num_indices,
+                   uint32_t *out_indices,
+                   float *out_error);
+
+#endif
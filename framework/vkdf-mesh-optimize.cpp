@@ -0,0 +1,384 @@
+#include "vkdf.hpp"
+
+#include <algorithm>
+
+// Overdraw clusters can be split at any triangle where the cache miss ratio
+// of the cluster so far (with a cold cache) is within this factor of the
+// miss ratio of the whole mesh, since restarting there costs little cache
+// locality.
+#define OVERDRAW_SPLIT_THRESHOLD 1.05f
+
+/**
+ * Returns the number of vertex shader invocations needed to render the
+ * triangle list in 'indices' with a FIFO post-transform cache of
+ * 'cache_size' entries.
+ */
+uint32_t
+vkdf_mesh_simulate_vertex_cache(const uint32_t *indices,
+                                uint32_t num_indices,
+                                uint32_t num_vertices,
+                                uint32_t cache_size)
+{
+   // A vertex is in the cache if fewer than 'cache_size' misses happened
+   // since it was last inserted
+   std::vector<uint32_t> cache_time(num_vertices, 0);
+   uint32_t timestamp = cache_size + 1;
+   uint32_t misses = 0;
+
+   for (uint32_t i = 0; i < num_indices; i++) {
+      uint32_t v = indices[i];
+      if (timestamp - cache_time[v] > cache_size) {
+         cache_time[v] = timestamp++;
+         misses++;
+      }
+   }
+
+   return misses;
+}
+
+static void
+build_adjacency(const uint32_t *indices,
+                uint32_t num_indices,
+                uint32_t num_vertices,
+                std::vector<uint32_t> &offsets,
+                std::vector<uint32_t> &triangles)
+{
+   offsets.assign(num_vertices + 1, 0);
+   for (uint32_t i = 0; i < num_indices; i++)
+      offsets[indices[i] + 1]++;
+
+   for (uint32_t v = 0; v < num_vertices; v++)
+      offsets[v + 1] += offsets[v];
+
+   std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+   triangles.resize(num_indices);
+   for (uint32_t i = 0; i < num_indices; i++)
+      triangles[fill[indices[i]]++] = i / 3;
+}
+
+/**
+ * Tipsify. Writes the reordered triangle list to 'out' and the index of
+ * the first triangle of each run that starts at a dead end (where the
+ * cache is effectively cold) to 'clusters'.
+ */
+static void
+tipsify(const uint32_t *indices,
+        uint32_t num_indices,
+        uint32_t num_vertices,
+        uint32_t cache_size,
+        std::vector<uint32_t> &out,
+        std::vector<uint32_t> &clusters)
+{
+   std::vector<uint32_t> adj_offsets, adj_triangles;
+   build_adjacency(indices, num_indices, num_vertices,
+                   adj_offsets, adj_triangles);
+
+   // Number of triangles not emitted yet for each vertex
+   std::vector<uint32_t> live(num_vertices);
+   for (uint32_t v = 0; v < num_vertices; v++)
+      live[v] = adj_offsets[v + 1] - adj_offsets[v];
+
+   std::vector<uint32_t> cache_time(num_vertices, 0);
+   std::vector<bool> emitted(num_indices / 3, false);
+   std::vector<uint32_t> dead_end;
+   std::vector<uint32_t> candidates;
+   dead_end.reserve(num_indices);
+   out.reserve(num_indices);
+
+   uint32_t timestamp = cache_size + 1;
+   uint32_t cursor = 0;
+   int64_t fanning = 0;
+   bool restart = true;
+
+   while (fanning >= 0) {
+      if (restart)
+         clusters.push_back(out.size() / 3);
+
+      // Emit all remaining triangles around the fanning vertex
+      candidates.clear();
+      for (uint32_t a = adj_offsets[fanning]; a < adj_offsets[fanning + 1];
+           a++) {
+         uint32_t t = adj_triangles[a];
+         if (emitted[t])
+            continue;
+
+         for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = indices[3 * t + k];
+            out.push_back(v);
+            dead_end.push_back(v);
+            candidates.push_back(v);
+            live[v]--;
+            if (timestamp - cache_time[v] > cache_size)
+               cache_time[v] = timestamp++;
+         }
+         emitted[t] = true;
+      }
+
+      // Pick the next fanning vertex among the vertices we just used,
+      // preferring the oldest ones that will still be in the cache after
+      // emitting all their triangles
+      int64_t next = -1;
+      int64_t best_priority = -1;
+      for (uint32_t c = 0; c < candidates.size(); c++) {
+         uint32_t v = candidates[c];
+         if (live[v] == 0)
+            continue;
+
+         int64_t priority = 0;
+         if (timestamp - cache_time[v] + 2 * live[v] <= cache_size)
+            priority = timestamp - cache_time[v];
+
+         if (priority > best_priority) {
+            best_priority = priority;
+            next = v;
+         }
+      }
+
+      // Dead end: go back to a recently used vertex with triangles left,
+      // or to the next one in input order
+      restart = next < 0;
+      while (next < 0 && !dead_end.empty()) {
+         uint32_t v = dead_end.back();
+         dead_end.pop_back();
+         if (live[v] > 0)
+            next = v;
+      }
+
+      while (next < 0 && cursor < num_vertices) {
+         if (live[cursor] > 0)
+            next = cursor;
+         cursor++;
+      }
+
+      fanning = next;
+   }
+
+   // The first fanning vertex may not have been used by any triangle
+   if (clusters.size() > 1 && clusters[1] == 0)
+      clusters.erase(clusters.begin());
+}
+
+/**
+ * Splits the Tipsify clusters further wherever doing so costs little cache
+ * locality, then sorts them so that clusters facing away from the mesh's
+ * center are drawn first.
+ */
+static void
+sort_clusters_for_overdraw(VkdfMesh *mesh,
+                           std::vector<uint32_t> &indices,
+                           const std::vector<uint32_t> &hard_clusters,
+                           uint32_t cache_size)
+{
+   uint32_t num_triangles = indices.size() / 3;
+   uint32_t num_vertices = mesh->vertices.size();
+
+   float mesh_acmr =
+      vkdf_mesh_simulate_vertex_cache(indices.data(), indices.size(),
+                                      num_vertices, cache_size) /
+      (float) num_triangles;
+
+   // Advancing the timestamp by more than the cache size evicts everything,
+   // which lets us simulate a cold cache at the start of each cluster
+   std::vector<uint32_t> clusters;
+   std::vector<uint32_t> cache_time(num_vertices, 0);
+   uint32_t timestamp = cache_size + 1;
+   for (uint32_t c = 0; c < hard_clusters.size(); c++) {
+      uint32_t start = hard_clusters[c];
+      uint32_t end = c + 1 < hard_clusters.size() ?
+                     hard_clusters[c + 1] : num_triangles;
+
+      clusters.push_back(start);
+
+      timestamp += cache_size + 1;
+      uint32_t cluster_start = start;
+      uint32_t misses = 0;
+      for (uint32_t t = start; t < end; t++) {
+         if (t > cluster_start &&
+             misses <= OVERDRAW_SPLIT_THRESHOLD * mesh_acmr *
+                       (t - cluster_start)) {
+            clusters.push_back(t);
+            cluster_start = t;
+            misses = 0;
+            timestamp += cache_size + 1;
+         }
+
+         for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = indices[3 * t + k];
+            if (timestamp - cache_time[v] > cache_size) {
+               cache_time[v] = timestamp++;
+               misses++;
+            }
+         }
+      }
+   }
+
+   uint32_t num_clusters = clusters.size();
+   if (num_clusters < 2)
+      return;
+
+   // Area-weighted centroid and normal of each cluster
+   std::vector<glm::vec3> centroids(num_clusters, glm::vec3(0.0f));
+   std::vector<glm::vec3> normals(num_clusters, glm::vec3(0.0f));
+   glm::vec3 mesh_center = glm::vec3(0.0f);
+   float mesh_area = 0.0f;
+   for (uint32_t c = 0; c < num_clusters; c++) {
+      uint32_t end = c + 1 < num_clusters ? clusters[c + 1] : num_triangles;
+      float area = 0.0f;
+      for (uint32_t t = clusters[c]; t < end; t++) {
+         const glm::vec3 &p0 = mesh->vertices[indices[3 * t + 0]];
+         const glm::vec3 &p1 = mesh->vertices[indices[3 * t + 1]];
+         const glm::vec3 &p2 = mesh->vertices[indices[3 * t + 2]];
+         glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+         float a = glm::length(n);
+         centroids[c] += a * (p0 + p1 + p2) / 3.0f;
+         normals[c] += n;
+         area += a;
+      }
+
+      mesh_center += centroids[c];
+      mesh_area += area;
+      if (area > 0.0f)
+         centroids[c] /= area;
+   }
+
+   if (mesh_area > 0.0f)
+      mesh_center /= mesh_area;
+
+   std::vector<float> keys(num_clusters);
+   std::vector<uint32_t> order(num_clusters);
+   for (uint32_t c = 0; c < num_clusters; c++) {
+      float len = glm::length(normals[c]);
+      if (len > 0.0f)
+         keys[c] = glm::dot(centroids[c] - mesh_center, normals[c] / len);
+      else
+         keys[c] = 0.0f;
+      order[c] = c;
+   }
+
+   std::stable_sort(order.begin(), order.end(),
+                    [&keys](uint32_t a, uint32_t b) {
+                       return keys[a] > keys[b];
+                    });
+
+   std::vector<uint32_t> sorted;
+   sorted.reserve(indices.size());
+   for (uint32_t i = 0; i < num_clusters; i++) {
+      uint32_t c = order[i];
+      uint32_t end = c + 1 < num_clusters ? clusters[c + 1] : num_triangles;
+      sorted.insert(sorted.end(),
+                    indices.begin() + 3 * clusters[c],
+                    indices.begin() + 3 * end);
+   }
+
+   indices.swap(sorted);
+}
+
+template<typename T>
+static void
+remap_vertex_attrib(std::vector<T> &attrib,
+                    const std::vector<uint32_t> &remap,
+                    uint32_t num_vertices)
+{
+   if (attrib.size() == 0)
+      return;
+
+   std::vector<T> remapped(num_vertices);
+   for (uint32_t v = 0; v < remap.size(); v++) {
+      if (remap[v] != UINT32_MAX)
+         remapped[remap[v]] = attrib[v];
+   }
+   attrib.swap(remapped);
+}
+
+/**
+ * Reorders vertices in the order the index buffer first references them
+ * and drops unreferenced vertices.
+ */
+static void
+reorder_vertex_fetch(VkdfMesh *mesh)
+{
+   std::vector<uint32_t> remap(mesh->vertices.size(), UINT32_MAX);
+   uint32_t num_vertices = 0;
+   for (uint32_t i = 0; i < mesh->indices.size(); i++) {
+      uint32_t v = mesh->indices[i];
+      if (remap[v] == UINT32_MAX)
+         remap[v] = num_vertices++;
+      mesh->indices[i] = remap[v];
+   }
+
+   remap_vertex_attrib(mesh->vertices, remap, num_vertices);
+   remap_vertex_attrib(mesh->normals, remap, num_vertices);
+   remap_vertex_attrib(mesh->uvs, remap, num_vertices);
+}
+
+/**
+ * Optimizes a triangle-list mesh for vertex cache locality, overdraw and
+ * vertex fetch locality (see vkdf-mesh-optimize.hpp). If 'stats' is not
+ * NULL, it receives the simulated cache efficiency before and after.
+ * Levels of detail and meshlets are regenerated, since vertices and
+ * triangles are reordered.
+ */
+void
+vkdf_mesh_optimize(VkdfMesh *mesh, VkdfMeshOptimizeStats *stats)
+{
+   VKDF_TRACE_SCOPE("vkdf_mesh_optimize");
+
+   // Meshes from the model cache don't own their data
+   assert(!mesh->cached);
+
+   uint32_t num_lods = mesh->num_lods;
+   mesh->num_lods = 1;
+   mesh->lod_indices.clear();
+
+   uint32_t num_indices = mesh->indices.size();
+   uint32_t num_vertices = mesh->vertices.size();
+   uint32_t cache_size = VKDF_MESH_VERTEX_CACHE_SIZE;
+
+   if (stats) {
+      stats->num_triangles = num_indices / 3;
+      stats->num_vertices_before = num_vertices;
+      stats->transforms_before =
+         vkdf_mesh_simulate_vertex_cache(mesh->indices.data(), num_indices,
+                                         num_vertices, cache_size);
+   }
+
+   if (num_indices > 0 && num_indices % 3 == 0) {
+      std::vector<uint32_t> indices;
+      std::vector<uint32_t> clusters;
+      tipsify(mesh->indices.data(), num_indices, num_vertices, cache_size,
+              indices, clusters);
+      sort_clusters_for_overdraw(mesh, indices, clusters, cache_size);
+      mesh->indices.swap(indices);
+
+      reorder_vertex_fetch(mesh);
+   }
+
+   if (stats) {
+      stats->num_vertices_after = mesh->vertices.size();
+      stats->transforms_after =
+         vkdf_mesh_simulate_vertex_cache(mesh->indices.data(),
+                                         mesh->indices.size(),
+                                         mesh->vertices.size(), cache_size);
+   }
+
+   if (num_lods > 1)
+      vkdf_mesh_generate_lods(mesh, num_lods);
+
+   if (mesh->meshlets.size() > 0)
+      vkdf_mesh_build_meshlets(mesh);
+}
+
+void
+vkdf_mesh_optimize_stats_log(const char *name,
+                             const VkdfMeshOptimizeStats *stats)
+{
+   if (stats->num_triangles == 0 || stats->num_vertices_after == 0)
+      return;
+
+   vkdf_info("%s: %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+             name, stats->num_triangles,
+             stats->transforms_before / (float) stats->num_triangles,
+             stats->transforms_after / (float) stats->num_triangles,
+             stats->transforms_before / (float) stats->num_vertices_before,
+             stats->transforms_after / (float) stats->num_vertices_after);
+}
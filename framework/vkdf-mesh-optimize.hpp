@@ -0,0 +1,57 @@
+#ifndef __VKDF_MESH_OPTIMIZE_H__
+#define __VKDF_MESH_OPTIMIZE_H__
+
+/**
+ * Mesh optimization for triangle lists.
+ *
+ * vkdf_mesh_optimize() reorders the triangles of a mesh for post-transform
+ * vertex cache locality using Tipsify (Sander, Nehab and Barczak, "Fast
+ * Triangle Reordering for Vertex Locality and Reduced Overdraw"), then
+ * splits the result in clusters at cache flushes and sorts them so that
+ * outward-facing clusters are drawn first, which reduces overdraw without
+ * giving up much cache locality. Finally, vertices are reordered so that
+ * the vertex buffer follows the order in which the index buffer first uses
+ * them. Unreferenced vertices are dropped.
+ *
+ * Cache efficiency is measured by simulating a FIFO vertex cache:
+ *
+ *    ACMR (average cache miss ratio): transformed vertices per triangle.
+ *    ATVR (average transform to vertex ratio): transformed vertices per
+ *    vertex in the mesh, 1.0 is optimal.
+ */
+
+#define VKDF_MESH_VERTEX_CACHE_SIZE 16
+
+typedef struct {
+   uint32_t num_triangles;
+   uint32_t num_vertices_before;
+   uint32_t num_vertices_after;
+   uint32_t transforms_before;
+   uint32_t transforms_after;
+} VkdfMeshOptimizeStats;
+
+uint32_t
+vkdf_mesh_simulate_vertex_cache(const uint32_t *indices,
+                                uint32_t num_indices,
+                                uint32_t num_vertices,
+                                uint32_t cache_size);
+
+void
+vkdf_mesh_optimize(VkdfMesh *mesh, VkdfMeshOptimizeStats *stats);
+
+inline void
+vkdf_mesh_optimize_stats_add(VkdfMeshOptimizeStats *total,
+                             const VkdfMeshOptimizeStats *stats)
+{
+   total->num_triangles += stats->num_triangles;
+   total->num_vertices_before += stats->num_vertices_before;
+   total->num_vertices_after += stats->num_vertices_after;
+   total->transforms_before += stats->transforms_before;
+   total->transforms_after += stats->transforms_after;
+}
+
+void
+vkdf_mesh_optimize_stats_log(const char *name,
+                             const VkdfMeshOptimizeStats *stats);
+
+#endif
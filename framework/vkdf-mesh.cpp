@@ -13,6 +13,20 @@ vkdf_mesh_new()
 
    mesh->material_idx = -1;
 
+   vkdf_box_init_empty(&mesh->box);
+   vkdf_sphere_init_empty(&mesh->sphere);
+
+   mesh->vertex_format = VKDF_VERTEX_FORMAT_FLOAT;
+   mesh->pos_scale = glm::vec3(1.0f);
+   mesh->pos_offset = glm::vec3(0.0f);
+
+   mesh->index_type = VK_INDEX_TYPE_UINT32;
+
+   mesh->num_lods = 1;
+   mesh->lod_indices = std::vector<uint32_t>();
+
+   mesh->meshlets = std::vector<VkdfMeshlet>();
+
    return mesh;
 }
 
@@ -84,6 +98,8 @@ vkdf_cube_mesh_new(VkdfContext *ctx)
       mesh->normals.push_back(face_normals[i / 6]);
    }
 
+   vkdf_mesh_compute_bounds(mesh);
+
    return mesh;
 }
 
@@ -102,6 +118,12 @@ vkdf_mesh_free(VkdfContext *ctx, VkdfMesh *mesh)
    mesh->indices.clear();
    std::vector<uint32_t>(mesh->indices).swap(mesh->indices);
 
+   mesh->lod_indices.clear();
+   std::vector<uint32_t>(mesh->lod_indices).swap(mesh->lod_indices);
+
+   mesh->meshlets.clear();
+   std::vector<VkdfMeshlet>(mesh->meshlets).swap(mesh->meshlets);
+
    if (mesh->vertex_buf.buf) {
       vkDestroyBuffer(ctx->device, mesh->vertex_buf.buf, NULL);
       vkFreeMemory(ctx->device, mesh->vertex_buf.mem, NULL);
@@ -118,14 +140,21 @@ vkdf_mesh_free(VkdfContext *ctx, VkdfMesh *mesh)
 static inline VkDeviceSize
 get_vertex_data_size(VkdfMesh *mesh)
 {
-   uint32_t vertex_count = mesh->vertices.size();
-   uint32_t uv_count = mesh->uvs.size();
+   uint32_t vertex_count = vkdf_mesh_get_num_vertices(mesh);
 
-   assert(vertex_count == mesh->normals.size() &&
-          (vertex_count == uv_count || uv_count == 0));
+   assert(mesh->cached ||
+          (vertex_count == mesh->normals.size() &&
+           (vertex_count == mesh->uvs.size() || mesh->uvs.size() == 0)));
 
-   return vertex_count * 2 * sizeof(glm::vec3) + // pos + normal
-          uv_count * sizeof(glm::vec2);          // uv
+   return (VkDeviceSize) vertex_count * vkdf_mesh_get_vertex_stride(mesh);
+}
+
+// Stride of the float vertex data stored in model caches
+static inline uint32_t
+get_cached_vertex_stride(VkdfMesh *mesh)
+{
+   return vkdf_vertex_format_get_stride(VKDF_VERTEX_FORMAT_FLOAT,
+                                        mesh->cached_has_uv);
 }
 
 VkDeviceSize
@@ -134,6 +163,106 @@ vkdf_mesh_get_vertex_data_size(VkdfMesh *mesh)
    return get_vertex_data_size(mesh);
 }
 
+/**
+ * Selects the layout of the mesh's vertex buffer data. For compact
+ * formats this computes the position quantization range from the mesh's
+ * bounding box. Must be called before the mesh's vertex data is uploaded.
+ */
+void
+vkdf_mesh_set_vertex_format(VkdfMesh *mesh, VkdfVertexFormat format)
+{
+   assert(mesh->vertex_buf.buf == 0);
+
+   mesh->vertex_format = format;
+
+   if (format == VKDF_VERTEX_FORMAT_FLOAT) {
+      mesh->pos_scale = glm::vec3(1.0f);
+      mesh->pos_offset = glm::vec3(0.0f);
+      return;
+   }
+
+   glm::vec3 min = mesh->box.min;
+   glm::vec3 max = mesh->box.max;
+   if (vkdf_box_is_empty(&mesh->box)) {
+      min = glm::vec3(0.0f);
+      max = glm::vec3(0.0f);
+   }
+
+   // Avoid dividing by zero when quantizing flat meshes
+   mesh->pos_offset = min;
+   mesh->pos_scale = max - min;
+   for (uint32_t c = 0; c < 3; c++) {
+      if (mesh->pos_scale[c] <= 0.0f)
+         mesh->pos_scale[c] = 1.0f;
+   }
+}
+
+/**
+ * Writes the mesh's vertex data to 'dst' in interleaved fashion (position,
+ * normal and uv if present) using the mesh's vertex format, which is the
+ * layout used for vertex buffers. 'dst' must have room for
+ * vkdf_mesh_get_vertex_data_size() bytes.
+ */
+void
+vkdf_mesh_copy_vertex_data(VkdfMesh *mesh, uint8_t *dst)
+{
+   uint32_t num_vertices = vkdf_mesh_get_num_vertices(mesh);
+   bool has_uv = vkdf_mesh_has_uv(mesh);
+
+   if (mesh->cached) {
+      assert(mesh->cached_vertex_data);
+
+      // Cached meshes already have their vertex data interleaved
+      if (mesh->vertex_format == VKDF_VERTEX_FORMAT_FLOAT) {
+         memcpy(dst, mesh->cached_vertex_data, get_vertex_data_size(mesh));
+         return;
+      }
+
+      uint32_t stride = get_cached_vertex_stride(mesh);
+      const uint8_t *data = mesh->cached_vertex_data;
+      vkdf_vertex_format_pack(mesh->vertex_format, num_vertices,
+                              data, stride,
+                              data + sizeof(glm::vec3), stride,
+                              has_uv ? data + 2 * sizeof(glm::vec3) : NULL,
+                              stride,
+                              mesh->pos_scale, mesh->pos_offset, dst);
+      return;
+   }
+
+   vkdf_vertex_format_pack(mesh->vertex_format, num_vertices,
+                           (const uint8_t *) mesh->vertices.data(),
+                           sizeof(glm::vec3),
+                           (const uint8_t *) mesh->normals.data(),
+                           sizeof(glm::vec3),
+                           has_uv ? (const uint8_t *) mesh->uvs.data() : NULL,
+                           sizeof(glm::vec2),
+                           mesh->pos_scale, mesh->pos_offset, dst);
+}
+
+/**
+ * Recomputes the mesh's bounding box and sphere from its vertices
+ */
+void
+vkdf_mesh_compute_bounds(VkdfMesh *mesh)
+{
+   const uint8_t *positions;
+   uint32_t stride;
+   if (!mesh->cached) {
+      positions = (const uint8_t *) mesh->vertices.data();
+      stride = sizeof(glm::vec3);
+   } else {
+      // Positions are the first attribute of each interleaved vertex
+      assert(mesh->cached_vertex_data);
+      positions = mesh->cached_vertex_data;
+      stride = get_cached_vertex_stride(mesh);
+   }
+
+   uint32_t num_vertices = vkdf_mesh_get_num_vertices(mesh);
+   vkdf_box_compute(&mesh->box, positions, stride, num_vertices);
+   vkdf_sphere_compute(&mesh->sphere, &mesh->box,
+                       positions, stride, num_vertices);
+}
+
 /**
  * Allocates a device buffer and populates it with vertex data from the
  * mesh in interleaved fashion.
@@ -154,27 +283,11 @@ vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx, VkdfMesh *mesh)
                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
-   bool has_uv = mesh->uvs.size() > 0;
-
    uint8_t *map;
    VK_CHECK(vkMapMemory(ctx->device, mesh->vertex_buf.mem,
                         0, vertex_data_size, 0, (void **) &map));
 
-   for (uint32_t i = 0; i < mesh->vertices.size(); i++) {
-      uint32_t elem_size = sizeof(mesh->vertices[0]);
-      memcpy(map, &mesh->vertices[i], elem_size);
-      map += elem_size;
-
-      elem_size = sizeof(mesh->normals[0]);
-      memcpy(map, &mesh->normals[i], elem_size);
-      map += elem_size;
-
-      if (has_uv) {
-         elem_size = sizeof(mesh->uvs[0]);
-         memcpy(map, &mesh->uvs[i], elem_size);
-         map += elem_size;
-      }
-   }
+   vkdf_mesh_copy_vertex_data(mesh, map);
 
    VkMappedMemoryRange range;
    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
@@ -185,12 +298,35 @@ vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx, VkdfMesh *mesh)
    VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
 
    vkUnmapMemory(ctx->device, mesh->vertex_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, vertex_data_size);
 }
 
 static inline VkDeviceSize
 get_index_data_size(VkdfMesh *mesh)
 {
-   return mesh->indices.size() * sizeof(uint32_t);
+   return (VkDeviceSize) vkdf_mesh_get_total_num_indices(mesh) *
+          vkdf_mesh_get_index_size(mesh);
+}
+
+/**
+ * Selects 16-bit indices for the mesh's index buffer data if all its
+ * vertices can be addressed with them. This is done automatically when
+ * the mesh's (or its model's) index buffer is filled.
+ */
+void
+vkdf_mesh_select_index_type(VkdfMesh *mesh)
+{
+   assert(mesh->index_buf.buf == 0);
+
+#if VKDF_MESH_16BIT_INDICES_ENABLE
+   if (vkdf_mesh_get_num_vertices(mesh) <= 65536)
+      mesh->index_type = VK_INDEX_TYPE_UINT16;
+   else
+      mesh->index_type = VK_INDEX_TYPE_UINT32;
+#else
+   mesh->index_type = VK_INDEX_TYPE_UINT32;
+#endif
 }
 
 VkDeviceSize
@@ -199,6 +335,50 @@ vkdf_mesh_get_index_data_size(VkdfMesh *mesh)
    return get_index_data_size(mesh);
 }
 
+static uint8_t *
+copy_indices(const uint32_t *src,
+             uint32_t num_indices,
+             VkIndexType index_type,
+             uint8_t *dst)
+{
+   if (index_type == VK_INDEX_TYPE_UINT32) {
+      memcpy(dst, src, num_indices * sizeof(uint32_t));
+      return dst + num_indices * sizeof(uint32_t);
+   }
+
+   uint16_t *dst16 = (uint16_t *) dst;
+   for (uint32_t i = 0; i < num_indices; i++) {
+      assert(src[i] <= 0xffff);
+      dst16[i] = (uint16_t) src[i];
+   }
+   return dst + num_indices * sizeof(uint16_t);
+}
+
+/**
+ * Writes the mesh's index data, including all its LODs, to 'dst' using the
+ * mesh's index type. 'dst' must have room for
+ * vkdf_mesh_get_index_data_size() bytes.
+ */
+void
+vkdf_mesh_copy_index_data(VkdfMesh *mesh, uint8_t *dst)
+{
+   if (mesh->cached) {
+      assert(mesh->cached_index_data);
+      copy_indices((const uint32_t *) mesh->cached_index_data,
+                   vkdf_mesh_get_total_num_indices(mesh),
+                   mesh->index_type, dst);
+      return;
+   }
+
+   assert(mesh->lod_indices.size() + mesh->indices.size() ==
+          vkdf_mesh_get_total_num_indices(mesh));
+
+   dst = copy_indices(mesh->indices.data(), mesh->indices.size(),
+                      mesh->index_type, dst);
+   copy_indices(mesh->lod_indices.data(), mesh->lod_indices.size(),
+                mesh->index_type, dst);
+}
+
 /**
  * Allocates a device buffer and populates it with index data from the mesh
  */
@@ -208,6 +388,8 @@ vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh)
    if (mesh->index_buf.buf != 0)
       return;
 
+   vkdf_mesh_select_index_type(mesh);
+
    VkDeviceSize index_data_size = get_index_data_size(mesh);
    assert(index_data_size > 0);
 
@@ -222,7 +404,7 @@ vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh)
    VK_CHECK(vkMapMemory(ctx->device, mesh->index_buf.mem,
                         0, index_data_size, 0, (void **) &map));
 
-   memcpy(map, &mesh->indices[0], index_data_size);
+   vkdf_mesh_copy_index_data(mesh, map);
 
    VkMappedMemoryRange range;
    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
@@ -233,4 +415,6 @@ vkdf_mesh_fill_index_buffer(VkdfContext *ctx, VkdfMesh *mesh)
    VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
 
    vkUnmapMemory(ctx->device, mesh->index_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, index_data_size);
 }
@@ -3,6 +3,8 @@
 
 #include <vector>
 
+#define VKDF_MESH_MAX_LODS 4
+
 typedef struct {
    std::vector<glm::vec3> vertices;
    std::vector<glm::vec3> normals;
@@ -10,7 +12,55 @@ typedef struct {
    std::vector<uint32_t> indices;
 
    int32_t material_idx;
-   
+
+   // Bounds of the mesh's vertices in object space. Kept up to date by
+   // vkdf_mesh_add_*_vertex(), other code that changes 'vertices' must
+   // call vkdf_mesh_compute_bounds().
+   VkdfBox box;
+   VkdfSphere sphere;
+
+   // Meshes loaded from a model cache (see vkdf-model-cache.hpp) or an
+   // asset bundle (see vkdf-bundle.hpp) don't populate the vectors above,
+   // only their vertex and index counts. Meshes from a model cache also
+   // point to their interleaved vertex data and their index data in the
+   // memory-mapped cache file. Meshes from a bundle have their data
+   // uploaded to the model's buffers when they are loaded.
+   bool cached;
+   uint32_t cached_num_vertices;
+   uint32_t cached_num_indices;
+   bool cached_has_uv;
+   const uint8_t *cached_vertex_data;
+   const uint8_t *cached_index_data;
+
+   // Layout of the mesh's vertex buffer data (see vkdf-vertex-format.hpp).
+   // pos_scale and pos_offset dequantize compact positions, they are 1 and
+   // 0 for float positions.
+   VkdfVertexFormat vertex_format;
+   glm::vec3 pos_scale;
+   glm::vec3 pos_offset;
+
+   // Type of the mesh's index buffer data. 'indices' are always 32-bit,
+   // but meshes with few enough vertices are uploaded with 16-bit indices
+   // (see vkdf_mesh_select_index_type()).
+   VkIndexType index_type;
+
+   // Levels of detail (see vkdf-mesh-lod.hpp). Level 0 is the mesh itself.
+   // Coarser levels reuse the mesh's vertices and their indices are stored
+   // after level 0's in the mesh's index data (in 'lod_indices' for meshes
+   // that are not cached): level 'l' draws lod_num_indices[l] indices
+   // starting at index lod_first_index[l]. lod_error[l] is the
+   // simplification error of level 'l' in object-space units. Entries for
+   // level 0 are not used, see the vkdf_mesh_get_lod_*() helpers.
+   uint32_t num_lods;
+   uint32_t lod_first_index[VKDF_MESH_MAX_LODS];
+   uint32_t lod_num_indices[VKDF_MESH_MAX_LODS];
+   float lod_error[VKDF_MESH_MAX_LODS];
+   std::vector<uint32_t> lod_indices;
+
+   // Meshlets of level 0 (see vkdf-meshlet.hpp). Meshes from a model cache
+   // or a bundle also have them.
+   std::vector<VkdfMeshlet> meshlets;
+
    VkdfBuffer vertex_buf;
    VkdfBuffer index_buf;
 } VkdfMesh;
@@ -31,6 +81,8 @@ vkdf_mesh_add_solid_vertex(VkdfMesh *mesh,
 {
    mesh->vertices.push_back(pos);
    mesh->normals.push_back(normal);
+   vkdf_box_add_point(&mesh->box, pos);
+   vkdf_sphere_add_point(&mesh->sphere, pos);
 }
 
 inline void
@@ -42,11 +94,94 @@ vkdf_mesh_add_textured_vertex(VkdfMesh *mesh,
    mesh->vertices.push_back(pos);
    mesh->normals.push_back(normal);
    mesh->uvs.push_back(uv);
+   vkdf_box_add_point(&mesh->box, pos);
+   vkdf_sphere_add_point(&mesh->sphere, pos);
+}
+
+inline uint32_t
+vkdf_mesh_get_num_vertices(VkdfMesh *mesh)
+{
+   return mesh->cached ? mesh->cached_num_vertices : mesh->vertices.size();
+}
+
+inline uint32_t
+vkdf_mesh_get_num_indices(VkdfMesh *mesh)
+{
+   return mesh->cached ? mesh->cached_num_indices : mesh->indices.size();
+}
+
+inline uint32_t
+vkdf_mesh_get_lod_first_index(VkdfMesh *mesh, uint32_t lod)
+{
+   assert(lod < mesh->num_lods);
+   return lod == 0 ? 0 : mesh->lod_first_index[lod];
+}
+
+inline uint32_t
+vkdf_mesh_get_lod_num_indices(VkdfMesh *mesh, uint32_t lod)
+{
+   assert(lod < mesh->num_lods);
+   return lod == 0 ? vkdf_mesh_get_num_indices(mesh) :
+                     mesh->lod_num_indices[lod];
+}
+
+inline float
+vkdf_mesh_get_lod_error(VkdfMesh *mesh, uint32_t lod)
+{
+   assert(lod < mesh->num_lods);
+   return lod == 0 ? 0.0f : mesh->lod_error[lod];
 }
 
+// Number of indices in the mesh's index data, including all its LODs
+inline uint32_t
+vkdf_mesh_get_total_num_indices(VkdfMesh *mesh)
+{
+   uint32_t last = mesh->num_lods - 1;
+   return vkdf_mesh_get_lod_first_index(mesh, last) +
+          vkdf_mesh_get_lod_num_indices(mesh, last);
+}
+
+inline bool
+vkdf_mesh_has_uv(VkdfMesh *mesh)
+{
+   return mesh->cached ? mesh->cached_has_uv : mesh->uvs.size() > 0;
+}
+
+inline uint32_t
+vkdf_mesh_get_vertex_stride(VkdfMesh *mesh)
+{
+   return vkdf_vertex_format_get_stride(mesh->vertex_format,
+                                        vkdf_mesh_has_uv(mesh));
+}
+
+void
+vkdf_mesh_set_vertex_format(VkdfMesh *mesh, VkdfVertexFormat format);
+
+inline uint32_t
+vkdf_mesh_get_index_size(VkdfMesh *mesh)
+{
+   return mesh->index_type == VK_INDEX_TYPE_UINT16 ?
+      sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void
+vkdf_mesh_select_index_type(VkdfMesh *mesh);
+
 VkDeviceSize
 vkdf_mesh_get_vertex_data_size(VkdfMesh *mesh);
 
+void
+vkdf_mesh_copy_vertex_data(VkdfMesh *mesh, uint8_t *dst);
+
+void
+vkdf_mesh_copy_index_data(VkdfMesh *mesh, uint8_t *dst);
+
+void
+vkdf_mesh_compute_bounds(VkdfMesh *mesh);
+
+void
+vkdf_mesh_build_meshlets(VkdfMesh *mesh);
+
 void
 vkdf_mesh_fill_vertex_buffer(VkdfContext *ctx, VkdfMesh *mesh);
 
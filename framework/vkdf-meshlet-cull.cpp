@@ -0,0 +1,423 @@
+#include "vkdf.hpp"
+
+// Bindings 0-1: frustum and view UBOs, bindings 2-8: meshlets, meshlet
+// draws, object matrices, culled draws, instance IDs, commands and counts
+#define NUM_BINDINGS 9
+
+static inline VkDescriptorType
+get_binding_type(uint32_t binding)
+{
+   return binding < 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
+static VkDescriptorSetLayout
+create_set_layout(VkdfContext *ctx)
+{
+   VkDescriptorSetLayoutBinding bindings[NUM_BINDINGS];
+   for (uint32_t i = 0; i < NUM_BINDINGS; i++) {
+      bindings[i].binding = i;
+      bindings[i].descriptorType = get_binding_type(i);
+      bindings[i].descriptorCount = 1;
+      bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+      bindings[i].pImmutableSamplers = NULL;
+   }
+
+   VkDescriptorSetLayoutCreateInfo set_layout_info;
+   set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+   set_layout_info.pNext = NULL;
+   set_layout_info.bindingCount = NUM_BINDINGS;
+   set_layout_info.pBindings = bindings;
+   set_layout_info.flags = 0;
+
+   VkDescriptorSetLayout set_layout;
+   VK_CHECK(vkCreateDescriptorSetLayout(ctx->device,
+                                        &set_layout_info,
+                                        NULL,
+                                        &set_layout));
+   return set_layout;
+}
+
+static VkDescriptorPool
+create_pool(VkdfContext *ctx)
+{
+   VkDescriptorPoolSize type_count[2];
+   type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   type_count[0].descriptorCount = 2;
+   type_count[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+   type_count[1].descriptorCount = NUM_BINDINGS - 2;
+
+   VkDescriptorPoolCreateInfo pool_ci;
+   pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+   pool_ci.pNext = NULL;
+   pool_ci.maxSets = 1;
+   pool_ci.poolSizeCount = 2;
+   pool_ci.pPoolSizes = type_count;
+   pool_ci.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+   VkDescriptorPool pool;
+   VK_CHECK(vkCreateDescriptorPool(ctx->device, &pool_ci, NULL, &pool));
+
+   return pool;
+}
+
+static void
+create_descriptor_set(VkdfContext *ctx,
+                      VkdfMeshletCull *mc,
+                      VkdfModel *model,
+                      VkdfBuffer *matrix_buf)
+{
+   mc->set_layout = create_set_layout(ctx);
+   mc->pool = create_pool(ctx);
+
+   VkDescriptorSetAllocateInfo alloc_info;
+   alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+   alloc_info.pNext = NULL;
+   alloc_info.descriptorPool = mc->pool;
+   alloc_info.descriptorSetCount = 1;
+   alloc_info.pSetLayouts = &mc->set_layout;
+   VK_CHECK(vkAllocateDescriptorSets(ctx->device, &alloc_info, &mc->set));
+
+   const VkBuffer bufs[NUM_BINDINGS] = {
+      mc->cull->frustum_buf.buf,
+      mc->view_buf.buf,
+      model->meshlet_buf.buf,
+      mc->draw_buf.buf,
+      matrix_buf->buf,
+      mc->cull->draw_buf.buf,
+      mc->cull->instance_buf.buf,
+      mc->cmd_buf.buf,
+      mc->count_buf.buf,
+   };
+
+   VkDescriptorBufferInfo buf_info[NUM_BINDINGS];
+   VkWriteDescriptorSet writes[NUM_BINDINGS];
+   for (uint32_t i = 0; i < NUM_BINDINGS; i++) {
+      buf_info[i].buffer = bufs[i];
+      buf_info[i].offset = 0;
+      buf_info[i].range = VK_WHOLE_SIZE;
+
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].pNext = NULL;
+      writes[i].dstSet = mc->set;
+      writes[i].dstBinding = i;
+      writes[i].dstArrayElement = 0;
+      writes[i].descriptorCount = 1;
+      writes[i].descriptorType = get_binding_type(i);
+      writes[i].pImageInfo = NULL;
+      writes[i].pBufferInfo = &buf_info[i];
+      writes[i].pTexelBufferView = NULL;
+   }
+
+   vkUpdateDescriptorSets(ctx->device, NUM_BINDINGS, writes, 0, NULL);
+}
+
+static void
+create_pipeline(VkdfContext *ctx,
+                VkdfMeshletCull *mc,
+                VkShaderModule cs_module)
+{
+   VkPipelineLayoutCreateInfo pipeline_layout_info;
+   pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+   pipeline_layout_info.pNext = NULL;
+   pipeline_layout_info.pushConstantRangeCount = 0;
+   pipeline_layout_info.pPushConstantRanges = NULL;
+   pipeline_layout_info.setLayoutCount = 1;
+   pipeline_layout_info.pSetLayouts = &mc->set_layout;
+   pipeline_layout_info.flags = 0;
+
+   VK_CHECK(vkCreatePipelineLayout(ctx->device,
+                                   &pipeline_layout_info,
+                                   NULL,
+                                   &mc->pipeline_layout));
+
+   VkComputePipelineCreateInfo pipeline_info;
+   pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+   pipeline_info.pNext = NULL;
+   pipeline_info.flags = 0;
+   pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+   pipeline_info.stage.pNext = NULL;
+   pipeline_info.stage.flags = 0;
+   pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+   pipeline_info.stage.module = cs_module;
+   pipeline_info.stage.pName = "main";
+   pipeline_info.stage.pSpecializationInfo = NULL;
+   pipeline_info.layout = mc->pipeline_layout;
+   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+   pipeline_info.basePipelineIndex = -1;
+
+   VK_CHECK(vkCreateComputePipelines(ctx->device, NULL, 1, &pipeline_info,
+                                     NULL, &mc->pipeline));
+}
+
+/**
+ * Whether the device can draw the culled meshlets. Every surviving meshlet
+ * is a separate indirect draw that takes its object index through
+ * firstInstance.
+ */
+bool
+vkdf_meshlet_cull_is_supported(VkdfContext *ctx)
+{
+   return ctx->device_features.multiDrawIndirect &&
+          ctx->device_features.drawIndirectFirstInstance;
+}
+
+/**
+ * Creates the buffers and the compute pipeline to cull the meshlets of
+ * 'num_draws' meshlet draws. Meshlet draw 'd' tests the meshlets of mesh
+ * 'mesh_idxs[d]' of 'model', transformed by 'transforms[d]', for each
+ * visible instance of draw 'cull_draws[d]' of 'cull', which must draw the
+ * mesh's full-detail index range. Meshes without meshlets have nothing to
+ * draw.
+ *
+ * 'matrix_buf' is a storage buffer with the model matrix of each of the
+ * culled objects. The model's meshlet buffer is created if needed, see
+ * vkdf_model_fill_meshlet_buffer().
+ */
+VkdfMeshletCull *
+vkdf_meshlet_cull_new(VkdfContext *ctx,
+                      VkShaderModule cs_module,
+                      VkdfGpuCull *cull,
+                      VkdfModel *model,
+                      VkdfBuffer *matrix_buf,
+                      uint32_t num_draws,
+                      const uint32_t *cull_draws,
+                      const uint32_t *mesh_idxs,
+                      const glm::mat4 *transforms)
+{
+   assert(vkdf_meshlet_cull_is_supported(ctx));
+   assert(num_draws > 0);
+
+   VkdfMeshletCull *mc = g_new0(VkdfMeshletCull, 1);
+   mc->cull = cull;
+   mc->num_draws = num_draws;
+
+   vkdf_model_fill_meshlet_buffer(ctx, model);
+
+   // Every meshlet of every object may survive, so each draw gets room for
+   // as many commands
+   uint32_t num_cmds = 0;
+   mc->draws = g_new0(VkdfMeshletCullDraw, num_draws);
+   for (uint32_t d = 0; d < num_draws; d++) {
+      assert(cull_draws[d] < cull->num_draws);
+      assert(mesh_idxs[d] < model->meshes.size());
+
+      VkdfMeshletCullDraw *draw = &mc->draws[d];
+      draw->transform = transforms[d];
+      draw->cull_draw = cull_draws[d];
+      draw->first_meshlet = model->meshlet_offsets[mesh_idxs[d]];
+      draw->num_meshlets = model->meshes[mesh_idxs[d]]->meshlets.size();
+      draw->first_cmd = num_cmds;
+
+      num_cmds += cull->num_objects * draw->num_meshlets;
+      mc->max_meshlets = MAX(mc->max_meshlets, draw->num_meshlets);
+   }
+
+   assert(num_cmds > 0);
+
+   VkDeviceSize draws_size = num_draws * sizeof(VkdfMeshletCullDraw);
+   mc->draw_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         draws_size,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   vkdf_buffer_map_and_fill(ctx, mc->draw_buf, 0, draws_size, mc->draws);
+
+   mc->view_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         sizeof(glm::vec4),
+                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VK_CHECK(vkMapMemory(ctx->device, mc->view_buf.mem,
+                        0, VK_WHOLE_SIZE, 0, (void **) &mc->view_map));
+   memset(mc->view_map, 0, sizeof(glm::vec4));
+
+   mc->cmd_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         (VkDeviceSize) num_cmds *
+                            sizeof(VkDrawIndexedIndirectCommand),
+                         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   mc->count_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         num_draws * sizeof(uint32_t),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+   create_descriptor_set(ctx, mc, model, matrix_buf);
+   create_pipeline(ctx, mc, cs_module);
+
+   return mc;
+}
+
+void
+vkdf_meshlet_cull_free(VkdfContext *ctx, VkdfMeshletCull *mc)
+{
+   vkDestroyPipeline(ctx->device, mc->pipeline, NULL);
+   vkDestroyPipelineLayout(ctx->device, mc->pipeline_layout, NULL);
+   vkFreeDescriptorSets(ctx->device, mc->pool, 1, &mc->set);
+   vkDestroyDescriptorSetLayout(ctx->device, mc->set_layout, NULL);
+   vkDestroyDescriptorPool(ctx->device, mc->pool, NULL);
+
+   vkUnmapMemory(ctx->device, mc->view_buf.mem);
+
+   vkdf_destroy_buffer(ctx, &mc->view_buf);
+   vkdf_destroy_buffer(ctx, &mc->draw_buf);
+   vkdf_destroy_buffer(ctx, &mc->cmd_buf);
+   vkdf_destroy_buffer(ctx, &mc->count_buf);
+
+   g_free(mc->draws);
+   g_free(mc);
+}
+
+/**
+ * Uploads the world-space camera position used by the cone test. Like
+ * vkdf_gpu_cull_update(), must be called before submitting command
+ * buffers with the commands recorded by vkdf_meshlet_cull_cmd_dispatch().
+ */
+void
+vkdf_meshlet_cull_update(VkdfContext *ctx,
+                         VkdfMeshletCull *mc,
+                         const glm::vec3 &view_pos)
+{
+   glm::vec4 pos = glm::vec4(view_pos, 1.0f);
+   memcpy(mc->view_map, &pos[0], sizeof(pos));
+
+   VkMappedMemoryRange range =
+      vkdf_buffer_get_flush_range(ctx, &mc->view_buf, 0, sizeof(pos));
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, sizeof(pos));
+}
+
+/**
+ * Records a meshlet culling pass for the objects found visible by the
+ * last culling pass recorded with vkdf_gpu_cull_cmd_dispatch(): resets the
+ * draw commands, runs the compute shader and makes its results visible to
+ * indirect draws. Must be recorded outside of a render pass, after the
+ * VkdfGpuCull pass and before the draws that use the results.
+ */
+void
+vkdf_meshlet_cull_cmd_dispatch(VkdfMeshletCull *mc, VkCommandBuffer cmd_buf)
+{
+   // Wait for the VkdfGpuCull pass's results, and for the draws of the
+   // previous pass to read our commands before overwriting them
+   VkBufferMemoryBarrier cull_barriers[2];
+   cull_barriers[0] =
+      vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT,
+                                 mc->cull->draw_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+   cull_barriers[1] =
+      vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT,
+                                 mc->cull->instance_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT |
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        2, cull_barriers,
+                        0, NULL);
+
+   // Commands past the ones appended by the shader draw nothing
+   vkCmdFillBuffer(cmd_buf, mc->cmd_buf.buf, 0, VK_WHOLE_SIZE, 0);
+   vkCmdFillBuffer(cmd_buf, mc->count_buf.buf, 0, VK_WHOLE_SIZE, 0);
+
+   VkBufferMemoryBarrier reset_barriers[2];
+   reset_barriers[0] =
+      vkdf_create_buffer_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+                                 VK_ACCESS_SHADER_WRITE_BIT,
+                                 mc->cmd_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+   reset_barriers[1] =
+      vkdf_create_buffer_barrier(VK_ACCESS_TRANSFER_WRITE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT |
+                                 VK_ACCESS_SHADER_WRITE_BIT,
+                                 mc->count_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        0, NULL,
+                        2, reset_barriers,
+                        0, NULL);
+
+   vkdf_cmd_bind_pipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          mc->pipeline);
+   vkdf_cmd_bind_descriptor_sets(cmd_buf,
+                                 VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 mc->pipeline_layout,
+                                 0, 1, &mc->set,
+                                 0, NULL);
+   vkCmdDispatch(cmd_buf,
+                 (mc->max_meshlets + VKDF_MESHLET_CULL_GROUP_SIZE - 1) /
+                    VKDF_MESHLET_CULL_GROUP_SIZE,
+                 mc->cull->num_objects,
+                 mc->num_draws);
+
+   VkBufferMemoryBarrier result_barrier =
+      vkdf_create_buffer_barrier(VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                                 mc->cmd_buf.buf,
+                                 0, VK_WHOLE_SIZE);
+
+   vkCmdPipelineBarrier(cmd_buf,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                        0,
+                        0, NULL,
+                        1, &result_barrier,
+                        0, NULL);
+}
+
+/**
+ * Records the culled meshlets of meshlet draw 'draw' and binds the
+ * VkdfGpuCull instance ID list to vertex binding 'instance_binding'. The
+ * pipeline, the mesh's index buffer and the rest of the vertex buffers
+ * must be bound by the caller.
+ */
+void
+vkdf_meshlet_cull_cmd_draw(VkdfContext *ctx,
+                           VkdfMeshletCull *mc,
+                           VkCommandBuffer cmd_buf,
+                           uint32_t instance_binding,
+                           uint32_t draw)
+{
+   assert(draw < mc->num_draws);
+
+   const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+   const uint32_t max_count =
+      ctx->phy_device_props.limits.maxDrawIndirectCount;
+
+   uint32_t first_cmd = mc->draws[draw].first_cmd;
+   uint32_t num_cmds = mc->cull->num_objects * mc->draws[draw].num_meshlets;
+   if (num_cmds == 0)
+      return;
+
+   VkDeviceSize offset = 0;
+   vkdf_cmd_bind_vertex_buffers(cmd_buf, instance_binding, 1,
+                                &mc->cull->instance_buf.buf, &offset);
+
+   for (uint32_t c = 0; c < num_cmds; c += max_count) {
+      vkdf_cmd_draw_indexed_indirect(cmd_buf,
+                                     mc->cmd_buf.buf,
+                                     (VkDeviceSize) (first_cmd + c) * stride,
+                                     MIN(num_cmds - c, max_count),
+                                     stride);
+   }
+}
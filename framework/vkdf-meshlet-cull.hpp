@@ -0,0 +1,150 @@
+#ifndef __VKDF_MESHLET_CULL_H__
+#define __VKDF_MESHLET_CULL_H__
+
+/**
+ * GPU meshlet culling on top of VkdfGpuCull.
+ *
+ * Each meshlet draw tests the meshlets of one mesh (see vkdf-meshlet.hpp)
+ * for every visible instance of one of the VkdfGpuCull draws, usually the
+ * full-detail draw of that mesh. After each vkdf_gpu_cull_cmd_dispatch(),
+ * vkdf_meshlet_cull_cmd_dispatch() runs a compute shader that culls the
+ * meshlets of the visible objects against the view frustum, using their
+ * bounding spheres, and for facing away from the viewer, using their
+ * normal cones like vkdf_meshlet_is_backfacing(). The index ranges of the
+ * meshlets that survive are appended to a list of
+ * VkDrawIndexedIndirectCommand per meshlet draw, and the rest of the list
+ * is left with zero instances, so vkdf_meshlet_cull_cmd_draw() can draw it
+ * with a fixed draw count.
+ *
+ * Meshlets are tested in world space, transforming their bounds with the
+ * object's model matrix times the draw's mesh transform. The cone test is
+ * only exact if these don't scale non-uniformly or shear.
+ *
+ * Each surviving meshlet is drawn as one instance whose instance ID is the
+ * object's index, read from the VkdfGpuCull instance ID list, so vertex
+ * shaders written for vkdf_gpu_cull_cmd_draw() work unchanged. This needs
+ * the multiDrawIndirect and drawIndirectFirstInstance features (see
+ * vkdf_meshlet_cull_is_supported()).
+ *
+ * The compute shader is provided by the application and must match this
+ * interface (see demos/model/meshlet-cull.comp):
+ *
+ *    layout(local_size_x = VKDF_MESHLET_CULL_GROUP_SIZE) in;
+ *
+ *    // The VkdfGpuCull frustum UBO
+ *    layout(std140, set = 0, binding = 0) uniform frustum_ubo {
+ *       vec4 planes[6];
+ *       uvec4 counts;      // x: number of objects, y: number of draws
+ *       mat4 view_proj;
+ *    };
+ *
+ *    layout(std140, set = 0, binding = 1) uniform view_ubo {
+ *       vec4 view_pos;     // World-space camera position
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 2) readonly buffer meshlets_ssbo {
+ *       VkdfMeshlet meshlets[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 3) readonly buffer draws_ssbo {
+ *       VkdfMeshletCullDraw draws[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 4) readonly buffer matrices_ssbo {
+ *       mat4 model[];      // Model matrix of each object
+ *    };
+ *
+ *    // The VkdfGpuCull draw arguments and instance ID list
+ *    layout(std430, set = 0, binding = 5) readonly buffer cull_draws_ssbo {
+ *       VkDrawIndexedIndirectCommand cull_draws[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 6) readonly buffer ids_ssbo {
+ *       uint ids[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 7) writeonly buffer cmds_ssbo {
+ *       VkDrawIndexedIndirectCommand cmds[];
+ *    };
+ *
+ *    layout(std430, set = 0, binding = 8) buffer counts_ssbo {
+ *       uint num_cmds[];   // Commands appended to each meshlet draw
+ *    };
+ *
+ * The shader is dispatched with one invocation per meshlet along X, one
+ * work group per possibly visible object along Y and one per meshlet draw
+ * along Z.
+ */
+
+#define VKDF_MESHLET_CULL_GROUP_SIZE 64
+
+// Same layout as the meshlet draws in the compute shader's storage buffer
+typedef struct {
+   glm::mat4 transform;      // From mesh space to object space
+
+   uint32_t cull_draw;       // VkdfGpuCull draw with the objects to test
+   uint32_t first_meshlet;   // In the model's meshlet buffer
+   uint32_t num_meshlets;
+   uint32_t first_cmd;       // Of the draw's commands in 'cmd_buf'
+} VkdfMeshletCullDraw;
+
+typedef struct {
+   VkdfGpuCull *cull;
+   uint32_t num_draws;
+   uint32_t max_meshlets;
+
+   // The commands of draw 'd' are [draws[d].first_cmd, draws[d].first_cmd
+   // + num_objects * draws[d].num_meshlets)
+   VkdfMeshletCullDraw *draws;
+
+   // Camera position, kept mapped
+   VkdfBuffer view_buf;
+   uint8_t *view_map;
+
+   VkdfBuffer draw_buf;
+
+   // Draw commands and per-draw command counts written by the compute
+   // shader
+   VkdfBuffer cmd_buf;
+   VkdfBuffer count_buf;
+
+   VkDescriptorPool pool;
+   VkDescriptorSetLayout set_layout;
+   VkDescriptorSet set;
+   VkPipelineLayout pipeline_layout;
+   VkPipeline pipeline;
+} VkdfMeshletCull;
+
+bool
+vkdf_meshlet_cull_is_supported(VkdfContext *ctx);
+
+VkdfMeshletCull *
+vkdf_meshlet_cull_new(VkdfContext *ctx,
+                      VkShaderModule cs_module,
+                      VkdfGpuCull *cull,
+                      VkdfModel *model,
+                      VkdfBuffer *matrix_buf,
+                      uint32_t num_draws,
+                      const uint32_t *cull_draws,
+                      const uint32_t *mesh_idxs,
+                      const glm::mat4 *transforms);
+
+void
+vkdf_meshlet_cull_free(VkdfContext *ctx, VkdfMeshletCull *mc);
+
+void
+vkdf_meshlet_cull_update(VkdfContext *ctx,
+                         VkdfMeshletCull *mc,
+                         const glm::vec3 &view_pos);
+
+void
+vkdf_meshlet_cull_cmd_dispatch(VkdfMeshletCull *mc, VkCommandBuffer cmd_buf);
+
+void
+vkdf_meshlet_cull_cmd_draw(VkdfContext *ctx,
+                           VkdfMeshletCull *mc,
+                           VkCommandBuffer cmd_buf,
+                           uint32_t instance_binding,
+                           uint32_t draw);
+
+#endif
@@ -0,0 +1,119 @@
+#include "vkdf.hpp"
+
+static void
+finish_meshlet(VkdfMesh *mesh,
+               uint32_t first_index,
+               uint32_t num_indices,
+               std::vector<glm::vec3> &positions)
+{
+   const uint32_t *indices = &mesh->indices[first_index];
+   const glm::vec3 *vertices = mesh->vertices.data();
+
+   VkdfMeshlet meshlet;
+   memset(&meshlet, 0, sizeof(meshlet));
+   meshlet.first_index = first_index;
+   meshlet.num_indices = num_indices;
+
+   // Bounding sphere. Vertices shared by several triangles are visited
+   // more than once, which doesn't change the result.
+   positions.resize(num_indices);
+   for (uint32_t i = 0; i < num_indices; i++)
+      positions[i] = vertices[indices[i]];
+
+   VkdfBox box;
+   VkdfSphere sphere;
+   vkdf_box_compute(&box, (const uint8_t *) positions.data(),
+                    sizeof(glm::vec3), num_indices);
+   vkdf_sphere_compute(&sphere, &box, (const uint8_t *) positions.data(),
+                       sizeof(glm::vec3), num_indices);
+   meshlet.sphere = glm::vec4(sphere.center, sphere.radius);
+
+   // Normal cone: the average of the triangle normals as axis, and the
+   // widest angle between the axis and any of them. We can only cull if
+   // all the normals are within 90 degrees of the axis, in which case the
+   // cutoff is the sine of that angle.
+   glm::vec3 axis = glm::vec3(0.0f);
+   for (uint32_t i = 0; i < num_indices; i += 3) {
+      const glm::vec3 &p0 = vertices[indices[i + 0]];
+      glm::vec3 n = glm::cross(vertices[indices[i + 1]] - p0,
+                               vertices[indices[i + 2]] - p0);
+      float len = glm::length(n);
+      if (len > 0.0f)
+         axis += n / len;
+   }
+
+   float axis_len = glm::length(axis);
+   float min_dot = -1.0f;
+   if (axis_len > 0.0f) {
+      axis /= axis_len;
+      min_dot = 1.0f;
+      for (uint32_t i = 0; i < num_indices; i += 3) {
+         const glm::vec3 &p0 = vertices[indices[i + 0]];
+         glm::vec3 n = glm::cross(vertices[indices[i + 1]] - p0,
+                                  vertices[indices[i + 2]] - p0);
+         float len = glm::length(n);
+         if (len > 0.0f)
+            min_dot = MIN(min_dot, glm::dot(axis, n / len));
+      }
+   }
+
+   if (min_dot <= 0.0f)
+      meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 2.0f);
+   else
+      meshlet.cone = glm::vec4(axis, sqrtf(1.0f - min_dot * min_dot));
+
+   mesh->meshlets.push_back(meshlet);
+}
+
+/**
+ * Splits the mesh's level 0 triangle list into meshlets (see
+ * vkdf-meshlet.hpp), replacing any meshlets it had
+ */
+void
+vkdf_mesh_build_meshlets(VkdfMesh *mesh)
+{
+   VKDF_TRACE_SCOPE("vkdf_mesh_build_meshlets");
+
+   assert(!mesh->cached);
+
+   mesh->meshlets.clear();
+
+   uint32_t num_indices = mesh->indices.size();
+   if (num_indices == 0 || num_indices % 3 != 0)
+      return;
+
+   const uint32_t *indices = mesh->indices.data();
+
+   // Tags each vertex with the last meshlet it was added to
+   std::vector<uint32_t> vertex_meshlet(mesh->vertices.size(), UINT32_MAX);
+   std::vector<glm::vec3> positions;
+   uint32_t meshlet_idx = 0;
+   uint32_t first_index = 0;
+   uint32_t num_vertices = 0;
+
+   for (uint32_t i = 0; i < num_indices; i += 3) {
+      uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+      uint32_t new_vertices = (vertex_meshlet[a] != meshlet_idx) +
+                              (vertex_meshlet[b] != meshlet_idx && b != a) +
+                              (vertex_meshlet[c] != meshlet_idx &&
+                               c != a && c != b);
+      uint32_t num_triangles = (i - first_index) / 3;
+
+      if (num_vertices + new_vertices > VKDF_MESHLET_MAX_VERTICES ||
+          num_triangles + 1 > VKDF_MESHLET_MAX_TRIANGLES) {
+         finish_meshlet(mesh, first_index, i - first_index, positions);
+         meshlet_idx++;
+         first_index = i;
+         num_vertices = 0;
+         new_vertices = 1 + (b != a) + (c != a && c != b);
+      }
+
+      vertex_meshlet[a] = meshlet_idx;
+      vertex_meshlet[b] = meshlet_idx;
+      vertex_meshlet[c] = meshlet_idx;
+      num_vertices += new_vertices;
+   }
+
+   finish_meshlet(mesh, first_index, num_indices - first_index, positions);
+}
@@ -0,0 +1,66 @@
+#ifndef __VKDF_MESHLET_H__
+#define __VKDF_MESHLET_H__
+
+/**
+ * Meshlets: small clusters of consecutive triangles of a mesh, each with
+ * its own bounding sphere and normal cone, so whole clusters can be culled
+ * against the view frustum or for facing away from the viewer.
+ *
+ * vkdf-meshlet-cull.hpp culls them on the GPU for the objects that
+ * VkdfGpuCull finds visible.
+ *
+ * vkdf_mesh_build_meshlets() splits the mesh's triangle list (level 0
+ * only) into runs of at most VKDF_MESHLET_MAX_VERTICES unique vertices and
+ * VKDF_MESHLET_MAX_TRIANGLES triangles, in index order. Meshes are usually
+ * optimized for vertex cache locality first, which keeps runs compact.
+ * Since meshlets are plain index ranges of the mesh, drawing the surviving
+ * ones only needs an indexed draw per meshlet (or an indirect draw buffer
+ * with one command per meshlet) with the mesh's index buffer bound.
+ *
+ * The layout of VkdfMeshlet matches std430 so an array of them can be
+ * read from shaders as-is (see vkdf_model_fill_meshlet_buffer()):
+ *
+ *    struct Meshlet {
+ *       vec4 sphere;
+ *       vec4 cone;
+ *       uint first_index;
+ *       uint num_indices;
+ *       uint pad[2];
+ *    };
+ */
+
+#define VKDF_MESHLET_MAX_VERTICES  64
+#define VKDF_MESHLET_MAX_TRIANGLES 124
+
+typedef struct {
+   // Bounding sphere: center (xyz) and radius (w) in mesh space
+   glm::vec4 sphere;
+
+   // Normal cone: axis (xyz) and cutoff (w), see
+   // vkdf_meshlet_is_backfacing(). A cutoff larger than 1 means the
+   // meshlet's triangles face too many directions to ever be culled.
+   glm::vec4 cone;
+
+   // Index range, relative to the start of the mesh's index data
+   uint32_t first_index;
+   uint32_t num_indices;
+
+   uint32_t pad[2];
+} VkdfMeshlet;
+
+/**
+ * Whether all triangles in the meshlet face away from 'view_pos' (in mesh
+ * space), assuming counter-clockwise front faces. Conservative: it can
+ * return false for back-facing meshlets, never true for visible ones.
+ */
+inline bool
+vkdf_meshlet_is_backfacing(const VkdfMeshlet *meshlet,
+                           const glm::vec3 &view_pos)
+{
+   glm::vec3 d = glm::vec3(meshlet->sphere) - view_pos;
+   float dist = glm::length(d);
+   return glm::dot(d, glm::vec3(meshlet->cone)) >=
+          meshlet->cone.w * dist + meshlet->sphere.w;
+}
+
+#endif
@@ -0,0 +1,461 @@
+#include "vkdf.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC     0x4d464456 // "VDFM"
+#define CACHE_VERSION   6
+
+#define CACHE_MESH_HAS_UV (1 << 0)
+
+// Framework options that change the imported data
+#define CACHE_OPTION_OPTIMIZED (1 << 0)
+#define CACHE_OPTION_MESHLETS  (1 << 1)
+#define CACHE_OPTION_NUM_LODS_SHIFT 8
+
+static const uint32_t cache_options =
+   (VKDF_MODEL_OPTIMIZE_ENABLE ? CACHE_OPTION_OPTIMIZED : 0) |
+   (VKDF_MODEL_MESHLETS_ENABLE ? CACHE_OPTION_MESHLETS : 0) |
+   (VKDF_MODEL_NUM_LODS << CACHE_OPTION_NUM_LODS_SHIFT);
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t import_flags;
+   uint32_t options;
+   int64_t source_mtime_ns;
+   int64_t source_size;
+   uint32_t num_materials;
+   uint32_t num_meshes;
+   uint32_t num_instances;
+   uint32_t num_meshlets;
+   uint64_t materials_offset;
+   uint64_t meshes_offset;
+   uint64_t instances_offset;
+   uint64_t meshlets_offset;
+   uint64_t vertex_data_offset;
+   uint64_t vertex_data_size;
+   uint64_t index_data_offset;
+   uint64_t index_data_size;
+   float box_min[3];
+   float box_max[3];
+} CacheHeader;
+
+typedef struct {
+   uint32_t num_vertices;
+   uint32_t num_indices;      // Level 0 only
+   int32_t material_idx;
+   uint32_t flags;
+   uint64_t vertex_offset;    // From the start of the vertex data
+   uint64_t index_offset;     // From the start of the index data
+   float box_min[3];
+   float box_max[3];
+   float sphere[4];           // Center and radius
+   uint32_t num_lods;
+   uint32_t lod_first_index[VKDF_MESH_MAX_LODS];
+   uint32_t lod_num_indices[VKDF_MESH_MAX_LODS];
+   float lod_error[VKDF_MESH_MAX_LODS];
+   uint32_t first_meshlet;    // In the meshlet table
+   uint32_t num_meshlets;
+} CacheMesh;
+
+typedef struct {
+   float transform[16];       // Column-major
+   uint32_t mesh_idx;
+   uint32_t pad;
+} CacheInstance;
+
+static inline uint64_t
+align_offset(uint64_t offset, uint64_t align)
+{
+   return (offset + align - 1) & ~(align - 1);
+}
+
+static bool
+get_source_info(const char *file, int64_t *mtime_ns, int64_t *size)
+{
+   struct stat st;
+   if (stat(file, &st) != 0)
+      return false;
+
+   *mtime_ns = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+   *size = st.st_size;
+   return true;
+}
+
+/**
+ * Returns the path of the cache file for the model at 'file'. The caller
+ * takes ownership of the returned string.
+ */
+char *
+vkdf_model_cache_get_path(const char *file)
+{
+   char *abs_path = g_canonicalize_filename(file, NULL);
+   char *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, abs_path, -1);
+   char *name = g_strdup_printf("%s.vkdfm", hash);
+   char *path = g_build_filename(g_get_user_cache_dir(),
+                                 "vkdf", "models", name, NULL);
+   g_free(name);
+   g_free(hash);
+   g_free(abs_path);
+
+   return path;
+}
+
+static bool
+validate_header(const CacheHeader *header,
+                size_t file_size,
+                uint32_t import_flags,
+                int64_t source_mtime_ns,
+                int64_t source_size)
+{
+   if (header->magic != CACHE_MAGIC ||
+       header->version != CACHE_VERSION ||
+       header->import_flags != import_flags ||
+       header->options != cache_options ||
+       header->source_mtime_ns != source_mtime_ns ||
+       header->source_size != source_size) {
+      return false;
+   }
+
+   // Make sure that a truncated or corrupt file can't make us read past
+   // the end of the mapping
+   if (header->materials_offset +
+          header->num_materials * sizeof(VkdfMaterial) > file_size ||
+       header->meshes_offset +
+          header->num_meshes * sizeof(CacheMesh) > file_size ||
+       header->instances_offset +
+          header->num_instances * sizeof(CacheInstance) > file_size ||
+       header->meshlets_offset +
+          header->num_meshlets * sizeof(VkdfMeshlet) > file_size ||
+       header->vertex_data_offset + header->vertex_data_size > file_size ||
+       header->index_data_offset + header->index_data_size > file_size) {
+      return false;
+   }
+
+   return true;
+}
+
+static bool
+validate_mesh(const CacheHeader *header, const CacheMesh *mesh)
+{
+   uint32_t vertex_size = 2 * sizeof(glm::vec3) +
+      ((mesh->flags & CACHE_MESH_HAS_UV) ? sizeof(glm::vec2) : 0);
+
+   if (mesh->num_lods < 1 || mesh->num_lods > VKDF_MESH_MAX_LODS)
+      return false;
+
+   if ((uint64_t) mesh->first_meshlet + mesh->num_meshlets >
+       header->num_meshlets) {
+      return false;
+   }
+
+   // Coarser levels follow level 0's indices
+   uint64_t num_indices = mesh->num_indices;
+   for (uint32_t l = 1; l < mesh->num_lods; l++) {
+      if (mesh->lod_first_index[l] != num_indices)
+         return false;
+      num_indices += mesh->lod_num_indices[l];
+   }
+
+   return mesh->vertex_offset +
+             (uint64_t) mesh->num_vertices * vertex_size <=
+             header->vertex_data_size &&
+          mesh->index_offset + num_indices * sizeof(uint32_t) <=
+             header->index_data_size;
+}
+
+/**
+ * Loads the model for 'file' from the cache. Returns NULL if there is
+ * no cache entry or it is out of date.
+ */
+VkdfModel *
+vkdf_model_cache_load(const char *file, uint32_t import_flags)
+{
+   VKDF_TRACE_SCOPE("vkdf_model_cache_load");
+
+   int64_t source_mtime_ns, source_size;
+   if (!get_source_info(file, &source_mtime_ns, &source_size))
+      return NULL;
+
+   char *path = vkdf_model_cache_get_path(file);
+   int fd = open(path, O_RDONLY);
+   g_free(path);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CacheHeader)) {
+      close(fd);
+      return NULL;
+   }
+
+   size_t map_size = st.st_size;
+   void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   const uint8_t *data = (const uint8_t *) map;
+   const CacheHeader *header = (const CacheHeader *) data;
+   if (!validate_header(header, map_size, import_flags,
+                        source_mtime_ns, source_size)) {
+      munmap(map, map_size);
+      return NULL;
+   }
+
+   const CacheMesh *meshes =
+      (const CacheMesh *) (data + header->meshes_offset);
+   for (uint32_t i = 0; i < header->num_meshes; i++) {
+      if (!validate_mesh(header, &meshes[i])) {
+         munmap(map, map_size);
+         return NULL;
+      }
+   }
+
+   const CacheInstance *instances =
+      (const CacheInstance *) (data + header->instances_offset);
+   for (uint32_t i = 0; i < header->num_instances; i++) {
+      if (instances[i].mesh_idx >= header->num_meshes) {
+         munmap(map, map_size);
+         return NULL;
+      }
+   }
+
+   VkdfModel *model = vkdf_model_new();
+   model->cache_map = map;
+   model->cache_map_size = map_size;
+
+   const VkdfMaterial *materials =
+      (const VkdfMaterial *) (data + header->materials_offset);
+   model->materials.assign(materials, materials + header->num_materials);
+
+   const VkdfMeshlet *meshlets =
+      (const VkdfMeshlet *) (data + header->meshlets_offset);
+   const uint8_t *vertex_data = data + header->vertex_data_offset;
+   const uint8_t *index_data = data + header->index_data_offset;
+   for (uint32_t i = 0; i < header->num_meshes; i++) {
+      VkdfMesh *mesh = vkdf_mesh_new();
+      mesh->material_idx = meshes[i].material_idx;
+      mesh->cached = true;
+      mesh->cached_vertex_data = vertex_data + meshes[i].vertex_offset;
+      mesh->cached_index_data = index_data + meshes[i].index_offset;
+      mesh->cached_num_vertices = meshes[i].num_vertices;
+      mesh->cached_num_indices = meshes[i].num_indices;
+      mesh->cached_has_uv = (meshes[i].flags & CACHE_MESH_HAS_UV) != 0;
+      memcpy(&mesh->box.min, meshes[i].box_min, sizeof(glm::vec3));
+      memcpy(&mesh->box.max, meshes[i].box_max, sizeof(glm::vec3));
+      memcpy(&mesh->sphere.center, meshes[i].sphere, sizeof(glm::vec3));
+      mesh->sphere.radius = meshes[i].sphere[3];
+      mesh->num_lods = meshes[i].num_lods;
+      memcpy(mesh->lod_first_index, meshes[i].lod_first_index,
+             sizeof(mesh->lod_first_index));
+      memcpy(mesh->lod_num_indices, meshes[i].lod_num_indices,
+             sizeof(mesh->lod_num_indices));
+      memcpy(mesh->lod_error, meshes[i].lod_error, sizeof(mesh->lod_error));
+      mesh->meshlets.assign(meshlets + meshes[i].first_meshlet,
+                            meshlets + meshes[i].first_meshlet +
+                               meshes[i].num_meshlets);
+      vkdf_model_add_mesh(model, mesh);
+   }
+
+   if (header->num_instances > 0) {
+      std::vector<VkdfModelInstance> model_instances(header->num_instances);
+      for (uint32_t i = 0; i < header->num_instances; i++) {
+         memcpy(&model_instances[i].transform, instances[i].transform,
+                sizeof(glm::mat4));
+         model_instances[i].mesh_idx = instances[i].mesh_idx;
+      }
+      vkdf_model_set_instances(model, model_instances);
+   }
+
+   // We are going to read the whole file when we upload the model
+   madvise(map, map_size, MADV_WILLNEED);
+
+   return model;
+}
+
+void
+vkdf_model_cache_unmap(VkdfModel *model)
+{
+   munmap(model->cache_map, model->cache_map_size);
+   model->cache_map = NULL;
+   model->cache_map_size = 0;
+}
+
+static bool
+write_all(FILE *f, const void *data, size_t size)
+{
+   return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+static bool
+write_padding(FILE *f, uint64_t *offset, uint64_t align)
+{
+   static const uint8_t zeros[16] = { 0 };
+   uint64_t aligned = align_offset(*offset, align);
+   bool ok = write_all(f, zeros, aligned - *offset);
+   *offset = aligned;
+   return ok;
+}
+
+static bool
+write_cache(FILE *f, VkdfModel *model, CacheHeader *header)
+{
+   uint32_t num_meshes = model->meshes.size();
+   CacheMesh *meshes = g_new0(CacheMesh, num_meshes);
+
+   std::vector<VkdfMeshlet> meshlets;
+   uint64_t vertex_data_size = 0;
+   uint64_t index_data_size = 0;
+   for (uint32_t i = 0; i < num_meshes; i++) {
+      VkdfMesh *mesh = model->meshes[i];
+      assert(mesh->vertex_format == VKDF_VERTEX_FORMAT_FLOAT);
+      assert(mesh->index_type == VK_INDEX_TYPE_UINT32);
+      meshes[i].num_vertices = vkdf_mesh_get_num_vertices(mesh);
+      meshes[i].num_indices = vkdf_mesh_get_num_indices(mesh);
+      meshes[i].material_idx = mesh->material_idx;
+      meshes[i].flags = vkdf_mesh_has_uv(mesh) ? CACHE_MESH_HAS_UV : 0;
+      meshes[i].vertex_offset = vertex_data_size;
+      meshes[i].index_offset = index_data_size;
+      meshes[i].num_lods = mesh->num_lods;
+      memcpy(meshes[i].lod_first_index, mesh->lod_first_index,
+             sizeof(mesh->lod_first_index));
+      memcpy(meshes[i].lod_num_indices, mesh->lod_num_indices,
+             sizeof(mesh->lod_num_indices));
+      memcpy(meshes[i].lod_error, mesh->lod_error, sizeof(mesh->lod_error));
+      meshes[i].first_meshlet = meshlets.size();
+      meshes[i].num_meshlets = mesh->meshlets.size();
+      meshlets.insert(meshlets.end(),
+                      mesh->meshlets.begin(), mesh->meshlets.end());
+
+      memcpy(meshes[i].box_min, &mesh->box.min, 3 * sizeof(float));
+      memcpy(meshes[i].box_max, &mesh->box.max, 3 * sizeof(float));
+      memcpy(meshes[i].sphere, &mesh->sphere.center, 3 * sizeof(float));
+      meshes[i].sphere[3] = mesh->sphere.radius;
+
+      vertex_data_size += vkdf_mesh_get_vertex_data_size(mesh);
+      index_data_size += vkdf_mesh_get_index_data_size(mesh);
+   }
+
+   uint32_t num_instances = model->instances.size();
+   CacheInstance *instances = g_new0(CacheInstance, num_instances);
+   for (uint32_t i = 0; i < num_instances; i++) {
+      memcpy(instances[i].transform, &model->instances[i].transform,
+             sizeof(instances[i].transform));
+      instances[i].mesh_idx = model->instances[i].mesh_idx;
+   }
+
+   uint64_t offset = sizeof(CacheHeader);
+   header->num_materials = model->materials.size();
+   header->num_meshes = num_meshes;
+   header->num_instances = num_instances;
+   header->num_meshlets = meshlets.size();
+   header->materials_offset = offset;
+   offset += header->num_materials * sizeof(VkdfMaterial);
+   header->meshes_offset = offset;
+   offset += num_meshes * sizeof(CacheMesh);
+   header->instances_offset = offset;
+   offset += num_instances * sizeof(CacheInstance);
+   header->meshlets_offset = offset;
+   offset += meshlets.size() * sizeof(VkdfMeshlet);
+   header->vertex_data_offset = align_offset(offset, 16);
+   header->vertex_data_size = vertex_data_size;
+   header->index_data_offset =
+      align_offset(header->vertex_data_offset + vertex_data_size, 16);
+   header->index_data_size = index_data_size;
+   memcpy(header->box_min, &model->box.min, 3 * sizeof(float));
+   memcpy(header->box_max, &model->box.max, 3 * sizeof(float));
+
+   bool ok = write_all(f, header, sizeof(CacheHeader)) &&
+             write_all(f, model->materials.data(),
+                       header->num_materials * sizeof(VkdfMaterial)) &&
+             write_all(f, meshes, num_meshes * sizeof(CacheMesh)) &&
+             write_all(f, instances, num_instances * sizeof(CacheInstance)) &&
+             write_all(f, meshlets.data(),
+                       meshlets.size() * sizeof(VkdfMeshlet));
+   g_free(meshes);
+   g_free(instances);
+
+   offset = header->meshlets_offset + meshlets.size() * sizeof(VkdfMeshlet);
+   ok = ok && write_padding(f, &offset, 16);
+
+   // Interleaved vertex data, same layout we use for vertex buffers
+   for (uint32_t m = 0; ok && m < num_meshes; m++) {
+      VkdfMesh *mesh = model->meshes[m];
+      VkDeviceSize size = vkdf_mesh_get_vertex_data_size(mesh);
+      uint8_t *data = (uint8_t *) g_malloc(size);
+      vkdf_mesh_copy_vertex_data(mesh, data);
+      ok = write_all(f, data, size);
+      g_free(data);
+   }
+
+   offset += vertex_data_size;
+   ok = ok && write_padding(f, &offset, 16);
+
+   // Index data for all levels of detail
+   for (uint32_t m = 0; ok && m < num_meshes; m++) {
+      VkdfMesh *mesh = model->meshes[m];
+      VkDeviceSize size = vkdf_mesh_get_index_data_size(mesh);
+      uint8_t *data = (uint8_t *) g_malloc(size);
+      vkdf_mesh_copy_index_data(mesh, data);
+      ok = write_all(f, data, size);
+      g_free(data);
+   }
+
+   return ok;
+}
+
+/**
+ * Stores a model that has just been imported from 'file' in the cache.
+ * The file is written under a temporary name and renamed into place, so
+ * concurrent loads never see a partially written file. Returns whether the
+ * entry was stored.
+ */
+bool
+vkdf_model_cache_store(VkdfModel *model,
+                       const char *file,
+                       uint32_t import_flags)
+{
+   VKDF_TRACE_SCOPE("vkdf_model_cache_store");
+
+   // Models that have been loaded from the cache are already there
+   assert(!model->cache_map);
+
+   CacheHeader header;
+   memset(&header, 0, sizeof(CacheHeader));
+   header.magic = CACHE_MAGIC;
+   header.version = CACHE_VERSION;
+   header.import_flags = import_flags;
+   header.options = cache_options;
+   if (!get_source_info(file, &header.source_mtime_ns, &header.source_size))
+      return false;
+
+   char *path = vkdf_model_cache_get_path(file);
+   char *dir = g_path_get_dirname(path);
+   char *tmp_path = g_strdup_printf("%s.%d.tmp", path, getpid());
+
+   bool ok = false;
+   FILE *f = NULL;
+   if (g_mkdir_with_parents(dir, 0755) == 0 &&
+       (f = fopen(tmp_path, "wb")) != NULL) {
+      ok = write_cache(f, model, &header);
+      ok = (fclose(f) == 0) && ok;
+      ok = ok && rename(tmp_path, path) == 0;
+   }
+
+   if (!ok) {
+      vkdf_error("Failed to store model cache for '%s' at '%s'",
+                 file, path);
+      if (f)
+         unlink(tmp_path);
+   }
+
+   g_free(tmp_path);
+   g_free(dir);
+   g_free(path);
+
+   return ok;
+}
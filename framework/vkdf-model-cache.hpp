@@ -0,0 +1,47 @@
+#ifndef __VKDF_MODEL_CACHE_H__
+#define __VKDF_MODEL_CACHE_H__
+
+/**
+ * Binary model cache.
+ *
+ * Imported models are stored in a versioned binary file under the user's
+ * cache directory ($XDG_CACHE_HOME/vkdf/models), named after the absolute
+ * path of the source model. The file records the source's modification
+ * time and size, the import flags and the framework options that affect
+ * the imported data (such as mesh optimization), so edits to the source or
+ * changes to the import process invalidate it.
+ *
+ * Layout (native endianness, all offsets in bytes from the start of the
+ * file):
+ *
+ *    header | materials | mesh table | instances | meshlets |
+ *    vertex data | index data
+ *
+ * Vertex data for each mesh is stored interleaved in the same layout used
+ * for vertex buffers (position, normal and, if present, uv) and index data
+ * as 32-bit indices. The mesh table records offsets into both blobs, the
+ * material index, the levels of detail and the bounding box and sphere of
+ * each mesh. Instances record the transform and mesh of each mesh
+ * reference in the source's scene graph. Each mesh's meshlets are a range
+ * of the meshlet table.
+ *
+ * Cached models are memory-mapped rather than read: their meshes point
+ * straight into the mapping, so uploading them to GPU buffers is one
+ * memcpy per mesh with no parsing.
+ */
+
+char *
+vkdf_model_cache_get_path(const char *file);
+
+VkdfModel *
+vkdf_model_cache_load(const char *file, uint32_t import_flags);
+
+bool
+vkdf_model_cache_store(VkdfModel *model,
+                       const char *file,
+                       uint32_t import_flags);
+
+void
+vkdf_model_cache_unmap(VkdfModel *model);
+
+#endif
@@ -1,63 +1,187 @@
 #include "vkdf.hpp"
 
+#include <algorithm>
+
 VkdfModel *
 vkdf_model_new()
 {
    VkdfModel *model = g_new0(VkdfModel, 1);
    model->meshes = std::vector<VkdfMesh *>();
+   model->instances = std::vector<VkdfModelInstance>();
+   model->instance_offsets = std::vector<uint32_t>();
+   model->meshlet_offsets = std::vector<uint32_t>();
+   vkdf_box_init_empty(&model->box);
+   vkdf_sphere_init_empty(&model->sphere);
    return model;
 }
 
-static VkdfMesh *
-process_mesh(const aiScene *scene, const aiMesh *mesh)
+static void
+process_mesh(const aiMesh *mesh,
+             VkdfMesh *_mesh,
+             VkdfMeshOptimizeStats *stats)
 {
-   VkdfMesh *_mesh = vkdf_mesh_new();
-
-   // Vertex data
-   for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
-         glm::vec3 vertex;
-         vertex.x = mesh->mVertices[i].x;
-         vertex.y = mesh->mVertices[i].y;
-         vertex.z = mesh->mVertices[i].z;
-         _mesh->vertices.push_back(vertex);
-
-         glm::vec3 normal;
-         normal.x = mesh->mNormals[i].x;
-         normal.y = mesh->mNormals[i].y;
-         normal.z = mesh->mNormals[i].z;
-         _mesh->normals.push_back(normal);
-
-         if (mesh->mTextureCoords[0]) {
-             glm::vec2 uv;
-             uv.x = mesh->mTextureCoords[0][i].x;
-             uv.y = mesh->mTextureCoords[0][i].y;
-            _mesh->uvs.push_back(uv);
-         }
+   uint32_t num_vertices = mesh->mNumVertices;
+
+   // Vertex data. Storage is sized up-front and written in place.
+   static_assert(sizeof(aiVector3D) == sizeof(glm::vec3),
+                 "aiVector3D and glm::vec3 must have the same layout");
+
+   _mesh->vertices.resize(num_vertices);
+   memcpy(_mesh->vertices.data(), mesh->mVertices,
+          num_vertices * sizeof(glm::vec3));
+
+   _mesh->normals.resize(num_vertices);
+   if (mesh->mNormals) {
+      memcpy(_mesh->normals.data(), mesh->mNormals,
+             num_vertices * sizeof(glm::vec3));
+   }
+
+   if (mesh->mTextureCoords[0]) {
+      _mesh->uvs.resize(num_vertices);
+      glm::vec2 *uvs = _mesh->uvs.data();
+      for (uint32_t i = 0; i < num_vertices; i++) {
+         uvs[i].x = mesh->mTextureCoords[0][i].x;
+         uvs[i].y = mesh->mTextureCoords[0][i].y;
+      }
    }
 
    // Index data
+   uint32_t num_indices = 0;
+   for (uint32_t i = 0; i < mesh->mNumFaces; i++)
+      num_indices += mesh->mFaces[i].mNumIndices;
+
+   _mesh->indices.resize(num_indices);
+   uint32_t *indices = _mesh->indices.data();
    for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
-      aiFace *face = &mesh->mFaces[i];
-      for (uint32_t j = 0; j < face->mNumIndices; j++)
-         _mesh->indices.push_back(face->mIndices[j]);
+      const aiFace *face = &mesh->mFaces[i];
+      memcpy(indices, face->mIndices, face->mNumIndices * sizeof(uint32_t));
+      indices += face->mNumIndices;
    }
 
    // Material data
    _mesh->material_idx = mesh->mMaterialIndex;
 
-   return _mesh;
+#if VKDF_MODEL_OPTIMIZE_ENABLE
+   if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+      vkdf_mesh_optimize(_mesh, stats);
+#endif
+
+#if VKDF_MODEL_NUM_LODS > 1
+   if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+      vkdf_mesh_generate_lods(_mesh, VKDF_MODEL_NUM_LODS);
+#endif
+
+#if VKDF_MODEL_MESHLETS_ENABLE
+   if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+      vkdf_mesh_build_meshlets(_mesh);
+#endif
+
+   vkdf_mesh_compute_bounds(_mesh);
 }
 
+/**
+ * Records an instance for each mesh reference in the node hierarchy, with
+ * the node's transform accumulated from the root
+ */
 static void
-process_node(VkdfModel *model, const aiScene *scene, const aiNode *node)
+collect_node_instances(const aiNode *node,
+                       const glm::mat4 &parent_transform,
+                       std::vector<VkdfModelInstance> &instances)
 {
+   // Assimp matrices are row-major
+   static_assert(sizeof(aiMatrix4x4) == sizeof(glm::mat4),
+                 "aiMatrix4x4 and glm::mat4 must have the same size");
+   glm::mat4 local;
+   memcpy(&local, &node->mTransformation, sizeof(glm::mat4));
+   glm::mat4 transform = parent_transform * glm::transpose(local);
+
    for (uint32_t i = 0; i < node->mNumMeshes; i++) {
-      aiMesh* mesh = scene->mMeshes[node->mMeshes[i]]; 
-      model->meshes.push_back(process_mesh(scene, mesh));			
+      VkdfModelInstance instance;
+      instance.transform = transform;
+      instance.mesh_idx = node->mMeshes[i];
+      instances.push_back(instance);
    }
 
    for (uint32_t i = 0; i < node->mNumChildren; i++)
-      process_node(model, scene, node->mChildren[i]);
+      collect_node_instances(node->mChildren[i], transform, instances);
+}
+
+typedef struct {
+   const aiScene *scene;
+   VkdfModel *model;
+   std::vector<VkdfMeshOptimizeStats> *stats;
+   gint next;
+} ProcessMeshesJob;
+
+static gpointer
+process_meshes_thread(gpointer data)
+{
+   VKDF_TRACE_SCOPE("process_meshes_thread");
+
+   ProcessMeshesJob *job = (ProcessMeshesJob *) data;
+   uint32_t num_meshes = job->scene->mNumMeshes;
+
+   // Meshes are picked up one at a time so that a few large meshes don't
+   // leave the other threads idle
+   uint32_t i;
+   while ((i = (uint32_t) g_atomic_int_add(&job->next, 1)) < num_meshes)
+      process_mesh(job->scene->mMeshes[i], job->model->meshes[i],
+                   &(*job->stats)[i]);
+
+   return NULL;
+}
+
+/**
+ * Converts all meshes in the scene, once each no matter how many nodes
+ * reference them. Meshes are converted in parallel into meshes allocated
+ * up-front in scene order, so the resulting mesh order doesn't depend on
+ * thread scheduling. Node references become model instances.
+ */
+static void
+process_meshes(VkdfModel *model, const aiScene *scene, const char *file)
+{
+   VKDF_TRACE_SCOPE("process_meshes");
+
+   uint32_t num_meshes = scene->mNumMeshes;
+   model->meshes.reserve(num_meshes);
+   for (uint32_t i = 0; i < num_meshes; i++)
+      vkdf_model_add_mesh(model, vkdf_mesh_new());
+
+   std::vector<VkdfMeshOptimizeStats> stats(num_meshes);
+
+   ProcessMeshesJob job;
+   job.scene = scene;
+   job.model = model;
+   job.stats = &stats;
+   job.next = 0;
+
+   uint32_t num_threads =
+      MIN(MIN(g_get_num_processors(), VKDF_MODEL_IMPORT_MAX_THREADS),
+          num_meshes);
+
+   // The calling thread takes part too
+   std::vector<GThread *> threads;
+   for (uint32_t i = 1; i < num_threads; i++) {
+      threads.push_back(g_thread_new("vkdf-model-import",
+                                     process_meshes_thread, &job));
+   }
+
+   process_meshes_thread(&job);
+
+   for (uint32_t i = 0; i < threads.size(); i++)
+      g_thread_join(threads[i]);
+
+   std::vector<VkdfModelInstance> instances;
+   collect_node_instances(scene->mRootNode, glm::mat4(1.0f), instances);
+   vkdf_model_set_instances(model, instances);
+
+#if VKDF_MODEL_OPTIMIZE_ENABLE && VKDF_LOG_MODEL_OPTIMIZE_ENABLE
+   VkdfMeshOptimizeStats total;
+   memset(&total, 0, sizeof(total));
+   for (uint32_t i = 0; i < num_meshes; i++)
+      vkdf_mesh_optimize_stats_add(&total, &stats[i]);
+   vkdf_mesh_optimize_stats_log(file, &total);
+#endif
 }
 
 static VkdfMaterial
@@ -86,7 +210,7 @@ process_material(aiMaterial *material)
 }
 
 static VkdfModel *
-create_model_from_scene(const aiScene *scene)
+create_model_from_scene(const aiScene *scene, const char *file)
 {
    VkdfModel *model = vkdf_model_new();
 
@@ -97,29 +221,61 @@ create_model_from_scene(const aiScene *scene)
    }
 
    // Load meshes
-   process_node(model, scene, scene->mRootNode);
+   process_meshes(model, scene, file);
 
    return model;
 }
 
+static const uint32_t import_flags = aiProcess_CalcTangentSpace |
+                                     aiProcess_Triangulate |
+                                     aiProcess_JoinIdenticalVertices |
+                                     aiProcess_SplitLargeMeshes |
+                                     aiProcess_OptimizeMeshes |
+                                     aiProcess_TransformUVCoords |
+                                     aiProcess_GenNormals |
+                                     aiProcess_SortByPType;
+
+/**
+ * Loads a model from the model cache if there is an up-to-date entry for
+ * 'file', otherwise imports it with Assimp and stores the result in the
+ * cache for later loads (see vkdf-model-cache.hpp).
+ */
 VkdfModel *
 vkdf_model_load(const char *file)
 {
-   uint32_t flags = aiProcess_CalcTangentSpace | 
-                    aiProcess_Triangulate |
-                    aiProcess_JoinIdenticalVertices |
-                    aiProcess_SplitLargeMeshes |
-                    aiProcess_OptimizeMeshes |
-                    aiProcess_TransformUVCoords |
-                    aiProcess_GenNormals |
-                    aiProcess_SortByPType;
-
-   const aiScene *scene = aiImportFile(file, flags);
+   VKDF_TRACE_SCOPE("vkdf_model_load");
+
+#if VKDF_MODEL_CACHE_ENABLE
+   VkdfModel *model = vkdf_model_cache_load(file, import_flags);
+   if (model)
+      return model;
+
+   model = vkdf_model_import(file);
+   vkdf_model_cache_store(model, file, import_flags);
+   return model;
+#else
+   return vkdf_model_import(file);
+#endif
+}
+
+/**
+ * Imports a model with Assimp, bypassing the model cache
+ */
+VkdfModel *
+vkdf_model_import(const char *file)
+{
+   VKDF_TRACE_SCOPE("vkdf_model_import");
+
+   const aiScene *scene;
+   {
+      VKDF_TRACE_SCOPE("aiImportFile");
+      scene = aiImportFile(file, import_flags);
+   }
    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
       vkdf_fatal("Assimp failed to load model at '%s'. Error: %s.",
                  file, aiGetErrorString());
 
-   VkdfModel *model = create_model_from_scene(scene);
+   VkdfModel *model = create_model_from_scene(scene, file);
 
    aiReleaseImport(scene);
 
@@ -138,6 +294,27 @@ vkdf_model_free(VkdfContext *ctx, VkdfModel *model)
    model->materials.clear();
    std::vector<VkdfMaterial>(model->materials).swap(model->materials);
 
+   model->instances.clear();
+   std::vector<VkdfModelInstance>(model->instances).swap(model->instances);
+
+   model->instance_offsets.clear();
+   std::vector<uint32_t>(model->instance_offsets).swap(
+      model->instance_offsets);
+
+   if (model->instance_buf.buf) {
+      vkDestroyBuffer(ctx->device, model->instance_buf.buf, NULL);
+      vkFreeMemory(ctx->device, model->instance_buf.mem, NULL);
+   }
+
+   if (model->meshlet_buf.buf) {
+      vkDestroyBuffer(ctx->device, model->meshlet_buf.buf, NULL);
+      vkFreeMemory(ctx->device, model->meshlet_buf.mem, NULL);
+   }
+
+   model->meshlet_offsets.clear();
+   std::vector<uint32_t>(model->meshlet_offsets).swap(
+      model->meshlet_offsets);
+
    if (model->vertex_buf.buf) {
       vkDestroyBuffer(ctx->device, model->vertex_buf.buf, NULL);
       vkFreeMemory(ctx->device, model->vertex_buf.mem, NULL);
@@ -147,11 +324,26 @@ vkdf_model_free(VkdfContext *ctx, VkdfModel *model)
       vkDestroyBuffer(ctx->device, model->index_buf.buf, NULL);
       vkFreeMemory(ctx->device, model->index_buf.mem, NULL);
    }
+
+   model->vertex_buf_offsets.clear();
+   std::vector<VkDeviceSize>(model->vertex_buf_offsets).swap(
+      model->vertex_buf_offsets);
+
+   model->index_buf_offsets.clear();
+   std::vector<VkDeviceSize>(model->index_buf_offsets).swap(
+      model->index_buf_offsets);
+
+   if (model->cache_map)
+      vkdf_model_cache_unmap(model);
+
+   g_free(model);
 }
 
 static void
 model_fill_vertex_buffer(VkdfContext *ctx, VkdfModel *model)
 {
+   VKDF_TRACE_SCOPE("model_fill_vertex_buffer");
+
    assert(model->meshes.size() > 0);
 
    if (model->vertex_buf.buf != 0)
@@ -178,25 +370,9 @@ model_fill_vertex_buffer(VkdfContext *ctx, VkdfModel *model)
    VkDeviceSize byte_offset = 0;
    for (uint32_t m = 0; m < model->meshes.size(); m++) {
       VkdfMesh *mesh = model->meshes[m];
-      bool has_uv = mesh->uvs.size() > 0;
-
       model->vertex_buf_offsets.push_back(byte_offset);
-
-      for (uint32_t i = 0; i < mesh->vertices.size(); i++) {
-         uint32_t elem_size = sizeof(mesh->vertices[0]);
-         memcpy(map + byte_offset, &mesh->vertices[i], elem_size);
-         byte_offset += elem_size;
-
-         elem_size = sizeof(mesh->normals[0]);
-         memcpy(map + byte_offset, &mesh->normals[i], elem_size);
-         byte_offset += elem_size;
-
-         if (has_uv) {
-            elem_size = sizeof(mesh->uvs[0]);
-            memcpy(map + byte_offset, &mesh->uvs[i], elem_size);
-            byte_offset += elem_size;
-         }
-      }
+      vkdf_mesh_copy_vertex_data(mesh, map + byte_offset);
+      byte_offset += vkdf_mesh_get_vertex_data_size(mesh);
    }
 
    VkMappedMemoryRange range;
@@ -208,19 +384,29 @@ model_fill_vertex_buffer(VkdfContext *ctx, VkdfModel *model)
    VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
 
    vkUnmapMemory(ctx->device, model->vertex_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, vertex_data_size);
 }
 
 static void
 model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
 {
+   VKDF_TRACE_SCOPE("model_fill_index_buffer");
+
    assert(model->meshes.size() > 0);
 
    if (model->index_buf.buf != 0)
       return;
 
+   // Meshes can have different index types. Keep each mesh's index data
+   // 4-byte aligned so it is a valid offset for either of them.
    VkDeviceSize index_data_size = 0;
-   for (uint32_t m = 0; m < model->meshes.size(); m++)
-      index_data_size += vkdf_mesh_get_index_data_size(model->meshes[m]);
+   for (uint32_t m = 0; m < model->meshes.size(); m++) {
+      VkdfMesh *mesh = model->meshes[m];
+      vkdf_mesh_select_index_type(mesh);
+      index_data_size = (index_data_size + 3) & ~((VkDeviceSize) 3);
+      index_data_size += vkdf_mesh_get_index_data_size(mesh);
+   }
 
    assert(index_data_size > 0);
 
@@ -240,9 +426,10 @@ model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
       VkdfMesh *mesh = model->meshes[m];
       VkDeviceSize mesh_index_data_size = vkdf_mesh_get_index_data_size(mesh);
 
+      byte_offset = (byte_offset + 3) & ~((VkDeviceSize) 3);
       model->index_buf_offsets.push_back(byte_offset);
 
-      memcpy(map + byte_offset, &mesh->indices[0], mesh_index_data_size);
+      vkdf_mesh_copy_index_data(mesh, map + byte_offset);
       byte_offset += mesh_index_data_size;
    }
 
@@ -255,6 +442,145 @@ model_fill_index_buffer(VkdfContext *ctx, VkdfModel *model)
    VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
 
    vkUnmapMemory(ctx->device, model->index_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, index_data_size);
+}
+
+/**
+ * Selects the vertex format of all meshes in the model. Must be called
+ * before vkdf_model_fill_vertex_buffers(). Each mesh gets its own position
+ * quantization range for compact formats, so shaders need the mesh's
+ * pos_scale and pos_offset for each draw.
+ */
+void
+vkdf_model_set_vertex_format(VkdfModel *model, VkdfVertexFormat format)
+{
+   assert(model->vertex_buf.buf == 0);
+
+   model->vertex_format = format;
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      vkdf_mesh_set_vertex_format(model->meshes[i], format);
+}
+
+/**
+ * Optimizes all meshes in the model (see vkdf-mesh-optimize.hpp). Models
+ * imported with Assimp are already optimized unless the framework is built
+ * with VKDF_MODEL_OPTIMIZE_ENABLE=0, so this is mostly useful for models
+ * built by hand. If 'stats' is not NULL, it receives the totals for all
+ * meshes. Meshes must be triangle lists.
+ */
+void
+vkdf_model_optimize(VkdfModel *model, VkdfMeshOptimizeStats *stats)
+{
+   if (stats)
+      memset(stats, 0, sizeof(VkdfMeshOptimizeStats));
+
+   for (uint32_t i = 0; i < model->meshes.size(); i++) {
+      VkdfMeshOptimizeStats mesh_stats;
+      vkdf_mesh_optimize(model->meshes[i], stats ? &mesh_stats : NULL);
+      if (stats)
+         vkdf_mesh_optimize_stats_add(stats, &mesh_stats);
+   }
+}
+
+/**
+ * Recomputes the model's bounds from the bounds of its meshes (or of its
+ * mesh instances, if it has any). Needed if meshes change after they are
+ * added to the model.
+ */
+void
+vkdf_model_compute_bounds(VkdfModel *model)
+{
+   vkdf_box_init_empty(&model->box);
+   vkdf_sphere_init_empty(&model->sphere);
+
+   if (model->instances.size() == 0) {
+      for (uint32_t i = 0; i < model->meshes.size(); i++) {
+         vkdf_box_merge(&model->box, &model->meshes[i]->box);
+         vkdf_sphere_merge(&model->sphere, &model->meshes[i]->sphere);
+      }
+      return;
+   }
+
+   for (uint32_t i = 0; i < model->instances.size(); i++) {
+      const VkdfModelInstance *instance = &model->instances[i];
+      const VkdfMesh *mesh = model->meshes[instance->mesh_idx];
+      const glm::mat4 &m = instance->transform;
+
+      VkdfBox box;
+      vkdf_box_transform(&mesh->box, m, &box);
+      vkdf_box_merge(&model->box, &box);
+
+      if (vkdf_sphere_is_empty(&mesh->sphere))
+         continue;
+
+      float scale = MAX(glm::length(glm::vec3(m[0])),
+                        MAX(glm::length(glm::vec3(m[1])),
+                            glm::length(glm::vec3(m[2]))));
+      VkdfSphere sphere;
+      sphere.center = glm::vec3(m * glm::vec4(mesh->sphere.center, 1.0f));
+      sphere.radius = mesh->sphere.radius * scale;
+      vkdf_sphere_merge(&model->sphere, &sphere);
+   }
+}
+
+/**
+ * Replaces the model's mesh instances. Instances are stored grouped by
+ * mesh, keeping their relative order. Updates the model's bounds.
+ */
+void
+vkdf_model_set_instances(VkdfModel *model,
+                         const std::vector<VkdfModelInstance> &instances)
+{
+   assert(model->instance_buf.buf == 0);
+
+   model->instances = instances;
+   std::stable_sort(model->instances.begin(), model->instances.end(),
+                    [](const VkdfModelInstance &a,
+                       const VkdfModelInstance &b) {
+                       return a.mesh_idx < b.mesh_idx;
+                    });
+
+   uint32_t num_meshes = model->meshes.size();
+   model->instance_offsets.assign(num_meshes + 1, 0);
+   for (uint32_t i = 0; i < model->instances.size(); i++) {
+      assert(model->instances[i].mesh_idx < num_meshes);
+      model->instance_offsets[model->instances[i].mesh_idx + 1]++;
+   }
+   for (uint32_t m = 0; m < num_meshes; m++)
+      model->instance_offsets[m + 1] += model->instance_offsets[m];
+
+   vkdf_model_compute_bounds(model);
+}
+
+/**
+ * Returns the number of levels of detail of the model, that is, the
+ * largest number of levels of any of its meshes. Meshes with fewer levels
+ * draw their coarsest level for the levels they don't have.
+ */
+uint32_t
+vkdf_model_get_num_lods(VkdfModel *model)
+{
+   uint32_t num_lods = 1;
+   for (uint32_t i = 0; i < model->meshes.size(); i++)
+      num_lods = MAX(num_lods, model->meshes[i]->num_lods);
+   return num_lods;
+}
+
+/**
+ * Returns the simplification error of the model at level 'lod', as the
+ * largest error of any of its meshes, in object-space units.
+ */
+float
+vkdf_model_get_lod_error(VkdfModel *model, uint32_t lod)
+{
+   float error = 0.0f;
+   for (uint32_t i = 0; i < model->meshes.size(); i++) {
+      VkdfMesh *mesh = model->meshes[i];
+      uint32_t mesh_lod = MIN(lod, mesh->num_lods - 1);
+      error = MAX(error, vkdf_mesh_get_lod_error(mesh, mesh_lod));
+   }
+   return error;
 }
 
 /**
@@ -281,3 +607,102 @@ vkdf_model_fill_vertex_buffers(VkdfContext *ctx,
    }
 }
 
+/**
+ * Creates a vertex buffer with the transform of each of the model's mesh
+ * instances, to be used as a per-instance attribute (4 vec4 columns). Mesh
+ * 'm' is drawn with vkdf_model_get_mesh_num_instances() instances starting
+ * at instance vkdf_model_get_mesh_first_instance().
+ */
+void
+vkdf_model_fill_instance_buffer(VkdfContext *ctx, VkdfModel *model)
+{
+   assert(model->instances.size() > 0);
+
+   if (model->instance_buf.buf != 0)
+      return;
+
+   VkDeviceSize instance_data_size =
+      model->instances.size() * sizeof(glm::mat4);
+
+   model->instance_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         instance_data_size,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   uint8_t *map;
+   VK_CHECK(vkMapMemory(ctx->device, model->instance_buf.mem,
+                        0, instance_data_size, 0, (void **) &map));
+
+   for (uint32_t i = 0; i < model->instances.size(); i++) {
+      memcpy(map + i * sizeof(glm::mat4), &model->instances[i].transform,
+             sizeof(glm::mat4));
+   }
+
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = model->instance_buf.mem;
+   range.offset = 0;
+   range.size = instance_data_size;
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+
+   vkUnmapMemory(ctx->device, model->instance_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, instance_data_size);
+}
+
+
+/**
+ * Creates a storage buffer with the meshlets of all meshes in the model,
+ * so compute shaders can cull them (see vkdf-meshlet-cull.hpp). The
+ * meshlets of mesh 'm' start at element model->meshlet_offsets[m] and
+ * their index ranges are relative to the mesh's index data.
+ */
+void
+vkdf_model_fill_meshlet_buffer(VkdfContext *ctx, VkdfModel *model)
+{
+   if (model->meshlet_buf.buf != 0)
+      return;
+
+   uint32_t num_meshlets = 0;
+   for (uint32_t m = 0; m < model->meshes.size(); m++) {
+      model->meshlet_offsets.push_back(num_meshlets);
+      num_meshlets += model->meshes[m]->meshlets.size();
+   }
+
+   assert(num_meshlets > 0);
+
+   VkDeviceSize meshlet_data_size = num_meshlets * sizeof(VkdfMeshlet);
+
+   model->meshlet_buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         meshlet_data_size,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+   uint8_t *map;
+   VK_CHECK(vkMapMemory(ctx->device, model->meshlet_buf.mem,
+                        0, meshlet_data_size, 0, (void **) &map));
+
+   for (uint32_t m = 0; m < model->meshes.size(); m++) {
+      VkdfMesh *mesh = model->meshes[m];
+      memcpy(map + model->meshlet_offsets[m] * sizeof(VkdfMeshlet),
+             mesh->meshlets.data(),
+             mesh->meshlets.size() * sizeof(VkdfMeshlet));
+   }
+
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = model->meshlet_buf.mem;
+   range.offset = 0;
+   range.size = meshlet_data_size;
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+
+   vkUnmapMemory(ctx->device, model->meshlet_buf.mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, meshlet_data_size);
+}
@@ -9,6 +9,12 @@ typedef struct {
    float padding[3]; // So the size if 16-byte aligned
 } VkdfMaterial;
 
+// A placement of one of the model's meshes in the model's scene graph
+typedef struct {
+   glm::mat4 transform;    // From mesh space to model space
+   uint32_t mesh_idx;
+} VkdfModelInstance;
+
 typedef struct {
    std::vector<VkdfMesh *> meshes;
    std::vector<VkdfMaterial> materials;
@@ -22,11 +28,43 @@ typedef struct {
    // index data for mesh 'm' starts at byte offset 'index_buf_offsets[m]'
    VkdfBuffer index_buf;
    std::vector<VkDeviceSize> index_buf_offsets;
+
+   // Mesh instances, grouped by mesh: the instances of mesh 'm' are
+   // instances[instance_offsets[m]] to instances[instance_offsets[m + 1] - 1].
+   // Models without instances (such as models built by hand) draw each
+   // mesh once, untransformed.
+   std::vector<VkdfModelInstance> instances;
+   std::vector<uint32_t> instance_offsets;
+
+   // Instance transforms (a mat4 per instance, in the same order as
+   // 'instances'), see vkdf_model_fill_instance_buffer()
+   VkdfBuffer instance_buf;
+
+   // Meshlets of all meshes (see vkdf-meshlet.hpp) in a storage buffer,
+   // where the meshlets of mesh 'm' start at meshlet_offsets[m], see
+   // vkdf_model_fill_meshlet_buffer()
+   VkdfBuffer meshlet_buf;
+   std::vector<uint32_t> meshlet_offsets;
+
+   // Vertex format of all meshes in the model (see vkdf-vertex-format.hpp)
+   VkdfVertexFormat vertex_format;
+
+   // Bounds of all meshes in the model, in object space
+   VkdfBox box;
+   VkdfSphere sphere;
+
+   // Memory-mapped cache file for models loaded from the model cache. Mesh
+   // vertex and index data point into it.
+   void *cache_map;
+   size_t cache_map_size;
 } VkdfModel;
 
 VkdfModel *
 vkdf_model_load(const char *file);
 
+VkdfModel *
+vkdf_model_import(const char *file);
+
 VkdfModel *
 vkdf_model_new();
 
@@ -37,11 +75,53 @@ inline void
 vkdf_model_add_mesh(VkdfModel *model, VkdfMesh *mesh)
 {
    model->meshes.push_back(mesh);
+   vkdf_box_merge(&model->box, &mesh->box);
+   vkdf_sphere_merge(&model->sphere, &mesh->sphere);
+}
+
+void
+vkdf_model_compute_bounds(VkdfModel *model);
+
+void
+vkdf_model_set_instances(VkdfModel *model,
+                         const std::vector<VkdfModelInstance> &instances);
+
+inline uint32_t
+vkdf_model_get_mesh_first_instance(VkdfModel *model, uint32_t mesh_idx)
+{
+   assert(model->instances.size() > 0);
+   return model->instance_offsets[mesh_idx];
+}
+
+inline uint32_t
+vkdf_model_get_mesh_num_instances(VkdfModel *model, uint32_t mesh_idx)
+{
+   assert(model->instances.size() > 0);
+   return model->instance_offsets[mesh_idx + 1] -
+          model->instance_offsets[mesh_idx];
 }
 
+void
+vkdf_model_set_vertex_format(VkdfModel *model, VkdfVertexFormat format);
+
+void
+vkdf_model_optimize(VkdfModel *model, VkdfMeshOptimizeStats *stats);
+
+uint32_t
+vkdf_model_get_num_lods(VkdfModel *model);
+
+float
+vkdf_model_get_lod_error(VkdfModel *model, uint32_t lod);
+
 void
 vkdf_model_fill_vertex_buffers(VkdfContext *ctx,
                                VkdfModel *model,
                                bool per_mesh);
 
+void
+vkdf_model_fill_instance_buffer(VkdfContext *ctx, VkdfModel *model);
+
+void
+vkdf_model_fill_meshlet_buffer(VkdfContext *ctx, VkdfModel *model);
+
 #endif
@@ -6,6 +6,7 @@ init_object(VkdfObject *obj, const glm::vec3 &pos)
    obj->pos = pos;
    obj->rot = glm::vec3(0.0f, 0.0f, 0.0f);
    obj->scale = glm::vec3(1.0f, 1.0f, 1.0f);
+   obj->dirty = true;
 }
 
 VkdfObject *
@@ -36,13 +37,59 @@ vkdf_object_new(const glm::vec3 &pos, VkdfModel *model)
 void
 vkdf_object_free(VkdfObject *obj)
 {
+   // Detach from the transform store so it doesn't reference freed memory
+   if (obj->transforms)
+      obj->transforms->objects[obj->transform_idx] = NULL;
+
    // Models are not owned by the objects
    g_free(obj);
 }
 
+void
+vkdf_object_set_position(VkdfObject *obj, const glm::vec3 &pos)
+{
+   obj->pos = pos;
+   obj->dirty = true;
+
+   if (obj->transforms) {
+      vkdf_transform_store_set_position(obj->transforms, obj->transform_idx,
+                                        pos);
+   }
+}
+
+void
+vkdf_object_set_rotation(VkdfObject *obj, const glm::vec3 &rot)
+{
+   obj->rot = rot;
+   obj->dirty = true;
+
+   if (obj->transforms) {
+      glm::vec3 rot_rad = glm::vec3(DEG_TO_RAD(rot.x),
+                                    DEG_TO_RAD(rot.y),
+                                    DEG_TO_RAD(rot.z));
+      vkdf_transform_store_set_rotation(obj->transforms, obj->transform_idx,
+                                        glm::quat(rot_rad));
+   }
+}
+
+void
+vkdf_object_set_scale(VkdfObject *obj, const glm::vec3 &scale)
+{
+   obj->scale = scale;
+   obj->dirty = true;
+
+   if (obj->transforms) {
+      vkdf_transform_store_set_scale(obj->transforms, obj->transform_idx,
+                                     scale);
+   }
+}
+
 glm::mat4
 vkdf_object_get_model_matrix(VkdfObject *obj)
 {
+   if (!obj->dirty)
+      return obj->model_matrix;
+
    glm::mat4 model = glm::translate(glm::mat4(1.0f), obj->pos);
 
    if (obj->rot.x != 0.0f || obj->rot.y != 0.0f || obj->rot.z != 0.0f) {
@@ -57,6 +104,102 @@ vkdf_object_get_model_matrix(VkdfObject *obj)
    if (obj->scale.x != 1.0f || obj->scale.y != 1.0f || obj->scale.z != 1.0f)
       model = glm::scale(model, obj->scale);
 
+   obj->model_matrix = model;
+   obj->dirty = false;
+
    return model;
 }
 
+static inline float
+get_max_scale(VkdfObject *obj)
+{
+   return MAX(fabsf(obj->scale.x),
+              MAX(fabsf(obj->scale.y), fabsf(obj->scale.z)));
+}
+
+/**
+ * Returns the material of one of the object's meshes. Material variants
+ * are stored after the model's default materials, so variant 'v' of
+ * material 'm' is v * num_materials + m. Meshes without a material get
+ * the object's material_idx_base as is, so applications can use it as a
+ * per-object index into their own material data.
+ */
+int32_t
+vkdf_object_get_material_idx(VkdfObject *obj, VkdfMesh *mesh)
+{
+   if (mesh->material_idx < 0)
+      return obj->material_idx_base;
+
+   return obj->material_idx_base * (int32_t) obj->model->materials.size() +
+          mesh->material_idx;
+}
+
+/**
+ * Computes the world-space bounding box of the object from its model's
+ * bounding box
+ */
+void
+vkdf_object_get_box(VkdfObject *obj, VkdfBox *box)
+{
+   vkdf_box_transform(&obj->model->box, vkdf_object_get_model_matrix(obj),
+                      box);
+}
+
+/**
+ * Computes the world-space bounding sphere of the object from its model's
+ * bounding sphere
+ */
+void
+vkdf_object_get_sphere(VkdfObject *obj, VkdfSphere *sphere)
+{
+   if (vkdf_sphere_is_empty(&obj->model->sphere)) {
+      vkdf_sphere_init_empty(sphere);
+      return;
+   }
+
+   glm::mat4 model = vkdf_object_get_model_matrix(obj);
+   glm::vec4 center = glm::vec4(obj->model->sphere.center, 1.0f);
+   sphere->center = glm::vec3(model * center);
+   sphere->radius = obj->model->sphere.radius * get_max_scale(obj);
+}
+
+
+/**
+ * Selects the coarsest level of detail of the object's model whose
+ * simplification error projects to at most 'max_pixel_error' pixels on a
+ * viewport 'viewport_height' pixels high, seen from 'cam' through its
+ * projection. The error is projected at the distance to the object's
+ * bounding sphere, scaled by its largest scale factor.
+ */
+uint32_t
+vkdf_object_select_lod(VkdfObject *obj,
+                       VkdfCamera *cam,
+                       float viewport_height,
+                       float max_pixel_error)
+{
+   uint32_t num_lods = vkdf_model_get_num_lods(obj->model);
+   if (num_lods == 1)
+      return 0;
+
+   VkdfSphere sphere;
+   vkdf_object_get_sphere(obj, &sphere);
+   float dist = glm::length(sphere.center - vkdf_camera_get_position(cam)) -
+                sphere.radius;
+   float scale = get_max_scale(obj);
+
+   // Pixels per world-space unit at distance 'dist'. The projection's
+   // [1][1] is 1 / tan(fov_y / 2), negated if it flips Y.
+   glm::mat4 projection = vkdf_camera_get_projection_matrix(cam);
+   float pixels_per_unit = viewport_height * fabsf(projection[1][1]) /
+      (2.0f * MAX(dist, 0.0001f));
+
+   uint32_t lod = 0;
+   for (uint32_t l = 1; l < num_lods; l++) {
+      float error = vkdf_model_get_lod_error(obj->model, l) * scale;
+      if (error * pixels_per_unit > max_pixel_error)
+         break;
+      lod = l;
+   }
+
+   return lod;
+}
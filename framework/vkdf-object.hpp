@@ -1,11 +1,24 @@
 #ifndef __VKDF_OBJECT_H__
 #define __VKDF_OBJECT_H__
 
+struct _VkdfTransformStore;
+
 typedef struct {
    glm::vec3 pos;
    glm::vec3 rot;
    glm::vec3 scale;
 
+   // Model matrix as of the last call to vkdf_object_get_model_matrix().
+   // The setters below flag it as dirty so it is only recomputed after
+   // the object's transform changes.
+   bool dirty;
+   glm::mat4 model_matrix;
+
+   // Transform store the object was added to, if any, and the index of its
+   // transform in it. The setters keep the transform up to date.
+   struct _VkdfTransformStore *transforms;
+   uint32_t transform_idx;
+
    VkdfModel *model;
 
    // In theory each mesh in a model has at most 1 material. However, it is
@@ -26,25 +39,31 @@ vkdf_object_new(const glm::vec3 &pos, VkdfModel *model);
 void
 vkdf_object_free(VkdfObject *obj);
 
-inline void
-vkdf_object_set_position(VkdfObject *obj, const glm::vec3 &pos)
-{
-   obj->pos = pos;
-}
+void
+vkdf_object_set_position(VkdfObject *obj, const glm::vec3 &pos);
 
-inline void
-vkdf_object_set_rotation(VkdfObject *obj, const glm::vec3 &rot)
-{
-   obj->rot = rot;
-}
+void
+vkdf_object_set_rotation(VkdfObject *obj, const glm::vec3 &rot);
 
-inline void
-vkdf_object_set_scale(VkdfObject *obj, const glm::vec3 &scale)
-{
-   obj->scale = scale;
-}
+void
+vkdf_object_set_scale(VkdfObject *obj, const glm::vec3 &scale);
 
 glm::mat4
 vkdf_object_get_model_matrix(VkdfObject *obj);
 
+int32_t
+vkdf_object_get_material_idx(VkdfObject *obj, VkdfMesh *mesh);
+
+void
+vkdf_object_get_box(VkdfObject *obj, VkdfBox *box);
+
+void
+vkdf_object_get_sphere(VkdfObject *obj, VkdfSphere *sphere);
+
+uint32_t
+vkdf_object_select_lod(VkdfObject *obj,
+                       VkdfCamera *cam,
+                       float viewport_height,
+                       float max_pixel_error);
+
 #endif
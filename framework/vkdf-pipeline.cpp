@@ -15,6 +15,8 @@ vkdf_create_gfx_pipeline(VkdfContext *ctx,
                          VkShaderModule vs_module,
                          VkShaderModule fs_module)
 {
+   VKDF_TRACE_SCOPE("vkdf_create_gfx_pipeline");
+
    VkPipeline pipeline;
 
    // Vertex input
@@ -0,0 +1,343 @@
+#include "vkdf.hpp"
+
+static const VkQueryPipelineStatisticFlags pipeline_stat_flags =
+   VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+   VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+   VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+   VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+   VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+static const char *pipeline_stat_names[VKDF_QUERY_STAT_COUNT] = {
+   "IA vertices",
+   "IA primitives",
+   "VS invocations",
+   "Clipping primitives",
+   "FS invocations",
+};
+
+static inline uint32_t
+query_index(VkdfQueryPool *qp, uint32_t set, uint32_t scope)
+{
+   assert(set < qp->num_sets);
+   assert(scope < qp->scopes.size());
+   return (set * qp->max_scopes + scope) * qp->queries_per_scope;
+}
+
+static inline uint32_t
+query_count(VkdfQueryPool *qp)
+{
+   return qp->max_scopes * qp->num_sets * qp->queries_per_scope;
+}
+
+/**
+ * Queries are in an undefined state after creation so we reset the whole
+ * pool once here. This way vkdf_query_pool_collect() can be called on sets
+ * that have never been submitted and simply find them unavailable.
+ *
+ * For timestamp pools we also write a timestamp to the extra query at the
+ * end of the pool and pair it with the CPU clock halfway through the
+ * submission, which gives us the offset between both clocks with an error
+ * bounded by the submission latency.
+ */
+static void
+reset_all_queries(VkdfContext *ctx, VkdfQueryPool *qp)
+{
+   VkCommandPool cmd_pool =
+      vkdf_create_gfx_command_pool(ctx, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+   VkCommandBuffer cmd_buf;
+   vkdf_create_command_buffer(ctx, cmd_pool,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1, &cmd_buf);
+
+   vkdf_command_buffer_begin(cmd_buf,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+   const bool is_timestamp = qp->type == VK_QUERY_TYPE_TIMESTAMP;
+   const uint32_t count = query_count(qp);
+   vkCmdResetQueryPool(cmd_buf, qp->pool, 0, count + (is_timestamp ? 1 : 0));
+   if (is_timestamp) {
+      vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          qp->pool, count);
+   }
+   vkdf_command_buffer_end(cmd_buf);
+
+   uint64_t cpu_start_ns = vkdf_trace_now_ns();
+   vkdf_command_buffer_execute_sync(ctx, cmd_buf,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+   uint64_t cpu_end_ns = vkdf_trace_now_ns();
+
+   if (is_timestamp) {
+      uint64_t ticks;
+      VK_CHECK(vkGetQueryPoolResults(ctx->device, qp->pool, count, 1,
+                                     sizeof(uint64_t), &ticks,
+                                     sizeof(uint64_t),
+                                     VK_QUERY_RESULT_64_BIT |
+                                     VK_QUERY_RESULT_WAIT_BIT));
+      qp->gpu_base_ticks = ticks & qp->timestamp_mask;
+      qp->cpu_base_ns = cpu_start_ns + (cpu_end_ns - cpu_start_ns) / 2;
+   }
+
+   vkDestroyCommandPool(ctx->device, cmd_pool, NULL);
+}
+
+// Timestamps are always taken after calibration, so masking the difference
+// also takes care of counters that wrapped around since then.
+static inline uint64_t
+timestamp_to_cpu_ns(VkdfQueryPool *qp, uint64_t ticks)
+{
+   uint64_t delta = (ticks - qp->gpu_base_ticks) & qp->timestamp_mask;
+   return qp->cpu_base_ns + (uint64_t) (delta * qp->timestamp_period);
+}
+
+VkdfQueryPool *
+vkdf_query_pool_new(VkdfContext *ctx,
+                    VkQueryType type,
+                    uint32_t max_scopes,
+                    uint32_t num_sets)
+{
+   assert(max_scopes > 0 && num_sets > 0);
+
+   VkdfQueryPool *qp = g_new0(VkdfQueryPool, 1);
+   qp->scopes = std::vector<VkdfQueryScope>();
+   qp->type = type;
+   qp->max_scopes = max_scopes;
+   qp->num_sets = num_sets;
+   qp->queries_per_scope = 1;
+
+   switch (type) {
+   case VK_QUERY_TYPE_OCCLUSION:
+      qp->supported = true;
+      qp->num_results = 1;
+      if (ctx->device_features.occlusionQueryPrecise)
+         qp->control_flags = VK_QUERY_CONTROL_PRECISE_BIT;
+      break;
+   case VK_QUERY_TYPE_PIPELINE_STATISTICS:
+      qp->supported = ctx->device_features.pipelineStatisticsQuery;
+      qp->num_results = VKDF_QUERY_STAT_COUNT;
+      qp->stat_flags = pipeline_stat_flags;
+      break;
+   case VK_QUERY_TYPE_TIMESTAMP: {
+      uint32_t valid_bits =
+         ctx->queues[ctx->gfx_queue_index].timestampValidBits;
+      qp->supported = valid_bits > 0;
+      qp->num_results = 1;
+      qp->queries_per_scope = 2;
+      qp->timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+      qp->timestamp_period = ctx->phy_device_props.limits.timestampPeriod;
+      break;
+   }
+   default:
+      vkdf_fatal("Unsupported query type");
+   }
+
+   if (!qp->supported) {
+      vkdf_info("Query type not supported by the device. "
+                "Query collection disabled.\n");
+      return qp;
+   }
+
+   VkQueryPoolCreateInfo info;
+   info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+   info.pNext = NULL;
+   info.flags = 0;
+   info.queryType = type;
+   // Timestamp pools have an extra query for clock calibration
+   info.queryCount =
+      query_count(qp) + (type == VK_QUERY_TYPE_TIMESTAMP ? 1 : 0);
+   info.pipelineStatistics = qp->stat_flags;
+
+   VK_CHECK(vkCreateQueryPool(ctx->device, &info, NULL, &qp->pool));
+
+   reset_all_queries(ctx, qp);
+
+   return qp;
+}
+
+void
+vkdf_query_pool_free(VkdfContext *ctx, VkdfQueryPool *qp)
+{
+   for (uint32_t i = 0; i < qp->scopes.size(); i++)
+      g_free(qp->scopes[i].name);
+   qp->scopes.clear();
+   std::vector<VkdfQueryScope>(qp->scopes).swap(qp->scopes);
+
+   if (qp->pool)
+      vkDestroyQueryPool(ctx->device, qp->pool, NULL);
+
+   g_free(qp);
+}
+
+uint32_t
+vkdf_query_pool_add_scope(VkdfQueryPool *qp, const char *name)
+{
+   assert(qp->scopes.size() < qp->max_scopes);
+
+   VkdfQueryScope scope;
+   memset(&scope, 0, sizeof(VkdfQueryScope));
+   scope.name = g_strdup(name);
+   qp->scopes.push_back(scope);
+
+   return qp->scopes.size() - 1;
+}
+
+/**
+ * Must be recorded outside a render pass, before any of the scopes in
+ * the set are used in the same command buffer.
+ */
+void
+vkdf_query_pool_reset(VkdfQueryPool *qp,
+                      VkCommandBuffer cmd_buf,
+                      uint32_t set)
+{
+   if (!qp->supported)
+      return;
+
+   assert(set < qp->num_sets);
+   const uint32_t count = qp->max_scopes * qp->queries_per_scope;
+   vkCmdResetQueryPool(cmd_buf, qp->pool, set * count, count);
+}
+
+void
+vkdf_query_begin(VkdfQueryPool *qp,
+                 VkCommandBuffer cmd_buf,
+                 uint32_t set,
+                 uint32_t scope)
+{
+   if (!qp->supported)
+      return;
+
+   if (qp->type == VK_QUERY_TYPE_TIMESTAMP) {
+      vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          qp->pool, query_index(qp, set, scope));
+      return;
+   }
+
+   vkCmdBeginQuery(cmd_buf, qp->pool, query_index(qp, set, scope),
+                   qp->control_flags);
+}
+
+void
+vkdf_query_end(VkdfQueryPool *qp,
+               VkCommandBuffer cmd_buf,
+               uint32_t set,
+               uint32_t scope)
+{
+   if (!qp->supported)
+      return;
+
+   if (qp->type == VK_QUERY_TYPE_TIMESTAMP) {
+      vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          qp->pool, query_index(qp, set, scope) + 1);
+      return;
+   }
+
+   vkCmdEndQuery(cmd_buf, qp->pool, query_index(qp, set, scope));
+}
+
+/**
+ * Retrieves the results for all scopes in a set without stalling. Scopes
+ * whose results are not available yet are skipped. Call this once per
+ * submission of the set (for example, right before the command buffer
+ * that records it is submitted again), otherwise results are counted
+ * more than once.
+ *
+ * Returns the number of scopes that had results available.
+ */
+uint32_t
+vkdf_query_pool_collect(VkdfContext *ctx, VkdfQueryPool *qp, uint32_t set)
+{
+   if (!qp->supported || qp->scopes.size() == 0)
+      return 0;
+
+   assert(set < qp->num_sets);
+
+   // Each query writes its results followed by the availability value
+   const uint32_t stride = qp->num_results + 1;
+   const uint32_t num_queries = qp->queries_per_scope;
+   const uint32_t num_scopes = qp->scopes.size();
+   uint64_t data[2 * (VKDF_QUERY_MAX_RESULTS + 1)];
+   uint32_t collected = 0;
+
+   for (uint32_t s = 0; s < num_scopes; s++) {
+      VkResult res =
+         vkGetQueryPoolResults(ctx->device, qp->pool,
+                               query_index(qp, set, s), num_queries,
+                               num_queries * stride * sizeof(uint64_t), data,
+                               stride * sizeof(uint64_t),
+                               VK_QUERY_RESULT_64_BIT |
+                               VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+      if (res != VK_SUCCESS && res != VK_NOT_READY)
+         vkdf_fatal("Failed to retrieve query results");
+
+      bool available = true;
+      for (uint32_t q = 0; q < num_queries; q++)
+         available = available && data[q * stride + qp->num_results] != 0;
+      if (!available)
+         continue;
+
+      VkdfQueryScope *scope = &qp->scopes[s];
+      if (qp->type == VK_QUERY_TYPE_TIMESTAMP) {
+         uint64_t start_ns = timestamp_to_cpu_ns(qp, data[0]);
+         uint64_t end_ns = timestamp_to_cpu_ns(qp, data[stride]);
+         uint64_t time_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+         scope->last[VKDF_QUERY_RESULT_TIME_NS] = time_ns;
+         scope->total[VKDF_QUERY_RESULT_TIME_NS] += time_ns;
+         vkdf_trace_gpu_event(scope->name, start_ns, end_ns);
+      } else {
+         for (uint32_t r = 0; r < qp->num_results; r++) {
+            scope->last[r] = data[r];
+            scope->total[r] += data[r];
+         }
+      }
+      scope->samples++;
+      collected++;
+   }
+
+   return collected;
+}
+
+void
+vkdf_query_pool_clear_stats(VkdfQueryPool *qp)
+{
+   for (uint32_t s = 0; s < qp->scopes.size(); s++) {
+      VkdfQueryScope *scope = &qp->scopes[s];
+      memset(scope->total, 0, sizeof(scope->total));
+      scope->samples = 0;
+   }
+}
+
+/**
+ * Logs the average results per collected sample for each scope since the
+ * last time statistics were cleared.
+ */
+void
+vkdf_query_pool_log(VkdfQueryPool *qp)
+{
+   if (!qp->supported)
+      return;
+
+   for (uint32_t s = 0; s < qp->scopes.size(); s++) {
+      VkdfQueryScope *scope = &qp->scopes[s];
+      if (scope->samples == 0)
+         continue;
+
+      if (qp->type == VK_QUERY_TYPE_TIMESTAMP) {
+         vkdf_info("%s: GPU time: %.3f ms\n", scope->name,
+                   scope->total[VKDF_QUERY_RESULT_TIME_NS] /
+                   (scope->samples * 1000000.0));
+         continue;
+      }
+
+      if (qp->type == VK_QUERY_TYPE_OCCLUSION) {
+         vkdf_info("%s: samples passed: %" PRIu64 "\n", scope->name,
+                   scope->total[VKDF_QUERY_RESULT_SAMPLES] / scope->samples);
+         continue;
+      }
+
+      vkdf_info("%s:\n", scope->name);
+      for (uint32_t r = 0; r < qp->num_results; r++) {
+         vkdf_info("   %s: %" PRIu64 "\n", pipeline_stat_names[r],
+                   scope->total[r] / scope->samples);
+      }
+   }
+}
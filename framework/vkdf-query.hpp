@@ -0,0 +1,91 @@
+#ifndef __VKDF_QUERY_H__
+#define __VKDF_QUERY_H__
+
+// Counters collected by pipeline statistics query pools, in the order in
+// which Vulkan writes them. Occlusion pools only use VKDF_QUERY_RESULT_SAMPLES
+// and timestamp pools only use VKDF_QUERY_RESULT_TIME_NS.
+enum {
+   VKDF_QUERY_STAT_IA_VERTICES = 0,
+   VKDF_QUERY_STAT_IA_PRIMITIVES,
+   VKDF_QUERY_STAT_VS_INVOCATIONS,
+   VKDF_QUERY_STAT_CLIPPING_PRIMITIVES,
+   VKDF_QUERY_STAT_FS_INVOCATIONS,
+   VKDF_QUERY_STAT_COUNT
+};
+
+#define VKDF_QUERY_RESULT_SAMPLES 0
+#define VKDF_QUERY_RESULT_TIME_NS 0
+#define VKDF_QUERY_MAX_RESULTS VKDF_QUERY_STAT_COUNT
+
+typedef struct {
+   char *name;
+   uint64_t last[VKDF_QUERY_MAX_RESULTS];   // Last collected results
+   uint64_t total[VKDF_QUERY_MAX_RESULTS];  // Accumulated since last clear
+   uint32_t samples;                        // Results accumulated in total
+} VkdfQueryScope;
+
+/**
+ * A query pool holds one query per scope for each of 'num_sets' sets, so
+ * that a set can be recorded into a frame's command buffer while results
+ * from the other sets are still in flight. Queries for a scope in a given
+ * set start at index (set * max_scopes + scope) * queries_per_scope.
+ *
+ * Timestamp pools use two queries per scope (start and end) and convert
+ * results to the CPU trace clock so they can be merged into CPU traces.
+ */
+typedef struct {
+   VkQueryType type;
+   bool supported;
+   VkQueryPool pool;
+   VkQueryPipelineStatisticFlags stat_flags;
+   VkQueryControlFlags control_flags;
+   uint32_t num_results;
+   uint32_t queries_per_scope;
+   uint64_t timestamp_mask;
+   double timestamp_period;      // Nanoseconds per timestamp tick
+   uint64_t gpu_base_ticks;      // GPU timestamp at calibration
+   uint64_t cpu_base_ns;         // CPU trace clock at calibration
+   uint32_t max_scopes;
+   uint32_t num_sets;
+   std::vector<VkdfQueryScope> scopes;
+} VkdfQueryPool;
+
+VkdfQueryPool *
+vkdf_query_pool_new(VkdfContext *ctx,
+                    VkQueryType type,
+                    uint32_t max_scopes,
+                    uint32_t num_sets);
+
+void
+vkdf_query_pool_free(VkdfContext *ctx, VkdfQueryPool *qp);
+
+uint32_t
+vkdf_query_pool_add_scope(VkdfQueryPool *qp, const char *name);
+
+void
+vkdf_query_pool_reset(VkdfQueryPool *qp,
+                      VkCommandBuffer cmd_buf,
+                      uint32_t set);
+
+void
+vkdf_query_begin(VkdfQueryPool *qp,
+                 VkCommandBuffer cmd_buf,
+                 uint32_t set,
+                 uint32_t scope);
+
+void
+vkdf_query_end(VkdfQueryPool *qp,
+               VkCommandBuffer cmd_buf,
+               uint32_t set,
+               uint32_t scope);
+
+uint32_t
+vkdf_query_pool_collect(VkdfContext *ctx, VkdfQueryPool *qp, uint32_t set);
+
+void
+vkdf_query_pool_clear_stats(VkdfQueryPool *qp);
+
+void
+vkdf_query_pool_log(VkdfQueryPool *qp);
+
+#endif
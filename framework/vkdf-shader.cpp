@@ -28,6 +28,8 @@ vkdf_shader_read_spirv_file(const char *path, VkDeviceSize *size)
 VkShaderModule
 vkdf_create_shader_module(VkdfContext *ctx, const char *path)
 {
+   VKDF_TRACE_SCOPE("vkdf_create_shader_module");
+
    VkDeviceSize size;
    uint32_t *spirv = vkdf_shader_read_spirv_file(path, &size);
 
@@ -0,0 +1,348 @@
+#include "vkdf.hpp"
+
+#include <algorithm>
+
+VkdfStaticBatch *
+vkdf_static_batch_new()
+{
+   VkdfStaticBatch *batch = g_new0(VkdfStaticBatch, 1);
+   batch->items = std::vector<VkdfStaticBatchItem>();
+   batch->ranges = std::vector<VkdfStaticBatchRange>();
+   return batch;
+}
+
+void
+vkdf_static_batch_free(VkdfContext *ctx, VkdfStaticBatch *batch)
+{
+   if (batch->vertex_buf.buf != 0)
+      vkdf_destroy_buffer(ctx, &batch->vertex_buf);
+   if (batch->index_buf.buf != 0)
+      vkdf_destroy_buffer(ctx, &batch->index_buf);
+
+   batch->items.clear();
+   std::vector<VkdfStaticBatchItem>(batch->items).swap(batch->items);
+   batch->ranges.clear();
+   std::vector<VkdfStaticBatchRange>(batch->ranges).swap(batch->ranges);
+
+   g_free(batch);
+}
+
+static inline void
+add_item(VkdfStaticBatch *batch,
+         VkdfObject *obj,
+         uint32_t mesh_idx,
+         int32_t instance_idx)
+{
+   VkdfMesh *mesh = obj->model->meshes[mesh_idx];
+
+   if (mesh->cached && !mesh->cached_vertex_data)
+      vkdf_fatal("Static batch: mesh data is not available on the CPU");
+
+   VkdfStaticBatchItem item;
+   item.obj = obj;
+   item.mesh_idx = mesh_idx;
+   item.instance_idx = instance_idx;
+   item.material_idx = vkdf_object_get_material_idx(obj, mesh);
+   batch->items.push_back(item);
+}
+
+/**
+ * Adds all the meshes of an object (or all their placements, if the
+ * object's model has mesh instances) to the batch, with the object's
+ * current transform. Must be called before vkdf_static_batch_build().
+ */
+void
+vkdf_static_batch_add_object(VkdfStaticBatch *batch, VkdfObject *obj)
+{
+   assert(batch->vertex_buf.buf == 0);
+
+   VkdfModel *model = obj->model;
+
+   if (model->instances.size() > 0) {
+      for (uint32_t i = 0; i < model->instances.size(); i++)
+         add_item(batch, obj, model->instances[i].mesh_idx, i);
+   } else {
+      for (uint32_t m = 0; m < model->meshes.size(); m++)
+         add_item(batch, obj, m, -1);
+   }
+}
+
+static bool
+item_less(const VkdfStaticBatchItem &a, const VkdfStaticBatchItem &b)
+{
+   return a.material_idx < b.material_idx;
+}
+
+static inline uint32_t
+get_item_num_indices(VkdfMesh *mesh)
+{
+   // Meshes without indices are drawn as plain triangle lists
+   uint32_t num_indices = vkdf_mesh_get_num_indices(mesh);
+   return num_indices > 0 ? num_indices : vkdf_mesh_get_num_vertices(mesh);
+}
+
+/**
+ * Writes the mesh's vertices transformed by 'm' to 'dst' and returns the
+ * end of the data written
+ */
+static uint8_t *
+write_vertices(VkdfMesh *mesh,
+               const glm::mat4 &m,
+               bool has_uv,
+               uint32_t stride,
+               VkdfBox *box,
+               uint8_t *dst)
+{
+   const glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(m)));
+   const uint32_t num_vertices = vkdf_mesh_get_num_vertices(mesh);
+   const bool mesh_has_uv = vkdf_mesh_has_uv(mesh);
+
+   // Cached meshes keep their vertices interleaved in float format
+   const uint32_t cached_stride =
+      vkdf_vertex_format_get_stride(VKDF_VERTEX_FORMAT_FLOAT,
+                                    mesh->cached_has_uv);
+
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      glm::vec3 pos, normal;
+      glm::vec2 uv = glm::vec2(0.0f);
+      if (mesh->cached) {
+         const float *src =
+            (const float *) (mesh->cached_vertex_data + i * cached_stride);
+         pos = glm::vec3(src[0], src[1], src[2]);
+         normal = glm::vec3(src[3], src[4], src[5]);
+         if (mesh_has_uv)
+            uv = glm::vec2(src[6], src[7]);
+      } else {
+         pos = mesh->vertices[i];
+         normal = mesh->normals[i];
+         if (mesh_has_uv)
+            uv = mesh->uvs[i];
+      }
+
+      pos = glm::vec3(m * glm::vec4(pos, 1.0f));
+      normal = glm::normalize(normal_matrix * normal);
+      vkdf_box_add_point(box, pos);
+
+      float *out = (float *) dst;
+      out[0] = pos.x;
+      out[1] = pos.y;
+      out[2] = pos.z;
+      out[3] = normal.x;
+      out[4] = normal.y;
+      out[5] = normal.z;
+      if (has_uv) {
+         out[6] = uv.x;
+         out[7] = uv.y;
+      }
+      dst += stride;
+   }
+
+   return dst;
+}
+
+/**
+ * Writes the mesh's level 0 indices, offset by 'base_vertex', to 'dst'
+ * and returns the end of the data written. If 'flip' is true the winding
+ * of the triangles is reversed, for transforms that mirror the mesh.
+ */
+static uint8_t *
+write_indices(VkdfMesh *mesh,
+              uint32_t base_vertex,
+              bool flip,
+              VkIndexType index_type,
+              uint8_t *dst)
+{
+   const uint32_t num_indices = vkdf_mesh_get_num_indices(mesh);
+   const uint32_t count = get_item_num_indices(mesh);
+
+   const uint32_t *src = NULL;
+   if (num_indices > 0) {
+      src = mesh->cached ? (const uint32_t *) mesh->cached_index_data :
+                           mesh->indices.data();
+   }
+
+   for (uint32_t i = 0; i < count; i++) {
+      // Swap the last two vertices of each triangle to flip it
+      uint32_t j = i;
+      if (flip && i % 3 != 0)
+         j = i % 3 == 1 ? i + 1 : i - 1;
+
+      uint32_t index = base_vertex + (src ? src[j] : j);
+      if (index_type == VK_INDEX_TYPE_UINT16) {
+         *((uint16_t *) dst) = (uint16_t) index;
+         dst += sizeof(uint16_t);
+      } else {
+         *((uint32_t *) dst) = index;
+         dst += sizeof(uint32_t);
+      }
+   }
+
+   return dst;
+}
+
+static VkdfBuffer
+create_buffer(VkdfContext *ctx,
+              VkDeviceSize size,
+              VkBufferUsageFlags usage,
+              uint8_t **map)
+{
+   VkdfBuffer buf =
+      vkdf_create_buffer(ctx,
+                         0,
+                         size,
+                         usage,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   VK_CHECK(vkMapMemory(ctx->device, buf.mem, 0, size, 0, (void **) map));
+   return buf;
+}
+
+static void
+flush_buffer(VkdfContext *ctx, VkdfBuffer *buf, VkDeviceSize size)
+{
+   VkMappedMemoryRange range;
+   range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+   range.pNext = NULL;
+   range.memory = buf->mem;
+   range.offset = 0;
+   range.size = VK_WHOLE_SIZE;
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device, 1, &range));
+   vkUnmapMemory(ctx->device, buf->mem);
+
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES, size);
+}
+
+/**
+ * Merges the meshes of all the objects added to the batch into its vertex
+ * and index buffers, sorted by material, and creates a range for each
+ * material.
+ */
+void
+vkdf_static_batch_build(VkdfContext *ctx, VkdfStaticBatch *batch)
+{
+   VKDF_TRACE_SCOPE("vkdf_static_batch_build");
+
+   assert(batch->vertex_buf.buf == 0);
+
+   if (batch->items.size() == 0)
+      return;
+
+   std::stable_sort(batch->items.begin(), batch->items.end(), item_less);
+
+   batch->has_uv = false;
+   batch->num_vertices = 0;
+   batch->num_indices = 0;
+   for (uint32_t i = 0; i < batch->items.size(); i++) {
+      VkdfStaticBatchItem *item = &batch->items[i];
+      VkdfMesh *mesh = item->obj->model->meshes[item->mesh_idx];
+      batch->has_uv = batch->has_uv || vkdf_mesh_has_uv(mesh);
+      batch->num_vertices += vkdf_mesh_get_num_vertices(mesh);
+      batch->num_indices += get_item_num_indices(mesh);
+   }
+
+#if VKDF_MESH_16BIT_INDICES_ENABLE
+   batch->index_type = batch->num_vertices <= 65536 ?
+      VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+#else
+   batch->index_type = VK_INDEX_TYPE_UINT32;
+#endif
+
+   const uint32_t stride =
+      vkdf_vertex_format_get_stride(VKDF_VERTEX_FORMAT_FLOAT, batch->has_uv);
+   const uint32_t index_size =
+      batch->index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) :
+                                                  sizeof(uint32_t);
+   const VkDeviceSize vertex_data_size =
+      (VkDeviceSize) batch->num_vertices * stride;
+   const VkDeviceSize index_data_size =
+      (VkDeviceSize) batch->num_indices * index_size;
+
+   uint8_t *vertex_map;
+   uint8_t *index_map;
+   batch->vertex_buf = create_buffer(ctx, vertex_data_size,
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                     &vertex_map);
+   batch->index_buf = create_buffer(ctx, index_data_size,
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                    &index_map);
+
+   uint8_t *vertex_dst = vertex_map;
+   uint8_t *index_dst = index_map;
+   uint32_t base_vertex = 0;
+   uint32_t first_index = 0;
+   for (uint32_t i = 0; i < batch->items.size(); i++) {
+      VkdfStaticBatchItem *item = &batch->items[i];
+      VkdfObject *obj = item->obj;
+      VkdfMesh *mesh = obj->model->meshes[item->mesh_idx];
+
+      if (i == 0 || item->material_idx != batch->ranges.back().material_idx) {
+         VkdfStaticBatchRange range;
+         range.material_idx = item->material_idx;
+         range.first_index = first_index;
+         range.num_indices = 0;
+         vkdf_box_init_empty(&range.box);
+         batch->ranges.push_back(range);
+      }
+      VkdfStaticBatchRange *range = &batch->ranges.back();
+
+      glm::mat4 m = vkdf_object_get_model_matrix(obj);
+      if (item->instance_idx >= 0)
+         m = m * obj->model->instances[item->instance_idx].transform;
+      bool flip = glm::determinant(glm::mat3(m)) < 0.0f;
+
+      vertex_dst = write_vertices(mesh, m, batch->has_uv, stride,
+                                  &range->box, vertex_dst);
+      index_dst = write_indices(mesh, base_vertex, flip,
+                                batch->index_type, index_dst);
+
+      uint32_t num_indices = get_item_num_indices(mesh);
+      range->num_indices += num_indices;
+      first_index += num_indices;
+      base_vertex += vkdf_mesh_get_num_vertices(mesh);
+   }
+
+   flush_buffer(ctx, &batch->vertex_buf, vertex_data_size);
+   flush_buffer(ctx, &batch->index_buf, index_data_size);
+
+   // The objects may be freed from now on
+   batch->items.clear();
+   std::vector<VkdfStaticBatchItem>(batch->items).swap(batch->items);
+}
+
+/**
+ * Binds the batch's vertex buffer to 'binding' and its index buffer
+ */
+void
+vkdf_static_batch_cmd_bind(VkdfStaticBatch *batch,
+                           VkCommandBuffer cmd_buf,
+                           uint32_t binding)
+{
+   assert(batch->vertex_buf.buf != 0);
+
+   const VkDeviceSize offset = 0;
+   vkdf_cmd_bind_vertex_buffers(cmd_buf, binding, 1,
+                                &batch->vertex_buf.buf, &offset);
+   vkdf_cmd_bind_index_buffer(cmd_buf, batch->index_buf.buf, 0,
+                              batch->index_type);
+}
+
+/**
+ * Draws a range of the batch. The batch's buffers must have been bound
+ * with vkdf_static_batch_cmd_bind().
+ */
+void
+vkdf_static_batch_cmd_draw_range(VkdfStaticBatch *batch,
+                                 VkCommandBuffer cmd_buf,
+                                 uint32_t range_idx,
+                                 uint32_t instance_count,
+                                 uint32_t first_instance)
+{
+   assert(range_idx < batch->ranges.size());
+
+   const VkdfStaticBatchRange *range = &batch->ranges[range_idx];
+   vkdf_cmd_draw_indexed(cmd_buf,
+                         range->num_indices,
+                         instance_count,
+                         range->first_index,
+                         0,
+                         first_instance);
+}
@@ -0,0 +1,90 @@
+#ifndef __VKDF_STATIC_BATCH_H__
+#define __VKDF_STATIC_BATCH_H__
+
+/**
+ * Static geometry batching.
+ *
+ * Objects that never move can be merged into a few large buffers instead
+ * of being drawn one by one. vkdf_static_batch_build() transforms the
+ * meshes of all the objects added to a VkdfStaticBatch to world space
+ * with their model matrices (and their mesh instance transforms) and
+ * packs them into a single vertex buffer and a single index buffer, with
+ * the geometry of each material in a contiguous range of indices. Every
+ * range can then be drawn with one indexed draw, no matter how many
+ * objects it came from.
+ *
+ * Vertices use VKDF_VERTEX_FORMAT_FLOAT, with uvs if any of the merged
+ * meshes has them (0 for those that don't), so there is no per-mesh
+ * dequantization and shaders take positions as world-space positions.
+ * Only the full-detail level of each mesh is merged. Meshes must be
+ * triangle lists with their vertex data available on the CPU, which is
+ * the case for meshes built by hand or loaded with vkdf_model_load(),
+ * but not for meshes loaded from asset bundles.
+ *
+ * Objects are not referenced after the batch is built, and changes to
+ * them are not reflected in the batch.
+ */
+
+// The geometry of one material in a VkdfStaticBatch
+typedef struct {
+   int32_t material_idx;
+   uint32_t first_index;
+   uint32_t num_indices;
+
+   // World-space bounds of the range
+   VkdfBox box;
+} VkdfStaticBatchRange;
+
+// A mesh of an added object, or one of its placements for models with
+// mesh instances (instance_idx is -1 otherwise)
+typedef struct {
+   VkdfObject *obj;
+   uint32_t mesh_idx;
+   int32_t instance_idx;
+   int32_t material_idx;
+} VkdfStaticBatchItem;
+
+typedef struct {
+   std::vector<VkdfStaticBatchItem> items;
+   std::vector<VkdfStaticBatchRange> ranges;
+
+   bool has_uv;
+   uint32_t num_vertices;
+   uint32_t num_indices;
+   VkIndexType index_type;
+
+   VkdfBuffer vertex_buf;
+   VkdfBuffer index_buf;
+} VkdfStaticBatch;
+
+VkdfStaticBatch *
+vkdf_static_batch_new();
+
+void
+vkdf_static_batch_free(VkdfContext *ctx, VkdfStaticBatch *batch);
+
+void
+vkdf_static_batch_add_object(VkdfStaticBatch *batch, VkdfObject *obj);
+
+void
+vkdf_static_batch_build(VkdfContext *ctx, VkdfStaticBatch *batch);
+
+void
+vkdf_static_batch_cmd_bind(VkdfStaticBatch *batch,
+                           VkCommandBuffer cmd_buf,
+                           uint32_t binding);
+
+void
+vkdf_static_batch_cmd_draw_range(VkdfStaticBatch *batch,
+                                 VkCommandBuffer cmd_buf,
+                                 uint32_t range_idx,
+                                 uint32_t instance_count,
+                                 uint32_t first_instance);
+
+inline uint32_t
+vkdf_static_batch_get_num_ranges(VkdfStaticBatch *batch)
+{
+   return batch->ranges.size();
+}
+
+#endif
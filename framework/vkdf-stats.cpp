@@ -0,0 +1,214 @@
+#include "vkdf.hpp"
+
+// Number of frames accumulated before logging stats with
+// VKDF_LOG_STATS_ENABLE
+#define STATS_LOG_FRAMES 60
+
+static const char *stat_names[VKDF_STAT_COUNT] = {
+   "draws",
+   "indexed draws",
+   "indirect draws",
+   "instances",
+   "pipeline binds",
+   "descriptor set binds",
+   "vertex buffer binds",
+   "index buffer binds",
+   "submits",
+   "bytes uploaded",
+};
+
+static GMutex _stats_mutex;
+
+// Counters for the frame being recorded / submitted and for the last frame
+// closed with vkdf_stats_frame_end()
+static VkdfStats _frame_stats;
+static VkdfStats _last_frame_stats;
+
+// Per-frame budgets, 0 means no budget. Violations are only logged the first
+// time for each counter, but they are always counted.
+static uint64_t _budgets[VKDF_STAT_COUNT];
+static bool _budget_reported[VKDF_STAT_COUNT];
+static uint32_t _budget_violations = 0;
+
+#if VKDF_LOG_STATS_ENABLE
+static VkdfStats _log_stats;
+static uint32_t _log_frames = 0;
+#endif
+
+static inline void
+stats_add(VkdfStats *dst, const VkdfStats *src)
+{
+   for (uint32_t i = 0; i < VKDF_STAT_COUNT; i++)
+      dst->counters[i] += src->counters[i];
+}
+
+#if VKDF_STATS_ENABLE
+
+// Counters recorded into each command buffer, indexed by VkCommandBuffer.
+// Entries are never removed: command buffer handles that are freed and
+// reused by the driver are reset by vkdf_command_buffer_begin().
+static GHashTable *_cmd_buf_stats = NULL;
+
+// Recording a command buffer usually happens from a single thread, so cache
+// the last lookup to skip the mutex and the hash table for every command.
+static thread_local VkCommandBuffer _last_cmd_buf = NULL;
+static thread_local VkdfStats *_last_cmd_buf_stats = NULL;
+
+static VkdfStats *
+get_cmd_buf_stats(VkCommandBuffer cmd_buf)
+{
+   if (G_LIKELY(cmd_buf == _last_cmd_buf))
+      return _last_cmd_buf_stats;
+
+   g_mutex_lock(&_stats_mutex);
+   if (!_cmd_buf_stats)
+      _cmd_buf_stats = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+   VkdfStats *stats =
+      (VkdfStats *) g_hash_table_lookup(_cmd_buf_stats, cmd_buf);
+   if (!stats) {
+      stats = g_new0(VkdfStats, 1);
+      g_hash_table_insert(_cmd_buf_stats, cmd_buf, stats);
+   }
+   g_mutex_unlock(&_stats_mutex);
+
+   _last_cmd_buf = cmd_buf;
+   _last_cmd_buf_stats = stats;
+
+   return stats;
+}
+
+void
+_vkdf_stats_cmd_count(VkCommandBuffer cmd_buf, VkdfStat stat, uint64_t n)
+{
+   get_cmd_buf_stats(cmd_buf)->counters[stat] += n;
+}
+
+void
+_vkdf_stats_cmd_buf_reset(VkCommandBuffer cmd_buf)
+{
+   memset(get_cmd_buf_stats(cmd_buf), 0, sizeof(VkdfStats));
+}
+
+void
+_vkdf_stats_cmd_buf_submitted(VkCommandBuffer cmd_buf)
+{
+   VkdfStats *stats = get_cmd_buf_stats(cmd_buf);
+
+   g_mutex_lock(&_stats_mutex);
+   stats_add(&_frame_stats, stats);
+   g_mutex_unlock(&_stats_mutex);
+}
+
+void
+_vkdf_stats_count(VkdfStat stat, uint64_t n)
+{
+   g_mutex_lock(&_stats_mutex);
+   _frame_stats.counters[stat] += n;
+   g_mutex_unlock(&_stats_mutex);
+}
+
+#endif
+
+/**
+ * Discards the counters accumulated for the current frame. The event loop
+ * calls this before the first frame so that work done during initialization
+ * is not accounted to it.
+ */
+void
+vkdf_stats_reset()
+{
+   g_mutex_lock(&_stats_mutex);
+   memset(&_frame_stats, 0, sizeof(VkdfStats));
+   g_mutex_unlock(&_stats_mutex);
+}
+
+void
+vkdf_stats_frame_end()
+{
+   g_mutex_lock(&_stats_mutex);
+   _last_frame_stats = _frame_stats;
+   memset(&_frame_stats, 0, sizeof(VkdfStats));
+   g_mutex_unlock(&_stats_mutex);
+
+   vkdf_stats_check_budgets(&_last_frame_stats);
+
+#if VKDF_LOG_STATS_ENABLE
+   stats_add(&_log_stats, &_last_frame_stats);
+   if (++_log_frames == STATS_LOG_FRAMES) {
+      vkdf_stats_log(&_log_stats, _log_frames);
+      memset(&_log_stats, 0, sizeof(VkdfStats));
+      _log_frames = 0;
+   }
+#endif
+}
+
+/**
+ * Counters for the last frame closed with vkdf_stats_frame_end().
+ */
+const VkdfStats *
+vkdf_stats_get_last_frame()
+{
+   return &_last_frame_stats;
+}
+
+/**
+ * Sets the maximum value a counter is allowed to reach in a single frame.
+ * Use 0 to remove the budget.
+ */
+void
+vkdf_stats_set_budget(VkdfStat stat, uint64_t max_per_frame)
+{
+   assert(stat < VKDF_STAT_COUNT);
+   _budgets[stat] = max_per_frame;
+   _budget_reported[stat] = false;
+}
+
+/**
+ * Returns the number of counters in 'stats' that exceed their budget.
+ * vkdf_stats_frame_end() checks every frame against the budgets and keeps
+ * a running count of violations (see vkdf_stats_get_budget_violations()).
+ */
+uint32_t
+vkdf_stats_check_budgets(const VkdfStats *stats)
+{
+   uint32_t violations = 0;
+
+   for (uint32_t i = 0; i < VKDF_STAT_COUNT; i++) {
+      if (_budgets[i] == 0 || stats->counters[i] <= _budgets[i])
+         continue;
+
+      violations++;
+      if (!_budget_reported[i]) {
+         vkdf_error("Stats: %s per frame over budget: %" PRIu64
+                    " > %" PRIu64,
+                    stat_names[i], stats->counters[i], _budgets[i]);
+         _budget_reported[i] = true;
+      }
+   }
+
+   _budget_violations += violations;
+   return violations;
+}
+
+uint32_t
+vkdf_stats_get_budget_violations()
+{
+   return _budget_violations;
+}
+
+/**
+ * Logs the per-frame average of the counters in 'stats', which accumulate
+ * 'num_frames' frames.
+ */
+void
+vkdf_stats_log(const VkdfStats *stats, uint32_t num_frames)
+{
+   assert(num_frames > 0);
+
+   vkdf_info("Stats (per frame, %u frames):\n", num_frames);
+   for (uint32_t i = 0; i < VKDF_STAT_COUNT; i++) {
+      vkdf_info("   %s: %.1f\n",
+                stat_names[i], stats->counters[i] / (double) num_frames);
+   }
+}
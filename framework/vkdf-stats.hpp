@@ -0,0 +1,188 @@
+#ifndef __VKDF_STATS_H__
+#define __VKDF_STATS_H__
+
+/**
+ * Per-frame counters for command recording and uploads.
+ *
+ * Commands recorded through the vkdf_cmd_* wrappers below are counted per
+ * command buffer (counts are reset by vkdf_command_buffer_begin()) and are
+ * added to the current frame every time the command buffer is submitted
+ * with vkdf_command_buffer_execute(), vkdf_command_buffer_execute_sync() or
+ * a VkdfSubmitBatch, so pre-recorded command buffers are accounted for
+ * each time they are used. Uploads through the framework's buffer fill
+ * paths are added to the current frame directly.
+ *
+ * The event loop closes a frame with vkdf_stats_frame_end() on every
+ * iteration. Applications that do not use the event loop (like
+ * benchmarks) should call it themselves.
+ */
+typedef enum {
+   VKDF_STAT_DRAW = 0,
+   VKDF_STAT_DRAW_INDEXED,
+   VKDF_STAT_DRAW_INDIRECT,         // draws issued through indirect buffers
+   VKDF_STAT_INSTANCES,
+   VKDF_STAT_BIND_PIPELINE,
+   VKDF_STAT_BIND_DESCRIPTOR_SETS,
+   VKDF_STAT_BIND_VERTEX_BUFFERS,
+   VKDF_STAT_BIND_INDEX_BUFFER,
+   VKDF_STAT_SUBMITS,               // vkQueueSubmit calls
+   VKDF_STAT_UPLOAD_BYTES,
+   VKDF_STAT_COUNT
+} VkdfStat;
+
+typedef struct {
+   uint64_t counters[VKDF_STAT_COUNT];
+} VkdfStats;
+
+#if VKDF_STATS_ENABLE
+
+void
+_vkdf_stats_cmd_count(VkCommandBuffer cmd_buf, VkdfStat stat, uint64_t n);
+
+void
+_vkdf_stats_cmd_buf_reset(VkCommandBuffer cmd_buf);
+
+void
+_vkdf_stats_cmd_buf_submitted(VkCommandBuffer cmd_buf);
+
+void
+_vkdf_stats_count(VkdfStat stat, uint64_t n);
+
+#else
+
+static inline void
+_vkdf_stats_cmd_count(VkCommandBuffer cmd_buf, VkdfStat stat, uint64_t n) { }
+
+static inline void
+_vkdf_stats_cmd_buf_reset(VkCommandBuffer cmd_buf) { }
+
+static inline void
+_vkdf_stats_cmd_buf_submitted(VkCommandBuffer cmd_buf) { }
+
+static inline void
+_vkdf_stats_count(VkdfStat stat, uint64_t n) { }
+
+#endif
+
+void
+vkdf_stats_reset();
+
+void
+vkdf_stats_frame_end();
+
+const VkdfStats *
+vkdf_stats_get_last_frame();
+
+void
+vkdf_stats_set_budget(VkdfStat stat, uint64_t max_per_frame);
+
+uint32_t
+vkdf_stats_check_budgets(const VkdfStats *stats);
+
+uint32_t
+vkdf_stats_get_budget_violations();
+
+void
+vkdf_stats_log(const VkdfStats *stats, uint32_t num_frames);
+
+// Command recording wrappers
+
+static inline void
+vkdf_cmd_draw(VkCommandBuffer cmd_buf,
+              uint32_t vertex_count,
+              uint32_t instance_count,
+              uint32_t first_vertex,
+              uint32_t first_instance)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_DRAW, 1);
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_INSTANCES, instance_count);
+   vkCmdDraw(cmd_buf, vertex_count, instance_count,
+             first_vertex, first_instance);
+}
+
+static inline void
+vkdf_cmd_draw_indexed(VkCommandBuffer cmd_buf,
+                      uint32_t index_count,
+                      uint32_t instance_count,
+                      uint32_t first_index,
+                      int32_t vertex_offset,
+                      uint32_t first_instance)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_DRAW_INDEXED, 1);
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_INSTANCES, instance_count);
+   vkCmdDrawIndexed(cmd_buf, index_count, instance_count,
+                    first_index, vertex_offset, first_instance);
+}
+
+// Instances drawn through indirect buffers are not known when recording,
+// so they are not counted
+static inline void
+vkdf_cmd_draw_indirect(VkCommandBuffer cmd_buf,
+                       VkBuffer buffer,
+                       VkDeviceSize offset,
+                       uint32_t draw_count,
+                       uint32_t stride)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_DRAW_INDIRECT, draw_count);
+   vkCmdDrawIndirect(cmd_buf, buffer, offset, draw_count, stride);
+}
+
+static inline void
+vkdf_cmd_draw_indexed_indirect(VkCommandBuffer cmd_buf,
+                               VkBuffer buffer,
+                               VkDeviceSize offset,
+                               uint32_t draw_count,
+                               uint32_t stride)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_DRAW_INDIRECT, draw_count);
+   vkCmdDrawIndexedIndirect(cmd_buf, buffer, offset, draw_count, stride);
+}
+
+static inline void
+vkdf_cmd_bind_pipeline(VkCommandBuffer cmd_buf,
+                       VkPipelineBindPoint bind_point,
+                       VkPipeline pipeline)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_BIND_PIPELINE, 1);
+   vkCmdBindPipeline(cmd_buf, bind_point, pipeline);
+}
+
+static inline void
+vkdf_cmd_bind_descriptor_sets(VkCommandBuffer cmd_buf,
+                              VkPipelineBindPoint bind_point,
+                              VkPipelineLayout layout,
+                              uint32_t first_set,
+                              uint32_t set_count,
+                              const VkDescriptorSet *sets,
+                              uint32_t dynamic_offset_count,
+                              const uint32_t *dynamic_offsets)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_BIND_DESCRIPTOR_SETS, 1);
+   vkCmdBindDescriptorSets(cmd_buf, bind_point, layout, first_set,
+                           set_count, sets,
+                           dynamic_offset_count, dynamic_offsets);
+}
+
+static inline void
+vkdf_cmd_bind_vertex_buffers(VkCommandBuffer cmd_buf,
+                             uint32_t first_binding,
+                             uint32_t binding_count,
+                             const VkBuffer *buffers,
+                             const VkDeviceSize *offsets)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_BIND_VERTEX_BUFFERS, 1);
+   vkCmdBindVertexBuffers(cmd_buf, first_binding, binding_count,
+                          buffers, offsets);
+}
+
+static inline void
+vkdf_cmd_bind_index_buffer(VkCommandBuffer cmd_buf,
+                           VkBuffer buffer,
+                           VkDeviceSize offset,
+                           VkIndexType index_type)
+{
+   _vkdf_stats_cmd_count(cmd_buf, VKDF_STAT_BIND_INDEX_BUFFER, 1);
+   vkCmdBindIndexBuffer(cmd_buf, buffer, offset, index_type);
+}
+
+#endif
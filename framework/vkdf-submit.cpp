@@ -0,0 +1,164 @@
+#include "vkdf.hpp"
+
+VkdfSubmitBatch *
+vkdf_submit_batch_new(VkdfContext *ctx, VkQueue queue)
+{
+   VkdfSubmitBatch *batch = g_new0(VkdfSubmitBatch, 1);
+   batch->wait_sems = std::vector<VkSemaphore>();
+   batch->wait_stages = std::vector<VkPipelineStageFlags>();
+   batch->cmd_bufs = std::vector<VkCommandBuffer>();
+   batch->signal_sems = std::vector<VkSemaphore>();
+   batch->ranges = std::vector<VkdfSubmitInfoRange>();
+   batch->submit_infos = std::vector<VkSubmitInfo>();
+   batch->queue = queue;
+
+   // Used by vkdf_submit_batch_flush_sync() so we don't have to create
+   // a new fence for every synchronous flush
+   VkFenceCreateInfo fence_info = { };
+   fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+   fence_info.pNext = NULL;
+   fence_info.flags = 0;
+   VK_CHECK(vkCreateFence(ctx->device, &fence_info, NULL, &batch->fence));
+
+   return batch;
+}
+
+void
+vkdf_submit_batch_free(VkdfContext *ctx, VkdfSubmitBatch *batch)
+{
+   batch->wait_sems.clear();
+   std::vector<VkSemaphore>(batch->wait_sems).swap(batch->wait_sems);
+   batch->wait_stages.clear();
+   std::vector<VkPipelineStageFlags>(batch->wait_stages).swap(
+      batch->wait_stages);
+   batch->cmd_bufs.clear();
+   std::vector<VkCommandBuffer>(batch->cmd_bufs).swap(batch->cmd_bufs);
+   batch->signal_sems.clear();
+   std::vector<VkSemaphore>(batch->signal_sems).swap(batch->signal_sems);
+   batch->ranges.clear();
+   std::vector<VkdfSubmitInfoRange>(batch->ranges).swap(batch->ranges);
+   batch->submit_infos.clear();
+   std::vector<VkSubmitInfo>(batch->submit_infos).swap(batch->submit_infos);
+
+   vkDestroyFence(ctx->device, batch->fence, NULL);
+
+   g_free(batch);
+}
+
+static VkdfSubmitInfoRange *
+new_range(VkdfSubmitBatch *batch)
+{
+   VkdfSubmitInfoRange range;
+   range.first_wait = batch->wait_sems.size();
+   range.wait_count = 0;
+   range.first_cmd_buf = batch->cmd_bufs.size();
+   range.cmd_buf_count = 0;
+   range.first_signal = batch->signal_sems.size();
+   range.signal_count = 0;
+   batch->ranges.push_back(range);
+
+   return &batch->ranges.back();
+}
+
+/**
+ * Queues 'cmd_buf' for submission in the next flush. Command buffers
+ * execute in the order in which they are added. 'wait_stages' has one
+ * stage mask for each of the 'wait_sems'.
+ */
+void
+vkdf_submit_batch_add(VkdfSubmitBatch *batch,
+                      VkCommandBuffer cmd_buf,
+                      uint32_t wait_sem_count,
+                      const VkSemaphore *wait_sems,
+                      const VkPipelineStageFlags *wait_stages,
+                      uint32_t signal_sem_count,
+                      const VkSemaphore *signal_sems)
+{
+   // We can only append to the last VkSubmitInfo if it doesn't signal
+   // anything (the signal would have to move after this command buffer)
+   // and this command buffer doesn't wait on anything (the wait would have
+   // to move before the command buffers already in the VkSubmitInfo).
+   VkdfSubmitInfoRange *range;
+   if (batch->ranges.size() > 0 &&
+       batch->ranges.back().signal_count == 0 &&
+       wait_sem_count == 0) {
+      range = &batch->ranges.back();
+   } else {
+      range = new_range(batch);
+   }
+
+   for (uint32_t i = 0; i < wait_sem_count; i++) {
+      batch->wait_sems.push_back(wait_sems[i]);
+      batch->wait_stages.push_back(wait_stages[i]);
+   }
+   range->wait_count += wait_sem_count;
+
+   batch->cmd_bufs.push_back(cmd_buf);
+   range->cmd_buf_count++;
+
+   for (uint32_t i = 0; i < signal_sem_count; i++)
+      batch->signal_sems.push_back(signal_sems[i]);
+   range->signal_count += signal_sem_count;
+}
+
+/**
+ * Submits everything added since the last flush with a single
+ * vkQueueSubmit. If 'fence' is not NULL it is signaled when all the
+ * command buffers in the batch have completed.
+ */
+void
+vkdf_submit_batch_flush(VkdfSubmitBatch *batch, VkFence fence)
+{
+   if (batch->ranges.size() == 0 && !fence)
+      return;
+
+   // Pointers into the arrays are only stable once we stop adding to them,
+   // so the VkSubmitInfos are only built here
+   batch->submit_infos.resize(batch->ranges.size());
+   for (uint32_t i = 0; i < batch->ranges.size(); i++) {
+      VkdfSubmitInfoRange *range = &batch->ranges[i];
+      VkSubmitInfo *info = &batch->submit_infos[i];
+
+      info->sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      info->pNext = NULL;
+      info->waitSemaphoreCount = range->wait_count;
+      info->pWaitSemaphores = range->wait_count > 0 ?
+         &batch->wait_sems[range->first_wait] : NULL;
+      info->pWaitDstStageMask = range->wait_count > 0 ?
+         &batch->wait_stages[range->first_wait] : NULL;
+      info->commandBufferCount = range->cmd_buf_count;
+      info->pCommandBuffers = &batch->cmd_bufs[range->first_cmd_buf];
+      info->signalSemaphoreCount = range->signal_count;
+      info->pSignalSemaphores = range->signal_count > 0 ?
+         &batch->signal_sems[range->first_signal] : NULL;
+   }
+
+   VK_CHECK(vkQueueSubmit(batch->queue,
+                          batch->submit_infos.size(),
+                          batch->submit_infos.size() > 0 ?
+                             &batch->submit_infos[0] : NULL,
+                          fence));
+
+   for (uint32_t i = 0; i < batch->cmd_bufs.size(); i++)
+      _vkdf_stats_cmd_buf_submitted(batch->cmd_bufs[i]);
+   _vkdf_stats_count(VKDF_STAT_SUBMITS, 1);
+
+   batch->wait_sems.clear();
+   batch->wait_stages.clear();
+   batch->cmd_bufs.clear();
+   batch->signal_sems.clear();
+   batch->ranges.clear();
+   batch->submit_infos.clear();
+}
+
+/**
+ * Like vkdf_submit_batch_flush() but waits for the batch to complete
+ */
+void
+vkdf_submit_batch_flush_sync(VkdfContext *ctx, VkdfSubmitBatch *batch)
+{
+   vkdf_submit_batch_flush(batch, batch->fence);
+   VK_CHECK(vkWaitForFences(ctx->device, 1, &batch->fence,
+                            true, 100000000000ull));
+   VK_CHECK(vkResetFences(ctx->device, 1, &batch->fence));
+}
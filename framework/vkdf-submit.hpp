@@ -0,0 +1,59 @@
+#ifndef __VKDF_SUBMIT_H__
+#define __VKDF_SUBMIT_H__
+
+#include <vector>
+
+// Ranges of the batch arrays used by a single VkSubmitInfo
+typedef struct {
+   uint32_t first_wait;
+   uint32_t wait_count;
+   uint32_t first_cmd_buf;
+   uint32_t cmd_buf_count;
+   uint32_t first_signal;
+   uint32_t signal_count;
+} VkdfSubmitInfoRange;
+
+/**
+ * Collects command buffers and the semaphores they wait on / signal across
+ * a frame and submits all of them with a single vkQueueSubmit.
+ *
+ * Consecutive command buffers are packed into the same VkSubmitInfo as long
+ * as that doesn't change synchronization: a VkSubmitInfo waits for all its
+ * semaphores before any of its command buffers executes and only signals
+ * after all of them complete, so a new VkSubmitInfo is started when a
+ * command buffer needs to wait on semaphores or the previous one has to
+ * signal semaphores.
+ */
+typedef struct {
+   VkQueue queue;
+   VkFence fence;
+   std::vector<VkSemaphore> wait_sems;
+   std::vector<VkPipelineStageFlags> wait_stages;
+   std::vector<VkCommandBuffer> cmd_bufs;
+   std::vector<VkSemaphore> signal_sems;
+   std::vector<VkdfSubmitInfoRange> ranges;
+   std::vector<VkSubmitInfo> submit_infos;
+} VkdfSubmitBatch;
+
+VkdfSubmitBatch *
+vkdf_submit_batch_new(VkdfContext *ctx, VkQueue queue);
+
+void
+vkdf_submit_batch_free(VkdfContext *ctx, VkdfSubmitBatch *batch);
+
+void
+vkdf_submit_batch_add(VkdfSubmitBatch *batch,
+                      VkCommandBuffer cmd_buf,
+                      uint32_t wait_sem_count,
+                      const VkSemaphore *wait_sems,
+                      const VkPipelineStageFlags *wait_stages,
+                      uint32_t signal_sem_count,
+                      const VkSemaphore *signal_sems);
+
+void
+vkdf_submit_batch_flush(VkdfSubmitBatch *batch, VkFence fence);
+
+void
+vkdf_submit_batch_flush_sync(VkdfContext *ctx, VkdfSubmitBatch *batch);
+
+#endif
@@ -0,0 +1,204 @@
+#include "vkdf.hpp"
+
+#if VKDF_TRACE_ENABLE
+
+#include <atomic>
+
+// Must be a power of two
+#define TRACE_RING_SIZE (1 << 16)
+
+#define TRACE_DEFAULT_OUTPUT "vkdf-trace.json"
+
+typedef struct {
+   const char *name;
+   uint64_t start_ns;
+   uint64_t end_ns;
+   bool gpu;
+} TraceEvent;
+
+/**
+ * Single producer / single consumer ring. The owning thread is the only
+ * producer and only moves 'head', the flush code is the only consumer and
+ * only moves 'tail'. When the ring is full new events are dropped instead
+ * of overwriting old ones that may be being read.
+ */
+typedef struct {
+   TraceEvent events[TRACE_RING_SIZE];
+   std::atomic<uint32_t> head;
+   std::atomic<uint32_t> tail;
+   std::atomic<uint64_t> dropped;
+   uint32_t tid;
+} TraceRing;
+
+static GMutex _trace_mutex;
+static std::vector<TraceRing *> _trace_rings;
+static uint64_t _trace_base_ns = 0;
+static char *_trace_path = NULL;
+static FILE *_trace_file = NULL;
+
+static thread_local TraceRing *_thread_ring = NULL;
+
+static void trace_finish();
+
+static TraceRing *
+register_thread_ring()
+{
+   TraceRing *ring = g_new0(TraceRing, 1);
+   ring->head.store(0);
+   ring->tail.store(0);
+   ring->dropped.store(0);
+
+   g_mutex_lock(&_trace_mutex);
+   if (_trace_rings.size() == 0) {
+      _trace_base_ns = vkdf_trace_now_ns();
+      atexit(trace_finish);
+   }
+   ring->tid = _trace_rings.size() + 1;
+   _trace_rings.push_back(ring);
+   g_mutex_unlock(&_trace_mutex);
+
+   return ring;
+}
+
+static inline void
+trace_push(const char *name, uint64_t start_ns, uint64_t end_ns, bool gpu)
+{
+   TraceRing *ring = _thread_ring;
+   if (G_UNLIKELY(!ring))
+      ring = _thread_ring = register_thread_ring();
+
+   uint32_t head = ring->head.load(std::memory_order_relaxed);
+   uint32_t tail = ring->tail.load(std::memory_order_acquire);
+   if (head - tail >= TRACE_RING_SIZE) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+   }
+
+   TraceEvent *ev = &ring->events[head & (TRACE_RING_SIZE - 1)];
+   ev->name = name;
+   ev->start_ns = start_ns;
+   ev->end_ns = end_ns;
+   ev->gpu = gpu;
+
+   ring->head.store(head + 1, std::memory_order_release);
+}
+
+void
+vkdf_trace_cpu_event(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+   trace_push(name, start_ns, end_ns, false);
+}
+
+/**
+ * GPU scope names usually belong to query pools that can be destroyed
+ * before the trace is flushed, so we keep interned copies.
+ */
+void
+vkdf_trace_gpu_event(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+   trace_push(g_intern_string(name), start_ns, end_ns, true);
+}
+
+void
+vkdf_trace_set_output(const char *path)
+{
+   g_mutex_lock(&_trace_mutex);
+   if (_trace_file)
+      vkdf_error("Trace output already open, ignoring '%s'\n", path);
+   else {
+      g_free(_trace_path);
+      _trace_path = g_strdup(path);
+   }
+   g_mutex_unlock(&_trace_mutex);
+}
+
+// Called with the trace mutex held
+static bool
+open_output()
+{
+   if (_trace_file)
+      return true;
+
+   const char *path = _trace_path ? _trace_path : TRACE_DEFAULT_OUTPUT;
+   _trace_file = fopen(path, "w");
+   if (!_trace_file) {
+      vkdf_error("Failed to open trace output file '%s'\n", path);
+      return false;
+   }
+
+   // Chrome trace event format. CPU threads go in process 1 and GPU scopes
+   // in process 2 so they show as separate tracks.
+   fprintf(_trace_file,
+           "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+           "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+           "\"args\":{\"name\":\"CPU\"}},\n"
+           "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+           "\"args\":{\"name\":\"GPU\"}}");
+
+   return true;
+}
+
+// Called with the trace mutex held
+static void
+drain_ring(TraceRing *ring)
+{
+   uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+   uint32_t head = ring->head.load(std::memory_order_acquire);
+
+   for (; tail != head; tail++) {
+      TraceEvent *ev = &ring->events[tail & (TRACE_RING_SIZE - 1)];
+
+      // Events recorded before the trace started (GPU events can be
+      // calibrated to earlier times) are clamped to the start.
+      uint64_t start_ns =
+         ev->start_ns > _trace_base_ns ? ev->start_ns - _trace_base_ns : 0;
+      uint64_t dur_ns =
+         ev->end_ns > ev->start_ns ? ev->end_ns - ev->start_ns : 0;
+
+      fprintf(_trace_file,
+              ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+              "\"pid\":%u,\"tid\":%u}",
+              ev->name, start_ns / 1000.0, dur_ns / 1000.0,
+              ev->gpu ? 2 : 1, ev->gpu ? 0 : ring->tid);
+   }
+
+   ring->tail.store(tail, std::memory_order_release);
+
+   uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+   if (dropped > 0)
+      vkdf_info("Trace: thread %u dropped %" PRIu64 " events\n",
+                ring->tid, dropped);
+}
+
+/**
+ * Writes all pending events from all threads to the trace output. This is
+ * called automatically at exit, but applications that run for a long time
+ * should call it periodically so the per-thread rings don't fill up.
+ */
+void
+vkdf_trace_flush()
+{
+   g_mutex_lock(&_trace_mutex);
+   if (open_output()) {
+      for (uint32_t i = 0; i < _trace_rings.size(); i++)
+         drain_ring(_trace_rings[i]);
+      fflush(_trace_file);
+   }
+   g_mutex_unlock(&_trace_mutex);
+}
+
+static void
+trace_finish()
+{
+   vkdf_trace_flush();
+
+   g_mutex_lock(&_trace_mutex);
+   if (_trace_file) {
+      fprintf(_trace_file, "\n]}\n");
+      fclose(_trace_file);
+      _trace_file = NULL;
+   }
+   g_mutex_unlock(&_trace_mutex);
+}
+
+#endif
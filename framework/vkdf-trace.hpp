@@ -0,0 +1,74 @@
+#ifndef __VKDF_TRACE_H__
+#define __VKDF_TRACE_H__
+
+#include <time.h>
+
+/**
+ * Monotonic clock used for all trace events, in nanoseconds. GPU timestamps
+ * are converted to this time base before they are added to the trace.
+ */
+static inline uint64_t
+vkdf_trace_now_ns()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t) ts.tv_sec) * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+#if VKDF_TRACE_ENABLE
+
+void
+vkdf_trace_set_output(const char *path);
+
+void
+vkdf_trace_cpu_event(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+void
+vkdf_trace_gpu_event(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+void
+vkdf_trace_flush();
+
+struct VkdfTraceScope {
+   const char *name;
+   uint64_t start_ns;
+
+   VkdfTraceScope(const char *_name)
+   {
+      name = _name;
+      start_ns = vkdf_trace_now_ns();
+   }
+
+   ~VkdfTraceScope()
+   {
+      vkdf_trace_cpu_event(name, start_ns, vkdf_trace_now_ns());
+   }
+};
+
+#define _VKDF_TRACE_CONCAT2(a, b) a##b
+#define _VKDF_TRACE_CONCAT(a, b) _VKDF_TRACE_CONCAT2(a, b)
+
+// Traces the enclosing scope. 'name' must be a string literal (or otherwise
+// outlive the program) since only the pointer is recorded.
+#define VKDF_TRACE_SCOPE(name) \
+   VkdfTraceScope _VKDF_TRACE_CONCAT(_vkdf_trace_scope_, __LINE__)(name)
+
+#else
+
+#define VKDF_TRACE_SCOPE(name)
+
+static inline void
+vkdf_trace_set_output(const char *path) { }
+
+static inline void
+vkdf_trace_cpu_event(const char *name, uint64_t start_ns, uint64_t end_ns) { }
+
+static inline void
+vkdf_trace_gpu_event(const char *name, uint64_t start_ns, uint64_t end_ns) { }
+
+static inline void
+vkdf_trace_flush() { }
+
+#endif
+
+#endif
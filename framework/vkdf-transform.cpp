@@ -0,0 +1,303 @@
+#include "vkdf.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static void
+store_resize(VkdfTransformStore *store, uint32_t capacity)
+{
+   store->pos_x = g_renew(float, store->pos_x, capacity);
+   store->pos_y = g_renew(float, store->pos_y, capacity);
+   store->pos_z = g_renew(float, store->pos_z, capacity);
+   store->rot_x = g_renew(float, store->rot_x, capacity);
+   store->rot_y = g_renew(float, store->rot_y, capacity);
+   store->rot_z = g_renew(float, store->rot_z, capacity);
+   store->rot_w = g_renew(float, store->rot_w, capacity);
+   store->scale_x = g_renew(float, store->scale_x, capacity);
+   store->scale_y = g_renew(float, store->scale_y, capacity);
+   store->scale_z = g_renew(float, store->scale_z, capacity);
+   store->dirty = g_renew(uint8_t, store->dirty, capacity);
+   store->dirty_list = g_renew(uint32_t, store->dirty_list, capacity);
+   store->objects = g_renew(VkdfObject *, store->objects, capacity);
+   store->capacity = capacity;
+}
+
+/**
+ * Creates an empty store with room for 'capacity' transforms. The store
+ * grows as needed when transforms are added.
+ */
+VkdfTransformStore *
+vkdf_transform_store_new(uint32_t capacity)
+{
+   VkdfTransformStore *store = g_new0(VkdfTransformStore, 1);
+   store_resize(store, MAX(capacity, 1));
+   return store;
+}
+
+/**
+ * Frees the store. Objects added to it are detached, so they can still be
+ * moved afterwards.
+ */
+void
+vkdf_transform_store_free(VkdfTransformStore *store)
+{
+   for (uint32_t i = 0; i < store->count; i++) {
+      if (store->objects[i])
+         store->objects[i]->transforms = NULL;
+   }
+
+   g_free(store->pos_x);
+   g_free(store->pos_y);
+   g_free(store->pos_z);
+   g_free(store->rot_x);
+   g_free(store->rot_y);
+   g_free(store->rot_z);
+   g_free(store->rot_w);
+   g_free(store->scale_x);
+   g_free(store->scale_y);
+   g_free(store->scale_z);
+   g_free(store->dirty);
+   g_free(store->dirty_list);
+   g_free(store->objects);
+   g_free(store);
+}
+
+/**
+ * Adds a transform and returns its index. 'rot' must be a unit quaternion.
+ * New transforms are dirty until the next flush.
+ */
+uint32_t
+vkdf_transform_store_add(VkdfTransformStore *store,
+                         const glm::vec3 &pos,
+                         const glm::quat &rot,
+                         const glm::vec3 &scale)
+{
+   if (store->count == store->capacity)
+      store_resize(store, store->capacity * 2);
+
+   uint32_t idx = store->count++;
+   store->dirty[idx] = 0;
+   store->objects[idx] = NULL;
+   vkdf_transform_store_set_position(store, idx, pos);
+   vkdf_transform_store_set_rotation(store, idx, rot);
+   vkdf_transform_store_set_scale(store, idx, scale);
+   return idx;
+}
+
+/**
+ * Adds a transform with the position, rotation and scale of 'obj' and
+ * attaches the object to it: from then on, the object's setters update
+ * the transform and mark it dirty. An object can only be in one store.
+ */
+uint32_t
+vkdf_transform_store_add_object(VkdfTransformStore *store, VkdfObject *obj)
+{
+   assert(obj->transforms == NULL);
+
+   glm::vec3 rot = glm::vec3(DEG_TO_RAD(obj->rot.x),
+                             DEG_TO_RAD(obj->rot.y),
+                             DEG_TO_RAD(obj->rot.z));
+   uint32_t idx = vkdf_transform_store_add(store, obj->pos, glm::quat(rot),
+                                           obj->scale);
+
+   store->objects[idx] = obj;
+   obj->transforms = store;
+   obj->transform_idx = idx;
+
+   return idx;
+}
+
+static inline void
+compute_matrix(const VkdfTransformStore *store, uint32_t i, float *m)
+{
+   float x = store->rot_x[i], y = store->rot_y[i];
+   float z = store->rot_z[i], w = store->rot_w[i];
+   float sx = store->scale_x[i], sy = store->scale_y[i];
+   float sz = store->scale_z[i];
+
+   m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+   m[1] = 2.0f * (x * y + w * z) * sx;
+   m[2] = 2.0f * (x * z - w * y) * sx;
+   m[3] = 0.0f;
+
+   m[4] = 2.0f * (x * y - w * z) * sy;
+   m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+   m[6] = 2.0f * (y * z + w * x) * sy;
+   m[7] = 0.0f;
+
+   m[8] = 2.0f * (x * z + w * y) * sz;
+   m[9] = 2.0f * (y * z - w * x) * sz;
+   m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+   m[11] = 0.0f;
+
+   m[12] = store->pos_x[i];
+   m[13] = store->pos_y[i];
+   m[14] = store->pos_z[i];
+   m[15] = 1.0f;
+}
+
+#ifdef __SSE2__
+// Writes one column for each of 4 consecutive transforms, given the column
+// elements of all 4 of them in SoA form
+static inline void
+store_columns(uint8_t *dst, uint32_t dst_stride,
+              __m128 c0, __m128 c1, __m128 c2, __m128 c3)
+{
+   _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+   _mm_storeu_ps((float *) (dst + 0 * dst_stride), c0);
+   _mm_storeu_ps((float *) (dst + 1 * dst_stride), c1);
+   _mm_storeu_ps((float *) (dst + 2 * dst_stride), c2);
+   _mm_storeu_ps((float *) (dst + 3 * dst_stride), c3);
+}
+#endif
+
+/**
+ * Writes the model matrices (column-major mat4) of transforms 'first' to
+ * 'first + count - 1' to 'dst', one every 'dst_stride' bytes. 'dst' is
+ * typically a mapped uniform or instance buffer, it is only written to.
+ */
+void
+vkdf_transform_store_compute_matrices(VkdfTransformStore *store,
+                                      uint32_t first,
+                                      uint32_t count,
+                                      uint8_t *dst,
+                                      uint32_t dst_stride)
+{
+   VKDF_TRACE_SCOPE("vkdf_transform_store_compute_matrices");
+
+   assert(first + count <= store->count);
+
+   uint32_t i = first;
+   uint32_t end = first + count;
+
+#ifdef __SSE2__
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 two = _mm_set1_ps(2.0f);
+   const __m128 zero = _mm_setzero_ps();
+
+   for (; i + 4 <= end; i += 4) {
+      __m128 x = _mm_loadu_ps(store->rot_x + i);
+      __m128 y = _mm_loadu_ps(store->rot_y + i);
+      __m128 z = _mm_loadu_ps(store->rot_z + i);
+      __m128 w = _mm_loadu_ps(store->rot_w + i);
+
+      __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+      __m128 zz = _mm_mul_ps(z, z);
+      __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z);
+      __m128 yz = _mm_mul_ps(y, z);
+      __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y);
+      __m128 wz = _mm_mul_ps(w, z);
+
+      __m128 sx = _mm_loadu_ps(store->scale_x + i);
+      __m128 sy = _mm_loadu_ps(store->scale_y + i);
+      __m128 sz = _mm_loadu_ps(store->scale_z + i);
+
+      uint8_t *out = dst + (size_t) (i - first) * dst_stride;
+
+      // Column 0: rotated X axis scaled by sx
+      __m128 m00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+      __m128 m10 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+      __m128 m20 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+      store_columns(out, dst_stride,
+                    _mm_mul_ps(m00, sx), _mm_mul_ps(m10, sx),
+                    _mm_mul_ps(m20, sx), zero);
+
+      // Column 1: rotated Y axis scaled by sy
+      __m128 m01 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+      __m128 m11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+      __m128 m21 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+      store_columns(out + 16, dst_stride,
+                    _mm_mul_ps(m01, sy), _mm_mul_ps(m11, sy),
+                    _mm_mul_ps(m21, sy), zero);
+
+      // Column 2: rotated Z axis scaled by sz
+      __m128 m02 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+      __m128 m12 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+      __m128 m22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+      store_columns(out + 32, dst_stride,
+                    _mm_mul_ps(m02, sz), _mm_mul_ps(m12, sz),
+                    _mm_mul_ps(m22, sz), zero);
+
+      // Column 3: translation
+      store_columns(out + 48, dst_stride,
+                    _mm_loadu_ps(store->pos_x + i),
+                    _mm_loadu_ps(store->pos_y + i),
+                    _mm_loadu_ps(store->pos_z + i), one);
+   }
+#endif
+
+   for (; i < end; i++) {
+      float m[16];
+      compute_matrix(store, i, m);
+      memcpy(dst + (size_t) (i - first) * dst_stride, m, sizeof(m));
+   }
+}
+
+/**
+ * Writes the model matrices of the transforms that changed since the last
+ * flush to 'map', the persistently mapped memory of 'buf', one matrix
+ * every 'stride' bytes from the start of the buffer, and flushes the
+ * modified ranges. Returns the number of matrices written.
+ */
+uint32_t
+vkdf_transform_store_flush(VkdfContext *ctx,
+                           VkdfTransformStore *store,
+                           VkdfBuffer *buf,
+                           uint8_t *map,
+                           uint32_t stride)
+{
+   VKDF_TRACE_SCOPE("vkdf_transform_store_flush");
+
+   if (store->num_dirty == 0)
+      return 0;
+
+   std::sort(store->dirty_list, store->dirty_list + store->num_dirty);
+
+   std::vector<VkMappedMemoryRange> ranges;
+   uint32_t num_written = 0;
+
+   uint32_t i = 0;
+   while (i < store->num_dirty) {
+      // Coalesce dirty transforms that are close enough into a single run
+      uint32_t first = store->dirty_list[i];
+      uint32_t last = first;
+      store->dirty[first] = 0;
+      for (i++; i < store->num_dirty; i++) {
+         uint32_t idx = store->dirty_list[i];
+         if (idx - last > VKDF_TRANSFORM_FLUSH_MAX_GAP)
+            break;
+         store->dirty[idx] = 0;
+         last = idx;
+      }
+
+      uint32_t count = last - first + 1;
+      vkdf_transform_store_compute_matrices(store, first, count,
+                                            map + (size_t) first * stride,
+                                            stride);
+      num_written += count;
+
+      // Merge with the previous range if they touch after alignment
+      VkMappedMemoryRange range =
+         vkdf_buffer_get_flush_range(ctx, buf, first * (VkDeviceSize) stride,
+                                     count * (VkDeviceSize) stride);
+      if (ranges.size() > 0) {
+         VkMappedMemoryRange &prev = ranges.back();
+         if (range.offset <= prev.offset + prev.size) {
+            prev.size = range.offset + range.size - prev.offset;
+            continue;
+         }
+      }
+      ranges.push_back(range);
+   }
+
+   VK_CHECK(vkFlushMappedMemoryRanges(ctx->device,
+                                      ranges.size(), ranges.data()));
+   _vkdf_stats_count(VKDF_STAT_UPLOAD_BYTES,
+                     num_written * (uint64_t) sizeof(glm::mat4));
+
+   store->num_dirty = 0;
+   return num_written;
+}
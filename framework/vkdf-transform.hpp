@@ -0,0 +1,136 @@
+#ifndef __VKDF_TRANSFORM_H__
+#define __VKDF_TRANSFORM_H__
+
+/**
+ * Transform store.
+ *
+ * Keeps the translation, rotation (unit quaternion) and scale of many
+ * objects in structure-of-arrays form, one array per component, so
+ * model matrices can be computed for 4 transforms at a time with SSE and
+ * written straight to a mapped buffer with
+ * vkdf_transform_store_compute_matrices(). Matrices are the same that
+ * vkdf_object_get_model_matrix() produces: translate * rotate * scale.
+ *
+ * The store also tracks which transforms changed since the last call to
+ * vkdf_transform_store_flush(), which recomputes only those and flushes
+ * the ranges of the buffer they were written to, so updating a mostly
+ * static scene every frame costs close to nothing.
+ *
+ * Objects added with vkdf_transform_store_add_object() keep a reference
+ * to their transform, and the vkdf_object_set_*() setters update it and
+ * mark it dirty, so registered objects can be moved through the object
+ * API as usual. Their transforms should not be changed through the store
+ * setters, which would leave the objects' own fields out of date.
+ */
+
+/**
+ * Dirty transforms that are at most this many transforms apart are
+ * recomputed and flushed as a single range, including the clean ones in
+ * between, rather than as separate ranges.
+ */
+#define VKDF_TRANSFORM_FLUSH_MAX_GAP 8
+
+typedef struct _VkdfTransformStore {
+   uint32_t count;
+   uint32_t capacity;
+
+   float *pos_x;
+   float *pos_y;
+   float *pos_z;
+
+   float *rot_x;
+   float *rot_y;
+   float *rot_z;
+   float *rot_w;
+
+   float *scale_x;
+   float *scale_y;
+   float *scale_z;
+
+   // Transforms changed since the last flush, in no particular order, and
+   // a flag per transform so they are listed only once
+   uint8_t *dirty;
+   uint32_t *dirty_list;
+   uint32_t num_dirty;
+
+   // The object each transform was added for, or NULL
+   VkdfObject **objects;
+} VkdfTransformStore;
+
+VkdfTransformStore *
+vkdf_transform_store_new(uint32_t capacity);
+
+void
+vkdf_transform_store_free(VkdfTransformStore *store);
+
+uint32_t
+vkdf_transform_store_add(VkdfTransformStore *store,
+                         const glm::vec3 &pos,
+                         const glm::quat &rot,
+                         const glm::vec3 &scale);
+
+uint32_t
+vkdf_transform_store_add_object(VkdfTransformStore *store, VkdfObject *obj);
+
+inline void
+vkdf_transform_store_mark_dirty(VkdfTransformStore *store, uint32_t idx)
+{
+   assert(idx < store->count);
+   if (!store->dirty[idx]) {
+      store->dirty[idx] = 1;
+      store->dirty_list[store->num_dirty++] = idx;
+   }
+}
+
+inline void
+vkdf_transform_store_set_position(VkdfTransformStore *store,
+                                  uint32_t idx,
+                                  const glm::vec3 &pos)
+{
+   assert(idx < store->count);
+   store->pos_x[idx] = pos.x;
+   store->pos_y[idx] = pos.y;
+   store->pos_z[idx] = pos.z;
+   vkdf_transform_store_mark_dirty(store, idx);
+}
+
+inline void
+vkdf_transform_store_set_rotation(VkdfTransformStore *store,
+                                  uint32_t idx,
+                                  const glm::quat &rot)
+{
+   assert(idx < store->count);
+   store->rot_x[idx] = rot.x;
+   store->rot_y[idx] = rot.y;
+   store->rot_z[idx] = rot.z;
+   store->rot_w[idx] = rot.w;
+   vkdf_transform_store_mark_dirty(store, idx);
+}
+
+inline void
+vkdf_transform_store_set_scale(VkdfTransformStore *store,
+                               uint32_t idx,
+                               const glm::vec3 &scale)
+{
+   assert(idx < store->count);
+   store->scale_x[idx] = scale.x;
+   store->scale_y[idx] = scale.y;
+   store->scale_z[idx] = scale.z;
+   vkdf_transform_store_mark_dirty(store, idx);
+}
+
+void
+vkdf_transform_store_compute_matrices(VkdfTransformStore *store,
+                                      uint32_t first,
+                                      uint32_t count,
+                                      uint8_t *dst,
+                                      uint32_t dst_stride);
+
+uint32_t
+vkdf_transform_store_flush(VkdfContext *ctx,
+                           VkdfTransformStore *store,
+                           VkdfBuffer *buf,
+                           uint8_t *map,
+                           uint32_t stride);
+
+#endif
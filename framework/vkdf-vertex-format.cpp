@@ -0,0 +1,268 @@
+#include "vkdf.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+uint32_t
+vkdf_vertex_format_get_stride(VkdfVertexFormat format, bool has_uv)
+{
+   switch (format) {
+   case VKDF_VERTEX_FORMAT_FLOAT:
+      return 2 * sizeof(glm::vec3) + (has_uv ? sizeof(glm::vec2) : 0);
+   case VKDF_VERTEX_FORMAT_COMPACT:
+      return 4 * sizeof(uint16_t) +                   // position
+             2 * sizeof(int16_t) +                    // normal
+             (has_uv ? 2 * sizeof(uint16_t) : 0);     // uv
+   default:
+      assert(!"Invalid vertex format");
+      return 0;
+   }
+}
+
+/**
+ * Fills 'attribs' with the vertex attribute descriptions for 'format'
+ * sourced from 'binding' at consecutive locations starting at
+ * 'first_location'. 'attribs' must have room for 3 elements. Returns the
+ * number of attributes.
+ */
+uint32_t
+vkdf_vertex_format_get_attributes(VkdfVertexFormat format,
+                                  bool has_uv,
+                                  uint32_t binding,
+                                  uint32_t first_location,
+                                  VkVertexInputAttributeDescription *attribs)
+{
+   VkFormat formats[3];
+   uint32_t offsets[3];
+
+   switch (format) {
+   case VKDF_VERTEX_FORMAT_FLOAT:
+      formats[0] = VK_FORMAT_R32G32B32_SFLOAT;
+      formats[1] = VK_FORMAT_R32G32B32_SFLOAT;
+      formats[2] = VK_FORMAT_R32G32_SFLOAT;
+      offsets[0] = 0;
+      offsets[1] = 12;
+      offsets[2] = 24;
+      break;
+   case VKDF_VERTEX_FORMAT_COMPACT:
+      formats[0] = VK_FORMAT_R16G16B16A16_UNORM;
+      formats[1] = VK_FORMAT_R16G16_SNORM;
+      formats[2] = VK_FORMAT_R16G16_SFLOAT;
+      offsets[0] = 0;
+      offsets[1] = 8;
+      offsets[2] = 12;
+      break;
+   default:
+      assert(!"Invalid vertex format");
+      return 0;
+   }
+
+   uint32_t count = has_uv ? 3 : 2;
+   for (uint32_t i = 0; i < count; i++) {
+      attribs[i].binding = binding;
+      attribs[i].location = first_location + i;
+      attribs[i].format = formats[i];
+      attribs[i].offset = offsets[i];
+   }
+
+   return count;
+}
+
+static inline uint16_t
+float_to_half(float f)
+{
+   uint32_t x;
+   memcpy(&x, &f, sizeof(x));
+
+   uint32_t sign = (x >> 16) & 0x8000;
+   uint32_t float_exp = (x >> 23) & 0xff;
+   uint32_t mant = x & 0x7fffff;
+
+   // Inf / NaN
+   if (float_exp == 0xff)
+      return sign | 0x7c00 | (mant ? 0x200 : 0);
+
+   int32_t exp = (int32_t) float_exp - 127 + 15;
+   if (exp >= 31)
+      return sign | 0x7c00;
+
+   // Denormals, rounding to nearest
+   if (exp <= 0) {
+      if (exp < -10)
+         return sign;
+      mant |= 0x800000;
+      uint32_t shift = 14 - exp;
+      uint32_t half_mant = mant >> shift;
+      if ((mant >> (shift - 1)) & 1)
+         half_mant++;
+      return sign | half_mant;
+   }
+
+   // Rounding can carry into the exponent, which is what we want
+   uint32_t h = sign | (exp << 10) | (mant >> 13);
+   if (mant & 0x1000)
+      h++;
+   return h;
+}
+
+static inline int16_t
+float_to_snorm16(float f)
+{
+   f = CLAMP(f, -1.0f, 1.0f);
+   return (int16_t) lrintf(f * 32767.0f);
+}
+
+static void
+pack_positions_unorm16(uint32_t num_vertices,
+                       const uint8_t *src,
+                       uint32_t src_stride,
+                       const glm::vec3 &scale,
+                       const glm::vec3 &offset,
+                       uint8_t *dst,
+                       uint32_t dst_stride)
+{
+   glm::vec3 inv_scale = glm::vec3(65535.0f / scale.x,
+                                   65535.0f / scale.y,
+                                   65535.0f / scale.z);
+
+#ifdef __SSE2__
+   const __m128 v_offset = _mm_set_ps(0.0f, offset.z, offset.y, offset.x);
+   const __m128 v_inv_scale =
+      _mm_set_ps(0.0f, inv_scale.z, inv_scale.y, inv_scale.x);
+   const __m128 v_zero = _mm_setzero_ps();
+   const __m128 v_max = _mm_set1_ps(65535.0f);
+   const __m128i v_bias32 = _mm_set1_epi32(32768);
+   const __m128i v_bias16 = _mm_set1_epi16((int16_t) 0x8000);
+
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      const float *p = (const float *) (src + i * src_stride);
+      __m128 v = _mm_set_ps(0.0f, p[2], p[1], p[0]);
+      v = _mm_mul_ps(_mm_sub_ps(v, v_offset), v_inv_scale);
+      v = _mm_min_ps(_mm_max_ps(v, v_zero), v_max);
+
+      // SSE2 can only pack to signed 16-bit with saturation, so bias to
+      // the signed range, pack and flip the sign bit back
+      __m128i q = _mm_sub_epi32(_mm_cvtps_epi32(v), v_bias32);
+      q = _mm_xor_si128(_mm_packs_epi32(q, q), v_bias16);
+      _mm_storel_epi64((__m128i *) (dst + i * dst_stride), q);
+   }
+#else
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      const float *p = (const float *) (src + i * src_stride);
+      uint16_t *q = (uint16_t *) (dst + i * dst_stride);
+      for (uint32_t c = 0; c < 3; c++) {
+         float v = (p[c] - offset[c]) * inv_scale[c];
+         q[c] = (uint16_t) lrintf(CLAMP(v, 0.0f, 65535.0f));
+      }
+      q[3] = 0;
+   }
+#endif
+}
+
+static void
+pack_normals_oct16(uint32_t num_vertices,
+                   const uint8_t *src,
+                   uint32_t src_stride,
+                   uint8_t *dst,
+                   uint32_t dst_stride)
+{
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      const float *n = (const float *) (src + i * src_stride);
+      int16_t *q = (int16_t *) (dst + i * dst_stride);
+
+      // Project to the octahedron and fold the lower hemisphere over
+      float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+      if (l1 == 0.0f) {
+         q[0] = q[1] = 0;
+         continue;
+      }
+
+      float x = n[0] / l1;
+      float y = n[1] / l1;
+      if (n[2] < 0.0f) {
+         float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+         float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+         x = fx;
+         y = fy;
+      }
+
+      q[0] = float_to_snorm16(x);
+      q[1] = float_to_snorm16(y);
+   }
+}
+
+static void
+pack_uvs_half(uint32_t num_vertices,
+              const uint8_t *src,
+              uint32_t src_stride,
+              uint8_t *dst,
+              uint32_t dst_stride)
+{
+   for (uint32_t i = 0; i < num_vertices; i++) {
+      const float *uv = (const float *) (src + i * src_stride);
+      uint16_t *q = (uint16_t *) (dst + i * dst_stride);
+      q[0] = float_to_half(uv[0]);
+      q[1] = float_to_half(uv[1]);
+   }
+}
+
+static void
+copy_attrib(uint32_t num_vertices,
+            const uint8_t *src,
+            uint32_t src_stride,
+            uint32_t size,
+            uint8_t *dst,
+            uint32_t dst_stride)
+{
+   for (uint32_t i = 0; i < num_vertices; i++)
+      memcpy(dst + i * dst_stride, src + i * src_stride, size);
+}
+
+/**
+ * Writes interleaved vertex data in 'format' to 'dst' from float positions,
+ * normals and (optionally) uvs, each read with their own byte stride.
+ * 'uvs' can be NULL. 'pos_scale' and 'pos_offset' define the range
+ * compact positions are quantized to and are ignored by other formats.
+ */
+void
+vkdf_vertex_format_pack(VkdfVertexFormat format,
+                        uint32_t num_vertices,
+                        const uint8_t *positions,
+                        uint32_t position_stride,
+                        const uint8_t *normals,
+                        uint32_t normal_stride,
+                        const uint8_t *uvs,
+                        uint32_t uv_stride,
+                        const glm::vec3 &pos_scale,
+                        const glm::vec3 &pos_offset,
+                        uint8_t *dst)
+{
+   VKDF_TRACE_SCOPE("vkdf_vertex_format_pack");
+
+   uint32_t stride = vkdf_vertex_format_get_stride(format, uvs != NULL);
+
+   switch (format) {
+   case VKDF_VERTEX_FORMAT_FLOAT:
+      copy_attrib(num_vertices, positions, position_stride,
+                  sizeof(glm::vec3), dst, stride);
+      copy_attrib(num_vertices, normals, normal_stride,
+                  sizeof(glm::vec3), dst + 12, stride);
+      if (uvs) {
+         copy_attrib(num_vertices, uvs, uv_stride,
+                     sizeof(glm::vec2), dst + 24, stride);
+      }
+      break;
+   case VKDF_VERTEX_FORMAT_COMPACT:
+      pack_positions_unorm16(num_vertices, positions, position_stride,
+                             pos_scale, pos_offset, dst, stride);
+      pack_normals_oct16(num_vertices, normals, normal_stride,
+                         dst + 8, stride);
+      if (uvs)
+         pack_uvs_half(num_vertices, uvs, uv_stride, dst + 12, stride);
+      break;
+   default:
+      assert(!"Invalid vertex format");
+      break;
+   }
+}
@@ -0,0 +1,59 @@
+#ifndef __VKDF_VERTEX_FORMAT_H__
+#define __VKDF_VERTEX_FORMAT_H__
+
+/**
+ * Vertex buffer layouts for meshes. Attributes are listed in the order
+ * of their shader locations, starting at the location passed to
+ * vkdf_vertex_format_get_attributes().
+ *
+ * VKDF_VERTEX_FORMAT_FLOAT (24 bytes, 32 with uv):
+ *    position: R32G32B32_SFLOAT
+ *    normal: R32G32B32_SFLOAT
+ *    uv: R32G32_SFLOAT
+ *
+ * VKDF_VERTEX_FORMAT_COMPACT (12 bytes, 16 with uv):
+ *    position: R16G16B16A16_UNORM, quantized to the mesh's bounding box.
+ *              Shaders recover the position as
+ *              pos.xyz * pos_scale + pos_offset, using the mesh's
+ *              pos_scale and pos_offset. The w component is 0.
+ *    normal: R16G16_SNORM, octahedral encoding
+ *    uv: R16G16_SFLOAT
+ *
+ * Decoding compact normals in GLSL:
+ *
+ *    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+ *    if (n.z < 0.0)
+ *       n.xy = (1.0 - abs(n.yx)) *
+ *              vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+ *    n = normalize(n);
+ */
+
+typedef enum {
+   VKDF_VERTEX_FORMAT_FLOAT = 0,
+   VKDF_VERTEX_FORMAT_COMPACT,
+} VkdfVertexFormat;
+
+uint32_t
+vkdf_vertex_format_get_stride(VkdfVertexFormat format, bool has_uv);
+
+uint32_t
+vkdf_vertex_format_get_attributes(VkdfVertexFormat format,
+                                  bool has_uv,
+                                  uint32_t binding,
+                                  uint32_t first_location,
+                                  VkVertexInputAttributeDescription *attribs);
+
+void
+vkdf_vertex_format_pack(VkdfVertexFormat format,
+                        uint32_t num_vertices,
+                        const uint8_t *positions,
+                        uint32_t position_stride,
+                        const uint8_t *normals,
+                        uint32_t normal_stride,
+                        const uint8_t *uvs,
+                        uint32_t uv_stride,
+                        const glm::vec3 &pos_scale,
+                        const glm::vec3 &pos_offset,
+                        uint8_t *dst);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <glib.h>
 
@@ -25,6 +26,64 @@
 
 #define VKDF_LOG_FPS_ENABLE 1
 
+// Per-frame command and upload counters (see vkdf-stats.hpp)
+#ifndef VKDF_STATS_ENABLE
+#define VKDF_STATS_ENABLE 1
+#endif
+#define VKDF_LOG_STATS_ENABLE 0
+
+// Cache imported models in a binary format (see vkdf-model-cache.hpp)
+#ifndef VKDF_MODEL_CACHE_ENABLE
+#define VKDF_MODEL_CACHE_ENABLE 1
+#endif
+
+// Upload 16-bit indices for meshes with up to 65536 vertices
+#ifndef VKDF_MESH_16BIT_INDICES_ENABLE
+#define VKDF_MESH_16BIT_INDICES_ENABLE 1
+#endif
+
+// Maximum number of threads used to convert meshes when importing models.
+// Set to 1 to import on the calling thread only.
+#ifndef VKDF_MODEL_IMPORT_MAX_THREADS
+#define VKDF_MODEL_IMPORT_MAX_THREADS 8
+#endif
+
+// Optimize imported meshes for vertex cache, overdraw and vertex fetch
+// locality (see vkdf-mesh-optimize.hpp)
+#ifndef VKDF_MODEL_OPTIMIZE_ENABLE
+#define VKDF_MODEL_OPTIMIZE_ENABLE 1
+#endif
+#define VKDF_LOG_MODEL_OPTIMIZE_ENABLE 0
+
+// Number of levels of detail generated for imported meshes, including the
+// full-detail mesh (see vkdf-mesh-lod.hpp). Set to 1 to disable.
+#ifndef VKDF_MODEL_NUM_LODS
+#define VKDF_MODEL_NUM_LODS 4
+#endif
+
+// Split imported meshes into meshlets for cluster culling (see
+// vkdf-meshlet.hpp and vkdf-meshlet-cull.hpp)
+#ifndef VKDF_MODEL_MESHLETS_ENABLE
+#define VKDF_MODEL_MESHLETS_ENABLE 1
+#endif
+
+// Maximum number of threads used to cull large object sets (see
+// vkdf-cull.hpp). Set to 1 to cull on the calling thread only.
+#ifndef VKDF_CULL_MAX_THREADS
+#define VKDF_CULL_MAX_THREADS 8
+#endif
+
+// Maximum number of threads used to sort large draw lists (see
+// vkdf-draw-list.hpp). Set to 1 to sort on the calling thread only.
+#ifndef VKDF_DRAW_LIST_MAX_THREADS
+#define VKDF_DRAW_LIST_MAX_THREADS 8
+#endif
+
+// Scoped CPU trace events written as Chrome trace JSON (see vkdf-trace.hpp)
+#ifndef VKDF_TRACE_ENABLE
+#define VKDF_TRACE_ENABLE 0
+#endif
+
 #define PI ((float) M_PI)
 #define DEG_TO_RAD(x) ((float)((x) * PI / 180.0f))
 #define RAD_TO_DEG(x) ((float)((x) * 180.0f / PI))
@@ -58,6 +117,8 @@ struct _VkdfContext {
    VkPhysicalDevice phy_device;
    VkPhysicalDeviceProperties phy_device_props;
    VkPhysicalDeviceMemoryProperties phy_device_mem_props;
+   VkPhysicalDeviceFeatures phy_device_features;
+   VkPhysicalDeviceFeatures device_features;
    uint32_t queue_count;
    VkQueueFamilyProperties *queues;
    int32_t gfx_queue_index;
@@ -68,7 +129,8 @@ struct _VkdfContext {
    uint32_t device_extension_count;
    const char **device_extensions;
 
-   // Window and surface
+   // Window and surface (not available for headless contexts)
+   bool headless;
    GLFWwindow *window;
    VkSurfaceKHR surface;
    VkSurfaceCapabilitiesKHR surface_caps;
@@ -93,9 +155,12 @@ struct _VkdfContext {
 typedef struct _VkdfContext VkdfContext;
 
 #include "vkdf-error.hpp"
+#include "vkdf-trace.hpp"
 #include "vkdf-init.hpp"
 #include "vkdf-event-loop.hpp"
+#include "vkdf-stats.hpp"
 #include "vkdf-cmd-buffer.hpp"
+#include "vkdf-submit.hpp"
 #include "vkdf-buffer.hpp"
 #include "vkdf-memory.hpp"
 #include "vkdf-shader.hpp"
@@ -105,10 +170,27 @@ typedef struct _VkdfContext VkdfContext;
 #include "vkdf-descriptor.hpp"
 #include "vkdf-barrier.hpp"
 #include "vkdf-semaphore.hpp"
+#include "vkdf-box.hpp"
+#include "vkdf-vertex-format.hpp"
+#include "vkdf-meshlet.hpp"
 #include "vkdf-mesh.hpp"
+#include "vkdf-mesh-optimize.hpp"
+#include "vkdf-mesh-lod.hpp"
 #include "vkdf-model.hpp"
+#include "vkdf-model-cache.hpp"
+#include "vkdf-bundle.hpp"
+#include "vkdf-camera.hpp"
 #include "vkdf-object.hpp"
+#include "vkdf-transform.hpp"
+#include "vkdf-cull.hpp"
+#include "vkdf-bvh.hpp"
+#include "vkdf-hiz.hpp"
+#include "vkdf-gpu-cull.hpp"
+#include "vkdf-meshlet-cull.hpp"
+#include "vkdf-batch.hpp"
+#include "vkdf-draw-list.hpp"
+#include "vkdf-static-batch.hpp"
 #include "vkdf-light.hpp"
-#include "vkdf-camera.hpp"
+#include "vkdf-query.hpp"
 
 #endif
@@ -0,0 +1,131 @@
+#include "vkdf.hpp"
+
+// ----------------------------------------------------------------------------
+// Packs models and raw data files into an asset bundle (see vkdf-bundle.hpp)
+//
+// Usage: vkdf-pack [--lz4] [--chunk-size=N] -o OUTPUT [NAME=]PATH...
+//
+// Files with an extension that Assimp can import are packed as models, any
+// other file is packed as a raw data section. Sections are named after the
+// file's basename unless a NAME is given. Packing is deterministic: the
+// same inputs and options always produce the same bundle.
+// ----------------------------------------------------------------------------
+
+static void
+usage(const char *prog)
+{
+   vkdf_fatal("Usage: %s [--lz4] [--chunk-size=N] -o OUTPUT [NAME=]PATH...",
+              prog);
+}
+
+static uint32_t
+parse_uint_option(const char *arg, const char *name)
+{
+   char *end;
+   unsigned long value = strtoul(arg, &end, 10);
+   if (*arg == '\0' || *end != '\0' || value == 0 || value > 0x7fffffff)
+      vkdf_fatal("Invalid value for option '%s': '%s'", name, arg);
+   return (uint32_t) value;
+}
+
+static bool
+is_model(const char *path)
+{
+   const char *ext = strrchr(path, '.');
+   return ext && aiIsExtensionSupported(ext) == AI_TRUE;
+}
+
+static bool
+pack_model(VkdfBundleWriter *writer, const char *name, const char *path)
+{
+   // Always import from source, we don't want to depend on the state of the
+   // model cache. Import failures are fatal.
+   VkdfModel *model = vkdf_model_import(path);
+
+   bool ok = vkdf_bundle_writer_add_model(writer, name, model);
+   vkdf_model_free(NULL, model);
+
+   return ok;
+}
+
+static bool
+pack_raw(VkdfBundleWriter *writer, const char *name, const char *path)
+{
+   gchar *data;
+   gsize size;
+   if (!g_file_get_contents(path, &data, &size, NULL)) {
+      vkdf_error("Failed to read '%s'", path);
+      return false;
+   }
+
+   bool ok = vkdf_bundle_writer_add_data(writer, name,
+                                         VKDF_BUNDLE_SECTION_RAW,
+                                         data, size);
+   g_free(data);
+
+   return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+   VkdfBundleCompression compression = VKDF_BUNDLE_COMPRESSION_NONE;
+   uint32_t chunk_size = VKDF_BUNDLE_DEFAULT_CHUNK_SIZE;
+   const char *output = NULL;
+   std::vector<const char *> inputs;
+
+   for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "--lz4")) {
+         compression = VKDF_BUNDLE_COMPRESSION_LZ4;
+      } else if (g_str_has_prefix(argv[i], "--chunk-size=")) {
+         chunk_size = parse_uint_option(argv[i] + strlen("--chunk-size="),
+                                        "--chunk-size");
+      } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+         output = argv[++i];
+      } else if (argv[i][0] == '-') {
+         usage(argv[0]);
+      } else {
+         inputs.push_back(argv[i]);
+      }
+   }
+
+   if (!output || inputs.size() == 0)
+      usage(argv[0]);
+
+   VkdfBundleWriter *writer =
+      vkdf_bundle_writer_new(output, compression, chunk_size);
+   if (!writer)
+      return 1;
+
+   bool ok = true;
+   for (uint32_t i = 0; ok && i < inputs.size(); i++) {
+      const char *path = inputs[i];
+      char *name;
+
+      const char *sep = strchr(path, '=');
+      if (sep) {
+         name = g_strndup(path, sep - path);
+         path = sep + 1;
+      } else {
+         name = g_path_get_basename(path);
+      }
+
+      if (is_model(path)) {
+         vkdf_info("Packing model '%s' from '%s'\n", name, path);
+         ok = pack_model(writer, name, path);
+      } else {
+         vkdf_info("Packing data '%s' from '%s'\n", name, path);
+         ok = pack_raw(writer, name, path);
+      }
+
+      g_free(name);
+   }
+
+   // Don't leave an incomplete bundle behind
+   if (!ok)
+      writer->failed = true;
+
+   ok = vkdf_bundle_writer_finish(writer) && ok;
+
+   return ok ? 0 : 1;
+}